@@ -1,6 +1,9 @@
 #include "MPEngine.hpp"
 
 #include <CSCI441/objects.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 //*************************************************************************************
@@ -16,20 +19,25 @@ GLfloat getRand() {
     return (GLfloat)rand() / (GLfloat)RAND_MAX;
 }
 
+/// \desc object space bounds of the environment meshes
+static const BoundingBox BUILDING_BOUNDS = { glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.5f, 0.5f) };
+static const BoundingBox TRUNK_BOUNDS = { glm::vec3(-0.5f, 0.0f, -0.5f), glm::vec3(0.5f, 1.0f, 0.5f) };
+static const BoundingBox LEAF_BOUNDS = { glm::vec3(-0.75f, 0.0f, -0.75f), glm::vec3(0.75f, 2.0f, 0.75f) };
+
+/// \desc colors of the point and spot light while they are on
+static const glm::vec3 POINT_LIGHT_COLOR(1.0f, 1.0f, 1.0f);
+static const glm::vec3 SPOT_LIGHT_COLOR(1.0f, 1.0f, 1.0f);
+
 //*************************************************************************************
 //
 // Public Interface
 
-MPEngine::MPEngine()
+MPEngine::MPEngine(bool isHeadless)
          : CSCI441::OpenGLEngine(4, 1,
                                  640, 480,
-                                 "MP: The Fellowship") {
+                                 "MP: The Fellowship"),
+           _isHeadless(isHeadless) {
 
-    for(auto& _key : _keys) _key = GL_FALSE;
-
-    _mousePosition = glm::vec2(MOUSE_UNINITIALIZED, MOUSE_UNINITIALIZED );
-    _leftMouseButtonState = GLFW_RELEASE;
-    _modelChoice = 0;
 }
 
 MPEngine::~MPEngine() {
@@ -38,8 +46,10 @@ MPEngine::~MPEngine() {
 }
 
 void MPEngine::handleKeyEvent(GLint key, GLint action) {
-    if(key != GLFW_KEY_UNKNOWN)
-        _keys[key] = ((action == GLFW_PRESS) || (action == GLFW_REPEAT));
+    // movement, camera and character choice belong to the simulation, it sees them at its next tick
+    _simulation->pushInput( { InputEvent::KEY, key, action, glm::vec2(0.0f) } );
+    // the toggles below change the picture without the simulation changing anything
+    if(action == GLFW_PRESS) _redrawScheduler->requestRedraw();
 
     if(action == GLFW_PRESS) {
         switch( key ) {
@@ -48,87 +58,131 @@ void MPEngine::handleKeyEvent(GLint key, GLint action) {
             case GLFW_KEY_ESCAPE:
                 setWindowShouldClose();
                 break;
-            case GLFW_KEY_LEFT_SHIFT:
-            case GLFW_KEY_RIGHT_SHIFT:
-                _shiftButtonState = GLFW_PRESS;
+            case GLFW_KEY_4:
+                firstPersonOn = !firstPersonOn;
+                // whatever the inset showed when it was last on is stale by now
+                _firstPersonView->invalidate();
                 break;
-            case GLFW_KEY_UP:
-                _changeCamera(true);
+            case GLFW_KEY_5:
+                _splitScreenOn = !_splitScreenOn;
+                _firstPersonView->invalidate();
                 break;
-            case GLFW_KEY_DOWN:
-                _changeCamera(false);
+            case GLFW_KEY_L:
+                _staticLayerCacheOn = !_staticLayerCacheOn;
+                _staticLayerCache->invalidate();
+                fprintf( stdout, "[INFO]: static layer cache %s\n", _staticLayerCacheOn ? "on" : "off" );
                 break;
-            case GLFW_KEY_1:
-                _modelChoice = 0;
-                _arcballCam->setPosition(_motorcycle->getPosition());
-                _arcballCam->setLookAtPoint(_motorcycle->getPosition());
-                _arcballCam->recomputeOrientation();
+            case GLFW_KEY_P:
+                _depthPrePassOn = !_depthPrePassOn;
+                fprintf( stdout, "[INFO]: depth pre-pass %s\n", _depthPrePassOn ? "on" : "off" );
                 break;
-            case GLFW_KEY_2:
-                _modelChoice = 1;
-                _arcballCam->setPosition(_bobomb->getPosition());
-                _arcballCam->setLookAtPoint(_bobomb->getPosition());
-                _arcballCam->recomputeOrientation();
+            case GLFW_KEY_B:
+                _bakedLightingOn = !_bakedLightingOn;
+                _staticLayerCache->invalidate();
+                fprintf( stdout, "[INFO]: %s lighting for the ground, buildings and trees\n", _bakedLightingOn ? "baked" : "real-time" );
                 break;
-            case GLFW_KEY_3:
-                _modelChoice = 2;
-                _arcballCam->setPosition(_robot->getPosition()+_robot->cameraOffset());
-                _arcballCam->setLookAtPoint(_robot->getPosition()+_robot->cameraOffset());
-                _arcballCam->recomputeOrientation();
+            case GLFW_KEY_N:
+                _pointLightOn = !_pointLightOn;
+                _applyLightToggles();
+                fprintf( stdout, "[INFO]: point light %s\n", _pointLightOn ? "on" : "off" );
                 break;
-            case GLFW_KEY_4:
-                firstPersonOn = !firstPersonOn;
+            case GLFW_KEY_M:
+                _spotLightOn = !_spotLightOn;
+                _applyLightToggles();
+                fprintf( stdout, "[INFO]: spot light %s\n", _spotLightOn ? "on" : "off" );
                 break;
-            default: break; // suppress CLion warning
-        }
-    }
-    if(action == GLFW_RELEASE){
-        switch(key) {
-            case GLFW_KEY_LEFT_SHIFT:
-            case GLFW_KEY_RIGHT_SHIFT:
-                _shiftButtonState = GLFW_RELEASE;
+            case GLFW_KEY_K:
+                _clusteredLightsOn = !_clusteredLightsOn;
+                _staticLayerCache->invalidate();
+                fprintf( stdout, "[INFO]: clustered streetlights and fuse light %s\n", _clusteredLightsOn ? "on" : "off" );
+                break;
+            case GLFW_KEY_I:
+                _impostorsOn = !_impostorsOn;
+                _staticLayerCache->invalidate();
+                fprintf( stdout, "[INFO]: impostors for distant buildings and trees %s\n", _impostorsOn ? "on" : "off" );
+                break;
+            case GLFW_KEY_O:
+                _occlusionCullingOn = !_occlusionCullingOn;
+                fprintf( stdout, "[INFO]: software occlusion culling %s\n", _occlusionCullingOn ? "on" : "off" );
+                break;
+            case GLFW_KEY_G:
+                if(_gpuCuller != nullptr) {
+                    _gpuCullingOn = !_gpuCullingOn;
+                    fprintf( stdout, "[INFO]: %s culling\n", _gpuCullingOn ? "GPU" : "CPU" );
+                } else {
+                    fprintf( stdout, "[INFO]: GPU culling needs OpenGL 4.3, staying on CPU culling\n" );
+                }
                 break;
-            default:
+            case GLFW_KEY_R:
+                _redrawScheduler->setOn( !_redrawScheduler->isOn() );
+                _redrawScheduler->resetStats();
+                fprintf( stdout, "[INFO]: redraw on demand %s\n", _redrawScheduler->isOn() ? "on" : "off" );
                 break;
+            case GLFW_KEY_C: {
+                fprintf( stdout, "[INFO]: GL state changes: %u issued, %u elided\n",
+                         _stateCache->getFrameStats().issued, _stateCache->getFrameStats().elided );
+                fprintf( stdout, "[INFO]: views took %.3f ms on the GPU, depth pre-pass %s\n",
+                         _viewGpuMilliseconds, _depthPrePassOn ? "on" : "off" );
+                fprintf( stdout, "[INFO]: render queue: %u packets drawn from %u merged draw lists, %u mesh changes, %u triangles last frame\n",
+                         _renderQueue->getStats().packets, _renderQueue->getStats().drawLists, _renderQueue->getStats().meshChanges, _renderQueue->getStats().triangles );
+                fprintf( stdout, "[INFO]: transforms: %u of %u part matrices recomputed last frame\n",
+                         _renderTransforms->getNumUpdated(), _renderTransforms->getNumNodes() );
+                fprintf( stdout, "[INFO]: simulation thread: %llu ticks at %u Hz, %llu dropped after stalls, %llu input events dropped\n",
+                         (unsigned long long)_snapshot->tick, Simulation::TICK_RATE,
+                         (unsigned long long)_snapshot->numDroppedTicks, (unsigned long long)_simulation->getNumDroppedInputs() );
+                if(_clusteredLightsOn && !_splitScreenOn) {
+                    const LightClusters::Stats& clusterStats = _lightClusters->getStats();
+                    fprintf( stdout, "[INFO]: light clusters: %u lights, %u light indices, at most %u lights per cluster, built in %.3f ms\n",
+                             clusterStats.lights, clusterStats.lightIndices, clusterStats.maxLightsPerCluster, clusterStats.buildMilliseconds );
+                }
+                fprintf( stdout, "[INFO]: main view: %u/%u cells visible, %u visible / %u culled / %u occluded objects, %u impostors\n",
+                         _mainViewCullingStats.visibleCells, _mainViewCullingStats.visibleCells + _mainViewCullingStats.culledCells,
+                         _mainViewCullingStats.visibleObjects, _mainViewCullingStats.culledObjects, _mainViewCullingStats.occludedObjects,
+                         _mainViewCullingStats.impostors );
+                if(_occlusionCullingOn && !_splitScreenOn && !_gpuCullingOn) {
+                    const OcclusionCuller::Stats& occlusionStats = _occlusionCuller->getStats();
+                    fprintf( stdout, "[INFO]: occlusion culling: %u occluders, %u/%u tested objects hidden, %.3f ms rasterizing + %.3f ms testing on %u threads\n",
+                             occlusionStats.occluders, occlusionStats.occludedObjects, occlusionStats.testedObjects,
+                             occlusionStats.rasterizeMilliseconds, occlusionStats.testMilliseconds, occlusionStats.numThreads );
+                }
+                if(_splitScreenOn) {
+                    fprintf( stdout, "[INFO]: split screen: %u/%u cells visible, %u visible / %u culled objects\n",
+                             _splitScreenCullingStats.visibleCells, _splitScreenCullingStats.visibleCells + _splitScreenCullingStats.culledCells,
+                             _splitScreenCullingStats.visibleObjects, _splitScreenCullingStats.culledObjects );
+                }
+                if(firstPersonOn) {
+                    fprintf( stdout, "[INFO]: first person: %u/%u cells visible, %u visible / %u culled objects\n",
+                             _firstPersonCullingStats.visibleCells, _firstPersonCullingStats.visibleCells + _firstPersonCullingStats.culledCells,
+                             _firstPersonCullingStats.visibleObjects, _firstPersonCullingStats.culledObjects );
+                }
+                if(_gpuCullingOn) {
+                    GpuCuller::Stats gpuStats = _gpuCuller->readStats();
+                    fprintf( stdout, "[INFO]: GPU culling: %u/%u objects visible in the last view, %u indirect commands\n",
+                             gpuStats.visibleObjects, gpuStats.objects, gpuStats.drawCommands );
+                }
+                // over the time since the last report, so idling between two presses shows the idle cost
+                const RedrawScheduler::Stats redrawStats = _redrawScheduler->getStats();
+                fprintf( stdout, "[INFO]: redraw on demand %s: %u frames drawn and %u waits for events in %.1f s, CPU %.1f%% of a core, GPU %.1f%% busy drawing views\n",
+                         _redrawScheduler->isOn() ? "on" : "off", redrawStats.framesDrawn, redrawStats.waits, redrawStats.seconds,
+                         redrawStats.cpuPercent, redrawStats.gpuPercent );
+                _redrawScheduler->resetStats();
+                break;
+            }
+            default: break; // suppress CLion warning
         }
     }
 }
 
 void MPEngine::handleMouseButtonEvent(GLint button, GLint action) {
-    // if the event is for the left mouse button
-    if( button == GLFW_MOUSE_BUTTON_LEFT ) {
-        // update the left mouse button's state
-        _leftMouseButtonState = action;
-    }
+    _simulation->pushInput( { InputEvent::MOUSE_BUTTON, button, action, glm::vec2(0.0f) } );
 }
 
 void MPEngine::handleCursorPositionEvent(glm::vec2 currMousePosition) {
-    // if mouse hasn't moved in the window, prevent camera from flipping out
-    if(_mousePosition.x == MOUSE_UNINITIALIZED) {
-        _mousePosition = currMousePosition;
-    }
-
-    // if the left mouse button is being held down while the mouse is moving
-    if(_leftMouseButtonState == GLFW_PRESS) {
-        if (_shiftButtonState != GLFW_PRESS) {
-            // rotate the camera by the distance the mouse moved
-            switch (_cameraIndex) {
-                case (0):
-                    _arcballCam->rotate((currMousePosition.x - _mousePosition.x) * 0.005f,
-                                        (_mousePosition.y - currMousePosition.y) * 0.005f);
-                    break;
-                case (1):
-                    _freeCam->rotate((currMousePosition.x - _mousePosition.x) * 0.005f,
-                                     (_mousePosition.y - currMousePosition.y) * 0.005f);
-                    break;
-            }
-        } else {
-            _arcballCam->zoom((_mousePosition.y - currMousePosition.y) * 0.005f);
-        }
-    }
+    _simulation->pushInput( { InputEvent::CURSOR_POSITION, 0, 0, currMousePosition } );
+}
 
-    // update the mouse position
-    _mousePosition = currMousePosition;
+void MPEngine::handleWindowRefreshEvent() {
+    _redrawScheduler->requestRedraw();
 }
 
 //*************************************************************************************
@@ -137,11 +191,14 @@ void MPEngine::handleCursorPositionEvent(glm::vec2 currMousePosition) {
 
 void MPEngine::_setupGLFW() {
     CSCI441::OpenGLEngine::_setupGLFW();
+    // a headless run still needs a context to build the characters' meshes
+    if(_isHeadless) glfwHideWindow(_window);
 
     // set our callbacks
     glfwSetKeyCallback(_window, a3_engine_keyboard_callback);
     glfwSetMouseButtonCallback(_window, a3_engine_mouse_button_callback);
     glfwSetCursorPosCallback(_window, a3_engine_cursor_callback);
+    glfwSetWindowRefreshCallback(_window, a3_engine_window_refresh_callback);
 }
 
 void MPEngine::_setupOpenGL() {
@@ -153,94 +210,169 @@ void MPEngine::_setupOpenGL() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);	    // use one minus blending equation
 
     glClearColor( 0.0f, 0.6f, 1.0f, 1.0f );	        // clear the frame buffer to black
+
+    glGenQueries( FRAMES_IN_FLIGHT, _viewTimerQueries );             // GPU time spent drawing the views
 }
 
 void MPEngine::_setupShaders() {
-    _lightingShaderProgram = new CSCI441::ShaderProgram("shaders/lab05.v.glsl", "shaders/lab05.f.glsl" );
-    _lightingShaderUniformLocations.mvpMatrix = _lightingShaderProgram->getUniformLocation("mvpMatrix");
-    _lightingShaderUniformLocations.materialColor = _lightingShaderProgram->getUniformLocation("materialColor");
-    _lightingShaderUniformLocations.lightColor = _lightingShaderProgram->getUniformLocation("lightColor");
-    _lightingShaderUniformLocations.lightDirection = _lightingShaderProgram->getUniformLocation("lightDirection");
+    _shaderCache = new ShaderCache(SHADER_CACHE_DIRECTORY);
+
+    // every permutation is built up front so toggling a light never stalls a frame on a compile.
+    // the views of a split screen share one fragment stage, so they go without the clustered lights
+    for(GLuint lightFeatures = 0; lightFeatures < NUM_LIGHT_PERMUTATIONS; lightFeatures++) {
+        _lightingPrograms[lightFeatures] = _makeLightingPermutation(nullptr, "shaders/clusteredLights.f.glsl", lightFeatures);
+        _splitScreenPrograms[lightFeatures] = _makeLightingPermutation("shaders/splitScreen.g.glsl", "shaders/lab05.f.glsl", lightFeatures);
+    }
+
+    // only instanced draws of the static layer reach this program, the colors come from the bake
+    // and the streetlights and fuse are added on top every frame
+    _bakedLightingProgram = _shaderCache->getProgram("shaders/lab05.v.glsl", nullptr, "shaders/clusteredLights.f.glsl",
+                                                     SHADER_FEATURE_BAKED_LIGHTING | SHADER_FEATURE_INSTANCING);
+    _bindLightingProgram(_bakedLightingProgram);
+    glProgramUniform1i(_bakedLightingProgram, glGetUniformLocation(_bakedLightingProgram, "bakedLighting"), BAKED_LIGHTING_TEXTURE_UNIT);
+
+    // the pre-pass draws each packet with the permutation matching the one that shades it
+    _depthProgram = _shaderCache->getProgram("shaders/depthOnly.v.glsl", nullptr, "shaders/depthOnly.f.glsl", 0);
+    _instancedDepthProgram = _shaderCache->getProgram("shaders/depthOnly.v.glsl", nullptr, "shaders/depthOnly.f.glsl",
+                                                      SHADER_FEATURE_INSTANCING);
+    _bindLightingProgram(_depthProgram);
+    _bindLightingProgram(_instancedDepthProgram);
+
+    // delete the cache directory to time a cold start again
+    const ShaderCache::Stats& shaderCacheStats = _shaderCache->getStats();
+    fprintf( stdout, "[INFO]: %s start: %u lighting and depth programs ready in %.3f ms, %u linked from cached binaries, %u compiled\n",
+             shaderCacheStats.compiled == 0 ? "warm" : "cold", shaderCacheStats.programs, shaderCacheStats.milliseconds,
+             shaderCacheStats.binariesLoaded, shaderCacheStats.compiled );
+    if(!_shaderCache->isBinaryCacheSupported()) {
+        fprintf( stdout, "[INFO]: the driver offers no program binary formats, every start compiles\n" );
+    }
+
+    const GLuint ALL_LIGHTS_PROGRAM = _lightingPrograms[SHADER_FEATURE_POINT_LIGHT | SHADER_FEATURE_SPOT_LIGHT].program;
+    _lightingShaderAttributeLocations.vPos = glGetAttribLocation(ALL_LIGHTS_PROGRAM, "vPos");
+    _lightingShaderAttributeLocations.vNormal = glGetAttribLocation(ALL_LIGHTS_PROGRAM, "vNormal");
+}
 
-    _lightingShaderUniformLocations.pointLightColor = _lightingShaderProgram->getUniformLocation("pointLightColor");
-    _lightingShaderUniformLocations.pointLightPosition = _lightingShaderProgram->getUniformLocation("pointLightPosition");
-    _lightingShaderUniformLocations.modelMtx = _lightingShaderProgram->getUniformLocation("modelMtx");
+MPEngine::LightingPermutation MPEngine::_makeLightingPermutation(const char* geometryPath, const char* fragmentPath, GLuint lightFeatures) {
+    LightingPermutation permutation;
+    permutation.program = _shaderCache->getProgram("shaders/lab05.v.glsl", geometryPath, fragmentPath, lightFeatures);
+    permutation.materialColor = glGetUniformLocation(permutation.program, "materialColor");
+    permutation.instancedProgram = _shaderCache->getProgram("shaders/lab05.v.glsl", geometryPath, fragmentPath, lightFeatures | SHADER_FEATURE_INSTANCING);
+    _bindLightingProgram(permutation.program);
+    _bindLightingProgram(permutation.instancedProgram);
+    return permutation;
+}
 
-    _lightingShaderUniformLocations.spotLightPosition = _lightingShaderProgram->getUniformLocation("spotLightPosition");
-    _lightingShaderUniformLocations.spotLightColor = _lightingShaderProgram->getUniformLocation("spotLightColor");
-    _lightingShaderUniformLocations.spotLightPhi = _lightingShaderProgram->getUniformLocation("spotLightPhi");
-    _lightingShaderUniformLocations.spotLightDirection = _lightingShaderProgram->getUniformLocation("spotLightDirection");
+void MPEngine::_bindLightingProgram(GLuint program) {
+    if(program == 0) return;
 
-    _lightingShaderUniformLocations.normalMatrix = _lightingShaderProgram->getUniformLocation("normalMatrix");
-    _lightingShaderAttributeLocations.vPos = _lightingShaderProgram->getAttributeLocation("vPos");
-    _lightingShaderAttributeLocations.vNormal = _lightingShaderProgram->getAttributeLocation("vNormal");
+    // attach the uniform blocks to the binding points the ring buffer binds ranges to,
+    // skipping those a permutation compiled out
+    const std::pair<const char*, GLuint> BLOCKS[] = {
+        { "FrameBlock", FRAME_BLOCK_BINDING },
+        { "TransformBlock", TRANSFORM_BLOCK_BINDING },
+        { "ViewBlock", VIEW_BLOCK_BINDING },
+        { "ClusterBlock", CLUSTER_BLOCK_BINDING }
+    };
+    for(const auto& block : BLOCKS) {
+        GLuint blockIndex = glGetUniformBlockIndex(program, block.first);
+        if(blockIndex != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, blockIndex, block.second);
+        }
+    }
+    // samplers of clusteredLights.f.glsl, the location is -1 and ignored in programs without them
+    glProgramUniform1i(program, glGetUniformLocation(program, "lights"), LIGHT_CLUSTER_TEXTURE_UNIT);
+    glProgramUniform1i(program, glGetUniformLocation(program, "clusterRanges"), LIGHT_CLUSTER_TEXTURE_UNIT + 1);
+    glProgramUniform1i(program, glGetUniformLocation(program, "lightIndices"), LIGHT_CLUSTER_TEXTURE_UNIT + 2);
 }
 
 void MPEngine::_setupBuffers() {
-    CSCI441::ModelLoader::enableAutoGenerateNormals();
     CSCI441::setVertexAttributeLocations( _lightingShaderAttributeLocations.vPos, _lightingShaderAttributeLocations.vNormal);
 
+    _uniformRing = new UniformRingBuffer(UNIFORM_RING_BYTES_PER_FRAME, FRAMES_IN_FLIGHT);
+    _stateCache = new GLStateCache();
+    _meshLibrary = new MeshLibrary(_lightingShaderAttributeLocations.vPos, _lightingShaderAttributeLocations.vNormal);
+
+    const LightingPermutation& lighting = _lightingPrograms[_getLightFeatures()];
+    _renderQueue = new RenderQueue(lighting.program,
+                                   _stateCache,
+                                   _uniformRing,
+                                   lighting.materialColor);
+    _setShadingProgram(false);
+
+    _transformHierarchy = new TransformHierarchy();
+    _jobSystem = new JobSystem();
+    fprintf( stdout, "[INFO]: job system running on %u threads\n", _jobSystem->getNumThreads() );
+    _parallelCuller = new ParallelCuller(_jobSystem);
+    _occlusionCuller = new OcclusionCuller(_jobSystem);
+
+    SecondaryView::Settings firstPersonSettings;
+    firstPersonSettings.windowOrigin = glm::vec2(2.0f / 3.0f);
+    firstPersonSettings.windowSize = glm::vec2(1.0f / 3.0f);
+    firstPersonSettings.resolutionScale = FIRST_PERSON_RESOLUTION_SCALE;
+    firstPersonSettings.updateInterval = FIRST_PERSON_UPDATE_INTERVAL;
+    _firstPersonView = new SecondaryView(firstPersonSettings);
+
     //create motorcycle
-    _motorcycle = new Motorcycle(_lightingShaderProgram->getShaderProgramHandle(),
-                       _lightingShaderUniformLocations.mvpMatrix,
-                       _lightingShaderUniformLocations.normalMatrix,
-                       _lightingShaderUniformLocations.materialColor,
-                                 _lightingShaderUniformLocations.modelMtx);
-
-    _bobomb = new Bobomb(_lightingShaderProgram->getShaderProgramHandle(),
-                         _lightingShaderUniformLocations.mvpMatrix,
-                         _lightingShaderUniformLocations.normalMatrix,
-                         _lightingShaderUniformLocations.materialColor,
-                         _lightingShaderUniformLocations.modelMtx);
-
-    _robot = new Robot(_lightingShaderProgram->getShaderProgramHandle(),
-                         _lightingShaderUniformLocations.mvpMatrix,
-                         _lightingShaderUniformLocations.normalMatrix,
-                         _lightingShaderUniformLocations.materialColor,
-                       _lightingShaderUniformLocations.modelMtx,
-                       _lightingShaderAttributeLocations.vPos,
-                       _lightingShaderAttributeLocations.vNormal);
+    _motorcycle = new Motorcycle(_meshLibrary, _transformHierarchy);
+
+    _bobomb = new Bobomb(_meshLibrary, _transformHierarchy);
+
+    _robot = new Robot(_meshLibrary, _transformHierarchy);
     // initialize bobomb Position
     _bobomb->setPosition(glm::vec3(2.0f,0.0f,0.0f));
     _robot->setPosition(glm::vec3(4.0f,0.0f,0.0f));
     _createGroundBuffers();
+
+    // environment meshes are shared by every building / tree and drawn instanced
+    _buildingMesh = new Mesh(generateCubeData(1.0f), _lightingShaderAttributeLocations.vPos, _lightingShaderAttributeLocations.vNormal);
+    _trunkMesh = new Mesh(generateCylinderData(0.5f, 0.5f, 1.0f, 2, 4), _lightingShaderAttributeLocations.vPos, _lightingShaderAttributeLocations.vNormal);
+    _leafMesh = new Mesh(generateConeData(.75f, 2, 2, 4), _lightingShaderAttributeLocations.vPos, _lightingShaderAttributeLocations.vNormal);
+    _buildingMesh->enableInstancing();
+    _trunkMesh->enableInstancing();
+    _leafMesh->enableInstancing();
+
+    _staticLayerCache = new StaticLayerCache();
+    _staticLighting = new StaticLighting(_jobSystem);
+    _lightClusters = new LightClusters();
+    _setupImpostors();
     _generateEnvironment();
+    _setupGpuCulling();
 }
 
-void MPEngine::_createGroundBuffers() {
-    struct Vertex {
-        GLfloat x, y, z;
-        GLfloat normalX, normalY, normalZ;
+void MPEngine::_setupGpuCulling() {
+    if(!GpuCuller::isSupported()) {
+        fprintf( stdout, "[INFO]: OpenGL 4.3 compute and indirect draws unavailable, culling on the CPU\n" );
+        return;
+    }
 
-    };
+    _gpuCuller = new GpuCuller(_lightingShaderAttributeLocations.vPos, _lightingShaderAttributeLocations.vNormal);
+    _gpuCuller->addStaticObject(_groundMesh, _groundInstance);
+    for(const InstanceData& instance : _buildingInstances) {
+        _gpuCuller->addStaticObject(_buildingMesh, instance);
+    }
+    for(const InstanceData& instance : _trunkInstances) {
+        _gpuCuller->addStaticObject(_trunkMesh, instance);
+    }
+    for(const InstanceData& instance : _leafInstances) {
+        _gpuCuller->addStaticObject(_leafMesh, instance);
+    }
+    _gpuCullingOn = true;
+    fprintf( stdout, "[INFO]: culling and drawing on the GPU, press G to switch to CPU culling\n" );
+}
 
-    Vertex groundQuad[4] = {
-            {-1.0f, 0.0f, -1.0f, 0,1,0},
-            { 1.0f, 0.0f, -1.0f,0,1,0},
-            {-1.0f, 0.0f,  1.0f,0,1,0},
-            { 1.0f, 0.0f,  1.0f,0,1,0}
+void MPEngine::_createGroundBuffers() {
+    // unit quad in the XZ plane facing up, scaled to the world size when drawn
+    MeshData groundQuad;
+    groundQuad.vertices = {
+            { glm::vec3(-1.0f, 0.0f, -1.0f), glm::vec3(0,1,0) },
+            { glm::vec3( 1.0f, 0.0f, -1.0f), glm::vec3(0,1,0) },
+            { glm::vec3(-1.0f, 0.0f,  1.0f), glm::vec3(0,1,0) },
+            { glm::vec3( 1.0f, 0.0f,  1.0f), glm::vec3(0,1,0) }
     };
+    groundQuad.indices = { 0, 2, 1,  1, 2, 3 };
 
-    GLushort indices[4] = {0,1,2,3};
-
-    _numGroundPoints = 4;
-
-    glGenVertexArrays(1, &_groundVAO);
-    glBindVertexArray(_groundVAO);
-
-    GLuint vbods[2];       // 0 - VBO, 1 - IBO
-    glGenBuffers(2, vbods);
-    glBindBuffer(GL_ARRAY_BUFFER, vbods[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(groundQuad), groundQuad, GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(_lightingShaderAttributeLocations.vPos);
-    glVertexAttribPointer(_lightingShaderAttributeLocations.vPos, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-
-    glEnableVertexAttribArray(_lightingShaderAttributeLocations.vNormal);
-    glVertexAttribPointer(_lightingShaderAttributeLocations.vNormal, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbods[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    _groundMesh = new Mesh(groundQuad, _lightingShaderAttributeLocations.vPos, _lightingShaderAttributeLocations.vNormal);
+    _groundMesh->enableInstancing();
 }
 
 void MPEngine::_generateEnvironment() {
@@ -260,41 +392,205 @@ void MPEngine::_generateEnvironment() {
 
     srand( time(0) );                                                   // seed our RNG
 
+    const glm::vec3 STREETLIGHT_COLOR(1.0f, 0.75f, 0.4f);
+    _streetLights.clear();
+
     // psych! everything's on a grid.
     for(int i = LEFT_END_POINT; i < RIGHT_END_POINT; i += GRID_SPACING_WIDTH) {
         for(int j = BOTTOM_END_POINT; j < TOP_END_POINT; j += GRID_SPACING_LENGTH) {
+            // the roads are the rows and columns the buildings leave clear (i % 6 == 0 || j % 6 == 0),
+            // they cross where both hold, and a streetlight goes over every crossing
+            if( i % 6 == 0 && j % 6 == 0 ) {
+                _streetLights.push_back( { glm::vec3(i, STREETLIGHT_HEIGHT, j), STREETLIGHT_RADIUS, STREETLIGHT_COLOR, 0.0f } );
+            }
             // don't just draw a building ANYWHERE.
-            if( i % 6 && j % 6 && getRand() < 0.05f ) {
-                // translate to spot
-                glm::mat4 transToSpotMtx = glm::translate( glm::mat4(1.0), glm::vec3(i, 0.0f, j) );
-
+            if( i % 6 && j % 6 && getRand() < ENVIRONMENT_DENSITY ) {
                 if(getRand() > 0.5f) {
                     // compute random height
                     GLdouble height = powf(getRand(), 2.5) * 10 + 1;
-                    // scale to building size
-                    glm::mat4 scaleToHeightMtx = glm::scale(glm::mat4(1.0), glm::vec3(1, height, 1));
-
-                    // translate up to grid
-                    glm::mat4 transToHeight = glm::translate(glm::mat4(1.0), glm::vec3(0, height / 2.0f, 0));
-
-                    // compute full model matrix
-                    glm::mat4 modelMatrix = transToHeight * scaleToHeightMtx * transToSpotMtx;
-
-                    // compute random color
-                    glm::vec3 color(.3, .3, .3);
                     // store building properties
-                    BuildingData currentBuilding = {modelMatrix, color};
-                    _buildings.emplace_back(currentBuilding);
+                    _buildings.emplace_back( _makeBuilding(glm::vec3(i, 0.0f, j), height) );
                 }
                 else{
-                    glm::mat4 modelMatrix = transToSpotMtx;
                     GLdouble height = powf(getRand(), 2.5) * 5 + 1;
-                    TreeData currentTree = {modelMatrix, glm::vec3(0,height,0), glm::vec3(.6, .3, 0), glm::vec3(0,1,0)};
-                    _trees.emplace_back(currentTree);
+                    _trees.emplace_back( _makeTree(glm::vec3(i, 0.0f, j), height) );
                 }
             }
         }
     }
+
+    _buildEnvironmentInstances();
+}
+
+MPEngine::BuildingData MPEngine::_makeBuilding(glm::vec3 position, GLfloat height) {
+    // translate to spot
+    glm::mat4 transToSpotMtx = glm::translate( glm::mat4(1.0), position );
+    // scale to building size
+    glm::mat4 scaleToHeightMtx = glm::scale(glm::mat4(1.0), glm::vec3(1, height, 1));
+
+    // translate up to grid
+    glm::mat4 transToHeight = glm::translate(glm::mat4(1.0), glm::vec3(0, height / 2.0f, 0));
+
+    // compute full model matrix
+    glm::mat4 modelMatrix = transToHeight * scaleToHeightMtx * transToSpotMtx;
+
+    // compute random color
+    glm::vec3 color(.3, .3, .3);
+    return {modelMatrix, color};
+}
+
+MPEngine::TreeData MPEngine::_makeTree(glm::vec3 position, GLfloat height) {
+    glm::mat4 modelMatrix = glm::translate( glm::mat4(1.0), position );
+    return {modelMatrix, glm::vec3(0,height,0), glm::vec3(.6, .3, 0), glm::vec3(0,1,0)};
+}
+
+GLuint MPEngine::_nearestHeight(const GLfloat* heights, GLuint numHeights, GLfloat height) {
+    GLuint nearest = 0;
+    for(GLuint i = 1; i < numHeights; i++) {
+        if(fabsf(heights[i] - height) < fabsf(heights[nearest] - height)) {
+            nearest = i;
+        }
+    }
+    return nearest;
+}
+
+void MPEngine::_setupImpostors() {
+    _impostorAtlas = new ImpostorAtlas();
+
+    // every variant is baked in the same spot, one at a time
+    const glm::vec3 BAKE_POSITION(0.0f, 0.0f, -IMPOSTOR_BAKE_DISTANCE);
+    for(GLfloat height : IMPOSTOR_BUILDING_HEIGHTS) {
+        BuildingData building = _makeBuilding(BAKE_POSITION, height);
+        _buildingImpostorVariants.push_back( _impostorAtlas->addVariant( transformBoundingBox(BUILDING_BOUNDS, building.modelMatrix) ) );
+    }
+    for(GLfloat height : IMPOSTOR_TREE_HEIGHTS) {
+        TreeData tree = _makeTree(BAKE_POSITION, height);
+        BoundingBox treeBounds = transformBoundingBox(TRUNK_BOUNDS, glm::scale(tree.modelMatrix, glm::vec3(1.0f, height, 1.0f)));
+        treeBounds.expand( transformBoundingBox(LEAF_BOUNDS, glm::translate(tree.modelMatrix, tree.leafTranslate)) );
+        _treeImpostorVariants.push_back( _impostorAtlas->addVariant(treeBounds) );
+    }
+}
+
+void MPEngine::_bakeImpostors() {
+    const glm::vec3 BAKE_POSITION(0.0f, 0.0f, -IMPOSTOR_BAKE_DISTANCE);
+    const GLuint NUM_BUILDING_HEIGHTS = sizeof(IMPOSTOR_BUILDING_HEIGHTS) / sizeof(GLfloat);
+    const GLuint NUM_TREE_HEIGHTS = sizeof(IMPOSTOR_TREE_HEIGHTS) / sizeof(GLfloat);
+
+    // drawn through the render queue like any other frame, so the sprites are lit the same way
+    _uniformRing->beginFrame();
+    _stateCache->invalidateProgram();
+    _stateCache->invalidateVertexArray();
+    _impostorAtlas->beginBake();
+    for(GLuint i = 0; i < NUM_BUILDING_HEIGHTS + NUM_TREE_HEIGHTS; i++) {
+        _renderQueue->begin();
+        GLint variant;
+        if(i < NUM_BUILDING_HEIGHTS) {
+            BuildingData building = _makeBuilding(BAKE_POSITION, IMPOSTOR_BUILDING_HEIGHTS[i]);
+            _renderQueue->submit(_buildingMesh, building.modelMatrix, building.color);
+            variant = _buildingImpostorVariants[i];
+        } else {
+            GLfloat height = IMPOSTOR_TREE_HEIGHTS[i - NUM_BUILDING_HEIGHTS];
+            TreeData tree = _makeTree(BAKE_POSITION, height);
+            _renderQueue->submit(_trunkMesh, glm::scale(tree.modelMatrix, glm::vec3(1.0f, height, 1.0f)), tree.treeColor);
+            _renderQueue->submit(_leafMesh, glm::translate(tree.modelMatrix, tree.leafTranslate), tree.leafColor);
+            variant = _treeImpostorVariants[i - NUM_BUILDING_HEIGHTS];
+        }
+        if(variant < 0) continue;
+
+        for(GLuint view = 0; view < ImpostorAtlas::NUM_VIEWS; view++) {
+            glm::mat4 viewMtx, projMtx;
+            _impostorAtlas->beginSprite(variant, view, viewMtx, projMtx);
+            _sendFrameUniforms(viewMtx, projMtx);
+            // the streetlights would follow the camera into every sprite, so the sprites go without them
+            _uniformRing->push( CLUSTER_BLOCK_BINDING, ClusterUniforms{} );
+            _renderQueue->execute(viewMtx);
+        }
+    }
+    _impostorAtlas->endBake();
+    _uniformRing->endFrame();
+
+    fprintf( stdout, "[INFO]: baked %u impostor variants from %u directions each\n",
+             _impostorAtlas->getNumVariants(), ImpostorAtlas::NUM_VIEWS );
+}
+
+void MPEngine::_buildEnvironmentInstances() {
+    // the cached image of the old environment no longer matches
+    _staticLayerCache->invalidate();
+    // every instance is lit again once the lights are known
+    _staticLighting->clear();
+
+    _groundInstance = makeInstanceData( glm::scale( glm::mat4(1.0f), glm::vec3(WORLD_SIZE, 1.0f, WORLD_SIZE)), glm::vec3(0.3f, 0.8f, 0.2f) );
+    _staticLighting->addInstance(_groundMesh, _groundInstance);
+    _groundMesh->setInstances(&_groundInstance, 1);
+
+    delete _buildingGrid;
+    delete _treeGrid;
+    _buildingGrid = new SpatialGrid(-WORLD_SIZE - 10.0f, WORLD_SIZE + 10.0f, CULLING_GRID_CELLS);
+    _treeGrid = new SpatialGrid(-WORLD_SIZE - 10.0f, WORLD_SIZE + 10.0f, CULLING_GRID_CELLS);
+
+    // every building and tree is placed on its own, only the grids and the lighting take them one at a time
+    _buildingInstances.resize(_buildings.size());
+    _buildingBounds.resize(_buildings.size());
+    _buildingImpostors.resize(_buildings.size());
+    _trunkInstances.resize(_trees.size());
+    _leafInstances.resize(_trees.size());
+    _treeBounds.resize(_trees.size());
+    _treeImpostors.resize(_trees.size());
+
+    JobSystem::TaskGraph graph;
+    const GLuint PLACE_BUILDINGS = graph.addTask( [this]() {
+        _jobSystem->parallelFor( _buildings.size(), ENVIRONMENT_GRAIN_SIZE, [this](GLuint begin, GLuint end) {
+            for(GLuint i = begin; i < end; i++) {
+                const BuildingData& currentBuilding = _buildings[i];
+                BoundingBox buildingBounds = transformBoundingBox(BUILDING_BOUNDS, currentBuilding.modelMatrix);
+                _buildingBounds[i] = buildingBounds;
+                _buildingInstances[i] = makeInstanceData(currentBuilding.modelMatrix, currentBuilding.color);
+
+                GLuint heightIndex = _nearestHeight(IMPOSTOR_BUILDING_HEIGHTS, _buildingImpostorVariants.size(), buildingBounds.max.y - buildingBounds.min.y);
+                _buildingImpostors[i] = _impostorAtlas->makeInstance(_buildingImpostorVariants[heightIndex], buildingBounds);
+            }
+        } );
+    } );
+    const GLuint PLACE_TREES = graph.addTask( [this]() {
+        _jobSystem->parallelFor( _trees.size(), ENVIRONMENT_GRAIN_SIZE, [this](GLuint begin, GLuint end) {
+            for(GLuint i = begin; i < end; i++) {
+                const TreeData& currentTree = _trees[i];
+                // the trunk mesh is one unit tall, so stretch it to the height of this tree
+                glm::mat4 trunkModelMtx = glm::scale(currentTree.modelMatrix, glm::vec3(1.0f, currentTree.leafTranslate.y, 1.0f));
+                glm::mat4 leafModelMtx = glm::translate(currentTree.modelMatrix, currentTree.leafTranslate);
+
+                BoundingBox treeBounds = transformBoundingBox(TRUNK_BOUNDS, trunkModelMtx);
+                treeBounds.expand( transformBoundingBox(LEAF_BOUNDS, leafModelMtx) );
+                _treeBounds[i] = treeBounds;
+                _trunkInstances[i] = makeInstanceData(trunkModelMtx, currentTree.treeColor);
+                _leafInstances[i] = makeInstanceData(leafModelMtx, currentTree.leafColor);
+
+                GLuint heightIndex = _nearestHeight(IMPOSTOR_TREE_HEIGHTS, _treeImpostorVariants.size(), currentTree.leafTranslate.y);
+                _treeImpostors[i] = _impostorAtlas->makeInstance(_treeImpostorVariants[heightIndex], treeBounds);
+            }
+        } );
+    } );
+    graph.addTask( [this]() {
+        for(GLuint i = 0; i < _buildingBounds.size(); i++) {
+            _buildingGrid->insert( i, _buildingBounds[i] );
+        }
+    }, { PLACE_BUILDINGS } );
+    graph.addTask( [this]() {
+        for(GLuint i = 0; i < _treeBounds.size(); i++) {
+            _treeGrid->insert( i, _treeBounds[i] );
+        }
+    }, { PLACE_TREES } );
+    // the baked colors are handed out in order, so the lighting always lays them out the same way
+    graph.addTask( [this]() {
+        for(InstanceData& buildingInstance : _buildingInstances) {
+            _staticLighting->addInstance(_buildingMesh, buildingInstance);
+        }
+        for(GLuint i = 0; i < _trees.size(); i++) {
+            _staticLighting->addInstance(_trunkMesh, _trunkInstances[i]);
+            _staticLighting->addInstance(_leafMesh, _leafInstances[i]);
+        }
+    }, { PLACE_BUILDINGS, PLACE_TREES } );
+    _jobSystem->run(graph);
 }
 
 void MPEngine::_setupScene() {
@@ -318,36 +614,34 @@ void MPEngine::_setupScene() {
     _firstPersonCam->setTheta(0);
     _firstPersonCam->recomputeOrientation();
 
-    glm::vec3 lightColor = glm::vec3(1,1,1);
-    glm::vec3 lightDirection = glm::vec3(-1,-1,-1);
-
-    glm::vec3 pointLightColor = glm::vec3(1,1,1);
-    glm::vec3 pointLightPosition = glm::vec3(-10,1,-10);
-
-    glm::vec3 spotLightColor = glm::vec3(1,1,1); //Light Color
-    glm::vec3 spotLightPosition = glm::vec3(0,5,0); //Light position
-    float spotLightPhi = 1; //Cutoff angle
-    glm::vec3 spotLightDirection = glm::vec3(0,-1,0); //Vector to look down
-
-    glProgramUniform3fv(_lightingShaderProgram->getShaderProgramHandle(),
-                        _lightingShaderUniformLocations.lightColor,1,&lightColor[0]);
-    glProgramUniform3fv(_lightingShaderProgram->getShaderProgramHandle(),
-                        _lightingShaderUniformLocations.lightDirection,1,&lightDirection[0]);
-
-    glProgramUniform3fv(_lightingShaderProgram->getShaderProgramHandle(),
-                        _lightingShaderUniformLocations.pointLightColor,1,&pointLightColor[0]);
-    glProgramUniform3fv(_lightingShaderProgram->getShaderProgramHandle(),
-                        _lightingShaderUniformLocations.pointLightPosition,1,&pointLightPosition[0]);
-
-    glProgramUniform3fv(_lightingShaderProgram->getShaderProgramHandle(),
-                        _lightingShaderUniformLocations.spotLightColor,1,&spotLightColor[0]);
-    glProgramUniform3fv(_lightingShaderProgram->getShaderProgramHandle(),
-                        _lightingShaderUniformLocations.spotLightPosition,1,&spotLightPosition[0]);
-    glProgramUniform3fv(_lightingShaderProgram->getShaderProgramHandle(),
-                        _lightingShaderUniformLocations.spotLightPhi,1,&spotLightPhi);
-    glProgramUniform3fv(_lightingShaderProgram->getShaderProgramHandle(),
-                        _lightingShaderUniformLocations.spotLightDirection,1,&spotLightDirection[0]);
-
+    // lights are written into the FrameBlock at the start of every view
+    _frameUniforms = {};
+    _frameUniforms.lightColor = glm::vec3(1,1,1);
+    _frameUniforms.lightDirection = glm::vec3(-1,-1,-1);
+
+    _frameUniforms.pointLightColor = POINT_LIGHT_COLOR;
+    _frameUniforms.pointLightPosition = glm::vec3(-10,1,-10);
+
+    _frameUniforms.spotLightColor = SPOT_LIGHT_COLOR; //Light Color
+    _frameUniforms.spotLightPosition = glm::vec3(0,5,0); //Light position
+    _frameUniforms.spotLightPhi = 1; //Cutoff angle
+    _frameUniforms.spotLightDirection = glm::vec3(0,-1,0); //Vector to look down
+
+    // the environment never moves and neither do the lights above, so it is lit once
+    _staticLighting->bake(_frameUniforms);
+    fprintf( stdout, "[INFO]: baked static lighting of %u vertices in %.3f ms on %u threads\n",
+             _staticLighting->getNumVertices(), _staticLighting->getBakeMilliseconds(), _staticLighting->getNumThreads() );
+
+    // the sprites are lit by the lights above
+    _bakeImpostors();
+
+    // the characters and cameras belong to the simulation from here on, rendering draws from
+    // a copy of their transforms filled in from each snapshot
+    _renderTransforms = new TransformHierarchy(*_transformHierarchy);
+    _simulation = new Simulation(_transformHierarchy, _motorcycle, _bobomb, _robot,
+                                 _arcballCam, _freeCam, _firstPersonCam, WORLD_SIZE);
+    _acquireSnapshot();
+    _redrawScheduler = new RedrawScheduler();
 }
 
 //*************************************************************************************
@@ -356,260 +650,322 @@ void MPEngine::_setupScene() {
 
 void MPEngine::_cleanupShaders() {
     fprintf( stdout, "[INFO]: ...deleting Shaders.\n" );
-    delete _lightingShaderProgram;
+    // every lighting and depth permutation belongs to the cache
+    delete _shaderCache;
 }
 
 void MPEngine::_cleanupBuffers() {
     fprintf( stdout, "[INFO]: ...deleting VAOs....\n" );
     CSCI441::deleteObjectVAOs();
-    glDeleteVertexArrays( 1, &_groundVAO );
 
     fprintf( stdout, "[INFO]: ...deleting VBOs....\n" );
     CSCI441::deleteObjectVBOs();
 
+    fprintf( stdout, "[INFO]: ...deleting meshes..\n" );
+    delete _groundMesh;
+    delete _buildingMesh;
+    delete _trunkMesh;
+    delete _leafMesh;
+    delete _buildingGrid;
+    delete _treeGrid;
+    delete _parallelCuller;
+    delete _occlusionCuller;
+    delete _firstPersonView;
+    delete _staticLayerCache;
+    delete _staticLighting;
+    delete _lightClusters;
+    delete _impostorAtlas;
+    delete _renderQueue;
+    glDeleteQueries( FRAMES_IN_FLIGHT, _viewTimerQueries );
+    delete _gpuCuller;
+    delete _uniformRing;
+    delete _meshLibrary;
+    delete _stateCache;
+    // nothing else hands the pool work once the culler and the lighting are gone
+    delete _jobSystem;
+
     fprintf( stdout, "[INFO]: ...deleting models..\n" );
+    // stops the simulation thread before the characters it moves go away
+    delete _simulation;
+    delete _redrawScheduler;
     delete _motorcycle;
     delete _bobomb;
     delete _robot;
+    delete _transformHierarchy;
+    delete _renderTransforms;
 }
 
 //*************************************************************************************
 //
 // Rendering / Drawing Functions - this is where the magic happens!
 
-void MPEngine::_renderScene(glm::mat4 viewMtx, glm::mat4 projMtx) const {
-    // use our lighting shader program
-    _lightingShaderProgram->useProgram();
-
-    //// BEGIN DRAWING THE GROUND PLANE ////
-    // draw the ground plane
-    glm::mat4 groundModelMtx = glm::scale( glm::mat4(1.0f), glm::vec3(WORLD_SIZE, 1.0f, WORLD_SIZE));
-    _computeAndSendMatrixUniforms(groundModelMtx, viewMtx, projMtx);
-
-    glm::vec3 groundColor(0.3f, 0.8f, 0.2f);
-    glUniform3fv(_lightingShaderUniformLocations.materialColor, 1, &groundColor[0]);
+void MPEngine::_recordScene() const {
+    // everything recorded here is in world space, so the list is shared by every view this frame
+    _renderQueue->begin();
 
-    glBindVertexArray(_groundVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, _numGroundPoints, GL_UNSIGNED_SHORT, (void*)0);
-    //// END DRAWING THE GROUND PLANE ////
+    // only parts that moved since last frame are recomputed, placed between the two ticks of the snapshot.
+    // the slices only read the matrices from here on
+    _renderTransforms->update(_snapshotAlpha);
 
-    //// BEGIN DRAWING THE BUILDINGS ////
-    for( const BuildingData& currentBuilding : _buildings ) {
-        _computeAndSendMatrixUniforms(currentBuilding.modelMatrix, viewMtx, projMtx);
-
-        glUniform3fv(_lightingShaderUniformLocations.materialColor, 1, &currentBuilding.color[0]);
-
-        CSCI441::drawSolidCube(1.0);
+    // each slice records into its own list on whichever thread takes it, then the lists are
+    // merged on this thread in slice order, so the queue replays the same way every frame
+    for(DrawList& drawList : _drawLists) {
+        drawList.begin(*_renderQueue);
     }
+    _jobSystem->parallelFor( NUM_SCENE_SLICES, 1, [this](GLuint begin, GLuint end) {
+        for(GLuint slice = begin; slice < end; slice++) {
+            _recordSlice(slice);
+        }
+    } );
+    for(const DrawList& drawList : _drawLists) {
+        _renderQueue->merge(drawList);
+    }
+}
 
-    for( TreeData currentTree : _trees){
-        _computeAndSendMatrixUniforms(currentTree.modelMatrix, viewMtx, projMtx);
-
-        glUniform3fv(_lightingShaderUniformLocations.materialColor, 1, &currentTree.treeColor[0]);
-        CSCI441::drawSolidCylinder(0.5f, 0.5f, currentTree.leafTranslate.y, 2, 4);
-
-        currentTree.modelMatrix = glm::translate(currentTree.modelMatrix, currentTree.leafTranslate);
-        _computeAndSendMatrixUniforms(currentTree.modelMatrix, viewMtx, projMtx);
+void MPEngine::_recordSlice(GLuint slice) const {
+    DrawList& drawList = _drawLists[slice];
+    switch(slice) {
+        case SCENE_SLICE_ENVIRONMENT:
+            // the ground, buildings and trees never move and may be drawn from the static layer cache
+            drawList.setLayer(RENDER_LAYER_STATIC);
+
+            //// BEGIN DRAWING THE GROUND PLANE ////
+            // draw the ground plane, its single instance is set in _buildEnvironmentInstances()
+            drawList.submitInstanced(_groundMesh);
+            //// END DRAWING THE GROUND PLANE ////
+
+            //// BEGIN DRAWING THE BUILDINGS AND TREES ////
+            // the instances never change, so nothing of them is recorded per frame.  _cullEnvironment()
+            // works through them per view in ranges of objects spread over the job system, and
+            // gathers the visible ones straight from the arrays _buildEnvironmentInstances() built
+            drawList.submitInstanced(_buildingMesh);
+            drawList.submitInstanced(_trunkMesh);
+            drawList.submitInstanced(_leafMesh);
+            //// END DRAWING THE BUILDINGS AND TREES////
+            break;
+        case SCENE_SLICE_MOTORCYCLE:
+            //// BEGIN DRAWING THE MOTORCYCLE ////
+            _motorcycle->drawMotorcycle(drawList, *_renderTransforms);
+            //// END DRAWING THE MOTORCYCLE ////
+            break;
+        case SCENE_SLICE_BOBOMB:
+            //// BEGIN DRAWING THE HERO ////
+            // positioned and rotated by its root transform node
+            _bobomb->drawBobomb(drawList, *_renderTransforms, _snapshot->isFlicker);
+            //// END DRAWING THE HERO ////
+            break;
+        case SCENE_SLICE_ROBOT:
+            //// BEGIN DRAWING THE ROBOT ////
+            _robot->drawRobot(drawList, *_renderTransforms);
+            //// END DRAWING THE ROBOT ////
+            break;
+        default: break;
+    }
+}
 
-        glUniform3fv(_lightingShaderUniformLocations.materialColor, 1, &currentTree.leafColor[0]);
-        CSCI441::drawSolidCone(.75f,2,2,4);
+void MPEngine::_renderView(glm::mat4 viewMtx, glm::mat4 projMtx, CullingStats& cullingStats, bool useOcclusion) const {
+    _sendFrameUniforms(viewMtx, projMtx);
+    _sendClusterUniforms(viewMtx, projMtx);
+    glm::mat4 viewProjectionMtx = projMtx * viewMtx;
+    if(_gpuCullingOn) {
+        _gpuCuller->draw(&viewProjectionMtx, 1, useOcclusion, *_stateCache,
+                         _lightingPrograms[_getLightFeatures()].instancedProgram);
+        return;
+    }
+    Frustum frustum(viewProjectionMtx);
+    glm::vec3 cameraPosition = glm::vec3( glm::inverse(viewMtx)[3] );
+    _cullEnvironment(&frustum, 1, cullingStats, useOcclusion && _occlusionCullingOn ? &viewProjectionMtx : nullptr, &cameraPosition);
+    // distant and opaque, drawn first so transparent packets still blend over them
+    _impostorAtlas->draw(*_stateCache, cameraPosition);
+    _executeRenderQueue(viewMtx, ALL_RENDER_LAYERS);
+}
 
+void MPEngine::_renderCachedView(glm::mat4 viewMtx, glm::mat4 projMtx, GLint framebufferWidth, GLint framebufferHeight) {
+    StaticLayerCache::Action action = _staticLayerCache->prepare( _makeFrameUniforms(viewMtx, projMtx), framebufferWidth, framebufferHeight );
+    if(action == StaticLayerCache::Action::DRAW_DIRECTLY) {
+        // the camera is on the move, capturing would only add a copy
+        _renderView(viewMtx, projMtx, _mainViewCullingStats, true);
+        return;
+    }
 
+    _sendFrameUniforms(viewMtx, projMtx);
+    _sendClusterUniforms(viewMtx, projMtx);
+    if(action == StaticLayerCache::Action::CAPTURE) {
+        // the environment is only culled and drawn when the layer is refreshed
+        glm::mat4 viewProjectionMtx = projMtx * viewMtx;
+        Frustum frustum(viewProjectionMtx);
+        glm::vec3 cameraPosition = glm::vec3( glm::inverse(viewMtx)[3] );
+        _cullEnvironment(&frustum, 1, _mainViewCullingStats, _occlusionCullingOn ? &viewProjectionMtx : nullptr, &cameraPosition);
+        _staticLayerCache->beginCapture();
+        _impostorAtlas->draw(*_stateCache, cameraPosition);
+        _executeRenderQueue(viewMtx, renderLayerBit(RENDER_LAYER_STATIC));
+        _staticLayerCache->endCapture();
+        glViewport( 0, 0, framebufferWidth, framebufferHeight );
+        glScissor( 0, 0, framebufferWidth, framebufferHeight );
     }
-    //// END DRAWING THE BUILDINGS AND TREES////
-    //// BEGIN DRAWING THE MOTORCYCLE ////
-    glm::mat4 modelMtx(1.0f);
-    glm::mat4 motorcycleModelMtx(1.0f);
+    _staticLayerCache->restore(*_stateCache);
+    // characters depth test against the restored environment
+    _executeRenderQueue(viewMtx, renderLayerBit(RENDER_LAYER_DYNAMIC));
+}
 
-    motorcycleModelMtx = glm::translate(motorcycleModelMtx, _motorcycle->getPosition());
-    _motorcycle->drawMotorcycle(motorcycleModelMtx, viewMtx, projMtx);
-    //// END DRAWING THE MOTORCYCLE ////
-    glm::mat4 modelBobombMtx(1.0f);
-    //// BEGIN DRAWING THE HERO ////
-    // model translated relative to stored hero position coordinates.
-    modelBobombMtx = glm::translate(modelBobombMtx, glm::vec3(_bobomb->getPosition().x, _bobomb->getPosition().y,
-                                                  _bobomb->getPosition().z));
-    // model rotated relative to stored direction angle
-    modelBobombMtx = glm::rotate(modelBobombMtx, _bobomb->getDirection(), CSCI441::Y_AXIS);
-    _bobomb->drawBobomb(modelBobombMtx, viewMtx, projMtx);
+void MPEngine::_executeRenderQueue(glm::mat4 viewMtx, GLuint layerMask) const {
+    const GLuint STATIC_LAYER = renderLayerBit(RENDER_LAYER_STATIC);
+    if(_bakedLightingOn && (layerMask & STATIC_LAYER) != 0) {
+        // the environment reads its lighting from the bake, only the characters are lit every frame
+        _staticLighting->bind(BAKED_LIGHTING_TEXTURE_UNIT);
+        _executeLayers(viewMtx, STATIC_LAYER, true);
+        layerMask &= ~STATIC_LAYER;
+    }
+    if(layerMask != 0) {
+        _executeLayers(viewMtx, layerMask, false);
+    }
+}
 
-    //// END DRAWING THE HERO ////
+void MPEngine::_executeLayers(glm::mat4 viewMtx, GLuint layerMask, bool useBakedLighting) const {
+    if(_depthPrePassOn) {
+        _executeWithDepthPrePass(viewMtx, layerMask, useBakedLighting);
+    } else {
+        _setShadingProgram(useBakedLighting);
+        _renderQueue->execute(viewMtx, ALL_RENDER_PASSES, layerMask);
+    }
+    // everything else expects the queue to draw with the real-time lighting program
+    _setShadingProgram(false);
+}
 
-    //// BEGIN DRAWING THE ROBOT ////
-    glm::mat4 robotModelMtx(1.0f);
-    robotModelMtx = glm::translate(robotModelMtx, _robot->getPosition());
-    _robot->drawRobot(robotModelMtx, viewMtx, projMtx);
-    //// END DRAWING THE ROBOT ////
+void MPEngine::_setShadingProgram(bool useBakedLighting) const {
+    const LightingPermutation& lighting = _lightingPrograms[_getLightFeatures()];
+    if(useBakedLighting) {
+        _renderQueue->setShaderPrograms(lighting.program, lighting.materialColor, _bakedLightingProgram);
+    } else {
+        _renderQueue->setShaderPrograms(lighting.program, lighting.materialColor, lighting.instancedProgram);
+    }
+}
 
+void MPEngine::_executeWithDepthPrePass(glm::mat4 viewMtx, GLuint layerMask, bool useBakedLighting) const {
+    // lay down the nearest depth of every opaque draw without running the lighting
+    glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+    // the pre-pass writes no color, so there is no material color to set
+    _renderQueue->setShaderPrograms(_depthProgram, -1, _instancedDepthProgram);
+    _renderQueue->execute(viewMtx, renderPassBit(RENDER_PASS_OPAQUE), layerMask);
+    glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+
+    // then shade only the fragments that won, each exactly once.  opaque draws have nothing to blend with
+    glDepthFunc( GL_EQUAL );
+    glDepthMask( GL_FALSE );
+    glDisable( GL_BLEND );
+    _setShadingProgram(useBakedLighting);
+    _renderQueue->execute(viewMtx, renderPassBit(RENDER_PASS_OPAQUE), layerMask);
+    glDepthFunc( GL_LESS );
+    glDepthMask( GL_TRUE );
+    glEnable( GL_BLEND );
+
+    // blended geometry was left out of the pre-pass and draws as usual on top
+    _renderQueue->execute(viewMtx, renderPassBit(RENDER_PASS_TRANSPARENT), layerMask);
 }
 
-void MPEngine::_updateScene() {
-    _bobomb->_updateFlicker();
-    _robot->idleMotion();
-    // turn right
-    if(_keys[GLFW_KEY_SPACE]){
-        switch(_cameraIndex){
-            case(0):
-                break;
-            case(1):
-                if( _keys[GLFW_KEY_LEFT_SHIFT] || _keys[GLFW_KEY_RIGHT_SHIFT] ) {
-                    _freeCam->moveBackward(.25f);
-                }
-                // go forward
-                else {
-                    _freeCam->moveForward(.25f);
-                }
-                break;
-        }
+void MPEngine::_renderSplitScreen(GLint framebufferWidth, GLint framebufferHeight, glm::mat4 projMtx) {
+    glm::mat4 VIEW_MATRICES[MAX_SPLIT_SCREEN_VIEWS];
+    const GLuint NUM_VIEWS = _getSplitScreenViewMatrices(VIEW_MATRICES);
+
+    GLint COLUMNS, ROWS;
+    _getSplitScreenLayout(NUM_VIEWS, COLUMNS, ROWS);
+    const GLfloat VIEW_WIDTH = (GLfloat)framebufferWidth / COLUMNS;
+    const GLfloat VIEW_HEIGHT = (GLfloat)framebufferHeight / ROWS;
+
+    ViewUniforms viewUniforms = {};
+    viewUniforms.numViews = NUM_VIEWS;
+    std::vector<Frustum> frustums;
+    for(GLuint i = 0; i < NUM_VIEWS; i++) {
+        // first view in the top left corner
+        GLfloat x = (i % COLUMNS) * VIEW_WIDTH;
+        GLfloat y = (ROWS - 1 - (GLint)(i / COLUMNS)) * VIEW_HEIGHT;
+        glViewportIndexedf(i, x, y, VIEW_WIDTH, VIEW_HEIGHT);
+        glScissorIndexed(i, (GLint)x, (GLint)y, (GLsizei)VIEW_WIDTH, (GLsizei)VIEW_HEIGHT);
+
+        viewUniforms.viewProjectionMtx[i] = projMtx * VIEW_MATRICES[i];
+        frustums.emplace_back(viewUniforms.viewProjectionMtx[i]);
     }
-    if( _keys[GLFW_KEY_D] ) {
-        switch(_cameraIndex) {
-            case(0):
-                if(_modelChoice == 0){
-                    _motorcycle->rotate(1.0f);
-                    if(firstPersonOn){
-                        _firstPersonCam->setTheta(-_motorcycle->getAngle() + (5 * M_PI_2 + M_PI_4 - .2));
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-                else if(_modelChoice == 1){
-                    _bobomb->rotateBobomb(GLFW_KEY_D);
-                    if(firstPersonOn){
-                        _firstPersonCam->setTheta( -_bobomb->getDirection() + glm::radians(200.0f) );
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-                else if(_modelChoice == 2){
-                    _robot->rotate(-0.0523599);
-                    if(firstPersonOn){
-                        _firstPersonCam->setTheta(-_robot->getAngle());
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-                break;
-            case(1):
-                _freeCam->rotate(.02f, 0.0f);
-                break;
 
-        }
+    // vertices leave the vertex shader in world space, the geometry shader applies each view
+    _sendFrameUniforms(glm::mat4(1.0f), glm::mat4(1.0f));
+    _uniformRing->push( VIEW_BLOCK_BINDING, viewUniforms );
+    if(_gpuCullingOn) {
+        // the depth pyramid only describes the main view, so the views are frustum culled only
+        _gpuCuller->draw(viewUniforms.viewProjectionMtx, NUM_VIEWS, false, *_stateCache,
+                         _splitScreenPrograms[_getLightFeatures()].instancedProgram);
+        return;
     }
-    // turn left
-    if( _keys[GLFW_KEY_A] ) {
-        switch(_cameraIndex) {
-            case(0):
-                if(_modelChoice == 0){
-                    _motorcycle->rotate(-1.0f);
-                    if(firstPersonOn){
-                        _firstPersonCam->setTheta(-_motorcycle->getAngle() + (5 * M_PI_2 + M_PI_4 - .15) );
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-                else if(_modelChoice == 1){
-                    _bobomb->rotateBobomb(GLFW_KEY_A);
-                    if(firstPersonOn){
-                        _firstPersonCam->setTheta(-_bobomb->getDirection() + glm::radians(200.0f));
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-                else if(_modelChoice == 2){
-                    _robot->rotate(0.0523599);
-                    if(firstPersonOn){
-                        _firstPersonCam->setTheta(-_robot->getAngle());
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-
-                break;
-            case(1):
-                _freeCam->rotate(-.02f, 0.0f);
-                break;
-        }
+    _cullEnvironment(frustums.data(), frustums.size(), _splitScreenCullingStats);
 
+    // a single submission reaches every viewport, sorted for the first view
+    const LightingPermutation& splitScreen = _splitScreenPrograms[_getLightFeatures()];
+    _renderQueue->setShaderPrograms(splitScreen.program, splitScreen.materialColor, splitScreen.instancedProgram);
+    _renderQueue->execute(VIEW_MATRICES[0]);
+    _setShadingProgram(false);
+}
 
+GLuint MPEngine::_getSplitScreenViewMatrices(glm::mat4* viewMatrices) const {
+    const glm::vec3* previousTargets = _snapshot->previousChaseTargets;
+    const glm::vec3* targets = _snapshot->chaseTargets;
+    for(GLuint i = 0; i < NUM_CHASE_TARGETS; i++) {
+        viewMatrices[i] = _getChaseViewMatrix( previousTargets[i] + (targets[i] - previousTargets[i]) * _snapshotAlpha );
     }
-    // move forward
-    if( _keys[GLFW_KEY_W] ) {
+    viewMatrices[3] = _getInterpolatedViewMatrix(_snapshot->previousCameras[SIMULATION_CAMERA_FREE],
+                                                 _snapshot->cameras[SIMULATION_CAMERA_FREE]);
+    return MAX_SPLIT_SCREEN_VIEWS;
+}
 
-        switch(_cameraIndex) {
-            case(0):
-                if(_modelChoice == 0) {
-                    _motorcycle->driveForward();
-                    _motorcycle->_checkBounds(WORLD_SIZE);
-                    _arcballCam->setLookAtPoint(_motorcycle->getPosition());
-                    if(firstPersonOn){
-                        _firstPersonCam->setPosition(_motorcycle->getPosition() + _motorcycle->getCameraOffset());
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-                else if(_modelChoice == 1) {
-                    _bobomb->driveForward(WORLD_SIZE);
-                    _arcballCam->setLookAtPoint(_bobomb->getPosition());
-                    if(firstPersonOn){
-                        _firstPersonCam->setPosition(_bobomb->getPosition() + glm::vec3(0.0f,1.2f,0.0f));
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-                else if(_modelChoice == 2) {
-                    _robot->moveForward(WORLD_SIZE);
-                    _arcballCam->setLookAtPoint(_robot->getPosition()+_robot->cameraOffset());
-                    if(firstPersonOn){
-                        _firstPersonCam->setPosition(_robot->getPosition()+_robot->cameraOffsetFirstPerson());
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
+void MPEngine::_getSplitScreenLayout(GLuint numViews, GLint& columns, GLint& rows) {
+    // lay the views out in the smallest square grid that fits them all
+    columns = (GLint)ceil( sqrt( (GLfloat)numViews ) );
+    rows = (numViews + columns - 1) / columns;
+}
 
-                _arcballCam->recomputeOrientation();
-                break;
-            case(1):
-                _freeCam->rotate(0.0f, 0.02f);
-                break;
-        }
+glm::mat4 MPEngine::_getChaseViewMatrix(glm::vec3 target) const {
+    return glm::lookAt( target + glm::vec3(0.0f, 4.0f, 8.0f), target, CSCI441::Y_AXIS );
+}
 
-    }
-    // move backward
-    if( _keys[GLFW_KEY_S] ) {
-        switch(_cameraIndex) {
-            case (0):
-                if (_modelChoice == 0) {
-                    _motorcycle->driveBackward();
-                    _motorcycle->_checkBounds(WORLD_SIZE);
-                    _arcballCam->setLookAtPoint(_motorcycle->getPosition());
-                    if(firstPersonOn){
-                        _firstPersonCam->setPosition(_motorcycle->getPosition() + _motorcycle->getCameraOffset());
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-                else if(_modelChoice == 1) {
-                    _bobomb->driveBackward(WORLD_SIZE);
-                    _arcballCam->setLookAtPoint(_bobomb->getPosition());
-                    if(firstPersonOn){
-                        _firstPersonCam->setPosition(_bobomb->getPosition() + glm::vec3(0.0f,1.2f,0.0f));
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
-                else if(_modelChoice == 2) {
-                    _robot->moveBackwards(WORLD_SIZE);
-                    _arcballCam->setLookAtPoint(_robot->getPosition()+_robot->cameraOffset());
-                    if(firstPersonOn){
-                        _firstPersonCam->setPosition(_robot->getPosition()+_robot->cameraOffsetFirstPerson());
-                        _firstPersonCam->recomputeOrientation();
-                    }
-                }
+glm::mat4 MPEngine::_getInterpolatedViewMatrix(const CameraPose& previousPose, const CameraPose& pose) const {
+    // written so a camera that holds still keeps exactly the same matrix, which the static layer cache relies on
+    const glm::vec3 EYE = previousPose.eye + (pose.eye - previousPose.eye) * _snapshotAlpha;
+    const glm::vec3 LOOK_AT = previousPose.lookAt + (pose.lookAt - previousPose.lookAt) * _snapshotAlpha;
+    const glm::vec3 UP = previousPose.up + (pose.up - previousPose.up) * _snapshotAlpha;
+    return glm::lookAt( EYE, LOOK_AT, UP );
+}
 
-                _arcballCam->recomputeOrientation();
-                break;
-            case(1):
-                _freeCam->rotate(0.0f, -0.02f);
-                break;
-        }
-    }
+void MPEngine::_acquireSnapshot() {
+    _snapshot = &_simulation->acquireSnapshot();
+    // a snapshot shows its tick's end state one tick after it was due, the simulation keeps at
+    // least that far ahead, so rendering runs one tick behind and never has to guess forward
+    const GLdouble STEP = _simulation->getStepSeconds();
+    _snapshotAlpha = (GLfloat)glm::clamp( (glfwGetTime() - _snapshot->tickTime) / STEP, 0.0, 1.0 );
+    _renderTransforms->setTransforms(_snapshot->previousTransforms, _snapshot->transforms);
 }
 
 void MPEngine::run() {
     //  This is our draw loop - all rendering is done here.  We use a loop to keep the window open
     //	until the user decides to close the window and quit the program.  Without a loop, the
     //	window will display once and then the program exits.
+    _simulation->start();
+    _redrawScheduler->resetStats();
     while( !glfwWindowShouldClose(_window) ) {	        // check if the window was instructed to be closed
+        // draw whatever the simulation thread last finished, blended between its two ticks
+        _acquireSnapshot();
+        if(!_redrawScheduler->isRedrawDue(*_snapshot)) {
+            // the last frame still shows all there is, sleep until input or the simulation changes something
+            _redrawScheduler->waitForEvents();
+            continue;
+        }
+        if(_redrawScheduler->isLastRedraw(*_snapshot, _snapshotAlpha)) {
+            // the inset skips frames, and the image it shows now stays up until the next change
+            _firstPersonView->invalidate();
+        }
+
+        _uniformRing->beginFrame();                     // wait until this frame's uniform region is free
+        // glfw and buffer setup may have changed bindings outside the cache, uniform values are still valid
+        _stateCache->invalidateProgram();
+        _stateCache->invalidateVertexArray();
+        _stateCache->resetFrameStats();
         glDrawBuffer( GL_BACK );				        // work with our back frame buffer
         // Get the size of our framebuffer.  Ideally this should be the same dimensions as our window, but
         // when using a Retina display the actual window can be larger than the requested window.  Therefore,
@@ -633,132 +989,246 @@ void MPEngine::run() {
 
 
         // set up our look at matrix to position our camera
-        switch(_cameraIndex) {
+        switch(_snapshot->cameraIndex) {
             case(0):
-                viewMatrix = _arcballCam->getViewMatrix();
+                viewMatrix = _getInterpolatedViewMatrix(_snapshot->previousCameras[SIMULATION_CAMERA_ARCBALL],
+                                                        _snapshot->cameras[SIMULATION_CAMERA_ARCBALL]);
                 break;
             case(1):
-                viewMatrix = _freeCam->getViewMatrix();
+                viewMatrix = _getInterpolatedViewMatrix(_snapshot->previousCameras[SIMULATION_CAMERA_FREE],
+                                                        _snapshot->cameras[SIMULATION_CAMERA_FREE]);
                 break;
         }
 
-        // draw everything to the window
-        _renderScene(viewMatrix, projectionMatrix);
-
-        glClear( GL_DEPTH_BUFFER_BIT );	// clear the current color contents and depth buffer in the window
-
-        if(firstPersonOn) {
-            glViewport(framebufferWidth / (double)3 * 2, framebufferHeight / (double)3 * 2, framebufferWidth, framebufferHeight);
-            glScissor(framebufferWidth / (double)3 * 2, framebufferHeight / (double)3 * 2, framebufferWidth, framebufferHeight);
-            glClear(GL_COLOR_BUFFER_BIT);
-            viewMatrix = _firstPersonCam->getViewMatrix();
-            _drawFirstPerson(viewMatrix, projectionMatrix);
+        // parts are tessellated for the finest view that will see them this frame
+        _lodViews.clear();
+        if(_splitScreenOn) {
+            glm::mat4 splitScreenViewMatrices[MAX_SPLIT_SCREEN_VIEWS];
+            GLuint numViews = _getSplitScreenViewMatrices(splitScreenViewMatrices);
+            GLint columns, rows;
+            _getSplitScreenLayout(numViews, columns, rows);
+            for(GLuint i = 0; i < numViews; i++) {
+                _lodViews.push_back( makeLodView(splitScreenViewMatrices[i], projectionMatrix, (GLfloat)framebufferHeight / rows) );
+            }
+        } else {
+            _lodViews.push_back( makeLodView(viewMatrix, projectionMatrix, framebufferHeight) );
+        }
+        // the inset is only redrawn on some frames, and then at its own resolution
+        const bool IS_FIRST_PERSON_VISIBLE = firstPersonOn && !_splitScreenOn;
+        const bool IS_FIRST_PERSON_DUE = IS_FIRST_PERSON_VISIBLE && _firstPersonView->beginFrame(framebufferWidth, framebufferHeight);
+        glm::mat4 firstPersonProjectionMatrix = projectionMatrix;
+        glm::mat4 firstPersonViewMatrix(1.0f);
+        if(IS_FIRST_PERSON_DUE) {
+            firstPersonProjectionMatrix = glm::perspective( 45.0f, _firstPersonView->getAspectRatio(), 0.001f, 1000.0f );
+            firstPersonViewMatrix = _getInterpolatedViewMatrix(_snapshot->previousCameras[SIMULATION_CAMERA_FIRST_PERSON],
+                                                               _snapshot->cameras[SIMULATION_CAMERA_FIRST_PERSON]);
+            _lodViews.push_back( makeLodView(firstPersonViewMatrix, firstPersonProjectionMatrix, _firstPersonView->getHeight()) );
+        }
+        _renderQueue->setLodViews(_lodViews);
+
+        // walk the scene once, then draw the recorded list from every active view
+        _recordScene();
+        _updateClusterLights();
+        if(_gpuCullingOn) {
+            _gpuCuller->clearDynamicObjects();
+            _renderQueue->submitToGpuCuller(*_gpuCuller);
         }
 
+        // read the oldest timer back once it is ready rather than waiting on the GPU
+        GLuint viewTimerQuery = _viewTimerQueries[_viewTimerFrame % FRAMES_IN_FLIGHT];
+        if(_viewTimerFrame >= FRAMES_IN_FLIGHT) {
+            GLint isAvailable = GL_FALSE;
+            glGetQueryObjectiv( viewTimerQuery, GL_QUERY_RESULT_AVAILABLE, &isAvailable );
+            if(isAvailable) {
+                GLuint64 elapsedNanoseconds = 0;
+                glGetQueryObjectui64v( viewTimerQuery, GL_QUERY_RESULT, &elapsedNanoseconds );
+                _viewGpuMilliseconds = elapsedNanoseconds / 1.0e6;
+                _redrawScheduler->addGpuMilliseconds(_viewGpuMilliseconds);
+            }
+        }
+        glBeginQuery( GL_TIME_ELAPSED, viewTimerQuery );
+
+        if(_splitScreenOn) {
+            _renderSplitScreen(framebufferWidth, framebufferHeight, projectionMatrix);
+            if(_gpuCullingOn) _gpuCuller->invalidateDepthPyramid();
+        } else if(_staticLayerCacheOn && !_gpuCullingOn) {
+            // only the characters are drawn while the camera holds still
+            _renderCachedView(viewMatrix, projectionMatrix, framebufferWidth, framebufferHeight);
+        } else {
+            // draw everything to the window
+            _renderView(viewMatrix, projectionMatrix, _mainViewCullingStats, true);
+            // what the main view covered this frame hides objects from it next frame
+            if(_gpuCullingOn) _gpuCuller->updateDepthPyramid(framebufferWidth, framebufferHeight, projectionMatrix * viewMatrix, *_stateCache);
+        }
 
+        if(IS_FIRST_PERSON_DUE) {
+            _firstPersonView->bindForRendering();
+            _renderView(firstPersonViewMatrix, firstPersonProjectionMatrix, _firstPersonCullingStats);
+        }
+        if(IS_FIRST_PERSON_VISIBLE) {
+            // frames that skip the redraw show the last image again
+            _firstPersonView->composite(framebufferWidth, framebufferHeight);
+        }
+        glEndQuery( GL_TIME_ELAPSED );
+        _viewTimerFrame++;
 
-
-        _updateScene();
-
+        _uniformRing->endFrame();                       // fence the uniform blocks written this frame
+        _redrawScheduler->frameDrawn(*_snapshot, _snapshotAlpha);
         glfwSwapBuffers(_window);                       // flush the OpenGL commands and make sure they get rendered!
         glfwPollEvents();				                // check for any events and signal to redraw screen
     }
+    _simulation->stop();
 }
 
-//*************************************************************************************
-//
-// Private Helper FUnctions
-
-void MPEngine::_computeAndSendMatrixUniforms(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const {
-    // precompute the Model-View-Projection matrix on the CPU
-    glm::mat4 mvpMtx = projMtx * viewMtx * modelMtx;
-    // then send it to the shader on the GPU to apply to every vertex
-    _lightingShaderProgram->setProgramUniform(_lightingShaderUniformLocations.mvpMatrix, mvpMtx);
-    _lightingShaderProgram->setProgramUniform(_lightingShaderUniformLocations.modelMtx, modelMtx);
-    glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(modelMtx)));
-    _lightingShaderProgram->setProgramUniform(_lightingShaderUniformLocations.normalMatrix, normalMatrix);
-}
-
-void MPEngine::_changeCamera(bool up) {
-    if(up){
-        if(_cameraIndex == 1){
-            _cameraIndex = 0;
+bool MPEngine::runHeadless(GLuint numTicks) {
+    // every character takes a turn driving, weaving left and right and now and then backing up
+    const GLuint TICKS_PER_CHARACTER = 4 * Simulation::TICK_RATE;
+    const GLuint TICKS_PER_TURN = Simulation::TICK_RATE;
+    const GLint CHARACTER_KEYS[NUM_CHASE_TARGETS] = { GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3 };
+    const GLint DRIVING_KEYS[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D };
+    const GLdouble STEP = _simulation->getStepSeconds();
+
+    // the same scripted input the keyboard would send, ticked on this thread as fast as it goes
+    bool wasHeld[4] = { false, false, false, false };
+    GLuint modelChoice = NUM_CHASE_TARGETS;
+    auto start = std::chrono::steady_clock::now();
+    for(GLuint tick = 0; tick < numTicks; tick++) {
+        if((tick / TICKS_PER_CHARACTER) % NUM_CHASE_TARGETS != modelChoice) {
+            modelChoice = (tick / TICKS_PER_CHARACTER) % NUM_CHASE_TARGETS;
+            _simulation->pushInput( { InputEvent::KEY, CHARACTER_KEYS[modelChoice], GLFW_PRESS, glm::vec2(0.0f) } );
+            _simulation->pushInput( { InputEvent::KEY, CHARACTER_KEYS[modelChoice], GLFW_RELEASE, glm::vec2(0.0f) } );
         }
-        else{
-            _cameraIndex++;
+        const bool IS_TURNING_LEFT = (tick / TICKS_PER_TURN) % 2 == 0;
+        const bool IS_REVERSING = (tick / TICKS_PER_TURN) % 5 == 4;
+        const bool IS_HELD[4] = { !IS_REVERSING, IS_REVERSING, IS_TURNING_LEFT, !IS_TURNING_LEFT };
+        for(GLuint i = 0; i < 4; i++) {
+            if(IS_HELD[i] == wasHeld[i]) continue;
+            _simulation->pushInput( { InputEvent::KEY, DRIVING_KEYS[i], IS_HELD[i] ? GLFW_PRESS : GLFW_RELEASE, glm::vec2(0.0f) } );
+            wasHeld[i] = IS_HELD[i];
         }
+
+        _simulation->tick(tick * STEP);
     }
-    else{
-        if(_cameraIndex == 0){
-            _cameraIndex = 1;
-        }
-        else{
-            _cameraIndex--;
+    std::chrono::duration<GLdouble, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    const GLdouble SIMULATED_SECONDS = numTicks * STEP;
+    fprintf( stdout, "[INFO]: headless: %u ticks (%.1f simulated seconds at %u Hz) in %.3f ms, %.0f ticks per second, %.0fx real time\n",
+             numTicks, SIMULATED_SECONDS, Simulation::TICK_RATE, elapsed.count(),
+             numTicks / (elapsed.count() / 1000.0), SIMULATED_SECONDS / (elapsed.count() / 1000.0) );
+
+    const WorldSnapshot& snapshot = _simulation->acquireSnapshot();
+    bool isInsideWorld = true;
+    for(const glm::vec3& position : snapshot.chaseTargets) {
+        fprintf( stdout, "[INFO]: headless: character ended at (%.3f, %.3f, %.3f)\n", position.x, position.y, position.z );
+        if(!std::isfinite(position.x) || !std::isfinite(position.z) ||
+           std::fabs(position.x) > WORLD_SIZE + 1.0f || std::fabs(position.z) > WORLD_SIZE + 1.0f) {
+            fprintf( stderr, "[ERROR]: headless: a character left the world\n" );
+            isInsideWorld = false;
         }
     }
+    return isInsideWorld;
 }
 
-void MPEngine::_drawFirstPerson(glm::mat4 viewMtx, glm::mat4 projMtx) {
-    _lightingShaderProgram->useProgram();
-
-    //// BEGIN DRAWING THE GROUND PLANE ////
-    // draw the ground plane
-    glm::mat4 groundModelMtx = glm::scale( glm::mat4(1.0f), glm::vec3(WORLD_SIZE, 1.0f, WORLD_SIZE));
-    _computeAndSendMatrixUniforms(groundModelMtx, viewMtx, projMtx);
+//*************************************************************************************
+//
+// Private Helper FUnctions
 
-    glm::vec3 groundColor(0.3f, 0.8f, 0.2f);
-    glUniform3fv(_lightingShaderUniformLocations.materialColor, 1, &groundColor[0]);
+FrameUniforms MPEngine::_makeFrameUniforms(glm::mat4 viewMtx, glm::mat4 projMtx) const {
+    FrameUniforms frameUniforms = _frameUniforms;
+    frameUniforms.viewProjectionMtx = projMtx * viewMtx;
+    return frameUniforms;
+}
 
-    glBindVertexArray(_groundVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, _numGroundPoints, GL_UNSIGNED_SHORT, (void*)0);
-    //// END DRAWING THE GROUND PLANE ////
+void MPEngine::_sendFrameUniforms(glm::mat4 viewMtx, glm::mat4 projMtx) const {
+    _uniformRing->push( FRAME_BLOCK_BINDING, _makeFrameUniforms(viewMtx, projMtx) );
+}
 
-    //// BEGIN DRAWING THE BUILDINGS ////
-    for( const BuildingData& currentBuilding : _buildings ) {
-        _computeAndSendMatrixUniforms(currentBuilding.modelMatrix, viewMtx, projMtx);
+GLuint MPEngine::_getLightFeatures() const {
+    return (_pointLightOn ? (GLuint)SHADER_FEATURE_POINT_LIGHT : 0u) | (_spotLightOn ? (GLuint)SHADER_FEATURE_SPOT_LIGHT : 0u);
+}
 
-        glUniform3fv(_lightingShaderUniformLocations.materialColor, 1, &currentBuilding.color[0]);
+void MPEngine::_applyLightToggles() {
+    // a light that is off is black, which bakes to nothing and is compiled out of the shading
+    _frameUniforms.pointLightColor = _pointLightOn ? POINT_LIGHT_COLOR : glm::vec3(0.0f);
+    _frameUniforms.spotLightColor = _spotLightOn ? SPOT_LIGHT_COLOR : glm::vec3(0.0f);
+    _staticLighting->bake(_frameUniforms);
+    _staticLayerCache->invalidate();
+    _setShadingProgram(false);
+}
 
-        CSCI441::drawSolidCube(1.0);
+void MPEngine::_updateClusterLights() {
+    const glm::vec3 FUSE_LIGHT_COLOR(1.0f, 0.5f, 0.1f);
+    ClusterLight fuseLight = { _bobomb->getFusePosition(*_renderTransforms), FUSE_LIGHT_RADIUS, FUSE_LIGHT_COLOR, 0.0f };
+    // the fuse lights the ground and buildings captured in the static layer
+    if(memcmp(&fuseLight, &_lastFuseLight, sizeof(ClusterLight)) != 0) {
+        _staticLayerCache->invalidate();
+        _lastFuseLight = fuseLight;
     }
 
-    for( TreeData currentTree : _trees){
-        _computeAndSendMatrixUniforms(currentTree.modelMatrix, viewMtx, projMtx);
-
-        glUniform3fv(_lightingShaderUniformLocations.materialColor, 1, &currentTree.treeColor[0]);
-        CSCI441::drawSolidCylinder(0.5f, 0.5f, currentTree.leafTranslate.y, 2, 4);
-
-        currentTree.modelMatrix = glm::translate(currentTree.modelMatrix, currentTree.leafTranslate);
-        _computeAndSendMatrixUniforms(currentTree.modelMatrix, viewMtx, projMtx);
+    _clusterLights = _streetLights;
+    _clusterLights.push_back(fuseLight);
+    _lightClusters->setLights(_clusterLights);
+}
 
-        glUniform3fv(_lightingShaderUniformLocations.materialColor, 1, &currentTree.leafColor[0]);
-        CSCI441::drawSolidCone(.75f,2,2,4);
+void MPEngine::_sendClusterUniforms(glm::mat4 viewMtx, glm::mat4 projMtx) const {
+    ClusterUniforms clusterUniforms = {};
+    if(_clusteredLightsOn) {
+        // clusters are laid over whichever viewport the view is about to draw into
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        clusterUniforms = _lightClusters->build(viewMtx, projMtx, viewport[2], viewport[3]);
+    }
+    _uniformRing->push( CLUSTER_BLOCK_BINDING, clusterUniforms );
+    _lightClusters->bind(LIGHT_CLUSTER_TEXTURE_UNIT);
+}
 
+void MPEngine::_cullEnvironment(const Frustum* frustums, GLuint numFrustums, CullingStats& cullingStats,
+                                const glm::mat4* occlusionViewProjectionMtx, const glm::vec3* impostorViewPosition) const {
+    // only upload the instances whose grid cell can be seen from one of the views
+    cullingStats.reset();
+    _visibleImpostors.clear();
+    const bool USE_IMPOSTORS = _impostorsOn && impostorViewPosition != nullptr;
+
+    _visibleObjects.clear();
+    _parallelCuller->query(*_buildingGrid, frustums, numFrustums, _visibleObjects, cullingStats);
+    if(occlusionViewProjectionMtx != nullptr) {
+        // the buildings in view double as the occluders for everything else
+        _occlusionCuller->beginFrame(*occlusionViewProjectionMtx);
+        _occlusionCuller->renderOccluders(_buildingBounds, _visibleObjects);
+        cullingStats.occludedObjects += _occlusionCuller->cullOccluded(_buildingBounds, _visibleObjects, true);
+    }
+    if(USE_IMPOSTORS) {
+        cullingStats.impostors += _separateImpostors(_buildingBounds, _buildingImpostors, *impostorViewPosition);
+    }
+    _uploadVisibleInstances(_buildingMesh, _buildingInstances);
 
+    _visibleObjects.clear();
+    _parallelCuller->query(*_treeGrid, frustums, numFrustums, _visibleObjects, cullingStats);
+    if(occlusionViewProjectionMtx != nullptr) {
+        cullingStats.occludedObjects += _occlusionCuller->cullOccluded(_treeBounds, _visibleObjects, false);
+    }
+    if(USE_IMPOSTORS) {
+        cullingStats.impostors += _separateImpostors(_treeBounds, _treeImpostors, *impostorViewPosition);
     }
-    //// END DRAWING THE BUILDINGS AND TREES////
-    //// BEGIN DRAWING THE MOTORCYCLE ////
-    glm::mat4 modelMtx(1.0f);
-    glm::mat4 motorcycleModelMtx(1.0f);
+    cullingStats.visibleObjects -= cullingStats.occludedObjects + cullingStats.impostors;
+    _uploadVisibleInstances(_trunkMesh, _trunkInstances);
+    _uploadVisibleInstances(_leafMesh, _leafInstances);
 
-    motorcycleModelMtx = glm::translate(motorcycleModelMtx, _motorcycle->getPosition());
-    _motorcycle->drawMotorcycle(motorcycleModelMtx, viewMtx, projMtx);
-    //// END DRAWING THE MOTORCYCLE ////
-    glm::mat4 modelBobombMtx(1.0f);
-    //// BEGIN DRAWING THE HERO ////
-    // model translated relative to stored hero position coordinates.
-    modelBobombMtx = glm::translate(modelBobombMtx, glm::vec3(_bobomb->getPosition().x, _bobomb->getPosition().y,
-                                                              _bobomb->getPosition().z));
-    // model rotated relative to stored direction angle
-    modelBobombMtx = glm::rotate(modelBobombMtx, _bobomb->getDirection(), CSCI441::Y_AXIS);
-    _bobomb->drawBobomb(modelBobombMtx, viewMtx, projMtx);
-    //// END DRAWING THE HERO ////
+    _impostorAtlas->setInstances(_visibleImpostors.data(), _visibleImpostors.size());
+}
 
-    //// BEGIN DRAWING THE ROBOT ////
-    glm::mat4 robotModelMtx(1.0f);
-    robotModelMtx = glm::translate(robotModelMtx, _robot->getPosition());
-    _robot->drawRobot(robotModelMtx, viewMtx, projMtx);
-    //// END DRAWING THE ROBOT ////
+GLuint MPEngine::_separateImpostors(const std::vector<BoundingBox>& bounds, const std::vector<ImpostorInstance>& impostors,
+                                    const glm::vec3& viewPosition) const {
+    _farObjects.clear();
+    GLuint numMoved = _parallelCuller->separateFar(_visibleObjects, bounds, viewPosition, IMPOSTOR_DISTANCE, _farObjects);
+    _parallelCuller->gather(_farObjects, impostors, _visibleImpostors);
+    return numMoved;
+}
+
+void MPEngine::_uploadVisibleInstances(Mesh* mesh, const std::vector<InstanceData>& instances) const {
+    _visibleInstances.clear();
+    _parallelCuller->gather(_visibleObjects, instances, _visibleInstances);
+    mesh->setInstances(_visibleInstances.data(), _visibleInstances.size());
 }
 
 //*************************************************************************************
@@ -785,3 +1255,10 @@ void a3_engine_mouse_button_callback(GLFWwindow *window, int button, int action,
     // pass the mouse button and action through to the engine
     engine->handleMouseButtonEvent(button, action);
 }
+
+void a3_engine_window_refresh_callback(GLFWwindow *window ) {
+    auto engine = (MPEngine*) glfwGetWindowUserPointer(window);
+
+    // the window needs repainting, whether or not anything changed
+    engine->handleWindowRefreshEvent();
+}
@@ -9,32 +9,56 @@
 #include "bobomb.hpp"
 #include "robot.hpp"
 #include "ArcBallCam.hpp"
+#include "mesh.hpp"
+#include "occlusionCulling.hpp"
+#include "culling.hpp"
+#include "glStateCache.hpp"
+#include "gpuCulling.hpp"
+#include "impostors.hpp"
+#include "jobSystem.hpp"
+#include "lightClusters.hpp"
+#include "redrawScheduler.hpp"
+#include "renderQueue.hpp"
+#include "secondaryView.hpp"
+#include "shaderCache.hpp"
+#include "simulation.hpp"
+#include "staticLighting.hpp"
+#include "staticLayerCache.hpp"
+#include "transformHierarchy.hpp"
+#include "uniformBuffers.hpp"
 
 #include <vector>
 
 class MPEngine : public CSCI441::OpenGLEngine {
 public:
-    MPEngine();
+    /// \param isHeadless if true the window is hidden, for runHeadless()
+    explicit MPEngine(bool isHeadless = false);
     ~MPEngine();
 
     void run() final;
 
-    /// \desc handle any key events inside the engine
+    /// \desc ticks the simulation as fast as possible without drawing, every character driving
+    /// around on a scripted input, and reports the tick rate reached
+    /// \param numTicks number of simulation ticks to run
+    /// \return true if every character is still inside the world afterwards
+    bool runHeadless(GLuint numTicks);
+
+    /// \desc handle any key events inside the engine, the simulation is handed every event too
     /// \param key key as represented by GLFW_KEY_ macros
     /// \param action key event action as represented by GLFW_ macros
     void handleKeyEvent(GLint key, GLint action);
 
-    /// \desc handle any mouse button events inside the engine
+    /// \desc hand mouse button events to the simulation
     /// \param button mouse button as represented by GLFW_MOUSE_BUTTON_ macros
     /// \param action mouse event as represented by GLFW_ macros
     void handleMouseButtonEvent(GLint button, GLint action);
 
-    /// \desc handle any cursor movement events inside the engine
+    /// \desc hand cursor movement events to the simulation
     /// \param currMousePosition the current cursor position
     void handleCursorPositionEvent(glm::vec2 currMousePosition);
 
-    /// \desc value off-screen to represent mouse has not begun interacting with window yet
-    static constexpr GLfloat MOUSE_UNINITIALIZED = -9999.0f;
+    /// \desc redraws the window once its contents were damaged or it was resized
+    void handleWindowRefreshEvent();
 
 private:
     void _setupGLFW() final;
@@ -46,26 +70,74 @@ private:
     void _cleanupBuffers() final;
     void _cleanupShaders() final;
 
-    void _changeCamera(bool up);
-
-    /// \desc draws everything to the scene from a particular point of view
+    /// \desc walks the scene once per frame, recording every draw into the render queue
+    void _recordScene() const;
+    /// \desc records the draws of one slice of the scene, runs on the job system
+    void _recordSlice(GLuint slice) const;
+    /// \desc draws the recorded scene from a particular point of view
     /// \param viewMtx the current view matrix for our camera
     /// \param projMtx the current projection matrix for our camera
-    void _renderScene(glm::mat4 viewMtx, glm::mat4 projMtx) const;
-    /// \desc handles moving our FreeCam as determined by keyboard input
-    void _updateScene();
-
-    /// \desc tracks the number of different keys that can be present as determined by GLFW
-    static constexpr GLuint NUM_KEYS = GLFW_KEY_LAST;
-    /// \desc boolean array tracking each key state.  if true, then the key is in a pressed or held
-    /// down state.  if false, then the key is in a released state and not being interacted with
-    GLboolean _keys[NUM_KEYS];
-
-    /// \desc last location of the mouse in window coordinates
-    glm::vec2 _mousePosition;
-    /// \desc current state of the left mouse button
-    GLint _leftMouseButtonState;
-    GLint _shiftButtonState;
+    /// \param cullingStats receives how many buildings and trees were culled for this view
+    /// \param useOcclusion if true objects hidden behind nearer geometry are skipped, using last frame's
+    /// depth when culling on the GPU and the software occlusion culler otherwise
+    void _renderView(glm::mat4 viewMtx, glm::mat4 projMtx, CullingStats& cullingStats, bool useOcclusion = false) const;
+    /// \desc draws the render queue for a view in a depth-only pass followed by a GL_EQUAL
+    /// shading pass, so every visible pixel is lit and written once
+    /// \param viewMtx camera view matrix
+    /// \param layerMask renderLayerBit() of every layer to draw
+    /// \param useBakedLighting if true the shading pass reads the lighting baked by _staticLighting
+    void _executeWithDepthPrePass(glm::mat4 viewMtx, GLuint layerMask, bool useBakedLighting) const;
+    /// \desc draws the render queue for a view, with the depth pre-pass if it is on
+    /// \param viewMtx camera view matrix
+    /// \param layerMask renderLayerBit() of every layer to draw
+    void _executeRenderQueue(glm::mat4 viewMtx, GLuint layerMask) const;
+    /// \desc draws layers of the render queue with one shading program, with the depth pre-pass if it is on
+    /// \param viewMtx camera view matrix
+    /// \param layerMask renderLayerBit() of every layer to draw
+    /// \param useBakedLighting if true the layers are shaded with the lighting baked by _staticLighting
+    void _executeLayers(glm::mat4 viewMtx, GLuint layerMask, bool useBakedLighting) const;
+    /// \desc points the render queue at the program that shades its draws
+    /// \param useBakedLighting if true the baked lighting program, otherwise the real-time lighting program
+    void _setShadingProgram(bool useBakedLighting) const;
+    /// \desc draws the main view with the static environment restored from _staticLayerCache
+    /// when the camera has not moved, refreshing the cache once it comes to rest
+    /// \param viewMtx camera view matrix
+    /// \param projMtx camera projection matrix
+    /// \param framebufferWidth width of the window's framebuffer
+    /// \param framebufferHeight height of the window's framebuffer
+    void _renderCachedView(glm::mat4 viewMtx, glm::mat4 projMtx, GLint framebufferWidth, GLint framebufferHeight);
+    /// \desc draws the recorded scene once into a grid of viewports, one per character plus the free cam
+    /// \param framebufferWidth width of the window's framebuffer
+    /// \param framebufferHeight height of the window's framebuffer
+    /// \param projMtx projection matrix shared by every view
+    void _renderSplitScreen(GLint framebufferWidth, GLint framebufferHeight, glm::mat4 projMtx);
+    /// \desc fills in the camera of every split-screen view
+    /// \param viewMatrices receives up to MAX_SPLIT_SCREEN_VIEWS view matrices
+    /// \return number of views
+    GLuint _getSplitScreenViewMatrices(glm::mat4* viewMatrices) const;
+    /// \desc grid the split-screen views are arranged in
+    /// \param numViews number of views to fit
+    /// \param columns receives the number of views across
+    /// \param rows receives the number of views down
+    static void _getSplitScreenLayout(GLuint numViews, GLint& columns, GLint& rows);
+    /// \desc view matrix of a camera trailing above and behind a character
+    /// \param target position of the character to look at
+    glm::mat4 _getChaseViewMatrix(glm::vec3 target) const;
+    /// \desc view matrix of a camera part way from its pose before the snapshot's tick to its pose after
+    glm::mat4 _getInterpolatedViewMatrix(const CameraPose& previousPose, const CameraPose& pose) const;
+
+    /// \desc moves the characters and cameras on a thread of its own, rendering only reads its snapshots
+    Simulation* _simulation = nullptr;
+    /// \desc snapshot the current frame is drawn from
+    const WorldSnapshot* _snapshot = nullptr;
+    /// \desc how far the current frame is from the snapshot's previous state to its current one
+    GLfloat _snapshotAlpha = 1.0f;
+    /// \desc takes the latest snapshot and works out how far past it the frame is
+    void _acquireSnapshot();
+    /// \desc skips frames that would show the same image as the last one
+    RedrawScheduler* _redrawScheduler = nullptr;
+    /// \desc if true the window stays hidden
+    bool _isHeadless;
 
     /// \desc the arcball camera in our world
     CSCI441::ArcballCam* _arcballCam;
@@ -76,11 +148,6 @@ private:
     /// \desc the firstPerson camera in our world
     CSCI441::FreeCam* _firstPersonCam;
 
-    GLint _cameraIndex = 0;
-
-    /// \desc int to choose model drawn
-    GLint _modelChoice;
-
     /// \desc our motorcycle model
     Motorcycle* _motorcycle;
 
@@ -92,12 +159,10 @@ private:
 
     /// \desc the size of the world (controls the ground size and locations of buildings)
     static constexpr GLfloat WORLD_SIZE = 55.0f;
-    /// \desc VAO for our ground
-    GLuint _groundVAO;
-    /// \desc the number of points that make up our ground object
-    GLsizei _numGroundPoints;
+    /// \desc unit quad scaled to the world size to form our ground
+    Mesh* _groundMesh = nullptr;
 
-    /// \desc creates the ground VAO
+    /// \desc creates the ground mesh
     void _createGroundBuffers();
 
     /// \desc smart container to store information specific to each building we wish to draw
@@ -120,28 +185,233 @@ private:
 
     std::vector<TreeData> _trees;
 
+    /// \desc fraction of open grid spots that receive a building or tree
+    static constexpr GLfloat ENVIRONMENT_DENSITY = 0.05f;
+    /// \desc fewest buildings or trees worth placing as a job of their own
+    static constexpr GLuint ENVIRONMENT_GRAIN_SIZE = 64;
+    /// \desc work-stealing pool the environment is placed, culled and lit on
+    JobSystem* _jobSystem = nullptr;
+    /// \desc slices of the scene recorded as separate jobs, merged into the render queue in this order
+    enum SceneSlice : GLuint {
+        SCENE_SLICE_ENVIRONMENT,
+        SCENE_SLICE_MOTORCYCLE,
+        SCENE_SLICE_BOBOMB,
+        SCENE_SLICE_ROBOT,
+        NUM_SCENE_SLICES
+    };
+    /// \desc draws of each slice this frame, recorded off the GL thread
+    mutable DrawList _drawLists[NUM_SCENE_SLICES];
+
+    /// \desc unit cube drawn once per building
+    Mesh* _buildingMesh = nullptr;
+    /// \desc unit height cylinder scaled per tree to form its trunk
+    Mesh* _trunkMesh = nullptr;
+    /// \desc cone drawn on top of each trunk
+    Mesh* _leafMesh = nullptr;
+
+    /// \desc per-instance data of every building, indexed the same as _buildings
+    std::vector<InstanceData> _buildingInstances;
+    /// \desc per-instance data of every tree trunk and top, indexed the same as _trees
+    std::vector<InstanceData> _trunkInstances;
+    std::vector<InstanceData> _leafInstances;
+    /// \desc the ground is drawn as a single instance so it can share the baked lighting path
+    InstanceData _groundInstance;
+
+    /// \desc number of culling grid cells along each side of the world
+    static constexpr GLint CULLING_GRID_CELLS = 16;
+    /// \desc buckets buildings by location so whole cells can be frustum culled at once
+    SpatialGrid* _buildingGrid = nullptr;
+    /// \desc buckets trees by location so whole cells can be frustum culled at once
+    SpatialGrid* _treeGrid = nullptr;
+    /// \desc world space bounds of every building and tree, indexed the same as their instances
+    std::vector<BoundingBox> _buildingBounds;
+    std::vector<BoundingBox> _treeBounds;
+    /// \desc spreads the grid queries and the gathering of the instances over _jobSystem
+    ParallelCuller* _parallelCuller = nullptr;
+    /// \desc rasterizes the nearest buildings on the CPU to drop what they hide from the main view
+    OcclusionCuller* _occlusionCuller = nullptr;
+    /// \desc if true the main view is occlusion culled before its instances are uploaded
+    bool _occlusionCullingOn = true;
+    /// \desc sprites of every building height and tree variant, baked at startup
+    ImpostorAtlas* _impostorAtlas = nullptr;
+    /// \desc if true distant buildings and trees are drawn as impostors
+    bool _impostorsOn = true;
+    /// \desc objects whose center is farther than this from the camera are drawn as impostors
+    static constexpr GLfloat IMPOSTOR_DISTANCE = 40.0f;
+    /// \desc building heights baked into the atlas, each building is drawn with the nearest
+    static constexpr GLfloat IMPOSTOR_BUILDING_HEIGHTS[] = { 1.5f, 3.0f, 5.5f, 9.0f };
+    /// \desc trunk heights baked into the atlas, each tree is drawn with the nearest
+    static constexpr GLfloat IMPOSTOR_TREE_HEIGHTS[] = { 1.5f, 3.0f, 5.0f };
+    /// \desc where variants are placed while baking, far enough that the point and spot lights do not reach
+    static constexpr GLfloat IMPOSTOR_BAKE_DISTANCE = 1000.0f;
+    /// \desc atlas variant of each entry in IMPOSTOR_BUILDING_HEIGHTS and IMPOSTOR_TREE_HEIGHTS
+    std::vector<GLint> _buildingImpostorVariants;
+    std::vector<GLint> _treeImpostorVariants;
+    /// \desc impostor of every building and tree, indexed the same as their instances
+    std::vector<ImpostorInstance> _buildingImpostors;
+    std::vector<ImpostorInstance> _treeImpostors;
+    /// \desc scratch list of the impostors drawn in the current view
+    mutable std::vector<ImpostorInstance> _visibleImpostors;
+    /// \desc registers every building height and tree variant with the atlas
+    void _setupImpostors();
+    /// \desc draws every variant into the atlas, the lights must already be set
+    void _bakeImpostors();
+    /// \desc model matrices and colors of a building as _generateEnvironment() would place it
+    /// \param position where the building stands
+    /// \param height height of the building
+    static BuildingData _makeBuilding(glm::vec3 position, GLfloat height);
+    /// \desc model matrix and colors of a tree as _generateEnvironment() would place it
+    /// \param position where the tree stands
+    /// \param height height of the trunk
+    static TreeData _makeTree(glm::vec3 position, GLfloat height);
+    /// \desc index of the height closest to a value
+    static GLuint _nearestHeight(const GLfloat* heights, GLuint numHeights, GLfloat height);
+    /// \desc scratch lists reused every view to avoid reallocating while culling
+    mutable std::vector<GLuint> _visibleObjects;
+    mutable std::vector<GLuint> _farObjects;
+    mutable std::vector<InstanceData> _visibleInstances;
+
+    /// \desc culling results of the last frame for the main view
+    CullingStats _mainViewCullingStats;
+    /// \desc culling results of the last frame for the first person inset
+    CullingStats _firstPersonCullingStats;
+    /// \desc culling results of the last frame for the split-screen views combined
+    CullingStats _splitScreenCullingStats;
+
     /// \desc generates building information to make up our scene
     void _generateEnvironment();
-
-    /// \desc shader program that performs lighting
-    CSCI441::ShaderProgram* _lightingShaderProgram = nullptr;   // the wrapper for our shader program
-    /// \desc stores the locations of all of our shader uniforms
-    struct LightingShaderUniformLocations {
-        /// \desc precomputed MVP matrix location
-        GLint mvpMatrix;
-        /// \desc material diffuse color location
+    /// \desc computes the per-instance data and bounds of every building and tree and
+    /// inserts them into the culling grids
+    void _buildEnvironmentInstances();
+    /// \desc uploads the buildings and trees inside any of the view frustums as the instances of their meshes
+    /// \param frustums frustums of the views the instances will be drawn in
+    /// \param numFrustums number of entries in frustums
+    /// \param cullingStats receives how many buildings and trees were culled for these views
+    /// \param occlusionViewProjectionMtx if not null, objects this camera cannot see past the nearest
+    /// buildings are culled too
+    /// \param impostorViewPosition if not null, objects farther than IMPOSTOR_DISTANCE from this
+    /// camera position are handed to _impostorAtlas instead of their meshes
+    void _cullEnvironment(const Frustum* frustums, GLuint numFrustums, CullingStats& cullingStats,
+                          const glm::mat4* occlusionViewProjectionMtx = nullptr,
+                          const glm::vec3* impostorViewPosition = nullptr) const;
+    /// \desc moves the objects listed in _visibleObjects that are far from the camera into _visibleImpostors
+    /// \param bounds world space bounds of the objects
+    /// \param impostors impostor of each object, indexed the same as bounds
+    /// \param viewPosition world space position of the camera
+    /// \return number of objects moved
+    GLuint _separateImpostors(const std::vector<BoundingBox>& bounds, const std::vector<ImpostorInstance>& impostors,
+                              const glm::vec3& viewPosition) const;
+    /// \desc uploads the instances listed in _visibleObjects to a mesh
+    void _uploadVisibleInstances(Mesh* mesh, const std::vector<InstanceData>& instances) const;
+
+    /// \desc builds every permutation of the lighting programs, or links it from a binary cached on disk
+    ShaderCache* _shaderCache = nullptr;
+    /// \desc where the program binaries are kept, relative to the working directory
+    static constexpr const char* SHADER_CACHE_DIRECTORY = "shaderCache";
+    /// \desc one lighting program per combination of the point and spot light
+    static constexpr GLuint NUM_LIGHT_PERMUTATIONS = 4;
+    /// \desc the permutations of a lighting program for single and for instanced draws
+    struct LightingPermutation {
+        GLuint program;
+        /// \desc material diffuse color location in program, the instanced program reads it per instance
         GLint materialColor;
-        GLint pointLightColor;
-        GLint pointLightPosition;
-        GLint lightColor;
-        GLint lightDirection;
-        GLint normalMatrix;
-        GLint modelMtx;
-        GLint spotLightPosition;
-        GLint spotLightColor;
-        GLint spotLightPhi;
-        GLint spotLightDirection;
-    } _lightingShaderUniformLocations;
+        GLuint instancedProgram;
+    };
+    /// \desc lighting program for every combination of lights, indexed by _getLightFeatures()
+    LightingPermutation _lightingPrograms[NUM_LIGHT_PERMUTATIONS];
+    /// \desc lighting program plus a geometry shader that replicates each triangle into every
+    /// split-screen viewport, indexed by _getLightFeatures()
+    LightingPermutation _splitScreenPrograms[NUM_LIGHT_PERMUTATIONS];
+    /// \desc builds the single and instanced permutations of lab05.v.glsl with a set of lights
+    /// \param geometryPath geometry shader to add, nullptr for none
+    /// \param fragmentPath fragment shader to pair them with
+    /// \param lightFeatures SHADER_FEATURE_POINT_LIGHT and SHADER_FEATURE_SPOT_LIGHT bits to build with
+    LightingPermutation _makeLightingPermutation(const char* geometryPath, const char* fragmentPath, GLuint lightFeatures);
+    /// \desc attaches the uniform blocks and samplers a lighting or depth program uses to their binding points
+    static void _bindLightingProgram(GLuint program);
+    /// \desc if true the point light is added, or baked, into the lighting
+    bool _pointLightOn = true;
+    /// \desc if true the spot light is added, or baked, into the lighting
+    bool _spotLightOn = true;
+    /// \desc the lighting permutation features of the lights that are on
+    GLuint _getLightFeatures() const;
+    /// \desc writes the toggled lights into the FrameBlock and re-bakes the static lighting with them
+    void _applyLightToggles();
+
+    /// \desc position-only programs the depth pre-pass draws single and instanced packets with, owned by _shaderCache
+    GLuint _depthProgram = 0;
+    GLuint _instancedDepthProgram = 0;
+    /// \desc if true the render queue is drawn depth first, then shaded with GL_EQUAL
+    bool _depthPrePassOn = false;
+
+    /// \desc instanced program the static environment is drawn with, reading its lighting from _staticLighting
+    GLuint _bakedLightingProgram = 0;
+    /// \desc lit vertex colors of the ground, buildings and trees, baked once the lights are set
+    StaticLighting* _staticLighting = nullptr;
+    /// \desc if true the static environment is drawn with its baked lighting
+    bool _bakedLightingOn = true;
+    /// \desc texture unit the baked lighting is read from
+    static constexpr GLint BAKED_LIGHTING_TEXTURE_UNIT = 2;
+
+    /// \desc assigns the streetlights and fuse lights to the clusters of each view
+    LightClusters* _lightClusters = nullptr;
+    /// \desc if true the lighting and baked lighting programs add the lights of each fragment's cluster
+    bool _clusteredLightsOn = true;
+    /// \desc first of the three consecutive texture units LightClusters::bind() uses
+    static constexpr GLint LIGHT_CLUSTER_TEXTURE_UNIT = 3;
+    /// \desc one light over every road intersection, placed by _generateEnvironment()
+    std::vector<ClusterLight> _streetLights;
+    /// \desc streetlights followed by the fuse light, rebuilt every frame
+    std::vector<ClusterLight> _clusterLights;
+    /// \desc the fuse light last frame, the static layer cache is stale once it moves
+    ClusterLight _lastFuseLight = {};
+    static constexpr GLfloat STREETLIGHT_HEIGHT = 3.0f;
+    static constexpr GLfloat STREETLIGHT_RADIUS = 5.0f;
+    static constexpr GLfloat FUSE_LIGHT_RADIUS = 3.0f;
+    /// \desc gathers this frame's lights, after _recordScene() has updated the transforms
+    void _updateClusterLights();
+    /// \desc assigns the lights to the clusters of a view and binds the result for the lighting programs
+    /// \param viewMtx camera view matrix
+    /// \param projMtx camera projection matrix
+    void _sendClusterUniforms(glm::mat4 viewMtx, glm::mat4 projMtx) const;
+
+    /// \desc tracks bound program, VAO and uniform values to drop redundant GL calls
+    GLStateCache* _stateCache = nullptr;
+    /// \desc shared primitive meshes used by the characters
+    MeshLibrary* _meshLibrary = nullptr;
+    /// \desc every character part, the simulation moves them once it starts
+    TransformHierarchy* _transformHierarchy = nullptr;
+    /// \desc copy of _transformHierarchy placed from each snapshot, caches the world matrices the characters are drawn at
+    TransformHierarchy* _renderTransforms = nullptr;
+    /// \desc draws recorded once per frame and replayed for each view
+    RenderQueue* _renderQueue = nullptr;
+    /// \desc culls and draws the whole scene on the GPU, nullptr if the context lacks GL 4.3 features
+    GpuCuller* _gpuCuller = nullptr;
+    /// \desc if true the scene is drawn through _gpuCuller rather than the CPU grid and render queue
+    bool _gpuCullingOn = false;
+    /// \desc creates the GPU culler if supported and registers the buildings and trees with it
+    void _setupGpuCulling();
+    /// \desc every camera drawn this frame, used to pick character levels of detail
+    std::vector<LodView> _lodViews;
+
+    /// \desc bytes of uniform blocks a single frame may write
+    static constexpr GLsizeiptr UNIFORM_RING_BYTES_PER_FRAME = 1 << 20;
+    /// \desc number of frames the CPU may get ahead of the GPU
+    static constexpr GLuint FRAMES_IN_FLIGHT = 3;
+    /// \desc persistently mapped storage for every uniform block written during a frame
+    UniformRingBuffer* _uniformRing = nullptr;
+    /// \desc GL_TIME_ELAPSED queries around the views of the last frames, read back a few frames later
+    GLuint _viewTimerQueries[FRAMES_IN_FLIGHT];
+    /// \desc number of frames timed so far, selects the query to reuse
+    GLuint _viewTimerFrame = 0;
+    /// \desc GPU time of the most recent frame whose timer came back
+    GLdouble _viewGpuMilliseconds = 0.0;
+    /// \desc light constants, the view-projection matrix is filled in per view
+    FrameUniforms _frameUniforms = {};
+    /// \desc the camera and light constants of a view
+    FrameUniforms _makeFrameUniforms(glm::mat4 viewMtx, glm::mat4 projMtx) const;
+    /// \desc writes the camera and light constants for a view and binds them
+    void _sendFrameUniforms(glm::mat4 viewMtx, glm::mat4 projMtx) const;
     /// \desc stores the locations of all of our shader attributes
     struct LightingShaderAttributeLocations {
         /// \desc vertex position location
@@ -150,20 +420,23 @@ private:
     } _lightingShaderAttributeLocations;
 
     bool firstPersonOn = false;
-
-    /// \desc precomputes the matrix uniforms CPU-side and then sends them
-    /// to the GPU to be used in the shader for each vertex.  It is more efficient
-    /// to calculate these once and then use the resultant product in the shader.
-    /// \param modelMtx model transformation matrix
-    /// \param viewMtx camera view matrix
-    /// \param projMtx camera projection matrix
-    void _computeAndSendMatrixUniforms(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const;
-
-    void _drawFirstPerson(glm::mat4 viewMtx, glm::mat4 projMtx);
+    /// \desc framebuffer pixels per window pixel of the first person inset
+    static constexpr GLfloat FIRST_PERSON_RESOLUTION_SCALE = 0.5f;
+    /// \desc the first person inset is redrawn once every this many frames
+    static constexpr GLuint FIRST_PERSON_UPDATE_INTERVAL = 2;
+    /// \desc offscreen target the first person camera is drawn into and composited from
+    SecondaryView* _firstPersonView = nullptr;
+    /// \desc color and depth of the ground, buildings and trees as last seen from the main view
+    StaticLayerCache* _staticLayerCache = nullptr;
+    /// \desc if true the main view reuses _staticLayerCache while the camera holds still
+    bool _staticLayerCacheOn = true;
+    /// \desc if true the window is split between every character and the free cam
+    bool _splitScreenOn = false;
 };
 
 void a3_engine_keyboard_callback(GLFWwindow *window, int key, int scancode, int action, int mods );
 void a3_engine_cursor_callback(GLFWwindow *window, double x, double y );
 void a3_engine_mouse_button_callback(GLFWwindow *window, int button, int action, int mods );
+void a3_engine_window_refresh_callback(GLFWwindow *window );
 
 #endif // LAB05_LAB05_ENGINE_HPP
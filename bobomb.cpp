@@ -10,28 +10,26 @@
 #include <CSCI441/OpenGLUtils.hpp>
 #include <CSCI441/OpenGLEngine.hpp>
 
+#include <cstdio>
+
 #ifndef M_PI
 #define M_PI 3.14159265
 #endif
 
 
-Bobomb::Bobomb( GLuint shaderProgramHandle, GLint mvpMtxUniformLocation, GLint normalMtxUniformLocation, GLint materialColorUniformLocation, GLint modelMtxUniformLocation ) {
+Bobomb::Bobomb( MeshLibrary* meshLibrary, TransformHierarchy* transforms ) {
 
     // initializing values in constructor
     _isFlicker = false;
-    _flickerCheck = 0;
+    _flickerTime = 0.0f;
 
     _wheelAngle = 0.0f;
-    _wheelAngleRotationSpeed = M_PI / 16.0f;
-
-    _shaderProgramHandle                            = shaderProgramHandle;
-    _shaderProgramUniformLocations.mvpMtx           = mvpMtxUniformLocation;
-    _shaderProgramUniformLocations.normalMtx        = normalMtxUniformLocation;
-    _shaderProgramUniformLocations.materialColor    = materialColorUniformLocation;
-    _shaderProgramUniformLocations.modelMtx    = modelMtxUniformLocation;
+    _wheelAngleRotationSpeed = 60.0f * M_PI / 16.0f;
 
+    _bobombPosition = glm::vec3( 0.0f, 0.0f, 0.0f );
     _bobombDirection =  0.0f;
-    _bobombDirectionRotationSpeed = M_PI / 24.0f;
+    _bobombDirectionRotationSpeed = 60.0f * M_PI / 24.0f;
+    _bobombSpeed = 9.0f;
 
     _colorBody = glm::vec3( 0.0f, 0.0f, 1.0f );
     _scaleBody = glm::vec3( 1.0f, 1.0f, 1.0f );
@@ -51,205 +49,191 @@ Bobomb::Bobomb( GLuint shaderProgramHandle, GLint mvpMtxUniformLocation, GLint n
     _colorFlicker = glm::vec3( 1.0f, 1.0f, 0.0f );
     _colorFlickerEx = glm::vec3( 1.0f, 0.0f, 0.0f );
 
+    // the body and eyes share one sphere, scaled per part
+    // coarser levels are picked by screen size, the eyes never use the body's finest ones
+    _rigidPartsLod = _bakeRigidParts(*meshLibrary);
+    _flickerMesh = meshLibrary->getCube( 0.05 );
+    // the wheels were drawn with 5 sides and 5 rings, too coarse to halve.  they start finer
+    // now and their coarsest level comes back down to about the original
+    _wheelLod = makeTorusLod(*meshLibrary, 0.1f,0.2f,10,12);
+    if(_wheelLod.getNumLevels() < 2) {
+        fprintf( stderr, "[ERROR]: bobomb wheel has a single level of detail\n" );
+    }
+    for(GLuint& lodLevel : _lodLevels) lodLevel = 0;
+
+    _transforms = transforms;
+    _addTransformNodes();
+
 }
 
-void Bobomb::drawBobomb( glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) {
-    glUseProgram( _shaderProgramHandle );
-
-    // apply transformations to entire model
-    modelMtx = glm::rotate(modelMtx,glm::radians(14.0f),CSCI441::Y_AXIS);
-    modelMtx = glm::translate(modelMtx,glm::vec3(0.0f,0.7f,0.0f));
-    modelMtx = glm::scale(modelMtx,glm::vec3(0.5f,0.5f,0.5f));
-
-    // draw each part of model, passing modelMtx between each.
-    _drawBobombBody(modelMtx, viewMtx, projMtx);        // the body of our bobomb
-    _drawBobombEye(true, modelMtx, viewMtx, projMtx);  // the left eye
-    _drawBobombEye(false, modelMtx, viewMtx, projMtx); // the right eye
-    _drawBobombFuse(modelMtx, viewMtx, projMtx);        // the fuse
-    _drawBobombFlicker(modelMtx, viewMtx, projMtx);       // the flicker
-    _drawBobombBoot(modelMtx, viewMtx, projMtx);   // the boot
-    _drawBobombWheels(modelMtx, viewMtx, projMtx);        // the wheels
+void Bobomb::drawBobomb( DrawList& drawList, const TransformHierarchy& transforms, bool isFlicker ) {
+    // queue each part of model at its cached world matrix.
+    // body, eyes, fuse and boot are a single baked mesh colored per vertex
+    drawList.submitLod(_rigidPartsLod, _lodLevels[LOD_RIGID_PARTS], transforms.getWorldMatrix(_bodyNode), glm::vec3(1.0f));
+    _drawBobombFlicker(drawList, transforms, isFlicker);       // the flicker
+    _drawBobombWheels(drawList, transforms);        // the wheels
 }
 // moving forward function
-void Bobomb::driveForward(GLfloat worldSize) {
+void Bobomb::driveForward(GLfloat worldSize, GLfloat deltaTime) {
     // update wheel angle to animate with movement
-    _wheelAngle += _wheelAngleRotationSpeed;
+    _wheelAngle += _wheelAngleRotationSpeed * deltaTime;
     if( _wheelAngle > 2.0f * M_PI ) _wheelAngle -= 2.0f * M_PI;
 
-    // create a new value by converting direction angle theta and a step size of 0.15 from polar
+    // create a new value by converting direction angle theta and the distance covered from polar
     // to linear coordinates; then add to the current position.
-    glm::vec3 nPosit = glm::vec3(-0.15*sin(-_bobombDirection),0.0f, 0.15*cos(-_bobombDirection));
+    GLfloat step = _bobombSpeed * deltaTime;
+    glm::vec3 nPosit = glm::vec3(-step*sin(-_bobombDirection),0.0f, step*cos(-_bobombDirection));
     _bobombPosition = _bobombPosition + nPosit;
     // bounds checking; if current position is outside the world, undo the movement just done. This functionally locks
     // down the edges of the map.
     if(_bobombPosition.x > worldSize || _bobombPosition.z > worldSize || _bobombPosition.x < -worldSize || _bobombPosition.z < -worldSize){
         _bobombPosition -= nPosit;
     }
+    _updateRootNode();
+    _updateWheelNodes();
 
 }
 // backwards moving function; very similar to the forwards movement one,
 // with the relative sign of the calculated value negated before being added to the position.
 // Bounds checking functionality inverted to account for the inverted direction.
-void Bobomb::driveBackward(GLfloat worldSize) {
-    _wheelAngle -= _wheelAngleRotationSpeed;
+void Bobomb::driveBackward(GLfloat worldSize, GLfloat deltaTime) {
+    _wheelAngle -= _wheelAngleRotationSpeed * deltaTime;
     if( _wheelAngle < 0.0f ) _wheelAngle += 2.0f * M_PI;
 
-    glm::vec3 nPosit = glm::vec3(-0.15f*sin(-_bobombDirection),0.0f,0.15*cos(-_bobombDirection));
+    GLfloat step = _bobombSpeed * deltaTime;
+    glm::vec3 nPosit = glm::vec3(-step*sin(-_bobombDirection),0.0f,step*cos(-_bobombDirection));
     _bobombPosition = _bobombPosition - nPosit;
     if(_bobombPosition.x > worldSize || _bobombPosition.z > worldSize || _bobombPosition.x < -worldSize || _bobombPosition.z < -worldSize){
         _bobombPosition += nPosit;
     }
+    _updateRootNode();
+    _updateWheelNodes();
 }
 // rotation function; takes a keypress as input,
 // and depending on which key is inputted, the stored
 // angle for our bobomb direction is updated appropriately.
-void Bobomb::rotateBobomb(GLuint key) {
+void Bobomb::rotateBobomb(GLuint key, GLfloat deltaTime) {
     if(key == GLFW_KEY_A) {
-        _bobombDirection += _bobombDirectionRotationSpeed;
+        _bobombDirection += _bobombDirectionRotationSpeed * deltaTime;
         // angle bounds checking; keeps value between 0 and 2*pi.
         if( _bobombDirection > 2.0f * M_PI ) _bobombDirection -= 2.0f * M_PI;
     } else {
-        _bobombDirection -= _bobombDirectionRotationSpeed;
+        _bobombDirection -= _bobombDirectionRotationSpeed * deltaTime;
         if( _bobombDirection < 0 ) _bobombDirection = 2.0f * M_PI;
     }
+    _updateRootNode();
 }
 
 // idle animation function;
-// update this value on every rendered frame.
+// update this value on every simulation tick.
 // change the color of the light on the
 // bob-omb fuse over time; providing idle animation
 // regardless of movement.
-void Bobomb::_updateFlicker() {
-    _flickerCheck += 1;
-    if(_flickerCheck > 1e8) _flickerCheck = 0;
-    if(_flickerCheck % 30 == 0 && !(_isFlicker))_isFlicker = true;
-    else if(_flickerCheck % 30 == 0) _isFlicker = false;
+void Bobomb::_updateFlicker(GLfloat deltaTime) {
+    _flickerTime += deltaTime;
+    while(_flickerTime >= FLICKER_SECONDS) {
+        _flickerTime -= FLICKER_SECONDS;
+        _isFlicker = !_isFlicker;
+    }
 }
-// beginning of several draw functions; all
-// iteratively draw different parts of the model and pass
-// the modelMtx along to the next as it goes.
-void Bobomb::_drawBobombBody(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const {
-    modelMtx = glm::translate(modelMtx, glm::vec3(0.0f, 0.0f, 0.0f));
-    modelMtx = glm::scale( modelMtx, _scaleBody );
-    _computeAndSendMatrixUniforms(modelMtx, viewMtx, projMtx);
-
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorBody[0]);
+// the body, eyes, fuse and boot never move relative to each other, so they are
+// flattened into one mesh here using the same transformations they used to be drawn with.
+LodMesh Bobomb::_bakeRigidParts(MeshLibrary& meshLibrary) const {
+    // the body and eyes share one sphere, scaled per part
+    LodMesh bodyLod = makeSphereLod(meshLibrary, 0.5,FINEST_SEGMENTS,FINEST_SEGMENTS);
+    std::vector<BakePart> parts;
+
+    // the body of our bobomb
+    parts.push_back( { bodyLod, glm::scale( glm::mat4(1.0f), _scaleBody ), _colorBody } );
+    // the eyes; functionality derived from isLeftWing function from lab05 plane class.
+    glm::mat4 leftEyeMtx = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.5f));
+    glm::mat4 rightEyeMtx = glm::translate(glm::mat4(1.0f), glm::vec3(-0.3f, 0.0f, 0.4f));
+    parts.push_back( { bodyLod, glm::scale( leftEyeMtx, _scaleEye ), _colorEye } );
+    parts.push_back( { bodyLod, glm::scale( rightEyeMtx, _scaleEye ), _colorEye } );
+    // the fuse
+    parts.push_back( { LodMesh( meshLibrary.getCube( 0.15 ) ), glm::translate( glm::mat4(1.0f), _transFuse ), _colorFuse } );
+    // the boot
+    parts.push_back( { makeCylinderLod(meshLibrary, 0.5f,0.5f,1.1f,FINEST_SEGMENTS,FINEST_SEGMENTS),
+                       glm::translate( glm::mat4(1.0f), _transBootA ), _colorBoot } );
+    parts.push_back( { makeSphereLod(meshLibrary, 0.45,FINEST_SEGMENTS,FINEST_SEGMENTS),
+                       glm::translate( glm::mat4(1.0f), _transBootB ), _colorBoot } );
+    parts.push_back( { makeCylinderLod(meshLibrary, 0.4f,0.4f,0.3f,FINEST_SEGMENTS,FINEST_SEGMENTS),
+                       glm::translate( glm::mat4(1.0f), _transBootC ), _colorBoot } );
+
+    return bakeLodMesh(meshLibrary, "bobomb", parts);
+}
+// the parts form a small tree: the root places the bobomb in the world, the body node
+// tilts and scales the model around it and the flicker and wheels hang off the body.
+void Bobomb::_addTransformNodes() {
+    _rootNode = _transforms->addNode();
+
+    GLuint tiltNode = _transforms->addNode(_rootNode);
+    _transforms->setRotation(tiltNode, glm::radians(14.0f), CSCI441::Y_AXIS);
+    _bodyNode = _transforms->addNode(tiltNode);
+    _transforms->setTranslation(_bodyNode, glm::vec3(0.0f,0.7f,0.0f));
+    _transforms->setScale(_bodyNode, glm::vec3(0.5f,0.5f,0.5f));
+
+    _flickerNode = _transforms->addNode(_bodyNode);
+    _transforms->setTranslation(_flickerNode, glm::vec3(0.0f,0.6f,0.0f));
+
+    // the axles of all four wheels are placed relative to the front left one
+    GLuint axleNode = _transforms->addNode(_bodyNode);
+    _transforms->setTranslation(axleNode, glm::vec3(0.15f,-1.2f,0.85f));
+    _transforms->setRotation(axleNode, glm::radians(75.0f), CSCI441::Y_AXIS);
+    const glm::vec3 WHEEL_OFFSETS[4] = {
+            glm::vec3(0.0f,0.0f,0.0f),
+            glm::vec3(0.0f,0.0f,-0.8f),
+            glm::vec3(1.0f,0.0f,0.15f),
+            glm::vec3(1.0f,0.0f,-0.85f)
+    };
+    for(GLuint i = 0; i < 4; i++) {
+        _wheelNodes[i] = _transforms->addNode(axleNode);
+        _transforms->setTranslation(_wheelNodes[i], WHEEL_OFFSETS[i]);
+    }
 
-    CSCI441::drawSolidSphere(0.5,glm::degrees(2*M_PI),glm::degrees(2*M_PI));
+    _updateRootNode();
+    _updateWheelNodes();
 }
-// functionality derived from isLeftWing function from lab05 plane class.
-void Bobomb::_drawBobombEye(bool isLeftEye, glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const {
-    if( isLeftEye ) {
-        modelMtx = glm::translate(modelMtx, glm::vec3(0.0f, 0.0f, 0.5f));
-
-    } else modelMtx = glm::translate(modelMtx, glm::vec3(-0.3f, 0.0f, 0.4f));
-
-    modelMtx = glm::scale( modelMtx, _scaleEye );
-
-    _computeAndSendMatrixUniforms(modelMtx, viewMtx, projMtx);
-
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorEye[0]);
-
-    CSCI441::drawSolidSphere(0.5,glm::degrees(2*M_PI),glm::degrees(2*M_PI));
+void Bobomb::_updateRootNode() {
+    _transforms->setTranslation(_rootNode, _bobombPosition);
+    _transforms->setRotation(_rootNode, _bobombDirection, CSCI441::Y_AXIS);
 }
-void Bobomb::_drawBobombFuse(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const {
-    modelMtx = glm::translate( modelMtx, _transFuse);
-
-    _computeAndSendMatrixUniforms(modelMtx, viewMtx, projMtx);
-
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorFuse[0]);
-
-    CSCI441::drawSolidCube( 0.15 );
+void Bobomb::_updateWheelNodes() {
+    for(GLuint wheelNode : _wheelNodes) {
+        _transforms->setRotation(wheelNode, _wheelAngle, CSCI441::Z_AXIS);
+    }
 }
-void Bobomb::_drawBobombFlicker(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const {
-    modelMtx = glm::translate( modelMtx, glm::vec3(0.0f,0.6f,0.0f));
-    _computeAndSendMatrixUniforms(modelMtx, viewMtx, projMtx);
-    // here is where we utilize the _isFlicker bool to choose a color for the flicker.
-    if(!_isFlicker) glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorFlicker[0]);
-    else glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorFlickerEx[0]);
-
-    CSCI441::drawSolidCube( 0.05 );
+// remaining draw functions queue the animated parts at their cached matrices.
+void Bobomb::_drawBobombFlicker( DrawList& drawList, const TransformHierarchy& transforms, bool isFlicker ) const {
+    // here is where we utilize the isFlicker bool to choose a color for the flicker.
+    drawList.submit(_flickerMesh, transforms.getWorldMatrix(_flickerNode), !isFlicker ? _colorFlicker : _colorFlickerEx);
 }
-void Bobomb::_drawBobombBoot(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const {
-
-    glm::mat4 modelMtx1 = glm::translate( modelMtx, _transBootA );
-    _computeAndSendMatrixUniforms(modelMtx1, viewMtx, projMtx);
-
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorBoot[0]);
-
-    CSCI441::drawSolidCylinder(0.5f,0.5f,1.1f,glm::degrees(2*M_PI),glm::degrees(2*M_PI));
-
-    glm::mat4 modelMtx2 = glm::translate( modelMtx, _transBootB );
-    _computeAndSendMatrixUniforms(modelMtx2, viewMtx, projMtx);
-
-    CSCI441::drawSolidSphere(0.45,glm::degrees(2*M_PI),glm::degrees(2*M_PI));
-
-    glm::mat4 modelMtx3 = glm::translate( modelMtx, _transBootC );
-    _computeAndSendMatrixUniforms(modelMtx3, viewMtx, projMtx);
-
-    CSCI441::drawSolidCylinder(0.4f,0.4f,0.3f,glm::degrees(2*M_PI),glm::degrees(2*M_PI));
-
+void Bobomb::_drawBobombWheels( DrawList& drawList, const TransformHierarchy& transforms ) const {
+    for(GLuint i = 0; i < 4; i++) {
+        drawList.submitLod(_wheelLod, _lodLevels[LOD_WHEEL_0 + i], transforms.getWorldMatrix(_wheelNodes[i]), _colorWheel);
+    }
 }
 
-void Bobomb::_drawBobombWheels(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const {
-    glm::mat4 modelMtx1 = glm::translate( modelMtx, glm::vec3(0.15f,-1.2f,0.85f));
-    modelMtx1 = glm::rotate( modelMtx1, glm::radians(75.0f),CSCI441::Y_AXIS );
-    glm::mat4 modelMtx1a = glm::rotate(modelMtx1,_wheelAngle,CSCI441::Z_AXIS);
-
-    _computeAndSendMatrixUniforms(modelMtx1a, viewMtx, projMtx);
-
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorWheel[0]);
-
-    CSCI441::drawSolidTorus(0.1f,0.2f,5,5);
-
-    glm::mat4 modelMtx2 = glm::translate( modelMtx1, glm::vec3(0.0f,0.0f,-0.8f));
-    glm::mat4 modelMtx2a = glm::rotate(modelMtx2,_wheelAngle,CSCI441::Z_AXIS);
-
-    _computeAndSendMatrixUniforms(modelMtx2a, viewMtx, projMtx);
-
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorWheel[0]);
-
-    CSCI441::drawSolidTorus(0.1f,0.2f,5,5);
-
-    glm::mat4 modelMtx3 = glm::translate( modelMtx1, glm::vec3(1.0f,0.0f,0.15f));
-    glm::mat4 modelMtx3a = glm::rotate(modelMtx3,_wheelAngle,CSCI441::Z_AXIS);
-
-    _computeAndSendMatrixUniforms(modelMtx3a, viewMtx, projMtx);
-
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorWheel[0]);
-
-    CSCI441::drawSolidTorus(0.1f,0.2f,5,5);
-
-    glm::mat4 modelMtx4 = glm::translate( modelMtx2, glm::vec3(1.0f,0.0f,-0.05f));
-    glm::mat4 modelMtx4a = glm::rotate(modelMtx4,_wheelAngle,CSCI441::Z_AXIS);
-
-    _computeAndSendMatrixUniforms(modelMtx4a, viewMtx, projMtx);
-
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorWheel[0]);
-
-    CSCI441::drawSolidTorus(0.1f,0.2f,5,5);
-
-
+// getters, setters
+glm::vec3 Bobomb::getPosition() {
+    return _bobombPosition;
 }
 
-void Bobomb::_computeAndSendMatrixUniforms(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const {
-    // precompute the Model-View-Projection matrix on the CPU
-    glm::mat4 mvpMtx = projMtx * viewMtx * modelMtx;
-    // then send it to the shader on the GPU to apply to every vertex
-    glProgramUniformMatrix4fv( _shaderProgramHandle, _shaderProgramUniformLocations.mvpMtx, 1, GL_FALSE, &mvpMtx[0][0] );
-    glProgramUniformMatrix4fv( _shaderProgramHandle, _shaderProgramUniformLocations.modelMtx, 1, GL_FALSE, &modelMtx[0][0] );
+glm::vec3 Bobomb::getFusePosition(const TransformHierarchy& transforms) const {
+    return glm::vec3( transforms.getWorldMatrix(_flickerNode)[3] );
+}
 
-    glm::mat3 normalMtx = glm::mat3( glm::transpose( glm::inverse( modelMtx )));
-    glProgramUniformMatrix3fv( _shaderProgramHandle, _shaderProgramUniformLocations.normalMtx, 1, GL_FALSE, &normalMtx[0][0] );
+bool Bobomb::isFlicker() const {
+    return _isFlicker;
 }
 
-// getters, setters
-glm::vec3 Bobomb::getPosition() {
-    return _bobombPosition;
+GLfloat Bobomb::getSecondsToFlicker() const {
+    return FLICKER_SECONDS - _flickerTime;
 }
 
 void Bobomb::setPosition(glm::vec3 nPosit) {
     _bobombPosition = nPosit;
+    _updateRootNode();
 }
 
 GLfloat Bobomb::getDirection() {
@@ -258,5 +242,6 @@ GLfloat Bobomb::getDirection() {
 
 void Bobomb::setDirection(GLfloat nDirec) {
     _bobombDirection = nDirec;
+    _updateRootNode();
 }
 
@@ -10,39 +10,59 @@
 
 #include <glm/glm.hpp>
 
+#include "mesh.hpp"
+#include "renderQueue.hpp"
+#include "transformHierarchy.hpp"
+
 class Bobomb {
 public:
     /// \desc creates a simple bobomb in a boot
-    /// \param shaderProgramHandle shader program handle that the bobomb should be drawn using
-    /// \param mvpMtxUniformLocation uniform location for the full precomputed MVP matrix
-    /// \param normalMtxUniformLocation uniform location for the precomputed Normal matrix
-    /// \param materialColorUniformLocation uniform location for the material diffuse color
-    Bobomb( GLuint shaderProgramHandle, GLint mvpMtxUniformLocation, GLint normalMtxUniformLocation, GLint materialColorUniformLocation,GLint modelMtxUniformLocation );
-
-    /// \desc draws the model bobomb for a given MVP matrix
-    /// \param modelMtx existing model matrix to apply to bobomb
-    /// \param viewMtx camera view matrix to apply to bobomb
-    /// \param projMtx camera projection matrix to apply to bobomb
-    /// \note internally uses the provided shader program and sets the necessary uniforms
-    /// for the MVP and Normal Matrices as well as the material diffuse color
-    void drawBobomb( glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx );
+    /// \param meshLibrary source of the primitive meshes the bobomb is built from
+    /// \param transforms hierarchy the bobomb's parts are registered in
+    Bobomb( MeshLibrary* meshLibrary, TransformHierarchy* transforms );
+
+    /// \desc queues the parts of the model bobomb at their cached world matrices
+    /// \param drawList list the draw of every part is recorded into
+    /// \param transforms hierarchy of the same shape as the one passed to the constructor, e.g. a copy rendering places
+    /// \param isFlicker flicker color to draw the fuse with, as isFlicker() returned when the transforms were taken
+    /// \note the transform hierarchy must have been updated since the bobomb last moved
+    void drawBobomb( DrawList& drawList, const TransformHierarchy& transforms, bool isFlicker );
 
     /// \desc simulates the bobomb driving by rotating the wheels and increasing its position relative to its direction
-    void driveForward(GLfloat worldSize);
+    /// \param deltaTime seconds to drive for
+    void driveForward(GLfloat worldSize, GLfloat deltaTime);
     /// \desc simulates the bobomb driving by rotating the wheels and decreasing its position relative to its direction
-    void driveBackward(GLfloat worldSize);
+    /// \param deltaTime seconds to drive for
+    void driveBackward(GLfloat worldSize, GLfloat deltaTime);
     /// \desc rotates bobomb's direction based on key input
-    void rotateBobomb(GLuint key);
+    /// \param deltaTime seconds to turn for
+    void rotateBobomb(GLuint key, GLfloat deltaTime);
 
     // position getters, setters
     glm::vec3 getPosition();
     void setPosition(glm::vec3 nPosit);
+    /// \desc world space position of the lit fuse on top of the bobomb
+    /// \param transforms hierarchy of the same shape as the one passed to the constructor
+    /// \note the transform hierarchy must have been updated since the bobomb last moved
+    glm::vec3 getFusePosition(const TransformHierarchy& transforms) const;
+    /// \desc which of its two colors the fuse currently flickers
+    bool isFlicker() const;
+    /// \desc seconds until the fuse next changes color
+    GLfloat getSecondsToFlicker() const;
 
     // direction setter, getter -- setter goes unused
     GLfloat getDirection();
     void setDirection(GLfloat nDirec);
 
-    void _updateFlicker();
+    /// \desc swaps the flicker color every half second
+    /// \param deltaTime seconds since the last call, may span several swaps
+    void _updateFlicker(GLfloat deltaTime);
+
+    /// \desc seconds the fuse shows each of its colors
+    static constexpr GLfloat FLICKER_SECONDS = 0.5f;
+    /// \desc slices and stacks of the finest level of the round parts.  they used to be drawn with
+    /// one per degree, far finer than a pixel even with the bobomb filling the window
+    static constexpr GLint FINEST_SEGMENTS = 128;
 
 
 private:
@@ -51,28 +71,16 @@ private:
     glm::vec3 _bobombPosition;
     /// \desc angle indicating direction bobomb is facing in space (encoded as float representing theta)
     GLfloat _bobombDirection;
+    /// \desc radians per second
     GLfloat _bobombDirectionRotationSpeed;
+    /// \desc units per second
+    GLfloat _bobombSpeed;
 
     /// \desc current angle of rotation for the wheels (float as theta)
     GLfloat _wheelAngle;
-    /// \desc one rotation step
+    /// \desc radians per second the wheels spin while driving
     GLfloat _wheelAngleRotationSpeed;
 
-    /// \desc handle of the shader program to use when drawing the bobomb
-    GLuint _shaderProgramHandle;
-    /// \desc stores the uniform locations needed for the plan information
-    struct ShaderProgramUniformLocations {
-        /// \desc location of the precomputed ModelViewProjection matrix
-        GLint mvpMtx;
-        /// \desc location of the precomputed Normal matrix
-        GLint normalMtx;
-        /// \desc location of the material diffuse color
-        GLint materialColor;
-        /// \desc location of the model matrix
-        GLint modelMtx;
-    } _shaderProgramUniformLocations;
-
-
     /// \desc color the bobomb's body
     glm::vec3 _colorBody;
     /// \desc amount to scale the bobomb's body by
@@ -105,45 +113,51 @@ private:
     glm::vec3 _colorFlicker;
     glm::vec3 _colorFlickerEx;
     bool _isFlicker;
-    int _flickerCheck;
-
-
-    /// \desc draws just the bobomb's body
-    /// \param modelMtx existing model matrix to apply to bobomb
-    /// \param viewMtx camera view matrix to apply to bobomb
-    /// \param projMtx camera projection matrix to apply to bobomb
-    void _drawBobombBody(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const;
-    /// \desc draws a single eye
-    /// \param isLeftWing true if left eye, false if right eye (controls if translation applied)
-    /// \param modelMtx existing model matrix to apply to bobomb
-    /// \param viewMtx camera view matrix to apply to bobomb
-    /// \param projMtx camera projection matrix to apply to bobomb
-    void _drawBobombEye(bool isLeftEye, glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const;
-    /// \desc draws the fuse (and animated flicker) of the bobomb
-    /// \param modelMtx existing model matrix to apply to bobomb
-    /// \param viewMtx camera view matrix to apply to bobomb
-    /// \param projMtx camera projection matrix to apply to bobomb
-    void _drawBobombFuse(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const;
-    void _drawBobombFlicker(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const;
-    /// \desc draws the boot car of the bobomb
-    /// \param modelMtx existing model matrix to apply to bobomb
-    /// \param viewMtx camera view matrix to apply to bobomb
-    /// \param projMtx camera projection matrix to apply to bobomb
-    void _drawBobombBoot(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const;
+    /// \desc seconds since the flicker color last swapped
+    GLfloat _flickerTime;
+
+    /// \desc body, eyes, fuse and boot baked into one mesh, shared through the mesh library
+    LodMesh _rigidPartsLod;
+    /// \desc animated parts, drawn separately
+    const Mesh* _flickerMesh;
+    LodMesh _wheelLod;
+
+    /// \desc every part drawn from a lod chain, each remembers its own level
+    enum LodPart {
+        LOD_RIGID_PARTS,
+        LOD_WHEEL_0, LOD_WHEEL_1, LOD_WHEEL_2, LOD_WHEEL_3,
+        NUM_LOD_PARTS
+    };
+    /// \desc level each part was last drawn with
+    mutable GLuint _lodLevels[NUM_LOD_PARTS];
+
+    /// \desc hierarchy holding the bobomb's part transforms
+    TransformHierarchy* _transforms;
+    /// \desc places the bobomb in the world from its position and direction
+    GLuint _rootNode;
+    /// \desc origin of the baked rigid parts, everything else hangs off it
+    GLuint _bodyNode;
+    GLuint _flickerNode;
+    /// \desc each wheel spins about its own axle
+    GLuint _wheelNodes[4];
+
+    /// \desc registers every part in the transform hierarchy
+    void _addTransformNodes();
+    /// \desc pushes the current position and direction to the root node
+    void _updateRootNode();
+    /// \desc pushes the current wheel angle to the wheel nodes
+    void _updateWheelNodes();
+
+
+    /// \desc flattens the parts that never move relative to each other into one mesh
+    /// \param meshLibrary library the part meshes come from and the baked meshes are stored in
+    LodMesh _bakeRigidParts(MeshLibrary& meshLibrary) const;
+    /// \desc draws the animated flicker on top of the fuse
+    /// \param drawList list the draws are recorded into
+    void _drawBobombFlicker( DrawList& drawList, const TransformHierarchy& transforms, bool isFlicker ) const;
     /// \desc draws the wheels of the boot of the bobomb
-    /// \param modelMtx existing model matrix to apply to bobomb
-    /// \param viewMtx camera view matrix to apply to bobomb
-    /// \param projMtx camera projection matrix to apply to bobomb
-    void _drawBobombWheels(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const;
-
-
-    /// \desc precomputes the matrix uniforms CPU-side and then sends them
-    /// to the GPU to be used in the shader for each vertex.  It is more efficient
-    /// to calculate these once and then use the resultant product in the shader.
-    /// \param modelMtx model transformation matrix
-    /// \param viewMtx camera view matrix
-    /// \param projMtx camera projection matrix
-    void _computeAndSendMatrixUniforms(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const;
+    /// \param drawList list the draws are recorded into
+    void _drawBobombWheels( DrawList& drawList, const TransformHierarchy& transforms ) const;
 };
 
 
@@ -0,0 +1,208 @@
+#include "culling.hpp"
+
+#include <algorithm>
+
+//*************************************************************************************
+//
+// Bounding Boxes
+
+void BoundingBox::expand(const BoundingBox& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+BoundingBox transformBoundingBox(const BoundingBox& box, const glm::mat4& modelMtx) {
+    // transform all eight corners and take the extents of the result
+    BoundingBox result;
+    for(GLint corner = 0; corner < 8; corner++) {
+        glm::vec4 point( (corner & 1) ? box.max.x : box.min.x,
+                         (corner & 2) ? box.max.y : box.min.y,
+                         (corner & 4) ? box.max.z : box.min.z,
+                         1.0f );
+        glm::vec3 worldPoint = glm::vec3( modelMtx * point );
+        if(corner == 0) {
+            result.min = result.max = worldPoint;
+        } else {
+            result.min = glm::min(result.min, worldPoint);
+            result.max = glm::max(result.max, worldPoint);
+        }
+    }
+    return result;
+}
+
+//*************************************************************************************
+//
+// Frustum
+
+Frustum::Frustum(const glm::mat4& viewProjectionMtx) {
+    // glm is column major, so pull out each row of the matrix first
+    glm::vec4 rows[4];
+    for(GLint row = 0; row < 4; row++) {
+        rows[row] = glm::vec4(viewProjectionMtx[0][row], viewProjectionMtx[1][row], viewProjectionMtx[2][row], viewProjectionMtx[3][row]);
+    }
+    _planes[0] = rows[3] + rows[0];     // left
+    _planes[1] = rows[3] - rows[0];     // right
+    _planes[2] = rows[3] + rows[1];     // bottom
+    _planes[3] = rows[3] - rows[1];     // top
+    _planes[4] = rows[3] + rows[2];     // near
+    _planes[5] = rows[3] - rows[2];     // far
+}
+
+bool Frustum::intersects(const BoundingBox& box) const {
+    for(const glm::vec4& plane : _planes) {
+        // test the corner furthest along the plane normal, if even that is outside the box is too
+        glm::vec3 positiveCorner( plane.x >= 0.0f ? box.max.x : box.min.x,
+                                  plane.y >= 0.0f ? box.max.y : box.min.y,
+                                  plane.z >= 0.0f ? box.max.z : box.min.z );
+        if(glm::dot(glm::vec3(plane), positiveCorner) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const glm::vec4& Frustum::getPlane(GLuint index) const {
+    return _planes[index];
+}
+
+void CullingStats::reset() {
+    visibleCells = culledCells = visibleObjects = culledObjects = occludedObjects = impostors = 0;
+}
+
+//*************************************************************************************
+//
+// Spatial Grid
+
+SpatialGrid::SpatialGrid(GLfloat worldMin, GLfloat worldMax, GLint cellsPerSide) {
+    _worldMin = worldMin;
+    _cellsPerSide = cellsPerSide;
+    _cellSize = (worldMax - worldMin) / (GLfloat)cellsPerSide;
+    _cells.resize(cellsPerSide * cellsPerSide);
+}
+
+void SpatialGrid::insert(GLuint objectIndex, const BoundingBox& bounds) {
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    GLint cellX = std::clamp( (GLint)((center.x - _worldMin) / _cellSize), 0, _cellsPerSide - 1 );
+    GLint cellZ = std::clamp( (GLint)((center.z - _worldMin) / _cellSize), 0, _cellsPerSide - 1 );
+
+    Cell& cell = _cells[cellZ * _cellsPerSide + cellX];
+    if(cell.objects.empty()) {
+        cell.bounds = bounds;
+    } else {
+        cell.bounds.expand(bounds);
+    }
+    cell.objects.push_back(objectIndex);
+}
+
+void SpatialGrid::query(const Frustum& frustum, std::vector<GLuint>& visibleObjects, CullingStats& stats) const {
+    query(&frustum, 1, visibleObjects, stats);
+}
+
+void SpatialGrid::query(const Frustum* frustums, GLuint numFrustums, std::vector<GLuint>& visibleObjects, CullingStats& stats) const {
+    queryCells(0, _cells.size(), frustums, numFrustums, visibleObjects, stats);
+}
+
+void SpatialGrid::queryCells(GLuint firstCell, GLuint endCell, const Frustum* frustums, GLuint numFrustums,
+                             std::vector<GLuint>& visibleObjects, CullingStats& stats) const {
+    for(GLuint cellIndex = firstCell; cellIndex < endCell; cellIndex++) {
+        const Cell& cell = _cells[cellIndex];
+        if(cell.objects.empty()) continue;
+
+        bool isVisible = false;
+        for(GLuint i = 0; i < numFrustums && !isVisible; i++) {
+            isVisible = frustums[i].intersects(cell.bounds);
+        }
+
+        if(isVisible) {
+            stats.visibleCells++;
+            stats.visibleObjects += cell.objects.size();
+            visibleObjects.insert(visibleObjects.end(), cell.objects.begin(), cell.objects.end());
+        } else {
+            stats.culledCells++;
+            stats.culledObjects += cell.objects.size();
+        }
+    }
+}
+
+GLuint SpatialGrid::getNumCells() const {
+    return _cells.size();
+}
+
+//*************************************************************************************
+//
+// Parallel Culler
+
+ParallelCuller::ParallelCuller(JobSystem* jobSystem) :
+    _jobSystem( jobSystem ) {
+
+}
+
+void ParallelCuller::query(const SpatialGrid& grid, const Frustum* frustums, GLuint numFrustums,
+                           std::vector<GLuint>& visibleObjects, CullingStats& stats) {
+    const GLuint NUM_CELLS = grid.getNumCells();
+    const GLuint NUM_CHUNKS = (NUM_CELLS + CELLS_PER_CHUNK - 1) / CELLS_PER_CHUNK;
+    _reserveChunks(NUM_CHUNKS);
+
+    _jobSystem->parallelFor( NUM_CHUNKS, 1, [&](GLuint begin, GLuint end) {
+        for(GLuint chunk = begin; chunk < end; chunk++) {
+            _chunkObjects[chunk].clear();
+            _chunkStats[chunk].reset();
+            grid.queryCells( chunk * CELLS_PER_CHUNK, std::min(NUM_CELLS, (chunk + 1) * CELLS_PER_CHUNK),
+                             frustums, numFrustums, _chunkObjects[chunk], _chunkStats[chunk] );
+        }
+    } );
+
+    _join(_chunkObjects, NUM_CHUNKS, visibleObjects);
+    for(GLuint chunk = 0; chunk < NUM_CHUNKS; chunk++) {
+        stats.visibleCells += _chunkStats[chunk].visibleCells;
+        stats.culledCells += _chunkStats[chunk].culledCells;
+        stats.visibleObjects += _chunkStats[chunk].visibleObjects;
+        stats.culledObjects += _chunkStats[chunk].culledObjects;
+    }
+}
+
+GLuint ParallelCuller::separateFar(std::vector<GLuint>& objects, const std::vector<BoundingBox>& bounds,
+                                   const glm::vec3& position, GLfloat distance, std::vector<GLuint>& farObjects) {
+    const GLuint NUM_OBJECTS = objects.size();
+    const GLuint NUM_CHUNKS = (NUM_OBJECTS + OBJECTS_PER_CHUNK - 1) / OBJECTS_PER_CHUNK;
+    _reserveChunks(NUM_CHUNKS);
+
+    const GLfloat DISTANCE_SQUARED = distance * distance;
+    _jobSystem->parallelFor( NUM_CHUNKS, 1, [&](GLuint begin, GLuint end) {
+        for(GLuint chunk = begin; chunk < end; chunk++) {
+            std::vector<GLuint>& nearList = _chunkObjects[chunk];
+            std::vector<GLuint>& farList = _chunkFarObjects[chunk];
+            nearList.clear();
+            farList.clear();
+            const GLuint END_OBJECT = std::min(NUM_OBJECTS, (chunk + 1) * OBJECTS_PER_CHUNK);
+            for(GLuint i = chunk * OBJECTS_PER_CHUNK; i < END_OBJECT; i++) {
+                const GLuint OBJECT_INDEX = objects[i];
+                glm::vec3 toObject = (bounds[OBJECT_INDEX].min + bounds[OBJECT_INDEX].max) * 0.5f - position;
+                if(glm::dot(toObject, toObject) > DISTANCE_SQUARED) {
+                    farList.push_back(OBJECT_INDEX);
+                } else {
+                    nearList.push_back(OBJECT_INDEX);
+                }
+            }
+        }
+    } );
+
+    const GLuint NUM_FAR_BEFORE = farObjects.size();
+    _join(_chunkFarObjects, NUM_CHUNKS, farObjects);
+    objects.clear();
+    _join(_chunkObjects, NUM_CHUNKS, objects);
+    return farObjects.size() - NUM_FAR_BEFORE;
+}
+
+void ParallelCuller::_reserveChunks(GLuint numChunks) {
+    if(_chunkObjects.size() >= numChunks) return;
+    _chunkObjects.resize(numChunks);
+    _chunkFarObjects.resize(numChunks);
+    _chunkStats.resize(numChunks);
+}
+
+void ParallelCuller::_join(const std::vector< std::vector<GLuint> >& chunkLists, GLuint numChunks, std::vector<GLuint>& list) {
+    for(GLuint chunk = 0; chunk < numChunks; chunk++) {
+        list.insert( list.end(), chunkLists[chunk].begin(), chunkLists[chunk].end() );
+    }
+}
@@ -0,0 +1,164 @@
+#ifndef MP_CULLING_HPP
+#define MP_CULLING_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "jobSystem.hpp"
+
+#include <vector>
+
+/// \desc axis aligned bounding box in world space
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    /// \desc grows the box to also contain other
+    void expand(const BoundingBox& other);
+};
+
+/// \desc computes the world space bounds of a box after applying a transformation
+/// \param box object space bounds
+/// \param modelMtx transformation to apply
+BoundingBox transformBoundingBox(const BoundingBox& box, const glm::mat4& modelMtx);
+
+/// \desc the six clipping planes of a camera, used to reject geometry that cannot be seen
+class Frustum {
+public:
+    /// \desc extracts the planes from a combined matrix
+    /// \param viewProjectionMtx camera projection matrix times camera view matrix
+    explicit Frustum(const glm::mat4& viewProjectionMtx);
+
+    /// \desc returns true if any part of the box may be inside the frustum
+    bool intersects(const BoundingBox& box) const;
+
+    /// \desc plane equation (normal, distance) pointing into the frustum
+    /// \param index left, right, bottom, top, near, far
+    const glm::vec4& getPlane(GLuint index) const;
+
+private:
+    /// \desc plane equations (normal, distance) pointing into the frustum
+    glm::vec4 _planes[6];
+};
+
+/// \desc counters describing how much work a culling query saved
+struct CullingStats {
+    GLuint visibleCells = 0;
+    GLuint culledCells = 0;
+    GLuint visibleObjects = 0;
+    GLuint culledObjects = 0;
+    /// \desc objects inside the view but hidden behind nearer buildings, not counted as visible
+    GLuint occludedObjects = 0;
+    /// \desc objects far enough to be drawn as impostors, not counted as visible
+    GLuint impostors = 0;
+
+    void reset();
+};
+
+/// \desc uniform grid over the ground plane bucketing static objects by where they stand
+class SpatialGrid {
+public:
+    /// \desc creates an empty square grid
+    /// \param worldMin lowest x/z coordinate covered by the grid
+    /// \param worldMax highest x/z coordinate covered by the grid
+    /// \param cellsPerSide number of cells along each of the x and z axes
+    SpatialGrid(GLfloat worldMin, GLfloat worldMax, GLint cellsPerSide);
+
+    /// \desc adds an object to the cell containing the center of its bounds
+    /// \param objectIndex index of the object in the caller's own list
+    /// \param bounds world space bounds of the object
+    void insert(GLuint objectIndex, const BoundingBox& bounds);
+
+    /// \desc collects the objects in every cell that intersects the frustum
+    /// \param frustum view to test against
+    /// \param visibleObjects receives the indices of the potentially visible objects
+    /// \param stats counters to accumulate into
+    void query(const Frustum& frustum, std::vector<GLuint>& visibleObjects, CullingStats& stats) const;
+    /// \desc collects the objects in every cell that intersects any of the frustums.  each
+    /// object is listed once no matter how many of the frustums see it
+    /// \param frustums views to test against
+    /// \param numFrustums number of entries in frustums
+    /// \param visibleObjects receives the indices of the potentially visible objects
+    /// \param stats counters to accumulate into
+    void query(const Frustum* frustums, GLuint numFrustums, std::vector<GLuint>& visibleObjects, CullingStats& stats) const;
+    /// \desc query() over a range of the cells only, so the cells can be split between jobs
+    /// \param firstCell first cell to test, cells are numbered row by row along x
+    /// \param endCell one past the last cell to test
+    void queryCells(GLuint firstCell, GLuint endCell, const Frustum* frustums, GLuint numFrustums,
+                    std::vector<GLuint>& visibleObjects, CullingStats& stats) const;
+    GLuint getNumCells() const;
+
+private:
+    struct Cell {
+        /// \desc tight bounds around every object in the cell
+        BoundingBox bounds;
+        std::vector<GLuint> objects;
+    };
+
+    GLfloat _worldMin;
+    GLfloat _cellSize;
+    GLint _cellsPerSide;
+    std::vector<Cell> _cells;
+};
+
+/// \desc runs the steps of culling a view that touch every object on a job system.  the input is
+/// split into chunks of a fixed size, each job fills lists of its own for the chunks it takes, and
+/// the lists are joined in chunk order, so the results come out in the same order as on one thread
+/// whatever the number of threads
+class ParallelCuller {
+public:
+    /// \param jobSystem pool to cull on
+    explicit ParallelCuller(JobSystem* jobSystem);
+
+    /// \desc SpatialGrid::query() with the cells spread over the jobs
+    /// \param grid objects to cull
+    /// \param frustums views to test against
+    /// \param numFrustums number of entries in frustums
+    /// \param visibleObjects receives the indices of the potentially visible objects
+    /// \param stats counters to accumulate into
+    void query(const SpatialGrid& grid, const Frustum* frustums, GLuint numFrustums,
+               std::vector<GLuint>& visibleObjects, CullingStats& stats);
+    /// \desc moves the objects whose center is farther than a distance from a position to another list
+    /// \param objects indices of the objects, left holding the near ones
+    /// \param bounds world space bounds of every object
+    /// \param position point the distance is measured from
+    /// \param distance objects farther than this are moved
+    /// \param farObjects receives the indices of the far objects
+    /// \return number of objects moved
+    GLuint separateFar(std::vector<GLuint>& objects, const std::vector<BoundingBox>& bounds,
+                       const glm::vec3& position, GLfloat distance, std::vector<GLuint>& farObjects);
+    /// \desc appends the items listed by indices to gathered, in the order of indices
+    template<typename T> void gather(const std::vector<GLuint>& indices, const std::vector<T>& items, std::vector<T>& gathered);
+
+private:
+    /// \desc grid cells tested per chunk
+    static constexpr GLuint CELLS_PER_CHUNK = 16;
+    /// \desc objects sorted or copied per chunk
+    static constexpr GLuint OBJECTS_PER_CHUNK = 256;
+
+    JobSystem* _jobSystem;
+    /// \desc what each chunk produced, reused every call to avoid reallocating
+    std::vector< std::vector<GLuint> > _chunkObjects;
+    std::vector< std::vector<GLuint> > _chunkFarObjects;
+    std::vector<CullingStats> _chunkStats;
+
+    /// \desc makes sure there are lists for numChunks chunks
+    void _reserveChunks(GLuint numChunks);
+    /// \desc appends the lists of the first numChunks chunks to list, in chunk order
+    static void _join(const std::vector< std::vector<GLuint> >& chunkLists, GLuint numChunks, std::vector<GLuint>& list);
+};
+
+template<typename T>
+void ParallelCuller::gather(const std::vector<GLuint>& indices, const std::vector<T>& items, std::vector<T>& gathered) {
+    // every item has its place before the copy starts, so the jobs need no lists of their own
+    const size_t FIRST = gathered.size();
+    gathered.resize( FIRST + indices.size() );
+    _jobSystem->parallelFor( indices.size(), OBJECTS_PER_CHUNK, [&](GLuint begin, GLuint end) {
+        for(GLuint i = begin; i < end; i++) {
+            gathered[FIRST + i] = items[ indices[i] ];
+        }
+    } );
+}
+
+#endif //MP_CULLING_HPP
@@ -0,0 +1,49 @@
+#include "fixedTimestep.hpp"
+
+#include <cmath>
+
+FixedTimestep::FixedTimestep(GLuint ticksPerSecond, GLuint maxTicksPerFrame) :
+    _ticksPerSecond( ticksPerSecond ),
+    _maxTicksPerFrame( maxTicksPerFrame ),
+    _stepSeconds( 1.0 / ticksPerSecond ),
+    _accumulator( 0.0 ),
+    _numDroppedTicks( 0 ) {
+
+}
+
+GLuint FixedTimestep::advance(GLdouble elapsedSeconds) {
+    // the clock never runs backwards, but a bad reading should not rewind the simulation
+    if(elapsedSeconds > 0.0) _accumulator += elapsedSeconds;
+
+    GLuint64 numDue = static_cast<GLuint64>( std::floor(_accumulator / _stepSeconds) );
+    GLuint numTicks = numDue > _maxTicksPerFrame ? _maxTicksPerFrame : static_cast<GLuint>(numDue);
+    if(numDue > numTicks) {
+        // keep the fraction of a tick so alpha stays continuous, the whole ticks are gone
+        _numDroppedTicks += numDue - numTicks;
+        _accumulator = std::fmod(_accumulator, _stepSeconds);
+    } else {
+        _accumulator -= numTicks * _stepSeconds;
+    }
+    return numTicks;
+}
+
+void FixedTimestep::reset() {
+    _accumulator = 0.0;
+}
+
+GLfloat FixedTimestep::getAlpha() const {
+    GLdouble alpha = _accumulator / _stepSeconds;
+    return static_cast<GLfloat>( alpha < 1.0 ? alpha : 1.0 );
+}
+
+GLdouble FixedTimestep::getStepSeconds() const {
+    return _stepSeconds;
+}
+
+GLuint FixedTimestep::getTicksPerSecond() const {
+    return _ticksPerSecond;
+}
+
+GLuint64 FixedTimestep::getNumDroppedTicks() const {
+    return _numDroppedTicks;
+}
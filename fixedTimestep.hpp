@@ -0,0 +1,42 @@
+#ifndef MP_FIXED_TIMESTEP_HPP
+#define MP_FIXED_TIMESTEP_HPP
+
+#include <GL/glew.h>
+
+/// \desc turns the time that passes between frames into a whole number of simulation ticks of a
+/// fixed length.  whatever is left over carries into the next frame, and as a fraction of a tick
+/// tells rendering how far it is from the last tick to the next, so the simulation runs at the
+/// same rate whatever the display refreshes at
+class FixedTimestep {
+public:
+    /// \param ticksPerSecond rate the simulation runs at
+    /// \param maxTicksPerFrame most ticks a single frame may run, time past that is dropped so
+    /// a long stall, e.g. a dragged window, does not leave the simulation forever catching up
+    FixedTimestep(GLuint ticksPerSecond, GLuint maxTicksPerFrame);
+
+    /// \desc adds the time that passed since the last call
+    /// \param elapsedSeconds wall clock time since the last call
+    /// \return number of ticks to run now
+    GLuint advance(GLdouble elapsedSeconds);
+    /// \desc discards the time added but not yet simulated without counting it as dropped, for a
+    /// caller that accounted for it some other way, e.g. while nothing needed ticking
+    void reset();
+
+    /// \desc how far past the last tick the time added so far is, 0 to 1
+    GLfloat getAlpha() const;
+    /// \desc length of one tick in seconds
+    GLdouble getStepSeconds() const;
+    GLuint getTicksPerSecond() const;
+    /// \desc ticks advance() has dropped after stalls
+    GLuint64 getNumDroppedTicks() const;
+
+private:
+    GLuint _ticksPerSecond;
+    GLuint _maxTicksPerFrame;
+    GLdouble _stepSeconds;
+    /// \desc time added but not yet simulated, under one tick between calls
+    GLdouble _accumulator;
+    GLuint64 _numDroppedTicks;
+};
+
+#endif //MP_FIXED_TIMESTEP_HPP
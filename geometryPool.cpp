@@ -0,0 +1,91 @@
+#include "geometryPool.hpp"
+
+#include <cstddef>
+
+GeometryPool::GeometryPool(GLint vPosLocation, GLint vNormalLocation) {
+    _isDirty = false;
+
+    glGenVertexArrays(1, &_vao);
+    glBindVertexArray(_vao);
+
+    glGenBuffers(1, &_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+
+    glEnableVertexAttribArray(vPosLocation);
+    glVertexAttribPointer(vPosLocation, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+
+    glEnableVertexAttribArray(vNormalLocation);
+    glVertexAttribPointer(vNormalLocation, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+
+    glEnableVertexAttribArray(Mesh::VERTEX_COLOR_LOCATION);
+    glVertexAttribPointer(Mesh::VERTEX_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, color));
+
+    glGenBuffers(1, &_ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+
+    glBindVertexArray(0);
+}
+
+GeometryPool::~GeometryPool() {
+    glDeleteVertexArrays(1, &_vao);
+    glDeleteBuffers(1, &_vbo);
+    glDeleteBuffers(1, &_ibo);
+}
+
+GLuint GeometryPool::getSlot(const Mesh* mesh) {
+    auto slot = _slots.find(mesh->getId());
+    if(slot != _slots.end()) return slot->second;
+
+    const MeshData& data = mesh->getData();
+    Range range;
+    range.firstIndex = _indices.size();
+    range.numIndices = data.indices.size();
+    range.baseVertex = _vertices.size();
+    range.bounds.min = range.bounds.max = data.vertices.empty() ? glm::vec3(0.0f) : data.vertices[0].position;
+    for(const MeshVertex& vertex : data.vertices) {
+        range.bounds.min = glm::min(range.bounds.min, vertex.position);
+        range.bounds.max = glm::max(range.bounds.max, vertex.position);
+    }
+
+    // indices stay relative to the mesh, the draw's base vertex offsets them
+    _vertices.insert(_vertices.end(), data.vertices.begin(), data.vertices.end());
+    _indices.insert(_indices.end(), data.indices.begin(), data.indices.end());
+    _ranges.push_back(range);
+    _isDirty = true;
+
+    GLuint index = _ranges.size() - 1;
+    _slots[mesh->getId()] = index;
+    return index;
+}
+
+const GeometryPool::Range& GeometryPool::getRange(GLuint slot) const {
+    return _ranges[slot];
+}
+
+GLuint GeometryPool::getNumSlots() const {
+    return _ranges.size();
+}
+
+void GeometryPool::setInstanceBuffer(GLuint instanceBuffer) {
+    glBindVertexArray(_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    setInstanceAttributes();
+    glBindVertexArray(0);
+}
+
+void GeometryPool::upload(GLStateCache& stateCache) {
+    if(!_isDirty) return;
+
+    // meshes are only added while the scene warms up, so re-uploading everything is cheap enough.
+    // the index buffer binding belongs to the VAO, so ours must be bound before touching it
+    stateCache.bindVertexArray(_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    glBufferData(GL_ARRAY_BUFFER, _vertices.size() * sizeof(MeshVertex), _vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indices.size() * sizeof(GLuint), _indices.data(), GL_STATIC_DRAW);
+    _isDirty = false;
+}
+
+GLuint GeometryPool::getVAO() const {
+    return _vao;
+}
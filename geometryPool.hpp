@@ -0,0 +1,70 @@
+#ifndef MP_GEOMETRY_POOL_HPP
+#define MP_GEOMETRY_POOL_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+#include "mesh.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+/// \desc the vertices and indices of every mesh packed into one vertex buffer and one index
+/// buffer behind a single VAO, so any mix of meshes can be drawn without rebinding.  meshes
+/// are added the first time they are asked for and the buffers are re-uploaded before the
+/// next draw
+class GeometryPool {
+public:
+    /// \desc where a mesh lives inside the pooled buffers
+    struct Range {
+        /// \desc first entry of the mesh in the index buffer
+        GLuint firstIndex;
+        GLuint numIndices;
+        /// \desc added to every index of the mesh to find its vertices
+        GLint baseVertex;
+        /// \desc object space bounds of the mesh
+        BoundingBox bounds;
+    };
+
+    /// \param vPosLocation attribute location of the vertex position
+    /// \param vNormalLocation attribute location of the vertex normal
+    GeometryPool(GLint vPosLocation, GLint vNormalLocation);
+    ~GeometryPool();
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    /// \desc looks up the slot of a mesh, appending its geometry on first use
+    /// \return index of the mesh's range
+    GLuint getSlot(const Mesh* mesh);
+    const Range& getRange(GLuint slot) const;
+    GLuint getNumSlots() const;
+
+    /// \desc sources the per-instance attributes of lab05.v.glsl from a buffer of InstanceData
+    /// \param instanceBuffer buffer holding the instances, indexed through each draw's base instance
+    void setInstanceBuffer(GLuint instanceBuffer);
+
+    /// \desc uploads the geometry added since the last upload
+    /// \param stateCache cache the VAO bind is routed through
+    void upload(GLStateCache& stateCache);
+
+    GLuint getVAO() const;
+
+private:
+    GLuint _vao;
+    GLuint _vbo;
+    GLuint _ibo;
+
+    /// \desc CPU copy of the pooled geometry, uploaded whole whenever it grows
+    std::vector<MeshVertex> _vertices;
+    std::vector<GLuint> _indices;
+    std::vector<Range> _ranges;
+    /// \desc slot of each mesh, keyed by mesh id
+    std::unordered_map<GLuint, GLuint> _slots;
+    /// \desc true if geometry was added since the last upload
+    bool _isDirty;
+};
+
+#endif //MP_GEOMETRY_POOL_HPP
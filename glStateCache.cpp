@@ -0,0 +1,98 @@
+#include "glStateCache.hpp"
+
+#include <cstring>
+
+GLStateCache::GLStateCache() {
+    _currentProgram = 0;
+    _currentVAO = 0;
+    _isProgramKnown = false;
+    _isVAOKnown = false;
+}
+
+void GLStateCache::useProgram(GLuint programHandle) {
+    if(_isProgramKnown && _currentProgram == programHandle) {
+        _frameStats.elided++;
+        return;
+    }
+    glUseProgram(programHandle);
+    _currentProgram = programHandle;
+    _isProgramKnown = true;
+    _frameStats.issued++;
+}
+
+void GLStateCache::bindVertexArray(GLuint vaoHandle) {
+    if(_isVAOKnown && _currentVAO == vaoHandle) {
+        _frameStats.elided++;
+        return;
+    }
+    glBindVertexArray(vaoHandle);
+    _currentVAO = vaoHandle;
+    _isVAOKnown = true;
+    _frameStats.issued++;
+}
+
+void GLStateCache::setUniform(GLint location, GLint value) {
+    if(location < 0) return;
+    if(!_updateUniform(location, &value, sizeof(value))) {
+        _frameStats.elided++;
+        return;
+    }
+    glUniform1i(location, value);
+    _frameStats.issued++;
+}
+
+void GLStateCache::setUniform(GLint location, const glm::vec3& value) {
+    if(location < 0) return;
+    if(!_updateUniform(location, &value[0], sizeof(GLfloat) * 3)) {
+        _frameStats.elided++;
+        return;
+    }
+    glUniform3fv(location, 1, &value[0]);
+    _frameStats.issued++;
+}
+
+void GLStateCache::invalidateVertexArray() {
+    _isVAOKnown = false;
+}
+
+void GLStateCache::invalidateProgram() {
+    _isProgramKnown = false;
+}
+
+void GLStateCache::invalidate() {
+    _isProgramKnown = false;
+    _isVAOKnown = false;
+    _uniformValues.clear();
+}
+
+const GLStateCache::Stats& GLStateCache::getFrameStats() const {
+    return _frameStats;
+}
+
+void GLStateCache::resetFrameStats() {
+    _frameStats = Stats();
+}
+
+bool GLStateCache::_updateUniform(GLint location, const void* value, size_t size) {
+    // the value lands in whichever program is current, and skipping its shadow entry would leave a
+    // stale value there that a later set of the old value wrongly matches.  rare enough to ask
+    if(!_isProgramKnown) {
+        GLint currentProgram = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+        _currentProgram = currentProgram;
+        _isProgramKnown = true;
+    }
+
+    // uniform values belong to the program, so the same location in two programs is tracked separately
+    uint64_t key = ((uint64_t)_currentProgram << 32) | (uint32_t)location;
+
+    UniformValue newValue = {};
+    memcpy(newValue.bits, value, size);
+
+    auto existing = _uniformValues.find(key);
+    if(existing != _uniformValues.end() && memcmp(existing->second.bits, newValue.bits, sizeof(newValue.bits)) == 0) {
+        return false;
+    }
+    _uniformValues[key] = newValue;
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef MP_GL_STATE_CACHE_HPP
+#define MP_GL_STATE_CACHE_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+
+/// \desc shadows the OpenGL state our draws touch so calls that would not change anything
+/// never reach the driver.  every program, VAO and uniform change in the engine and the
+/// character classes goes through here.
+class GLStateCache {
+public:
+    /// \desc number of state changes forwarded to OpenGL vs. dropped as redundant
+    struct Stats {
+        GLuint issued = 0;
+        GLuint elided = 0;
+    };
+
+    GLStateCache();
+
+    /// \desc glUseProgram, skipped if the program is already current
+    void useProgram(GLuint programHandle);
+    /// \desc glBindVertexArray, skipped if the VAO is already bound
+    void bindVertexArray(GLuint vaoHandle);
+
+    /// \desc glUniform1i on the current program, skipped if the location already holds the value
+    void setUniform(GLint location, GLint value);
+    /// \desc glUniform3fv on the current program, skipped if the location already holds the value
+    void setUniform(GLint location, const glm::vec3& value);
+
+    /// \desc forget the bound VAO, call after code outside the cache binds its own
+    void invalidateVertexArray();
+    /// \desc forget the current program, call after code outside the cache changes it
+    void invalidateProgram();
+    /// \desc forget everything, including uniform values
+    void invalidate();
+
+    /// \desc counts for the current frame
+    const Stats& getFrameStats() const;
+    /// \desc starts counting a new frame
+    void resetFrameStats();
+
+private:
+    /// \desc raw bits of a uniform value, large enough for a vec4
+    struct UniformValue {
+        GLuint bits[4];
+    };
+
+    /// \desc checks the shadow copy for a uniform and records the new value.  queries the current
+    /// program if it is unknown, so the value is always recorded against the program it reaches
+    /// \return true if the value differs and must be sent
+    bool _updateUniform(GLint location, const void* value, size_t size);
+
+    /// \desc 0 represents unknown as well as nothing bound
+    GLuint _currentProgram;
+    GLuint _currentVAO;
+    bool _isProgramKnown;
+    bool _isVAOKnown;
+
+    /// \desc last value sent per (program, location) pair
+    std::unordered_map<uint64_t, UniformValue> _uniformValues;
+
+    Stats _frameStats;
+};
+
+#endif //MP_GL_STATE_CACHE_HPP
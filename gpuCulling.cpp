@@ -0,0 +1,308 @@
+#include "gpuCulling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// storage buffer binding points, must match gpuCull.c.glsl
+static constexpr GLuint OBJECT_BUFFER_BINDING = 0;
+static constexpr GLuint COMMAND_BUFFER_BINDING = 1;
+static constexpr GLuint INSTANCE_BUFFER_BINDING = 2;
+
+/// \desc threads per work group, must match the local sizes of the compute shaders
+static constexpr GLuint CULL_GROUP_SIZE = 64;
+static constexpr GLuint DEPTH_PYRAMID_GROUP_SIZE = 8;
+
+/// \desc grows a buffer to hold at least the requested number of entries
+/// \param target binding point to allocate through
+/// \param handle buffer to grow
+/// \param capacity current number of entries, updated to the new capacity
+/// \param required number of entries needed
+/// \param entrySize size of a single entry in bytes
+static void reserveBuffer(GLenum target, GLuint handle, GLuint& capacity, GLuint required, GLsizeiptr entrySize) {
+    if(required <= capacity) return;
+    // grow geometrically so a slowly growing scene does not reallocate every frame
+    capacity = std::max(required, capacity * 2);
+    glBindBuffer(target, handle);
+    glBufferData(target, capacity * entrySize, nullptr, GL_DYNAMIC_DRAW);
+}
+
+bool GpuCuller::isSupported() {
+    // base instance lets every command read its own slice of the instance buffer
+    return GLEW_VERSION_4_3 ||
+           (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_multi_draw_indirect &&
+            GLEW_ARB_base_instance && GLEW_ARB_shader_image_load_store);
+}
+
+GpuCuller::GpuCuller(GLint vPosLocation, GLint vNormalLocation) : _geometryPool(vPosLocation, vNormalLocation) {
+    _numStaticObjects = 0;
+    _areStaticObjectsDirty = false;
+    _areDynamicObjectsDirty = false;
+    _lastNumObjects = 0;
+    _lastNumCommands = 0;
+
+    _cullProgram = _createComputeProgram("shaders/gpuCull.c.glsl");
+    _depthPyramidProgram = _createComputeProgram("shaders/depthPyramid.c.glsl");
+
+    _cullUniformLocations.numObjects = glGetUniformLocation(_cullProgram, "numObjects");
+    _cullUniformLocations.frustumPlanes = glGetUniformLocation(_cullProgram, "frustumPlanes");
+    _cullUniformLocations.numViews = glGetUniformLocation(_cullProgram, "numViews");
+    _cullUniformLocations.useOcclusion = glGetUniformLocation(_cullProgram, "useOcclusion");
+    _cullUniformLocations.occlusionViewProjection = glGetUniformLocation(_cullProgram, "occlusionViewProjection");
+    _cullUniformLocations.depthPyramidLevels = glGetUniformLocation(_cullProgram, "depthPyramidLevels");
+    _isFirstLevelUniformLocation = glGetUniformLocation(_depthPyramidProgram, "isFirstLevel");
+
+    // samplers keep their texture units for the lifetime of the programs
+    glProgramUniform1i(_cullProgram, glGetUniformLocation(_cullProgram, "depthPyramid"), 0);
+    glProgramUniform1i(_depthPyramidProgram, glGetUniformLocation(_depthPyramidProgram, "sourceDepth"), 0);
+
+    glGenBuffers(1, &_objectBuffer);
+    glGenBuffers(1, &_commandBuffer);
+    glGenBuffers(1, &_instanceBuffer);
+    _objectCapacity = _commandCapacity = _instanceCapacity = 0;
+    // the pool VAO reads the instance buffer, so it needs storage before the attributes are attached
+    reserveBuffer(GL_ARRAY_BUFFER, _instanceBuffer, _instanceCapacity, 1, sizeof(InstanceData));
+    _geometryPool.setInstanceBuffer(_instanceBuffer);
+
+    glGenTextures(1, &_depthTexture);
+    glGenTextures(1, &_depthPyramid);
+    _depthPyramidWidth = _depthPyramidHeight = 0;
+    _depthPyramidLevels = 0;
+    _depthPyramidViewProjection = glm::mat4(1.0f);
+    _isDepthPyramidValid = false;
+}
+
+GpuCuller::~GpuCuller() {
+    glDeleteProgram(_cullProgram);
+    glDeleteProgram(_depthPyramidProgram);
+    glDeleteBuffers(1, &_objectBuffer);
+    glDeleteBuffers(1, &_commandBuffer);
+    glDeleteBuffers(1, &_instanceBuffer);
+    glDeleteTextures(1, &_depthTexture);
+    glDeleteTextures(1, &_depthPyramid);
+}
+
+GpuCuller::GpuObject GpuCuller::_makeObject(const Mesh* mesh, const InstanceData& instance) {
+    GpuObject object;
+    object.instance = instance;
+    object.meshSlot = _geometryPool.getSlot(mesh);
+    object.padding[0] = object.padding[1] = 0;
+    BoundingBox bounds = transformBoundingBox(_geometryPool.getRange(object.meshSlot).bounds, instance.modelMtx);
+    object.boundsMin = glm::vec4(bounds.min, 1.0f);
+    object.boundsMax = glm::vec4(bounds.max, 1.0f);
+    return object;
+}
+
+void GpuCuller::addStaticObject(const Mesh* mesh, const InstanceData& instance) {
+    // static objects stay at the front so the dynamic ones can be dropped every frame
+    _objects.insert(_objects.begin() + _numStaticObjects, _makeObject(mesh, instance));
+    _numStaticObjects++;
+    _areStaticObjectsDirty = true;
+}
+
+void GpuCuller::clearDynamicObjects() {
+    _objects.resize(_numStaticObjects);
+    _areDynamicObjectsDirty = true;
+}
+
+void GpuCuller::addDynamicObject(const Mesh* mesh, const InstanceData& instance) {
+    _objects.push_back( _makeObject(mesh, instance) );
+    _areDynamicObjectsDirty = true;
+}
+
+void GpuCuller::_prepareBuffers(GLStateCache& stateCache) {
+    _geometryPool.upload(stateCache);
+
+    // give every mesh a slice of the instance buffer big enough for all its objects
+    const GLuint NUM_SLOTS = _geometryPool.getNumSlots();
+    _drawCommands.assign(NUM_SLOTS, DrawCommand());
+    for(const GpuObject& object : _objects) {
+        _drawCommands[object.meshSlot].baseInstance++;
+    }
+    GLuint firstInstance = 0;
+    for(GLuint slot = 0; slot < NUM_SLOTS; slot++) {
+        const GeometryPool::Range& range = _geometryPool.getRange(slot);
+        DrawCommand& command = _drawCommands[slot];
+        GLuint numObjects = command.baseInstance;
+        command.count = range.numIndices;
+        command.instanceCount = 0;      // counted up by the cull
+        command.firstIndex = range.firstIndex;
+        command.baseVertex = range.baseVertex;
+        command.baseInstance = firstInstance;
+        firstInstance += numObjects;
+    }
+
+    const GLuint NUM_OBJECTS = _objects.size();
+    GLuint previousObjectCapacity = _objectCapacity;
+    reserveBuffer(GL_SHADER_STORAGE_BUFFER, _objectBuffer, _objectCapacity, NUM_OBJECTS, sizeof(GpuObject));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _objectBuffer);
+    if(_areStaticObjectsDirty || _objectCapacity != previousObjectCapacity) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, NUM_OBJECTS * sizeof(GpuObject), _objects.data());
+        _areStaticObjectsDirty = false;
+    } else if(_areDynamicObjectsDirty && NUM_OBJECTS > _numStaticObjects) {
+        // the static objects are already resident, only the ones recorded this frame change
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, _numStaticObjects * sizeof(GpuObject),
+                        (NUM_OBJECTS - _numStaticObjects) * sizeof(GpuObject), _objects.data() + _numStaticObjects);
+    }
+    _areDynamicObjectsDirty = false;
+
+    reserveBuffer(GL_SHADER_STORAGE_BUFFER, _commandBuffer, _commandCapacity, NUM_SLOTS, sizeof(DrawCommand));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _commandBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, NUM_SLOTS * sizeof(DrawCommand), _drawCommands.data());
+
+    reserveBuffer(GL_SHADER_STORAGE_BUFFER, _instanceBuffer, _instanceCapacity, NUM_OBJECTS, sizeof(InstanceData));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BUFFER_BINDING, _objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BUFFER_BINDING, _commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BUFFER_BINDING, _instanceBuffer);
+
+    _lastNumObjects = NUM_OBJECTS;
+    _lastNumCommands = NUM_SLOTS;
+}
+
+void GpuCuller::draw(const glm::mat4* viewProjectionMatrices, GLuint numViews, bool useOcclusion,
+                     GLStateCache& stateCache, GLuint shaderProgramHandle) {
+    _prepareBuffers(stateCache);
+    if(_objects.empty()) return;
+
+    numViews = std::min(numViews, MAX_VIEWS);
+    std::vector<glm::vec4> planes;
+    for(GLuint view = 0; view < numViews; view++) {
+        Frustum frustum(viewProjectionMatrices[view]);
+        for(GLuint i = 0; i < 6; i++) {
+            planes.push_back( frustum.getPlane(i) );
+        }
+    }
+    useOcclusion = useOcclusion && _isDepthPyramidValid;
+
+    // cull: every visible object is appended to the instances of its mesh's command
+    stateCache.useProgram(_cullProgram);
+    glUniform1ui( _cullUniformLocations.numObjects, _objects.size() );
+    glUniform4fv( _cullUniformLocations.frustumPlanes, planes.size(), &planes[0][0] );
+    glUniform1ui( _cullUniformLocations.numViews, numViews );
+    glUniform1i( _cullUniformLocations.useOcclusion, useOcclusion );
+    glUniformMatrix4fv( _cullUniformLocations.occlusionViewProjection, 1, GL_FALSE, &_depthPyramidViewProjection[0][0] );
+    glUniform1i( _cullUniformLocations.depthPyramidLevels, _depthPyramidLevels );
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _depthPyramid);
+    glDispatchCompute( (_objects.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1 );
+
+    // the draw reads the counts as commands and the instances as vertex attributes
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    stateCache.useProgram(shaderProgramHandle);
+    stateCache.bindVertexArray(_geometryPool.getVAO());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, _drawCommands.size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GpuCuller::updateDepthPyramid(GLsizei width, GLsizei height, const glm::mat4& viewProjectionMtx, GLStateCache& stateCache) {
+    if(width <= 0 || height <= 0) return;
+
+    if(width != _depthPyramidWidth || height != _depthPyramidHeight) {
+        // textures are recreated, immutable storage cannot be resized
+        glDeleteTextures(1, &_depthTexture);
+        glDeleteTextures(1, &_depthPyramid);
+        glGenTextures(1, &_depthTexture);
+        glGenTextures(1, &_depthPyramid);
+
+        _depthPyramidWidth = width;
+        _depthPyramidHeight = height;
+        _depthPyramidLevels = (GLint)floor( log2( (GLfloat)std::max(width, height) ) ) + 1;
+
+        glBindTexture(GL_TEXTURE_2D, _depthTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glBindTexture(GL_TEXTURE_2D, _depthPyramid);
+        glTexStorage2D(GL_TEXTURE_2D, _depthPyramidLevels, GL_R32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // the default framebuffer's depth cannot be sampled, so copy it out first
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _depthTexture);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+    stateCache.useProgram(_depthPyramidProgram);
+    GLsizei levelWidth = width, levelHeight = height;
+    for(GLint level = 0; level < _depthPyramidLevels; level++) {
+        glUniform1i(_isFirstLevelUniformLocation, level == 0);
+        if(level > 0) {
+            glBindImageTexture(0, _depthPyramid, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        }
+        glBindImageTexture(1, _depthPyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute( (levelWidth + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE,
+                           (levelHeight + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, 1 );
+        // the next level reads this one
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+    // the next frame's cull samples the pyramid through a texture
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    _depthPyramidViewProjection = viewProjectionMtx;
+    _isDepthPyramidValid = true;
+}
+
+void GpuCuller::invalidateDepthPyramid() {
+    _isDepthPyramidValid = false;
+}
+
+GpuCuller::Stats GpuCuller::readStats() const {
+    Stats stats;
+    stats.objects = _lastNumObjects;
+    stats.drawCommands = _lastNumCommands;
+    if(_lastNumCommands == 0) return stats;
+
+    std::vector<DrawCommand> commands(_lastNumCommands);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _commandBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(DrawCommand), commands.data());
+    for(const DrawCommand& command : commands) {
+        stats.visibleObjects += command.instanceCount;
+    }
+    return stats;
+}
+
+GLuint GpuCuller::_createComputeProgram(const std::string& filename) {
+    std::ifstream file(filename);
+    if(!file.is_open()) {
+        fprintf( stderr, "[ERROR]: could not open compute shader \"%s\"\n", filename.c_str() );
+        return 0;
+    }
+    std::stringstream source;
+    source << file.rdbuf();
+    std::string sourceString = source.str();
+    const GLchar* sourceText = sourceString.c_str();
+
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &sourceText, nullptr);
+    glCompileShader(shader);
+
+    GLint status;
+    GLchar log[1024];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if(status != GL_TRUE) {
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        fprintf( stderr, "[ERROR]: compute shader \"%s\" failed to compile:\n%s\n", filename.c_str(), log );
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status != GL_TRUE) {
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        fprintf( stderr, "[ERROR]: compute shader \"%s\" failed to link:\n%s\n", filename.c_str(), log );
+    }
+    return program;
+}
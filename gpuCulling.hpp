@@ -0,0 +1,162 @@
+#ifndef MP_GPU_CULLING_HPP
+#define MP_GPU_CULLING_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+#include "geometryPool.hpp"
+#include "glStateCache.hpp"
+#include "mesh.hpp"
+
+#include <string>
+#include <vector>
+
+/// \desc culls and draws every object of the scene on the GPU.  objects live in a shader
+/// storage buffer alongside their world bounds; a compute pass tests each against the view
+/// frustums and, for the main view, against a depth pyramid built from the previous frame, then
+/// appends the survivors to per-mesh instance lists and bumps the instance count of that mesh's
+/// indirect command.  one glMultiDrawElementsIndirect over the geometry pool then draws them all.
+/// needs compute shaders, storage buffers and multi-draw indirect (GL 4.3), see isSupported()
+class GpuCuller {
+public:
+    /// \desc counts read back from the last cull, see readStats()
+    struct Stats {
+        GLuint objects = 0;
+        GLuint visibleObjects = 0;
+        GLuint drawCommands = 0;
+    };
+
+    /// \desc true if the context exposes everything the GPU path needs
+    static bool isSupported();
+
+    /// \param vPosLocation attribute location of the vertex position
+    /// \param vNormalLocation attribute location of the vertex normal
+    GpuCuller(GLint vPosLocation, GLint vNormalLocation);
+    ~GpuCuller();
+
+    GpuCuller(const GpuCuller&) = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+
+    /// \desc adds an object that stays put for the lifetime of the culler
+    /// \param mesh mesh to draw the object with
+    /// \param instance transform and color of the object
+    void addStaticObject(const Mesh* mesh, const InstanceData& instance);
+    /// \desc removes every object added with addDynamicObject()
+    void clearDynamicObjects();
+    /// \desc adds an object for the current frame only
+    /// \param mesh mesh to draw the object with
+    /// \param instance transform and color of the object
+    void addDynamicObject(const Mesh* mesh, const InstanceData& instance);
+
+    /// \desc culls every object against the views and draws the survivors with the bound program
+    /// \param viewProjectionMatrices camera of each view, an object is drawn if any view sees it
+    /// \param numViews number of entries in viewProjectionMatrices, at most MAX_VIEWS
+    /// \param useOcclusion if true objects hidden behind last frame's depth pyramid are skipped too
+    /// \param stateCache cache the program and VAO binds are routed through
+    /// \param shaderProgramHandle program to draw with, must be built with SHADER_FEATURE_INSTANCING
+    void draw(const glm::mat4* viewProjectionMatrices, GLuint numViews, bool useOcclusion,
+              GLStateCache& stateCache, GLuint shaderProgramHandle);
+
+    /// \desc reduces the depth buffer of the view just drawn into the pyramid the next frame's
+    /// occlusion test reads
+    /// \param width width of the default framebuffer
+    /// \param height height of the default framebuffer
+    /// \param viewProjectionMtx camera the depth buffer was drawn with
+    /// \param stateCache cache the program bind is routed through
+    void updateDepthPyramid(GLsizei width, GLsizei height, const glm::mat4& viewProjectionMtx, GLStateCache& stateCache);
+    /// \desc disables occlusion culling until the next updateDepthPyramid(), call when the main
+    /// view was not drawn so the pyramid no longer matches it
+    void invalidateDepthPyramid();
+
+    /// \desc reads the results of the last cull back from the GPU, stalls so only call on request
+    Stats readStats() const;
+
+    /// \desc views a single cull can test against, must match gpuCull.c.glsl
+    static constexpr GLuint MAX_VIEWS = 4;
+
+private:
+    /// \desc object as laid out in the std430 storage buffer read by gpuCull.c.glsl
+    struct GpuObject {
+        InstanceData instance;
+        /// \desc slot of the object's mesh in the geometry pool, selects its draw command
+        GLuint meshSlot;
+        /// \desc std430 aligns the vec4s that follow to 16 bytes
+        GLuint padding[2];
+        /// \desc world space bounds, w unused
+        glm::vec4 boundsMin;
+        glm::vec4 boundsMax;
+    };
+
+    /// \desc glMultiDrawElementsIndirect command, also written by gpuCull.c.glsl
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    /// \desc builds the storage buffer entry of an object
+    GpuObject _makeObject(const Mesh* mesh, const InstanceData& instance);
+    /// \desc compiles and links a compute shader
+    /// \param filename path of the shader source
+    static GLuint _createComputeProgram(const std::string& filename);
+    /// \desc uploads the objects and fresh draw commands before a cull
+    void _prepareBuffers(GLStateCache& stateCache);
+
+    GeometryPool _geometryPool;
+
+    /// \desc static objects first, then the dynamic objects of the current frame
+    std::vector<GpuObject> _objects;
+    GLuint _numStaticObjects;
+    /// \desc true if static objects were added since the last upload
+    bool _areStaticObjectsDirty;
+    /// \desc true if the dynamic objects changed since the last upload
+    bool _areDynamicObjectsDirty;
+    /// \desc draw commands with zeroed instance counts, copied to the GPU before every cull
+    std::vector<DrawCommand> _drawCommands;
+
+    GLuint _cullProgram;
+    /// \desc uniform locations of gpuCull.c.glsl
+    struct CullUniformLocations {
+        GLint numObjects;
+        GLint frustumPlanes;
+        GLint numViews;
+        GLint useOcclusion;
+        GLint occlusionViewProjection;
+        GLint depthPyramidLevels;
+    } _cullUniformLocations;
+    GLuint _depthPyramidProgram;
+    /// \desc uniform location of the level 0 toggle in depthPyramid.c.glsl
+    GLint _isFirstLevelUniformLocation;
+
+    /// \desc GpuObject array
+    GLuint _objectBuffer;
+    /// \desc number of GpuObjects the object buffer can hold
+    GLuint _objectCapacity;
+    /// \desc DrawCommand array, bound as both storage and indirect buffer
+    GLuint _commandBuffer;
+    GLuint _commandCapacity;
+    /// \desc InstanceData of the visible objects grouped by mesh, read as instance attributes
+    GLuint _instanceBuffer;
+    GLuint _instanceCapacity;
+
+    /// \desc copy of the default framebuffer's depth, since it cannot be sampled directly
+    GLuint _depthTexture;
+    /// \desc r32f pyramid, every level holds the farthest depth of the 2x2 block below it
+    GLuint _depthPyramid;
+    GLsizei _depthPyramidWidth;
+    GLsizei _depthPyramidHeight;
+    GLint _depthPyramidLevels;
+    /// \desc camera the pyramid was built from, objects are projected with it for the occlusion test
+    glm::mat4 _depthPyramidViewProjection;
+    bool _isDepthPyramidValid;
+
+    /// \desc number of objects and commands in the last cull
+    GLuint _lastNumObjects;
+    GLuint _lastNumCommands;
+};
+
+#endif //MP_GPU_CULLING_HPP
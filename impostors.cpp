@@ -0,0 +1,189 @@
+#include "impostors.hpp"
+
+#include "uniformBuffers.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+
+#ifndef M_PI
+#define M_PI 3.14159265
+#endif
+
+/// \desc texture unit the atlas is sampled from
+static constexpr GLint ATLAS_TEXTURE_UNIT = 0;
+/// \desc attribute locations of impostor.v.glsl
+static constexpr GLuint CORNER_LOCATION = 0;
+static constexpr GLuint INSTANCE_CENTER_LOCATION = 1;
+static constexpr GLuint INSTANCE_VARIANT_LOCATION = 2;
+
+ImpostorAtlas::ImpostorAtlas(GLsizei spriteSize) :
+    _spriteSize( spriteSize ),
+    _atlasTexture( 0 ),
+    _instanceCapacity( 0 ),
+    _numInstances( 0 ) {
+
+    _shaderProgram = new CSCI441::ShaderProgram("shaders/impostor.v.glsl", "shaders/impostor.f.glsl");
+    _cameraPositionUniformLocation = _shaderProgram->getUniformLocation("cameraPosition");
+    _atlasUniformLocation = _shaderProgram->getUniformLocation("atlas");
+    GLuint shaderHandle = _shaderProgram->getShaderProgramHandle();
+    glUniformBlockBinding(shaderHandle, glGetUniformBlockIndex(shaderHandle, "FrameBlock"), FRAME_BLOCK_BINDING);
+
+    glGenFramebuffers(1, &_framebuffer);
+    glGenRenderbuffers(1, &_depthRenderbuffer);
+
+    // a triangle strip over the unit quad, expanded to face the camera in the vertex shader
+    const GLfloat CORNERS[] = { -1.0f, -1.0f,   1.0f, -1.0f,   -1.0f, 1.0f,   1.0f, 1.0f };
+    glGenVertexArrays(1, &_vao);
+    glBindVertexArray(_vao);
+    glGenBuffers(1, &_quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, _quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(CORNERS), CORNERS, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(CORNER_LOCATION);
+    glVertexAttribPointer(CORNER_LOCATION, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (void*)0);
+
+    glGenBuffers(1, &_instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+    glEnableVertexAttribArray(INSTANCE_CENTER_LOCATION);
+    glVertexAttribPointer(INSTANCE_CENTER_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), (void*)offsetof(ImpostorInstance, center));
+    glVertexAttribDivisor(INSTANCE_CENTER_LOCATION, 1);
+    glEnableVertexAttribArray(INSTANCE_VARIANT_LOCATION);
+    glVertexAttribPointer(INSTANCE_VARIANT_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), (void*)offsetof(ImpostorInstance, variant));
+    glVertexAttribDivisor(INSTANCE_VARIANT_LOCATION, 1);
+    glBindVertexArray(0);
+}
+
+ImpostorAtlas::~ImpostorAtlas() {
+    delete _shaderProgram;
+    glDeleteVertexArrays(1, &_vao);
+    glDeleteBuffers(1, &_quadVBO);
+    glDeleteBuffers(1, &_instanceVBO);
+    glDeleteTextures(1, &_atlasTexture);
+    glDeleteRenderbuffers(1, &_depthRenderbuffer);
+    glDeleteFramebuffers(1, &_framebuffer);
+}
+
+GLint ImpostorAtlas::addVariant(const BoundingBox& bounds) {
+    if(_variantBounds.size() >= MAX_VARIANTS) {
+        fprintf( stderr, "[ERROR]: impostor atlas is full, at most %u variants\n", MAX_VARIANTS );
+        return -1;
+    }
+    _variantBounds.push_back(bounds);
+    return _variantBounds.size() - 1;
+}
+
+GLuint ImpostorAtlas::getNumVariants() const {
+    return _variantBounds.size();
+}
+
+void ImpostorAtlas::beginBake() {
+    const GLsizei WIDTH = _spriteSize * NUM_VIEWS;
+    const GLsizei HEIGHT = _spriteSize * std::max( (GLsizei)_variantBounds.size(), 1 );
+
+    glDeleteTextures(1, &_atlasTexture);
+    glGenTextures(1, &_atlasTexture);
+    glBindTexture(GL_TEXTURE_2D, _atlasTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WIDTH, HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, WIDTH, HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _atlasTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthRenderbuffer);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf( stderr, "[ERROR]: impostor atlas framebuffer of %dx%d is incomplete\n", WIDTH, HEIGHT );
+    }
+
+    // everything around the sprites stays transparent, the fragment shader discards it
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glViewport(0, 0, WIDTH, HEIGHT);
+    glScissor(0, 0, WIDTH, HEIGHT);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+}
+
+void ImpostorAtlas::beginSprite(GLuint variant, GLuint view, glm::mat4& viewMtx, glm::mat4& projMtx) const {
+    glViewport(view * _spriteSize, variant * _spriteSize, _spriteSize, _spriteSize);
+    glScissor(view * _spriteSize, variant * _spriteSize, _spriteSize, _spriteSize);
+
+    const BoundingBox& bounds = _variantBounds[variant];
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    GLfloat radius = glm::length(bounds.max - bounds.min) * 0.5f;
+
+    // must match the sprite picked in impostor.v.glsl
+    GLfloat azimuth = (view % NUM_AZIMUTHS) * 2.0f * (GLfloat)M_PI / NUM_AZIMUTHS;
+    GLfloat elevation = (view / NUM_AZIMUTHS) * ELEVATION_STEP;
+    glm::vec3 direction( cosf(elevation) * sinf(azimuth), sinf(elevation), cosf(elevation) * cosf(azimuth) );
+
+    viewMtx = glm::lookAt( center + direction * radius * 2.0f, center, glm::vec3(0.0f, 1.0f, 0.0f) );
+    projMtx = glm::ortho( -radius, radius, -radius, radius, radius * 0.5f, radius * 3.5f );
+}
+
+void ImpostorAtlas::endBake() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, _atlasTexture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the shape of every variant is fixed from now on
+    GLuint shaderHandle = _shaderProgram->getShaderProgramHandle();
+    GLfloat radii[MAX_VARIANTS] = {};
+    for(GLuint variant = 0; variant < _variantBounds.size(); variant++) {
+        radii[variant] = glm::length(_variantBounds[variant].max - _variantBounds[variant].min) * 0.5f;
+    }
+    glProgramUniform1fv(shaderHandle, _shaderProgram->getUniformLocation("variantRadii"), MAX_VARIANTS, radii);
+    glProgramUniform1f(shaderHandle, _shaderProgram->getUniformLocation("numVariants"), (GLfloat)std::max( (GLsizei)_variantBounds.size(), 1 ));
+}
+
+ImpostorInstance ImpostorAtlas::makeInstance(GLuint variant, const BoundingBox& worldBounds) const {
+    const BoundingBox& variantBounds = _variantBounds[variant];
+    ImpostorInstance instance;
+    instance.center = (worldBounds.min + worldBounds.max) * 0.5f;
+    instance.heightScale = (worldBounds.max.y - worldBounds.min.y) / (variantBounds.max.y - variantBounds.min.y);
+    instance.variant = (GLfloat)variant;
+    return instance;
+}
+
+void ImpostorAtlas::setInstances(const ImpostorInstance* instances, GLsizei numInstances) {
+    _numInstances = numInstances;
+    if(numInstances == 0) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+    if(numInstances > _instanceCapacity) {
+        // grow the buffer, otherwise update in place to avoid reallocating
+        _instanceCapacity = numInstances;
+        glBufferData(GL_ARRAY_BUFFER, numInstances * sizeof(ImpostorInstance), instances, GL_DYNAMIC_DRAW);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, numInstances * sizeof(ImpostorInstance), instances);
+    }
+}
+
+GLsizei ImpostorAtlas::getNumInstances() const {
+    return _numInstances;
+}
+
+void ImpostorAtlas::draw(GLStateCache& stateCache, const glm::vec3& cameraPosition) const {
+    if(_numInstances == 0) return;
+
+    stateCache.useProgram(_shaderProgram->getShaderProgramHandle());
+    stateCache.setUniform(_cameraPositionUniformLocation, cameraPosition);
+    stateCache.setUniform(_atlasUniformLocation, ATLAS_TEXTURE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + ATLAS_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _atlasTexture);
+
+    stateCache.bindVertexArray(_vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, _numInstances);
+}
@@ -0,0 +1,101 @@
+#ifndef MP_IMPOSTORS_HPP
+#define MP_IMPOSTORS_HPP
+
+#include <GL/glew.h>
+
+#include <CSCI441/ShaderProgram.hpp>
+
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+#include "glStateCache.hpp"
+
+#include <vector>
+
+/// \desc a distant object drawn as a single sprite, laid out as the per-instance attributes of impostor.v.glsl
+struct ImpostorInstance {
+    /// \desc world space center of the object's bounds
+    glm::vec3 center;
+    /// \desc height of the object over the height of the variant it is drawn with
+    GLfloat heightScale;
+    /// \desc row of the atlas holding the variant's sprites, a float to keep the attribute plain
+    GLfloat variant;
+};
+
+/// \desc sprites of a few representative shapes, each baked from a ring of directions at startup,
+/// so objects far from the camera can be drawn as one camera facing quad instead of their meshes.
+/// every variant is a row of the atlas with one square sprite per direction, framed around the
+/// bounding sphere of the shape so the quad drawn in its place is just as big
+class ImpostorAtlas {
+public:
+    /// \desc directions around the vertical axis each variant is baked from
+    static constexpr GLuint NUM_AZIMUTHS = 8;
+    /// \desc heights each ring of directions is baked from, starting level with the object
+    static constexpr GLuint NUM_ELEVATIONS = 3;
+    /// \desc angle in radians between two rings
+    static constexpr GLfloat ELEVATION_STEP = 0.5235988f;
+    /// \desc sprites per variant
+    static constexpr GLuint NUM_VIEWS = NUM_AZIMUTHS * NUM_ELEVATIONS;
+    /// \desc most variants an atlas can hold, must match impostor.v.glsl
+    static constexpr GLuint MAX_VARIANTS = 16;
+
+    /// \param spriteSize pixels along each side of a sprite
+    explicit ImpostorAtlas(GLsizei spriteSize = 64);
+    ~ImpostorAtlas();
+
+    ImpostorAtlas(const ImpostorAtlas&) = delete;
+    ImpostorAtlas& operator=(const ImpostorAtlas&) = delete;
+
+    /// \desc registers a shape to bake, must be called before beginBake()
+    /// \param bounds world space bounds of the shape where it will be drawn while baking
+    /// \return index of the variant, -1 if the atlas is full
+    GLint addVariant(const BoundingBox& bounds);
+    GLuint getNumVariants() const;
+
+    /// \desc allocates the atlas for every variant added and binds it as the render target
+    void beginBake();
+    /// \desc points the viewport at one sprite and returns the camera to draw its variant with
+    /// \param variant index returned by addVariant()
+    /// \param view direction to bake, elevation ring times NUM_AZIMUTHS plus azimuth
+    /// \param viewMtx receives the view matrix looking at the variant from that direction
+    /// \param projMtx receives the orthographic projection framing the variant
+    void beginSprite(GLuint variant, GLuint view, glm::mat4& viewMtx, glm::mat4& projMtx) const;
+    /// \desc rebinds the window framebuffer and builds the atlas mip chain
+    void endBake();
+
+    /// \desc the impostor standing in for an object
+    /// \param variant index returned by addVariant() of the shape closest to the object
+    /// \param worldBounds world space bounds of the object
+    ImpostorInstance makeInstance(GLuint variant, const BoundingBox& worldBounds) const;
+    /// \desc replaces the impostors drawn by draw()
+    void setInstances(const ImpostorInstance* instances, GLsizei numInstances);
+    GLsizei getNumInstances() const;
+    /// \desc draws every impostor in a single call
+    /// \param stateCache cache the program and VAO binds are routed through
+    /// \param cameraPosition world space position of the camera, picks each sprite and faces the quads
+    /// \note the FrameBlock for the view must already be bound
+    void draw(GLStateCache& stateCache, const glm::vec3& cameraPosition) const;
+
+private:
+    GLsizei _spriteSize;
+    /// \desc world space bounds of each variant while baking
+    std::vector<BoundingBox> _variantBounds;
+
+    GLuint _atlasTexture;
+    GLuint _framebuffer;
+    GLuint _depthRenderbuffer;
+
+    CSCI441::ShaderProgram* _shaderProgram;
+    /// \desc uniform locations of impostor.v.glsl
+    GLint _cameraPositionUniformLocation;
+    GLint _atlasUniformLocation;
+
+    /// \desc corners of the unit quad
+    GLuint _vao;
+    GLuint _quadVBO;
+    GLuint _instanceVBO;
+    GLsizei _instanceCapacity;
+    GLsizei _numInstances;
+};
+
+#endif //MP_IMPOSTORS_HPP
@@ -0,0 +1,353 @@
+#include "jobSystem.hpp"
+
+#include "culling.hpp"
+#include "mesh.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#ifndef M_PI
+#define M_PI 3.14159265
+#endif
+
+/// \desc worker the calling thread owns, threads outside the pool share worker 0
+static thread_local GLuint sWorkerIndex = 0;
+/// \desc times an idle worker looks for work again before it goes to sleep
+static constexpr GLuint IDLE_SPINS = 64;
+
+GLuint JobSystem::TaskGraph::addTask(std::function<void()> task, std::initializer_list<GLuint> dependencies) {
+    const GLuint ID = _nodes.size();
+    Node node;
+    node.task = std::move(task);
+    node.numDependencies = dependencies.size();
+    _nodes.push_back( std::move(node) );
+    for(GLuint dependency : dependencies) {
+        _nodes[dependency].successors.push_back(ID);
+    }
+    return ID;
+}
+
+GLuint JobSystem::TaskGraph::getNumTasks() const {
+    return _nodes.size();
+}
+
+JobSystem::JobSystem(GLuint numThreads) :
+    _numQueued( 0 ),
+    _numSleeping( 0 ),
+    _isRunning( true ) {
+
+    if(numThreads == 0) {
+        numThreads = std::thread::hardware_concurrency();
+    }
+    numThreads = std::max(numThreads, 1u);
+
+    for(GLuint i = 0; i < numThreads; i++) {
+        _workers.emplace_back( new Worker() );
+    }
+    // the calling thread is worker 0
+    for(GLuint i = 1; i < numThreads; i++) {
+        _threads.emplace_back( &JobSystem::_workerLoop, this, i );
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _isRunning = false;
+    }
+    _wake.notify_all();
+    for(std::thread& thread : _threads) {
+        thread.join();
+    }
+}
+
+GLuint JobSystem::getNumThreads() const {
+    return _workers.size();
+}
+
+void JobSystem::run(TaskGraph& graph) {
+    const GLuint NUM_TASKS = graph.getNumTasks();
+    if(NUM_TASKS == 0) return;
+
+    graph._pending.reset( new std::atomic<GLuint>[NUM_TASKS] );
+    for(GLuint i = 0; i < NUM_TASKS; i++) {
+        graph._pending[i] = graph._nodes[i].numDependencies;
+    }
+    Counter counter;
+    counter.pending = NUM_TASKS;
+    for(GLuint i = NUM_TASKS; i-- > 0; ) {
+        if(graph._nodes[i].numDependencies == 0) {
+            _push( { _runGraphTask, &graph, i, 0, &counter } );
+        }
+    }
+    _wait(counter);
+}
+
+void JobSystem::_runGraphTask(JobSystem& jobSystem, const Job& job) {
+    // run() owns the graph and does not return before every task is done
+    auto& graph = *const_cast<TaskGraph*>( static_cast<const TaskGraph*>(job.context) );
+    const TaskGraph::Node& node = graph._nodes[job.begin];
+    node.task();
+
+    // the counter is only released after this, so the successors are queued before run() can return
+    for(GLuint successor : node.successors) {
+        if(--graph._pending[successor] == 0) {
+            jobSystem._push( { _runGraphTask, &graph, successor, 0, job.counter } );
+        }
+    }
+}
+
+void JobSystem::_push(const Job& job) {
+    Worker& worker = *_workers[ sWorkerIndex ];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs.push_back(job);
+    }
+    _numQueued++;
+    // a worker only sleeps after seeing nothing queued, so one that is asleep missed this job
+    if(_numSleeping > 0) {
+        { std::lock_guard<std::mutex> lock(_sleepMutex); }
+        _wake.notify_one();
+    }
+}
+
+bool JobSystem::_pop(Job& job) {
+    if(_numQueued == 0) return false;
+
+    const GLuint NUM_WORKERS = _workers.size();
+    const GLuint SELF = sWorkerIndex;
+    {
+        Worker& worker = *_workers[SELF];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if(!worker.jobs.empty()) {
+            job = worker.jobs.back();
+            worker.jobs.pop_back();
+            _numQueued--;
+            return true;
+        }
+    }
+    for(GLuint i = 1; i < NUM_WORKERS; i++) {
+        Worker& victim = *_workers[ (SELF + i) % NUM_WORKERS ];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            _numQueued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::_execute(const Job& job) {
+    job.function(*this, job);
+    job.counter->pending--;
+}
+
+void JobSystem::_wait(Counter& counter) {
+    Job job;
+    while(counter.pending > 0) {
+        if(_pop(job)) {
+            _execute(job);
+        } else {
+            // the last jobs are running elsewhere
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::_workerLoop(GLuint workerIndex) {
+    sWorkerIndex = workerIndex;
+    Job job;
+    GLuint numIdleSpins = 0;
+    while(_isRunning) {
+        if(_pop(job)) {
+            _execute(job);
+            numIdleSpins = 0;
+            continue;
+        }
+        if(++numIdleSpins < IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+        // nothing has turned up for a while, sleep until _push() has something
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _numSleeping++;
+        _wake.wait( lock, [this]() { return _numQueued > 0 || !_isRunning; } );
+        _numSleeping--;
+        numIdleSpins = 0;
+    }
+}
+
+//*************************************************************************************
+//
+// Benchmark
+
+/// \desc what building and culling one object of the synthetic world produces
+struct BenchmarkObject {
+    InstanceData instance;
+    BoundingBox bounds;
+    /// \desc bit per view the object is inside of
+    GLuint visibleViews;
+};
+
+/// \desc the exact same results, which every thread count must produce
+static bool isSameObject(const BenchmarkObject& a, const BenchmarkObject& b) {
+    return a.instance.modelMtx == b.instance.modelMtx && a.instance.normalMtx == b.instance.normalMtx &&
+           a.bounds.min == b.bounds.min && a.bounds.max == b.bounds.max && a.visibleViews == b.visibleViews;
+}
+
+/// \desc runs a function repeatedly and keeps the fastest run, so scheduling noise does not skew the result
+/// \return milliseconds of the fastest run
+template<typename Function>
+static GLdouble fastestRun(Function function) {
+    static constexpr GLuint NUM_RUNS = 10;
+    GLdouble best = HUGE_VAL;
+    for(GLuint run = 0; run < NUM_RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<GLdouble, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min( best, elapsed.count() );
+    }
+    return best;
+}
+
+/// \desc what culling the synthetic world for the views produces
+struct BenchmarkCull {
+    std::vector<GLuint> visibleObjects;
+    std::vector<GLuint> farObjects;
+    std::vector<InstanceData> instances;
+    CullingStats stats;
+};
+
+/// \desc the exact same results, which every thread count must produce
+static bool isSameCull(const BenchmarkCull& a, const BenchmarkCull& b) {
+    if(a.visibleObjects != b.visibleObjects || a.farObjects != b.farObjects || a.instances.size() != b.instances.size()) return false;
+    for(size_t i = 0; i < a.instances.size(); i++) {
+        if(a.instances[i].modelMtx != b.instances[i].modelMtx) return false;
+    }
+    return a.stats.visibleCells == b.stats.visibleCells && a.stats.visibleObjects == b.stats.visibleObjects;
+}
+
+bool benchmarkJobSystem(GLuint numObjects) {
+    static constexpr GLuint NUM_VIEWS = 4;
+    static constexpr GLuint GRAIN_SIZE = 256;
+    static constexpr GLint GRID_CELLS = 64;
+    const BoundingBox UNIT_CUBE = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+
+    // a city far denser than the real one, on a fixed seed so every run builds the same world
+    std::mt19937 generator(441);
+    std::uniform_real_distribution<GLfloat> unit(0.0f, 1.0f);
+    const GLfloat WORLD_SIZE = sqrtf( (GLfloat)numObjects );
+    std::vector<glm::vec4> placements(numObjects);
+    for(glm::vec4& placement : placements) {
+        placement = glm::vec4( (unit(generator) - 0.5f) * WORLD_SIZE, 0.0f, (unit(generator) - 0.5f) * WORLD_SIZE,
+                               powf(unit(generator), 2.5f) * 10.0f + 1.0f );
+    }
+    // the four split-screen views, looking in at the world from each side
+    std::vector<Frustum> frustums;
+    // objects farther than this from the first view are drawn as impostors, as the engine does
+    const glm::vec3 IMPOSTOR_VIEW_POSITION( WORLD_SIZE * 0.25f, 10.0f, 0.0f );
+    const GLfloat IMPOSTOR_DISTANCE = WORLD_SIZE * 0.25f;
+    const glm::mat4 PROJECTION_MTX = glm::perspective( 45.0f, 4.0f / 3.0f, 0.001f, 1000.0f );
+    for(GLuint view = 0; view < NUM_VIEWS; view++) {
+        const GLfloat ANGLE = view * (GLfloat)M_PI / 2.0f;
+        const glm::vec3 EYE( cosf(ANGLE) * WORLD_SIZE * 0.25f, 10.0f, sinf(ANGLE) * WORLD_SIZE * 0.25f );
+        frustums.emplace_back( PROJECTION_MTX * glm::lookAt(EYE, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)) );
+    }
+
+    // the per-object work the engine does when it places the environment and culls it
+    auto buildAndCull = [&](std::vector<BenchmarkObject>& objects, GLuint begin, GLuint end) {
+        for(GLuint i = begin; i < end; i++) {
+            const glm::vec4& placement = placements[i];
+            glm::mat4 modelMtx = glm::translate( glm::mat4(1.0f), glm::vec3(placement.x, placement.w / 2.0f, placement.z) );
+            modelMtx = glm::scale( modelMtx, glm::vec3(1.0f, placement.w, 1.0f) );
+            BenchmarkObject& object = objects[i];
+            object.instance = makeInstanceData(modelMtx, glm::vec3(0.3f));
+            object.bounds = transformBoundingBox(UNIT_CUBE, modelMtx);
+            object.visibleViews = 0;
+            for(GLuint view = 0; view < NUM_VIEWS; view++) {
+                if(frustums[view].intersects(object.bounds)) object.visibleViews |= 1u << view;
+            }
+        }
+    };
+
+    const GLuint MAX_THREADS = std::max( std::thread::hardware_concurrency(), 1u );
+    fprintf( stdout, "[INFO]: building and culling %u objects against %u views, up to %u threads\n",
+             numObjects, NUM_VIEWS, MAX_THREADS );
+    fprintf( stdout, "[INFO]: build places every object and tests it against the views, cull runs the\n"
+                     "[INFO]: engine's ParallelCuller over a grid of them: query, impostor split and instance gather\n" );
+
+    std::vector<BenchmarkObject> reference(numObjects);
+    BenchmarkCull referenceCull;
+    SpatialGrid* grid = nullptr;
+    std::vector<BoundingBox> bounds(numObjects);
+    std::vector<InstanceData> instances(numObjects);
+    GLdouble singleThreadMilliseconds = 0.0, singleThreadCullMilliseconds = 0.0;
+    bool isCorrect = true;
+    for(GLuint numThreads = 1; ; numThreads = std::min(numThreads * 2, MAX_THREADS)) {
+        JobSystem jobSystem(numThreads);
+        std::vector<BenchmarkObject> objects(numObjects);
+        GLdouble milliseconds = fastestRun( [&]() {
+            jobSystem.parallelFor( numObjects, GRAIN_SIZE, [&](GLuint begin, GLuint end) { buildAndCull(objects, begin, end); } );
+        } );
+
+        if(numThreads == 1) {
+            singleThreadMilliseconds = milliseconds;
+            reference = objects;
+            // the grid is filled once on one thread, as _buildEnvironmentInstances() does
+            grid = new SpatialGrid(-WORLD_SIZE * 0.5f - 10.0f, WORLD_SIZE * 0.5f + 10.0f, GRID_CELLS);
+            for(GLuint i = 0; i < numObjects; i++) {
+                bounds[i] = reference[i].bounds;
+                instances[i] = reference[i].instance;
+                grid->insert(i, bounds[i]);
+            }
+        } else {
+            for(GLuint i = 0; i < numObjects; i++) {
+                if(isSameObject(objects[i], reference[i])) continue;
+                fprintf( stderr, "[ERROR]: %u threads did not build the same world as one\n", numThreads );
+                isCorrect = false;
+                break;
+            }
+        }
+
+        // the steps of MPEngine::_cullEnvironment() that touch every object
+        ParallelCuller culler(&jobSystem);
+        BenchmarkCull cull;
+        GLdouble cullMilliseconds = fastestRun( [&]() {
+            cull.visibleObjects.clear();
+            cull.farObjects.clear();
+            cull.instances.clear();
+            cull.stats.reset();
+            culler.query(*grid, frustums.data(), NUM_VIEWS, cull.visibleObjects, cull.stats);
+            culler.separateFar(cull.visibleObjects, bounds, IMPOSTOR_VIEW_POSITION, IMPOSTOR_DISTANCE, cull.farObjects);
+            culler.gather(cull.visibleObjects, instances, cull.instances);
+        } );
+
+        if(numThreads == 1) {
+            singleThreadCullMilliseconds = cullMilliseconds;
+            referenceCull = cull;
+        } else if(!isSameCull(cull, referenceCull)) {
+            fprintf( stderr, "[ERROR]: %u threads did not cull the same objects as one\n", numThreads );
+            isCorrect = false;
+        }
+        fprintf( stdout, "[INFO]: %3u threads build %9.3f ms %6.2fx  cull %9.3f ms %6.2fx\n",
+                 numThreads, milliseconds, singleThreadMilliseconds / milliseconds,
+                 cullMilliseconds, singleThreadCullMilliseconds / cullMilliseconds );
+        if(numThreads == MAX_THREADS) break;
+    }
+    delete grid;
+
+    GLuint numVisible = 0;
+    for(const BenchmarkObject& object : reference) {
+        if(object.visibleViews != 0) numVisible++;
+    }
+    fprintf( stdout, "[INFO]: %u of %u objects inside at least one view\n", numVisible, numObjects );
+    fprintf( stdout, "[INFO]: %zu objects in visible grid cells, %zu of them drawn as impostors\n",
+             referenceCull.visibleObjects.size() + referenceCull.farObjects.size(), referenceCull.farObjects.size() );
+    return isCorrect;
+}
@@ -0,0 +1,139 @@
+#ifndef MP_JOB_SYSTEM_HPP
+#define MP_JOB_SYSTEM_HPP
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// \desc work-stealing thread pool the engine spreads its CPU work over.  every worker owns a
+/// deque of jobs: it pushes and pops at the back, so the work it just split up stays in its
+/// cache, and whichever worker runs dry steals from the front of another's, taking the
+/// largest and oldest pieces first.  a thread waiting for its jobs runs jobs itself rather
+/// than blocking, so jobs may split up work of their own.  the thread that creates the pool
+/// takes part as worker 0, as do any other threads outside the pool that hand it work
+class JobSystem {
+public:
+    /// \desc tasks with dependencies between them, handed to run() as a whole.  a task starts
+    /// once every task it depends on has finished, independent tasks run at the same time
+    class TaskGraph {
+    public:
+        /// \param task work of the task, may itself call parallelFor()
+        /// \param dependencies ids of tasks added earlier that must finish first
+        /// \return id of the task for later tasks to depend on
+        GLuint addTask(std::function<void()> task, std::initializer_list<GLuint> dependencies = {});
+        GLuint getNumTasks() const;
+
+    private:
+        friend class JobSystem;
+        struct Node {
+            std::function<void()> task;
+            /// \desc tasks waiting on this one
+            std::vector<GLuint> successors;
+            GLuint numDependencies = 0;
+        };
+        std::vector<Node> _nodes;
+        /// \desc dependencies of each node still running during run()
+        std::unique_ptr<std::atomic<GLuint>[]> _pending;
+    };
+
+    /// \param numThreads threads to run jobs on including the calling thread, 0 uses one per hardware thread
+    explicit JobSystem(GLuint numThreads = 0);
+    /// \desc joins the workers, nothing may be running on the pool by then
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /// \desc threads jobs run on, including the calling thread
+    GLuint getNumThreads() const;
+
+    /// \desc calls body(begin, end) over [0, count) split into ranges of grainSize, and returns
+    /// once every range is done.  ranges run in any order on any thread
+    /// \param grainSize fewest indices worth a job of their own
+    template<typename Body> void parallelFor(GLuint count, GLuint grainSize, const Body& body);
+
+    /// \desc runs every task of a graph in dependency order and returns once all are done
+    void run(TaskGraph& graph);
+
+private:
+    /// \desc jobs of a parallelFor() or run() still to finish
+    struct Counter {
+        std::atomic<GLuint> pending{0};
+    };
+    /// \desc a range of a parallelFor() or a task of a graph
+    struct Job {
+        void (*function)(JobSystem& jobSystem, const Job& job);
+        /// \desc body of the parallelFor() or graph of the task
+        const void* context;
+        GLuint begin;
+        GLuint end;
+        Counter* counter;
+    };
+    /// \desc jobs queued by one thread, on a cache line of its own
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    /// \desc queues a job on the calling thread's worker
+    void _push(const Job& job);
+    /// \desc takes the newest job of the calling thread's worker, or else steals the oldest of another's
+    bool _pop(Job& job);
+    void _execute(const Job& job);
+    /// \desc runs jobs until counter reaches zero
+    void _wait(Counter& counter);
+    /// \desc body of the pool's threads
+    void _workerLoop(GLuint workerIndex);
+    /// \desc runs the task job.begin of a graph and queues the successors it was the last dependency of
+    static void _runGraphTask(JobSystem& jobSystem, const Job& job);
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    /// \desc jobs queued and not yet taken, lets idle workers sleep
+    std::atomic<GLuint> _numQueued;
+    std::atomic<GLuint> _numSleeping;
+    std::mutex _sleepMutex;
+    std::condition_variable _wake;
+    std::atomic<bool> _isRunning;
+};
+
+template<typename Body>
+void JobSystem::parallelFor(GLuint count, GLuint grainSize, const Body& body) {
+    grainSize = std::max(grainSize, 1u);
+    // a few ranges per thread lets the threads that finish early take work from the slow ones
+    const GLuint NUM_RANGES = std::min( (count + grainSize - 1) / grainSize, getNumThreads() * 4 );
+    if(NUM_RANGES <= 1) {
+        if(count > 0) body(0, count);
+        return;
+    }
+
+    auto runRange = [](JobSystem&, const Job& job) {
+        (*static_cast<const Body*>(job.context))(job.begin, job.end);
+    };
+    Counter counter;
+    counter.pending = NUM_RANGES;
+    // the calling thread works from the back of its own deque, so it starts on the first range
+    for(GLuint range = NUM_RANGES; range-- > 0; ) {
+        _push( { runRange, &body, (GLuint)((GLuint64)count * range / NUM_RANGES),
+                 (GLuint)((GLuint64)count * (range + 1) / NUM_RANGES), &counter } );
+    }
+    _wait(counter);
+}
+
+/// \desc times the same dense synthetic world built and culled with 1, 2, 4 ... threads up to
+/// one per hardware thread and reports the speedup of each over a single thread.  the culling
+/// runs through ParallelCuller, the same code the engine culls its environment with
+/// \param numObjects buildings in the synthetic world
+/// \return true if every thread count produced the same result as a single thread
+bool benchmarkJobSystem(GLuint numObjects);
+
+#endif //MP_JOB_SYSTEM_HPP
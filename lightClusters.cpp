@@ -0,0 +1,223 @@
+#include "lightClusters.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MP_LIGHT_CLUSTERS_SSE
+    #include <emmintrin.h>
+#endif
+
+/// \desc spheres tested per SSE instruction
+static constexpr GLuint LANES = 4;
+/// \desc position of the spheres padding a list, far enough that no box reaches them
+static constexpr GLfloat UNREACHABLE = 1.0e30f;
+
+//*************************************************************************************
+//
+// Sphere List
+
+void LightClusters::SphereList::clear() {
+    x.clear();
+    y.clear();
+    depth.clear();
+    radius.clear();
+    index.clear();
+}
+
+void LightClusters::SphereList::push(GLfloat sphereX, GLfloat sphereY, GLfloat sphereDepth, GLfloat sphereRadius, GLuint sphereIndex) {
+    x.push_back(sphereX);
+    y.push_back(sphereY);
+    depth.push_back(sphereDepth);
+    radius.push_back(sphereRadius);
+    index.push_back(sphereIndex);
+}
+
+void LightClusters::SphereList::pad() {
+    while(x.size() % LANES != 0) {
+        push(UNREACHABLE, UNREACHABLE, UNREACHABLE, 0.0f, 0);
+    }
+}
+
+GLuint LightClusters::SphereList::size() const {
+    return x.size();
+}
+
+//*************************************************************************************
+//
+// Light Clusters
+
+LightClusters::LightClusters() :
+    _projectionScaleX( 1.0f ),
+    _projectionScaleY( 1.0f ) {
+
+    glGenBuffers(1, &_lightBuffer);
+    glGenBuffers(1, &_clusterRangeBuffer);
+    glGenBuffers(1, &_lightIndexBuffer);
+    glGenTextures(1, &_lightTexture);
+    glGenTextures(1, &_clusterRangeTexture);
+    glGenTextures(1, &_lightIndexTexture);
+
+    // each texture views its buffer for good, only the buffer contents change
+    glBindTexture(GL_TEXTURE_BUFFER, _lightTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _lightBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, _clusterRangeTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, _clusterRangeBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, _lightIndexTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, _lightIndexBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    _clusterRanges.resize(NUM_CLUSTERS * 2, 0);
+}
+
+LightClusters::~LightClusters() {
+    glDeleteTextures(1, &_lightTexture);
+    glDeleteTextures(1, &_clusterRangeTexture);
+    glDeleteTextures(1, &_lightIndexTexture);
+    glDeleteBuffers(1, &_lightBuffer);
+    glDeleteBuffers(1, &_clusterRangeBuffer);
+    glDeleteBuffers(1, &_lightIndexBuffer);
+}
+
+void LightClusters::setLights(const std::vector<ClusterLight>& lights) {
+    _lights = lights;
+
+    // buffer textures may not be empty, so there is always room for one light
+    glBindBuffer(GL_TEXTURE_BUFFER, _lightBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(_lights.size(), (size_t)1) * sizeof(ClusterLight), _lights.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+ClusterUniforms LightClusters::build(const glm::mat4& viewMtx, const glm::mat4& projMtx, GLsizei viewportWidth, GLsizei viewportHeight) {
+    auto start = std::chrono::steady_clock::now();
+
+    // a symmetric perspective projection maps view x to x * scale / depth, and its third column
+    // holds the near and far planes the slices are spread between
+    _projectionScaleX = projMtx[0][0];
+    _projectionScaleY = projMtx[1][1];
+    const GLfloat NEAR_PLANE = projMtx[3][2] / (projMtx[2][2] - 1.0f);
+    const GLfloat FAR_PLANE = projMtx[3][2] / (projMtx[2][2] + 1.0f);
+    const GLfloat SLICE_SCALE = CLUSTERS_Z / logf(FAR_PLANE / NEAR_PLANE);
+
+    _viewLights.clear();
+    for(GLuint i = 0; i < _lights.size(); i++) {
+        glm::vec4 viewPosition = viewMtx * glm::vec4(_lights[i].position, 1.0f);
+        _viewLights.push(viewPosition.x, viewPosition.y, -viewPosition.z, _lights[i].radius, i);
+    }
+    _viewLights.pad();
+
+    _stats.lightIndices = 0;
+    _stats.maxLightsPerCluster = 0;
+    _lightIndices.clear();
+    std::fill(_clusterRanges.begin(), _clusterRanges.end(), 0);
+    for(GLuint z = 0; z < CLUSTERS_Z; z++) {
+        const GLfloat NEAR_DEPTH = NEAR_PLANE * powf(FAR_PLANE / NEAR_PLANE, (GLfloat)z / CLUSTERS_Z);
+        const GLfloat FAR_DEPTH = NEAR_PLANE * powf(FAR_PLANE / NEAR_PLANE, (GLfloat)(z + 1) / CLUSTERS_Z);
+
+        // narrow the lights down a slice, then a row, at a time so most tiles test only a few
+        if(_gatherOverlapping(_viewLights, _makeBox(0, CLUSTERS_X, 0, CLUSTERS_Y, NEAR_DEPTH, FAR_DEPTH), _sliceLights) == 0) continue;
+        for(GLuint y = 0; y < CLUSTERS_Y; y++) {
+            if(_gatherOverlapping(_sliceLights, _makeBox(0, CLUSTERS_X, y, y + 1, NEAR_DEPTH, FAR_DEPTH), _rowLights) == 0) continue;
+            for(GLuint x = 0; x < CLUSTERS_X; x++) {
+                GLuint numLights = _gatherOverlapping(_rowLights, _makeBox(x, x + 1, y, y + 1, NEAR_DEPTH, FAR_DEPTH), _tileLights);
+
+                const GLuint CLUSTER = (z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+                _clusterRanges[CLUSTER * 2] = _lightIndices.size();
+                _clusterRanges[CLUSTER * 2 + 1] = numLights;
+                _lightIndices.insert(_lightIndices.end(), _tileLights.index.begin(), _tileLights.index.begin() + numLights);
+                _stats.maxLightsPerCluster = std::max(_stats.maxLightsPerCluster, numLights);
+            }
+        }
+    }
+    _stats.lights = _lights.size();
+    _stats.lightIndices = _lightIndices.size();
+
+    glBindBuffer(GL_TEXTURE_BUFFER, _clusterRangeBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, _clusterRanges.size() * sizeof(GLuint), _clusterRanges.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, _lightIndexBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(_lightIndices.size(), (size_t)1) * sizeof(GLuint), _lightIndices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    std::chrono::duration<GLdouble, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    _stats.buildMilliseconds = elapsed.count();
+
+    ClusterUniforms clusterUniforms = {};
+    clusterUniforms.clusterScale = glm::vec2( (GLfloat)CLUSTERS_X / std::max(viewportWidth, 1), (GLfloat)CLUSTERS_Y / std::max(viewportHeight, 1) );
+    clusterUniforms.sliceScale = SLICE_SCALE;
+    clusterUniforms.sliceBias = -logf(NEAR_PLANE) * SLICE_SCALE;
+    clusterUniforms.numLights = _lights.size();
+    return clusterUniforms;
+}
+
+void LightClusters::bind(GLint firstTextureUnit) const {
+    glActiveTexture(GL_TEXTURE0 + firstTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, _lightTexture);
+    glActiveTexture(GL_TEXTURE0 + firstTextureUnit + 1);
+    glBindTexture(GL_TEXTURE_BUFFER, _clusterRangeTexture);
+    glActiveTexture(GL_TEXTURE0 + firstTextureUnit + 2);
+    glBindTexture(GL_TEXTURE_BUFFER, _lightIndexTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+const LightClusters::Stats& LightClusters::getStats() const {
+    return _stats;
+}
+
+LightClusters::ClusterBox LightClusters::_makeBox(GLuint minX, GLuint maxX, GLuint minY, GLuint maxY, GLfloat nearDepth, GLfloat farDepth) const {
+    // tile edges in normalized device coordinates, widening linearly with depth
+    const GLfloat LEFT = -1.0f + 2.0f * minX / CLUSTERS_X;
+    const GLfloat RIGHT = -1.0f + 2.0f * maxX / CLUSTERS_X;
+    const GLfloat BOTTOM = -1.0f + 2.0f * minY / CLUSTERS_Y;
+    const GLfloat TOP = -1.0f + 2.0f * maxY / CLUSTERS_Y;
+
+    // the projection may mirror an axis, so take whichever corner ends up lowest
+    const GLfloat X[4] = { LEFT * nearDepth / _projectionScaleX, LEFT * farDepth / _projectionScaleX,
+                           RIGHT * nearDepth / _projectionScaleX, RIGHT * farDepth / _projectionScaleX };
+    const GLfloat Y[4] = { BOTTOM * nearDepth / _projectionScaleY, BOTTOM * farDepth / _projectionScaleY,
+                           TOP * nearDepth / _projectionScaleY, TOP * farDepth / _projectionScaleY };
+    ClusterBox box;
+    box.min = glm::vec3( *std::min_element(X, X + 4), *std::min_element(Y, Y + 4), nearDepth );
+    box.max = glm::vec3( *std::max_element(X, X + 4), *std::max_element(Y, Y + 4), farDepth );
+    return box;
+}
+
+GLuint LightClusters::_gatherOverlapping(const SphereList& spheres, const ClusterBox& box, SphereList& overlapping) {
+    overlapping.clear();
+#ifdef MP_LIGHT_CLUSTERS_SSE
+    const __m128 ZERO = _mm_setzero_ps();
+    const __m128 MIN_X = _mm_set1_ps(box.min.x), MAX_X = _mm_set1_ps(box.max.x);
+    const __m128 MIN_Y = _mm_set1_ps(box.min.y), MAX_Y = _mm_set1_ps(box.max.y);
+    const __m128 MIN_DEPTH = _mm_set1_ps(box.min.z), MAX_DEPTH = _mm_set1_ps(box.max.z);
+    for(GLuint i = 0; i < spheres.size(); i += LANES) {
+        // squared distance from each center to the box, zero along axes the center lies within
+        __m128 x = _mm_loadu_ps(&spheres.x[i]);
+        __m128 y = _mm_loadu_ps(&spheres.y[i]);
+        __m128 depth = _mm_loadu_ps(&spheres.depth[i]);
+        __m128 radius = _mm_loadu_ps(&spheres.radius[i]);
+        __m128 dx = _mm_max_ps( _mm_max_ps(_mm_sub_ps(MIN_X, x), _mm_sub_ps(x, MAX_X)), ZERO );
+        __m128 dy = _mm_max_ps( _mm_max_ps(_mm_sub_ps(MIN_Y, y), _mm_sub_ps(y, MAX_Y)), ZERO );
+        __m128 dz = _mm_max_ps( _mm_max_ps(_mm_sub_ps(MIN_DEPTH, depth), _mm_sub_ps(depth, MAX_DEPTH)), ZERO );
+        __m128 distanceSquared = _mm_add_ps( _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz) );
+        GLint mask = _mm_movemask_ps( _mm_cmple_ps(distanceSquared, _mm_mul_ps(radius, radius)) );
+        for(GLuint lane = 0; mask != 0; lane++, mask >>= 1) {
+            if(mask & 1) {
+                overlapping.push(spheres.x[i + lane], spheres.y[i + lane], spheres.depth[i + lane], spheres.radius[i + lane], spheres.index[i + lane]);
+            }
+        }
+    }
+#else
+    for(GLuint i = 0; i < spheres.size(); i++) {
+        GLfloat dx = std::max( std::max(box.min.x - spheres.x[i], spheres.x[i] - box.max.x), 0.0f );
+        GLfloat dy = std::max( std::max(box.min.y - spheres.y[i], spheres.y[i] - box.max.y), 0.0f );
+        GLfloat dz = std::max( std::max(box.min.z - spheres.depth[i], spheres.depth[i] - box.max.z), 0.0f );
+        if(dx * dx + dy * dy + dz * dz <= spheres.radius[i] * spheres.radius[i]) {
+            overlapping.push(spheres.x[i], spheres.y[i], spheres.depth[i], spheres.radius[i], spheres.index[i]);
+        }
+    }
+#endif
+    // the padding trails the spheres gathered
+    GLuint numOverlapping = overlapping.size();
+    overlapping.pad();
+    return numOverlapping;
+}
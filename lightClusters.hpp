@@ -0,0 +1,120 @@
+#ifndef MP_LIGHT_CLUSTERS_HPP
+#define MP_LIGHT_CLUSTERS_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "uniformBuffers.hpp"
+
+#include <vector>
+
+/// \desc a point light with a finite reach, as laid out in the light buffer texture
+struct ClusterLight {
+    /// \desc world space position of the light
+    glm::vec3 position;
+    /// \desc distance at which the light's contribution fades to nothing
+    GLfloat radius;
+    glm::vec3 color;
+    GLfloat padding;
+};
+
+/// \desc splits a view's frustum into a grid of clusters, tiles across the screen by slices
+/// spaced exponentially in depth, and lists the lights whose sphere reaches each one.  the
+/// lights are tested a slice at a time, then a row of tiles at a time, then tile by tile,
+/// four lights per SSE instruction.  the lights and the lists are read by clusteredLights.f.glsl
+/// from buffer textures, so each fragment only loops over the lights of its own cluster
+class LightClusters {
+public:
+    /// \desc clusters across, down and into the screen, must match clusteredLights.f.glsl
+    static constexpr GLuint CLUSTERS_X = 16;
+    static constexpr GLuint CLUSTERS_Y = 9;
+    static constexpr GLuint CLUSTERS_Z = 24;
+    static constexpr GLuint NUM_CLUSTERS = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+    /// \desc results of the last build()
+    struct Stats {
+        GLuint lights = 0;
+        /// \desc entries in the light index list, summed over every cluster
+        GLuint lightIndices = 0;
+        GLuint maxLightsPerCluster = 0;
+        GLdouble buildMilliseconds = 0.0;
+    };
+
+    LightClusters();
+    ~LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    /// \desc replaces the lights and uploads them
+    /// \param lights world space lights
+    void setLights(const std::vector<ClusterLight>& lights);
+
+    /// \desc assigns the lights to the clusters of a view and uploads the lists
+    /// \param viewMtx camera view matrix
+    /// \param projMtx symmetric perspective projection of the camera
+    /// \param viewportWidth pixels across the view
+    /// \param viewportHeight pixels down the view
+    /// \return constants the view's fragments find their cluster with
+    ClusterUniforms build(const glm::mat4& viewMtx, const glm::mat4& projMtx, GLsizei viewportWidth, GLsizei viewportHeight);
+
+    /// \desc binds the lights, the cluster ranges and the light index list to consecutive texture units
+    /// \param firstTextureUnit unit of the lights sampler, the other two follow
+    void bind(GLint firstTextureUnit) const;
+
+    const Stats& getStats() const;
+
+private:
+    /// \desc view space spheres in structure of arrays form, padded to a multiple of four
+    struct SphereList {
+        std::vector<GLfloat> x;
+        std::vector<GLfloat> y;
+        /// \desc distance in front of the camera, positive
+        std::vector<GLfloat> depth;
+        std::vector<GLfloat> radius;
+        std::vector<GLuint> index;
+
+        void clear();
+        void push(GLfloat x, GLfloat y, GLfloat depth, GLfloat radius, GLuint index);
+        /// \desc appends spheres no box can reach until the size is a multiple of four
+        void pad();
+        GLuint size() const;
+    };
+    /// \desc view space box, depth positive in front of the camera
+    struct ClusterBox {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    /// \desc copies the spheres of a list that touch a box into another, then pads it
+    /// \return number of spheres copied, not counting the padding
+    static GLuint _gatherOverlapping(const SphereList& spheres, const ClusterBox& box, SphereList& overlapping);
+    /// \desc box around the tiles [minX, maxX) x [minY, maxY) between two depths
+    ClusterBox _makeBox(GLuint minX, GLuint maxX, GLuint minY, GLuint maxY, GLfloat nearDepth, GLfloat farDepth) const;
+
+    std::vector<ClusterLight> _lights;
+    /// \desc projection terms the boxes are derived from
+    GLfloat _projectionScaleX;
+    GLfloat _projectionScaleY;
+
+    /// \desc scratch lists reused every build
+    SphereList _viewLights;
+    SphereList _sliceLights;
+    SphereList _rowLights;
+    SphereList _tileLights;
+
+    /// \desc first entry in _lightIndices and number of lights of every cluster
+    std::vector<GLuint> _clusterRanges;
+    std::vector<GLuint> _lightIndices;
+    Stats _stats;
+
+    GLuint _lightBuffer;
+    GLuint _lightTexture;
+    GLuint _clusterRangeBuffer;
+    GLuint _clusterRangeTexture;
+    GLuint _lightIndexBuffer;
+    GLuint _lightIndexTexture;
+};
+
+#endif //MP_LIGHT_CLUSTERS_HPP
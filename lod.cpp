@@ -0,0 +1,167 @@
+#include "lod.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265
+#endif
+
+/// \desc levels stop once halving would leave fewer segments than this around the primitive
+static constexpr GLint MIN_LOD_SEGMENTS = 6;
+
+/// \desc largest distance between a circle and a polygon of the given number of segments inscribed in it
+static GLfloat chordError(GLfloat radius, GLint segments) {
+    return radius * (1.0f - cosf( M_PI / (GLfloat)segments ));
+}
+
+/// \desc length of the longest transformed axis, bounds how much a transformation stretches any distance
+static GLfloat maxAxisScale(const glm::mat4& modelMtx) {
+    return std::max( { glm::length(glm::vec3(modelMtx[0])),
+                       glm::length(glm::vec3(modelMtx[1])),
+                       glm::length(glm::vec3(modelMtx[2])) } );
+}
+
+LodView makeLodView(const glm::mat4& viewMtx, const glm::mat4& projMtx, GLfloat viewportHeight) {
+    LodView view;
+    view.eyePosition = glm::vec3( glm::inverse(viewMtx)[3] );
+    view.pixelsPerUnit = projMtx[1][1] * viewportHeight * 0.5f;
+    return view;
+}
+
+GLfloat computePixelsPerUnit(const std::vector<LodView>& views, const glm::mat4& modelMtx) {
+    // largest axis scale, so non-uniformly scaled parts are judged by their longest side
+    GLfloat scale = maxAxisScale(modelMtx);
+    glm::vec3 position = glm::vec3(modelMtx[3]);
+
+    GLfloat pixelsPerUnit = 0.0f;
+    for(const LodView& view : views) {
+        GLfloat distance = std::max( glm::length(position - view.eyePosition), 0.001f );
+        pixelsPerUnit = std::max( pixelsPerUnit, view.pixelsPerUnit * scale / distance );
+    }
+    return pixelsPerUnit;
+}
+
+LodMesh::LodMesh(const Mesh* mesh) {
+    addLevel(mesh, 0.0f);
+}
+
+void LodMesh::addLevel(const Mesh* mesh, GLfloat geometricError) {
+    _levels.push_back( { mesh, geometricError } );
+}
+
+GLuint LodMesh::selectLevel(GLfloat pixelsPerUnit, GLuint currentLevel) const {
+    GLuint level = std::min(currentLevel, (GLuint)_levels.size() - 1);
+
+    // refine right away when the current level is visibly wrong
+    while(level > 0 && _levels[level].geometricError * pixelsPerUnit > MAX_PIXEL_ERROR) {
+        level--;
+    }
+    // coarsen only once the next level is comfortably below the threshold
+    while(level + 1 < _levels.size() &&
+          _levels[level + 1].geometricError * pixelsPerUnit <= MAX_PIXEL_ERROR * (1.0f - HYSTERESIS)) {
+        level++;
+    }
+    return level;
+}
+
+GLuint LodMesh::getNumLevels() const {
+    return _levels.size();
+}
+
+const Mesh* LodMesh::getMesh(GLuint level) const {
+    return _levels[level].mesh;
+}
+
+GLfloat LodMesh::getGeometricError(GLuint level) const {
+    return _levels[level].geometricError;
+}
+
+LodMesh bakeLodMesh(MeshLibrary& meshLibrary, const std::string& name, const std::vector<BakePart>& parts) {
+    GLuint numLevels = 1;
+    for(const BakePart& part : parts) {
+        numLevels = std::max(numLevels, part.lodMesh.getNumLevels());
+    }
+
+    LodMesh lod;
+    std::vector<GLuint> previousPartLevels;
+    for(GLuint level = 0; level < numLevels; level++) {
+        // the target is the error of the part furthest from its true surface at this level
+        GLfloat target = 0.0f;
+        for(const BakePart& part : parts) {
+            GLuint partLevel = std::min(level, part.lodMesh.getNumLevels() - 1);
+            target = std::max( target, part.lodMesh.getGeometricError(partLevel) * maxAxisScale(part.modelMtx) );
+        }
+
+        // every part then drops to its coarsest level that still meets the target once scaled,
+        // so a small part such as a scaled down copy of the body is not carried at full detail
+        std::vector<GLuint> partLevels;
+        GLfloat error = 0.0f;
+        for(const BakePart& part : parts) {
+            const GLfloat SCALE = maxAxisScale(part.modelMtx);
+            GLuint partLevel = 0;
+            while(partLevel + 1 < part.lodMesh.getNumLevels() &&
+                  part.lodMesh.getGeometricError(partLevel + 1) * SCALE <= target) {
+                partLevel++;
+            }
+            partLevels.push_back(partLevel);
+            error = std::max( error, part.lodMesh.getGeometricError(partLevel) * SCALE );
+        }
+        // a level that picks what the one before it did would only duplicate its mesh
+        if(partLevels == previousPartLevels) continue;
+        previousPartLevels = partLevels;
+
+        std::string levelName = name + "#lod" + std::to_string(lod.getNumLevels());
+        const Mesh* mesh = meshLibrary.findMesh(levelName);
+        if(mesh == nullptr) {
+            MeshData data;
+            for(size_t i = 0; i < parts.size(); i++) {
+                appendMeshData(data, parts[i].lodMesh.getMesh(partLevels[i])->getData(), parts[i].modelMtx, parts[i].color);
+            }
+            mesh = meshLibrary.addMesh(levelName, data);
+        }
+        lod.addLevel(mesh, error);
+    }
+    return lod;
+}
+
+LodMesh makeSphereLod(MeshLibrary& meshLibrary, GLfloat radius, GLint stacks, GLint slices) {
+    LodMesh lod;
+    while(true) {
+        // a stack spans half the angle a slice does
+        GLfloat error = std::max( chordError(radius, slices), chordError(radius, stacks * 2) );
+        lod.addLevel( meshLibrary.getSphere(radius, stacks, slices), error );
+        if(slices / 2 < MIN_LOD_SEGMENTS) break;
+        slices /= 2;
+        stacks = std::max(stacks / 2, MIN_LOD_SEGMENTS / 2);
+    }
+    return lod;
+}
+
+LodMesh makeCylinderLod(MeshLibrary& meshLibrary, GLfloat base, GLfloat top, GLfloat height, GLint stacks, GLint slices) {
+    LodMesh lod;
+    while(true) {
+        // the walls are straight, so only the slices deviate from the true surface
+        lod.addLevel( meshLibrary.getCylinder(base, top, height, stacks, slices), chordError(std::max(base, top), slices) );
+        if(slices / 2 < MIN_LOD_SEGMENTS) break;
+        slices /= 2;
+        stacks = std::max(stacks / 2, 1);
+    }
+    return lod;
+}
+
+LodMesh makeTorusLod(MeshLibrary& meshLibrary, GLfloat innerRadius, GLfloat outerRadius, GLint sides, GLint rings) {
+    LodMesh lod;
+    while(true) {
+        GLfloat error = std::max( chordError(innerRadius, sides), chordError(outerRadius + innerRadius, rings) );
+        lod.addLevel( meshLibrary.getTorus(innerRadius, outerRadius, sides, rings), error );
+        // the tube and the ring are halved independently, so a coarse tube does not pin a finely
+        // divided ring to one level.  the tube is small enough to get away with a triangle
+        bool canHalveSides = sides / 2 >= MIN_LOD_SEGMENTS / 2;
+        bool canHalveRings = rings / 2 >= MIN_LOD_SEGMENTS;
+        if(!canHalveSides && !canHalveRings) break;
+        if(canHalveSides) sides /= 2;
+        if(canHalveRings) rings /= 2;
+    }
+    return lod;
+}
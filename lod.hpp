@@ -0,0 +1,100 @@
+#ifndef MP_LOD_HPP
+#define MP_LOD_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+
+#include <string>
+#include <vector>
+
+/// \desc camera a level of detail is chosen for
+struct LodView {
+    /// \desc position of the camera in world space
+    glm::vec3 eyePosition;
+    /// \desc pixels covered by one world unit seen from a distance of one unit
+    GLfloat pixelsPerUnit;
+};
+
+/// \desc describes a camera for level of detail selection
+/// \param viewMtx camera view matrix
+/// \param projMtx camera projection matrix
+/// \param viewportHeight height in pixels of the viewport the camera draws into
+LodView makeLodView(const glm::mat4& viewMtx, const glm::mat4& projMtx, GLfloat viewportHeight);
+
+/// \desc finest pixel density any of the views sees an object with
+/// \param views cameras the object is drawn from
+/// \param modelMtx model transformation matrix of the object
+/// \return pixels per object space unit, 0 if there are no views
+GLfloat computePixelsPerUnit(const std::vector<LodView>& views, const glm::mat4& modelMtx);
+
+/// \desc the same primitive tessellated several times, finest level first
+class LodMesh {
+public:
+    /// \desc a single tessellation of the primitive
+    struct Level {
+        const Mesh* mesh;
+        /// \desc largest object space distance between the tessellation and the true surface
+        GLfloat geometricError;
+    };
+
+    LodMesh() = default;
+    /// \desc wraps a single mesh that is always exact
+    explicit LodMesh(const Mesh* mesh);
+
+    /// \desc appends a level, must be coarser than every level added before it
+    void addLevel(const Mesh* mesh, GLfloat geometricError);
+
+    /// \desc picks the coarsest level whose error stays under MAX_PIXEL_ERROR.  a part only
+    /// moves to a coarser level once it is HYSTERESIS below the threshold so it does not pop
+    /// back and forth while the camera hovers at a switching distance
+    /// \param pixelsPerUnit pixels covered by one object space unit, see computePixelsPerUnit()
+    /// \param currentLevel level the part was drawn with last frame
+    GLuint selectLevel(GLfloat pixelsPerUnit, GLuint currentLevel) const;
+
+    GLuint getNumLevels() const;
+    const Mesh* getMesh(GLuint level) const;
+    GLfloat getGeometricError(GLuint level) const;
+
+    /// \desc largest allowed on screen deviation from the true surface, in pixels
+    static constexpr GLfloat MAX_PIXEL_ERROR = 0.5f;
+    /// \desc fraction below the threshold a coarser level must reach before switching to it
+    static constexpr GLfloat HYSTERESIS = 0.25f;
+
+private:
+    std::vector<Level> _levels;
+};
+
+/// \desc a rigid part of a character placed relative to the character's origin
+struct BakePart {
+    LodMesh lodMesh;
+    glm::mat4 modelMtx;
+    glm::vec3 color;
+};
+
+/// \desc flattens rigid parts into one lod chain whose meshes carry the part colors per vertex.
+/// level i of the result allows the largest error any part has at its own level i, scaled by the
+/// part's transformation, and combines per part the coarsest level whose scaled error stays within it.
+/// the meshes are stored in the library under the name so every copy of a character shares them
+/// \param meshLibrary library the baked meshes are stored in
+/// \param name unique name of the baked character
+/// \param parts parts to combine
+LodMesh bakeLodMesh(MeshLibrary& meshLibrary, const std::string& name, const std::vector<BakePart>& parts);
+
+/// \desc builds a sphere lod chain from the given tessellation down, halving it per level
+/// \param meshLibrary library the levels are created in
+/// \note remaining parameters match generateSphereData() and describe the finest level
+LodMesh makeSphereLod(MeshLibrary& meshLibrary, GLfloat radius, GLint stacks, GLint slices);
+/// \desc builds a cylinder lod chain from the given tessellation down, halving it per level
+/// \param meshLibrary library the levels are created in
+/// \note remaining parameters match generateCylinderData() and describe the finest level
+LodMesh makeCylinderLod(MeshLibrary& meshLibrary, GLfloat base, GLfloat top, GLfloat height, GLint stacks, GLint slices);
+/// \desc builds a torus lod chain from the given tessellation down, halving the sides and rings
+/// per level as long as each of them can be
+/// \param meshLibrary library the levels are created in
+/// \note remaining parameters match generateTorusData() and describe the finest level
+LodMesh makeTorusLod(MeshLibrary& meshLibrary, GLfloat innerRadius, GLfloat outerRadius, GLint sides, GLint rings);
+
+#endif //MP_LOD_HPP
@@ -12,6 +12,11 @@
  */
 
 #include "MPEngine.hpp"
+#include "jobSystem.hpp"
+#include "transformBatch.hpp"
+
+#include <cstdlib>
+#include <cstring>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -19,15 +24,36 @@
 ///*****************************************************************************
 //
 // Our main function
-int main() {
+int main(int argc, char* argv[]) {
+
+    // checks the batched transform kernels against glm without opening a window
+    if(argc > 1 && strcmp(argv[1], "--bench-transforms") == 0) {
+        return benchmarkTransformBatch(10000) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // times a dense synthetic world built and culled on 1 to N threads without opening a window
+    if(argc > 1 && strcmp(argv[1], "--bench-jobs") == 0) {
+        return benchmarkJobSystem(500000) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // ticks the simulation as fast as it will go without drawing anything
+    const bool IS_HEADLESS = argc > 1 && strcmp(argv[1], "--headless") == 0;
+    GLuint headlessTicks = 100000;
+    if(IS_HEADLESS && argc > 2) {
+        headlessTicks = (GLuint)strtoul(argv[2], nullptr, 10);
+    }
 
-    auto mpEngine = new MPEngine();
+    bool isSuccess = true;
+    auto mpEngine = new MPEngine(IS_HEADLESS);
     mpEngine->initialize();
     if (mpEngine->getError() == CSCI441::OpenGLEngine::OPENGL_ENGINE_ERROR_NO_ERROR) {
-        mpEngine->run();
+        if(IS_HEADLESS) {
+            isSuccess = mpEngine->runHeadless(headlessTicks);
+        } else {
+            mpEngine->run();
+        }
     }
     mpEngine->shutdown();
     delete mpEngine;
 
-	return EXIT_SUCCESS;
+	return isSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
 }
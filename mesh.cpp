@@ -0,0 +1,344 @@
+#include "mesh.hpp"
+
+#include <CSCI441/ModelLoader.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+#ifndef M_PI
+#define M_PI 3.14159265
+#endif
+
+//*************************************************************************************
+//
+// Geometry Generation
+
+InstanceData makeInstanceData(const glm::mat4& modelMtx, const glm::vec3& color) {
+    InstanceData instance;
+    instance.modelMtx = modelMtx;
+    instance.normalMtx = glm::mat3( glm::transpose( glm::inverse( modelMtx ) ) );
+    instance.color = color;
+    return instance;
+}
+
+void appendMeshData(MeshData& target, const MeshData& source, const glm::mat4& modelMtx, const glm::vec3& color) {
+    const glm::mat3 normalMtx = glm::mat3( glm::transpose( glm::inverse( modelMtx ) ) );
+    const GLuint firstVertex = target.vertices.size();
+
+    target.vertices.reserve(target.vertices.size() + source.vertices.size());
+    for(const MeshVertex& vertex : source.vertices) {
+        MeshVertex transformed;
+        transformed.position = glm::vec3( modelMtx * glm::vec4(vertex.position, 1.0f) );
+        transformed.normal = glm::normalize( normalMtx * vertex.normal );
+        transformed.color = vertex.color * color;
+        target.vertices.push_back(transformed);
+    }
+    target.indices.reserve(target.indices.size() + source.indices.size());
+    for(GLuint index : source.indices) {
+        target.indices.push_back(firstVertex + index);
+    }
+}
+
+/// \desc stitches a (rows+1) x (columns+1) grid of vertices into triangles
+static void addGridIndices(MeshData& data, GLuint firstVertex, GLint rows, GLint columns) {
+    for(GLint row = 0; row < rows; row++) {
+        for(GLint column = 0; column < columns; column++) {
+            GLuint a = firstVertex + row * (columns + 1) + column;
+            GLuint b = a + columns + 1;
+            data.indices.insert(data.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+}
+
+MeshData generateCubeData(GLfloat size) {
+    const GLfloat h = size / 2.0f;
+    const glm::vec3 normals[6] = { {1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1} };
+
+    MeshData data;
+    for(const glm::vec3& normal : normals) {
+        // build two tangents for the face so the four corners wind counter-clockwise
+        glm::vec3 u = (normal.y != 0.0f) ? glm::vec3(1,0,0) : glm::vec3(0,1,0);
+        glm::vec3 v = glm::cross(normal, u);
+        GLuint first = data.vertices.size();
+        data.vertices.push_back( { (normal - u - v) * h, normal } );
+        data.vertices.push_back( { (normal + u - v) * h, normal } );
+        data.vertices.push_back( { (normal + u + v) * h, normal } );
+        data.vertices.push_back( { (normal - u + v) * h, normal } );
+        data.indices.insert(data.indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+    }
+    return data;
+}
+
+MeshData generateCylinderData(GLfloat base, GLfloat top, GLfloat height, GLint stacks, GLint slices) {
+    MeshData data;
+    // slope of the side wall, used to tilt the normals for cones and tapered cylinders
+    const GLfloat slope = (height != 0.0f) ? (base - top) / height : 0.0f;
+    for(GLint stack = 0; stack <= stacks; stack++) {
+        GLfloat t = (GLfloat)stack / (GLfloat)stacks;
+        GLfloat radius = base + (top - base) * t;
+        for(GLint slice = 0; slice <= slices; slice++) {
+            GLfloat theta = 2.0f * M_PI * (GLfloat)slice / (GLfloat)slices;
+            glm::vec3 position( radius * cosf(theta), height * t, radius * sinf(theta) );
+            glm::vec3 normal = glm::normalize( glm::vec3( cosf(theta), slope, sinf(theta) ) );
+            data.vertices.push_back( { position, normal } );
+        }
+    }
+    addGridIndices(data, 0, stacks, slices);
+    return data;
+}
+
+MeshData generateConeData(GLfloat base, GLfloat height, GLint stacks, GLint slices) {
+    return generateCylinderData(base, 0.0f, height, stacks, slices);
+}
+
+MeshData generateSphereData(GLfloat radius, GLint stacks, GLint slices) {
+    MeshData data;
+    for(GLint stack = 0; stack <= stacks; stack++) {
+        GLfloat phi = M_PI * (GLfloat)stack / (GLfloat)stacks;
+        for(GLint slice = 0; slice <= slices; slice++) {
+            GLfloat theta = 2.0f * M_PI * (GLfloat)slice / (GLfloat)slices;
+            glm::vec3 normal( sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta) );
+            data.vertices.push_back( { normal * radius, normal } );
+        }
+    }
+    addGridIndices(data, 0, stacks, slices);
+    return data;
+}
+
+MeshData generateTorusData(GLfloat innerRadius, GLfloat outerRadius, GLint sides, GLint rings) {
+    MeshData data;
+    for(GLint ring = 0; ring <= rings; ring++) {
+        GLfloat theta = 2.0f * M_PI * (GLfloat)ring / (GLfloat)rings;
+        glm::vec3 center( outerRadius * cosf(theta), outerRadius * sinf(theta), 0.0f );
+        for(GLint side = 0; side <= sides; side++) {
+            GLfloat phi = 2.0f * M_PI * (GLfloat)side / (GLfloat)sides;
+            glm::vec3 normal( cosf(phi) * cosf(theta), cosf(phi) * sinf(theta), sinf(phi) );
+            data.vertices.push_back( { center + normal * innerRadius, normal } );
+        }
+    }
+    addGridIndices(data, 0, rings, sides);
+    return data;
+}
+
+void setInstanceAttributes() {
+    // matrices are passed as consecutive column attributes
+    for(GLint column = 0; column < 4; column++) {
+        GLint location = Mesh::INSTANCE_MODEL_MTX_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(offsetof(InstanceData, modelMtx) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    for(GLint column = 0; column < 3; column++) {
+        GLint location = Mesh::INSTANCE_NORMAL_MTX_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(offsetof(InstanceData, normalMtx) + column * sizeof(glm::vec3)));
+        glVertexAttribDivisor(location, 1);
+    }
+    glEnableVertexAttribArray(Mesh::INSTANCE_COLOR_LOCATION);
+    glVertexAttribPointer(Mesh::INSTANCE_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                          (void*)offsetof(InstanceData, color));
+    glVertexAttribDivisor(Mesh::INSTANCE_COLOR_LOCATION, 1);
+    glEnableVertexAttribArray(Mesh::INSTANCE_BAKED_LIGHTING_LOCATION);
+    glVertexAttribPointer(Mesh::INSTANCE_BAKED_LIGHTING_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                          (void*)offsetof(InstanceData, bakedLightingOffset));
+    glVertexAttribDivisor(Mesh::INSTANCE_BAKED_LIGHTING_LOCATION, 1);
+}
+
+//*************************************************************************************
+//
+// Mesh
+
+GLuint Mesh::_nextId = 0;
+
+Mesh::Mesh(const MeshData& data, GLint vPosLocation, GLint vNormalLocation) : _data(data) {
+    _id = _nextId++;
+    _instanceVBO = 0;
+    _instanceCapacity = 0;
+    _numInstances = 0;
+    _numIndices = (GLsizei)data.indices.size();
+
+    glGenVertexArrays(1, &_vao);
+    glBindVertexArray(_vao);
+
+    glGenBuffers(1, &_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+    glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(MeshVertex), data.vertices.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(vPosLocation);
+    glVertexAttribPointer(vPosLocation, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+
+    glEnableVertexAttribArray(vNormalLocation);
+    glVertexAttribPointer(vNormalLocation, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+
+    glEnableVertexAttribArray(VERTEX_COLOR_LOCATION);
+    glVertexAttribPointer(VERTEX_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, color));
+
+    glGenBuffers(1, &_ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(GLuint), data.indices.data(), GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+}
+
+Mesh::~Mesh() {
+    glDeleteVertexArrays(1, &_vao);
+    glDeleteBuffers(1, &_vbo);
+    glDeleteBuffers(1, &_ibo);
+    if(_instanceVBO != 0) glDeleteBuffers(1, &_instanceVBO);
+}
+
+void Mesh::enableInstancing() {
+    if(_instanceVBO != 0) return;
+
+    glBindVertexArray(_vao);
+    glGenBuffers(1, &_instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+
+    setInstanceAttributes();
+
+    glBindVertexArray(0);
+}
+
+void Mesh::setInstances(const InstanceData* instances, GLsizei numInstances) {
+    _numInstances = numInstances;
+    if(numInstances == 0) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceVBO);
+    if(numInstances > _instanceCapacity) {
+        // grow the buffer, otherwise update in place to avoid reallocating
+        _instanceCapacity = numInstances;
+        glBufferData(GL_ARRAY_BUFFER, numInstances * sizeof(InstanceData), instances, GL_DYNAMIC_DRAW);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, numInstances * sizeof(InstanceData), instances);
+    }
+}
+
+void Mesh::draw(GLStateCache& stateCache) const {
+    stateCache.bindVertexArray(_vao);
+    glDrawElements(GL_TRIANGLES, _numIndices, GL_UNSIGNED_INT, (void*)0);
+}
+
+void Mesh::drawInstanced(GLStateCache& stateCache) const {
+    if(_numInstances == 0) return;
+    stateCache.bindVertexArray(_vao);
+    glDrawElementsInstanced(GL_TRIANGLES, _numIndices, GL_UNSIGNED_INT, (void*)0, _numInstances);
+}
+
+GLuint Mesh::getId() const {
+    return _id;
+}
+
+GLuint Mesh::getVAO() const {
+    return _vao;
+}
+
+GLsizei Mesh::getNumIndices() const {
+    return _numIndices;
+}
+
+GLsizei Mesh::getNumInstances() const {
+    return _numInstances;
+}
+
+const MeshData& Mesh::getData() const {
+    return _data;
+}
+
+//*************************************************************************************
+//
+// Mesh Library
+
+MeshLibrary::MeshLibrary(GLint vPosLocation, GLint vNormalLocation) {
+    _vPosLocation = vPosLocation;
+    _vNormalLocation = vNormalLocation;
+}
+
+MeshLibrary::~MeshLibrary() {
+    for(auto& entry : _meshes) {
+        delete entry.second;
+    }
+    for(auto& entry : _namedMeshes) {
+        delete entry.second;
+    }
+}
+
+const Mesh* MeshLibrary::getCube(GLfloat size) {
+    return _getMesh( Key(Shape::CUBE, size, 0.0f, 0.0f, 0, 0) );
+}
+
+const Mesh* MeshLibrary::getCylinder(GLfloat base, GLfloat top, GLfloat height, GLint stacks, GLint slices) {
+    return _getMesh( Key(Shape::CYLINDER, base, top, height, stacks, slices) );
+}
+
+const Mesh* MeshLibrary::getCone(GLfloat base, GLfloat height, GLint stacks, GLint slices) {
+    return _getMesh( Key(Shape::CYLINDER, base, 0.0f, height, stacks, slices) );
+}
+
+const Mesh* MeshLibrary::getSphere(GLfloat radius, GLint stacks, GLint slices) {
+    return _getMesh( Key(Shape::SPHERE, radius, 0.0f, 0.0f, stacks, slices) );
+}
+
+const Mesh* MeshLibrary::getTorus(GLfloat innerRadius, GLfloat outerRadius, GLint sides, GLint rings) {
+    return _getMesh( Key(Shape::TORUS, innerRadius, outerRadius, 0.0f, sides, rings) );
+}
+
+const Mesh* MeshLibrary::getModel(const std::string& filename) {
+    const Mesh* existing = findMesh(filename);
+    if(existing != nullptr) return existing;
+
+    CSCI441::ModelLoader::enableAutoGenerateNormals();
+    CSCI441::ModelLoader modelLoader;
+    modelLoader.loadModelFile( filename.c_str() );
+
+    // copy the loaded geometry into our own vertex layout so it draws like any other mesh
+    MeshData data;
+    const GLfloat* vertices = modelLoader.getVertices();
+    const GLfloat* normals = modelLoader.getNormals();
+    for(GLuint i = 0; i < modelLoader.getNumberOfVertices(); i++) {
+        data.vertices.push_back( { glm::vec3(vertices[i*3], vertices[i*3 + 1], vertices[i*3 + 2]),
+                                   glm::vec3(normals[i*3], normals[i*3 + 1], normals[i*3 + 2]) } );
+    }
+    const GLuint* indices = modelLoader.getIndices();
+    data.indices.assign(indices, indices + modelLoader.getNumberOfIndices());
+
+    return addMesh(filename, data);
+}
+
+const Mesh* MeshLibrary::findMesh(const std::string& name) const {
+    auto existing = _namedMeshes.find(name);
+    return existing != _namedMeshes.end() ? existing->second : nullptr;
+}
+
+const Mesh* MeshLibrary::addMesh(const std::string& name, const MeshData& data) {
+    Mesh* mesh = new Mesh(data, _vPosLocation, _vNormalLocation);
+    delete _namedMeshes[name];
+    _namedMeshes[name] = mesh;
+    return mesh;
+}
+
+const Mesh* MeshLibrary::_getMesh(const Key& key) {
+    auto existing = _meshes.find(key);
+    if(existing != _meshes.end()) return existing->second;
+
+    MeshData data;
+    switch(std::get<0>(key)) {
+        case Shape::CUBE:
+            data = generateCubeData(std::get<1>(key));
+            break;
+        case Shape::CYLINDER:
+            data = generateCylinderData(std::get<1>(key), std::get<2>(key), std::get<3>(key), std::get<4>(key), std::get<5>(key));
+            break;
+        case Shape::SPHERE:
+            data = generateSphereData(std::get<1>(key), std::get<4>(key), std::get<5>(key));
+            break;
+        case Shape::TORUS:
+            data = generateTorusData(std::get<1>(key), std::get<2>(key), std::get<4>(key), std::get<5>(key));
+            break;
+    }
+
+    Mesh* mesh = new Mesh(data, _vPosLocation, _vNormalLocation);
+    _meshes[key] = mesh;
+    return mesh;
+}
@@ -0,0 +1,200 @@
+#ifndef MP_MESH_HPP
+#define MP_MESH_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "glStateCache.hpp"
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/// \desc a single vertex of a generated primitive
+struct MeshVertex {
+    /// \desc object space position of the vertex
+    glm::vec3 position;
+    /// \desc object space normal of the vertex
+    glm::vec3 normal;
+    /// \desc multiplied with the material color, lets one mesh carry several colored parts
+    glm::vec3 color = glm::vec3(1.0f);
+};
+
+/// \desc CPU-side copy of a primitive's geometry.  kept around after upload so the
+/// geometry can be inspected or combined with other meshes later on
+struct MeshData {
+    std::vector<MeshVertex> vertices;
+    std::vector<GLuint> indices;
+};
+
+/// \desc per-instance attributes read by the INSTANCING permutations of lab05.v.glsl
+struct InstanceData {
+    /// \desc transformations to position and size the instance
+    glm::mat4 modelMtx;
+    /// \desc precomputed normal matrix for the instance
+    glm::mat3 normalMtx;
+    /// \desc color to draw the instance
+    glm::vec3 color;
+    /// \desc first of the instance's lit vertex colors in the static lighting bake, -1 if it is lit
+    /// every frame.  a float to keep the attribute plain
+    GLfloat bakedLightingOffset = -1.0f;
+};
+
+/// \desc appends a transformed and colored copy of one mesh's geometry to another, used to
+/// bake parts that never move relative to each other into a single mesh
+/// \param target geometry to append to
+/// \param source geometry to copy
+/// \param modelMtx transformation to apply to the copied positions and normals
+/// \param color color to paint the copied vertices
+void appendMeshData(MeshData& target, const MeshData& source, const glm::mat4& modelMtx, const glm::vec3& color);
+
+/// \desc builds the instance attributes for a single object, precomputing its normal matrix
+/// \param modelMtx transformations to position and size the instance
+/// \param color color to draw the instance
+InstanceData makeInstanceData(const glm::mat4& modelMtx, const glm::vec3& color);
+
+/// \desc points the per-instance attributes of the bound VAO at the InstanceData in the bound
+/// GL_ARRAY_BUFFER, one instance per entry
+void setInstanceAttributes();
+
+/// \desc generates a cube centered at the origin
+/// \param size length of each edge
+MeshData generateCubeData(GLfloat size);
+/// \desc generates an open cylinder whose base sits at the origin and extends up +Y
+/// \param base radius at the base
+/// \param top radius at the top
+/// \param height distance along +Y from base to top
+/// \param stacks number of subdivisions along the height
+/// \param slices number of subdivisions around the circumference
+MeshData generateCylinderData(GLfloat base, GLfloat top, GLfloat height, GLint stacks, GLint slices);
+/// \desc generates an open cone whose base sits at the origin and apex points up +Y
+/// \param base radius at the base
+/// \param height distance along +Y from base to apex
+/// \param stacks number of subdivisions along the height
+/// \param slices number of subdivisions around the circumference
+MeshData generateConeData(GLfloat base, GLfloat height, GLint stacks, GLint slices);
+/// \desc generates a sphere centered at the origin
+/// \param radius radius of the sphere
+/// \param stacks number of subdivisions from pole to pole
+/// \param slices number of subdivisions around the equator
+MeshData generateSphereData(GLfloat radius, GLint stacks, GLint slices);
+/// \desc generates a torus centered at the origin lying in the XY plane
+/// \param innerRadius radius of the tube
+/// \param outerRadius distance from the center to the middle of the tube
+/// \param sides number of subdivisions around the tube
+/// \param rings number of subdivisions around the center
+MeshData generateTorusData(GLfloat innerRadius, GLfloat outerRadius, GLint sides, GLint rings);
+
+/// \desc GPU resident primitive that can be drawn once or many times in a single instanced call
+class Mesh {
+public:
+    /// \desc uploads the given geometry into its own VAO
+    /// \param data geometry to upload
+    /// \param vPosLocation attribute location of the vertex position
+    /// \param vNormalLocation attribute location of the vertex normal
+    Mesh(const MeshData& data, GLint vPosLocation, GLint vNormalLocation);
+    ~Mesh();
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    /// \desc creates the per-instance attribute buffer and attaches it to the VAO
+    void enableInstancing();
+    /// \desc replaces the per-instance attributes used by drawInstanced()
+    /// \param instances list of instances to draw
+    /// \param numInstances number of entries in instances
+    void setInstances(const InstanceData* instances, GLsizei numInstances);
+
+    /// \desc draws the mesh once using the currently set uniforms
+    /// \param stateCache cache the VAO bind is routed through
+    void draw(GLStateCache& stateCache) const;
+    /// \desc draws every instance set by setInstances() in a single call
+    /// \param stateCache cache the VAO bind is routed through
+    void drawInstanced(GLStateCache& stateCache) const;
+
+    /// \desc unique number identifying this mesh, used to group draws of the same mesh
+    GLuint getId() const;
+    GLuint getVAO() const;
+    GLsizei getNumIndices() const;
+    GLsizei getNumInstances() const;
+    const MeshData& getData() const;
+
+    /// \desc attribute location of the per-vertex color, must match lab05.v.glsl
+    static constexpr GLint VERTEX_COLOR_LOCATION = 2;
+    /// \desc attribute locations of the per-instance data, must match lab05.v.glsl
+    static constexpr GLint INSTANCE_MODEL_MTX_LOCATION = 3;
+    static constexpr GLint INSTANCE_NORMAL_MTX_LOCATION = 7;
+    static constexpr GLint INSTANCE_COLOR_LOCATION = 10;
+    /// \desc attribute location of the per-instance baked lighting offset, must match lab05.v.glsl
+    static constexpr GLint INSTANCE_BAKED_LIGHTING_LOCATION = 11;
+
+private:
+    /// \desc id handed to the next mesh created
+    static GLuint _nextId;
+
+    GLuint _id;
+    GLuint _vao;
+    GLuint _vbo;
+    GLuint _ibo;
+    /// \desc per-instance attribute buffer, 0 until enableInstancing() is called
+    GLuint _instanceVBO;
+    /// \desc number of instances the instance buffer can currently hold
+    GLsizei _instanceCapacity;
+    GLsizei _numInstances;
+    GLsizei _numIndices;
+
+    MeshData _data;
+};
+
+/// \desc creates primitive meshes on first request and shares them between everyone who
+/// asks for the same shape, so a mesh and its VAO exist once no matter how often it is drawn
+class MeshLibrary {
+public:
+    /// \param vPosLocation attribute location of the vertex position
+    /// \param vNormalLocation attribute location of the vertex normal
+    MeshLibrary(GLint vPosLocation, GLint vNormalLocation);
+    ~MeshLibrary();
+
+    MeshLibrary(const MeshLibrary&) = delete;
+    MeshLibrary& operator=(const MeshLibrary&) = delete;
+
+    /// \desc parameters match generateCubeData()
+    const Mesh* getCube(GLfloat size);
+    /// \desc parameters match generateCylinderData()
+    const Mesh* getCylinder(GLfloat base, GLfloat top, GLfloat height, GLint stacks, GLint slices);
+    /// \desc parameters match generateConeData()
+    const Mesh* getCone(GLfloat base, GLfloat height, GLint stacks, GLint slices);
+    /// \desc parameters match generateSphereData()
+    const Mesh* getSphere(GLfloat radius, GLint stacks, GLint slices);
+    /// \desc parameters match generateTorusData()
+    const Mesh* getTorus(GLfloat innerRadius, GLfloat outerRadius, GLint sides, GLint rings);
+    /// \desc loads a model file through CSCI441::ModelLoader and converts it into a Mesh
+    /// \param filename path of the model file
+    const Mesh* getModel(const std::string& filename);
+
+    /// \desc looks up a mesh previously stored with addMesh()
+    /// \return the mesh, or nullptr if no mesh has that name
+    const Mesh* findMesh(const std::string& name) const;
+    /// \desc uploads geometry built by the caller and shares it under a name
+    /// \param name name to find the mesh by later
+    /// \param data geometry to upload
+    const Mesh* addMesh(const std::string& name, const MeshData& data);
+
+private:
+    enum class Shape { CUBE, CYLINDER, SPHERE, TORUS };
+    /// \desc shape plus up to three size and two tessellation parameters
+    typedef std::tuple<Shape, GLfloat, GLfloat, GLfloat, GLint, GLint> Key;
+
+    /// \desc looks up a mesh, generating and uploading it if this is the first request
+    const Mesh* _getMesh(const Key& key);
+
+    GLint _vPosLocation;
+    GLint _vNormalLocation;
+    std::map<Key, Mesh*> _meshes;
+    /// \desc loaded models and meshes added by name
+    std::map<std::string, Mesh*> _namedMeshes;
+};
+
+#endif //MP_MESH_HPP
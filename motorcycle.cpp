@@ -8,17 +8,13 @@
 #include <CSCI441/objects.hpp>
 #include <CSCI441/OpenGLUtils.hpp>
 
+#include <cstdio>
+
 //constructor
-Motorcycle::Motorcycle(GLuint shaderProgramHandle, GLint mvpMtxUniformLocation, GLint normalMtxUniformLocation,GLint materialColorUniformLocation, GLint modelMtxUniformLocation) {
+Motorcycle::Motorcycle(MeshLibrary* meshLibrary, TransformHierarchy* transforms) {
 
         _wheelAngle = 0.0f;
-        _wheelRotationSpeed = M_PI / 16.0f;
-
-        _shaderProgramHandle = shaderProgramHandle;
-        _shaderProgramUniformLocations.modelMtx = modelMtxUniformLocation;
-        _shaderProgramUniformLocations.mvpMtx = mvpMtxUniformLocation;
-        _shaderProgramUniformLocations.normalMtx = normalMtxUniformLocation;
-        _shaderProgramUniformLocations.materialColor = materialColorUniformLocation;
+        _wheelRotationSpeed = 60.0f * M_PI / 16.0f;
 
         _rotateMotorcycleAngle = 3 * M_PI / 2.0f;
 
@@ -26,89 +22,103 @@ Motorcycle::Motorcycle(GLuint shaderProgramHandle, GLint mvpMtxUniformLocation,
         _scaleBody = glm::vec3(5.0f, 0.5f, .5f);
         _transBody = glm::vec3(0.0, .12f, 0.0f);
 
-        _colorWheel = glm::vec3(0.0f, 1.0f, 1.0f);
         _scaleWheel = glm::vec3(1.0f,1.0f,1.0f);
         _transWheel = glm::vec3(0.45f, 0,0);
 
-        _movementSpeed = 0.25f;
+        // bake the body's placement and color into its own mesh
+        std::vector<BakePart> bodyParts = {
+                { LodMesh( meshLibrary->getCube( 0.2 ) ), glm::scale( glm::translate( glm::mat4(1.0f), _transBody ), _scaleBody ), _colorBody }
+        };
+        _bodyMesh = bakeLodMesh(*meshLibrary, "motorcycle", bodyParts).getMesh(0);
+        _wheelLod = makeTorusLod(*meshLibrary, .05,.08,20,10);
+        if(_wheelLod.getNumLevels() < 2) {
+            fprintf( stderr, "[ERROR]: motorcycle wheel has a single level of detail\n" );
+        }
+        _wheelLodLevels[0] = _wheelLodLevels[1] = 0;
+
+        _movementSpeed = 15.0f;
+        _turnSpeed = 60.0f * M_PI / 24.0f;
 
         _position = glm::vec3(0,0.1,0);
         _cameraOffset = glm::vec3(0, .5, 0);
 
+        // the wheels hang off the root, one either side of the body
+        _transforms = transforms;
+        _rootNode = _transforms->addNode();
+        for(GLuint i = 0; i < 2; i++) {
+            _wheelNodes[i] = _transforms->addNode(_rootNode);
+            _transforms->setTranslation(_wheelNodes[i], i == 0 ? _transWheel : -_transWheel);
+            _transforms->setScale(_wheelNodes[i], _scaleWheel);
+        }
+        _updateRootNode();
+        _updateWheelNodes();
+
 }
 
 //moves forward, rotates wheels and checks to bounds of grid
-void Motorcycle::driveForward() {
-    _wheelAngle -= _wheelRotationSpeed;
+void Motorcycle::driveForward(GLfloat deltaTime) {
+    _wheelAngle -= _wheelRotationSpeed * deltaTime;
     if(_wheelAngle > 2.0f * M_PI){
         _wheelAngle -= 2.0f * M_PI;
     }
-    _position.x += cos(-_rotateMotorcycleAngle) * _movementSpeed;
-    _position.z += sin(-_rotateMotorcycleAngle) * _movementSpeed;
+    _position.x += cos(-_rotateMotorcycleAngle) * _movementSpeed * deltaTime;
+    _position.z += sin(-_rotateMotorcycleAngle) * _movementSpeed * deltaTime;
+    _updateRootNode();
+    _updateWheelNodes();
 
 }
 
 //moves backward, rotates wheels and checks to bounds of grid
-void Motorcycle::driveBackward() {
-    _wheelAngle -= _wheelRotationSpeed;
+void Motorcycle::driveBackward(GLfloat deltaTime) {
+    _wheelAngle -= _wheelRotationSpeed * deltaTime;
     if(_wheelAngle < 0.0f){
         _wheelAngle += 2.0f * M_PI;
     }
-    _position.x -= cos(-_rotateMotorcycleAngle) * _movementSpeed;
-    _position.z -= sin(-_rotateMotorcycleAngle) * _movementSpeed;
-}
-
-//send matrix info to GPU
-void Motorcycle::_computeAndSendMatrixUniforms(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const {
-    glm::mat4 mvpMtx = projMtx * viewMtx * modelMtx;
-    glProgramUniformMatrix4fv( _shaderProgramHandle, _shaderProgramUniformLocations.mvpMtx, 1, GL_FALSE, &mvpMtx[0][0] );
-    glProgramUniformMatrix4fv( _shaderProgramHandle, _shaderProgramUniformLocations.modelMtx, 1, GL_FALSE, &modelMtx[0][0] );
-    glm::mat3 normalMtx = glm::mat3( glm::transpose( glm::inverse( modelMtx )));
-    glProgramUniformMatrix3fv( _shaderProgramHandle, _shaderProgramUniformLocations.normalMtx, 1, GL_FALSE, &normalMtx[0][0] );
+    _position.x -= cos(-_rotateMotorcycleAngle) * _movementSpeed * deltaTime;
+    _position.z -= sin(-_rotateMotorcycleAngle) * _movementSpeed * deltaTime;
+    _updateRootNode();
+    _updateWheelNodes();
 }
 
-//high level draw that calls separate parts
-void Motorcycle::drawMotorcycle(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) {
-    glUseProgram(_shaderProgramHandle);
-    modelMtx = glm::rotate( modelMtx, _rotateMotorcycleAngle, CSCI441::Y_AXIS );
-    _drawMotorcycleBody(modelMtx, viewMtx, projMtx);
-    _drawMotorcycleWheel(true, modelMtx, viewMtx, projMtx);
-    _drawMotorcycleWheel(false, modelMtx, viewMtx, projMtx);
+//high level draw that queues separate parts at their cached matrices
+void Motorcycle::drawMotorcycle(DrawList& drawList, const TransformHierarchy& transforms) {
+    drawList.submit(_bodyMesh, transforms.getWorldMatrix(_rootNode), glm::vec3(1.0f));
+    _drawMotorcycleWheel(true, drawList, transforms);
+    _drawMotorcycleWheel(false, drawList, transforms);
 
 }
 
-void Motorcycle::_drawMotorcycleBody(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const {
-    modelMtx = glm::translate(modelMtx, _transBody);
-    modelMtx = glm::scale( modelMtx, _scaleBody );
-    _computeAndSendMatrixUniforms(modelMtx, viewMtx, projMtx);
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorBody[0]);
-    CSCI441::drawSolidCube( 0.2 );
-}
-
-void Motorcycle::_drawMotorcycleWheel(bool isFrontWheel, glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) {
+void Motorcycle::_drawMotorcycleWheel(bool isFrontWheel, DrawList& drawList, const TransformHierarchy& transforms) {
+    // a local rather than a member, the motorcycle is recorded on a job system thread
+    glm::vec3 colorWheel;
     if(!isFrontWheel){
-        modelMtx = glm::translate(modelMtx,-_transWheel);
-        _colorWheel = glm::vec3(0.0f,1.0f,1.0f);
+        colorWheel = glm::vec3(0.0f,1.0f,1.0f);
     }
     else{
-        modelMtx = glm::translate(modelMtx, _transWheel);
-        _colorWheel = glm::vec3(1.0f,0.0f,0.0f);
+        colorWheel = glm::vec3(1.0f,0.0f,0.0f);
     }
-    modelMtx = glm::rotate(modelMtx, static_cast<GLfloat>(M_PI / 2.0f) + _wheelAngle, CSCI441::Z_AXIS );
-    modelMtx = glm::rotate(modelMtx,static_cast<GLfloat>(M_PI / 2.0f), CSCI441::Z_AXIS );
-    modelMtx = glm::scale(modelMtx, _scaleWheel);
+    GLuint wheel = isFrontWheel ? 0 : 1;
+    drawList.submitLod(_wheelLod, _wheelLodLevels[wheel], transforms.getWorldMatrix(_wheelNodes[wheel]), colorWheel);
+}
 
-    _computeAndSendMatrixUniforms(modelMtx, viewMtx, projMtx);
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &_colorWheel[0]);
+void Motorcycle::_updateRootNode() {
+    _transforms->setTranslation(_rootNode, _position);
+    _transforms->setRotation(_rootNode, _rotateMotorcycleAngle, CSCI441::Y_AXIS);
+}
 
-    CSCI441::drawSolidTorus(.05,.08,20,10);
+void Motorcycle::_updateWheelNodes() {
+    // the wheel's two quarter turns about Z combine into a half turn
+    for(GLuint wheelNode : _wheelNodes) {
+        _transforms->setRotation(wheelNode, static_cast<GLfloat>(M_PI) + _wheelAngle, CSCI441::Z_AXIS);
+    }
 }
 
 //rotates motorcycle
-void Motorcycle::rotate(GLfloat dTheta) {
-    _rotateMotorcycleAngle -=  dTheta * M_PI / 24.0f;
+void Motorcycle::rotate(GLfloat direction, GLfloat deltaTime) {
+    _rotateMotorcycleAngle -=  direction * _turnSpeed * deltaTime;
     if(_rotateMotorcycleAngle > 2 * M_PI) _rotateMotorcycleAngle -= 2 * M_PI;
     if(_rotateMotorcycleAngle < 0) _rotateMotorcycleAngle += 2 * M_PI;
+    _updateRootNode();
 }
 
 glm::vec3 Motorcycle::getPosition() {
@@ -129,6 +139,7 @@ void Motorcycle::_checkBounds(GLfloat WorldSize) {
     else if(_position.z < -WorldSize){
         _position.z = -WorldSize;
     }
+    _updateRootNode();
 }
 
 GLfloat Motorcycle::getAngle() {
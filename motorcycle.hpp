@@ -10,18 +10,25 @@
 
 #include <glm/glm.hpp>
 
+#include "mesh.hpp"
+#include "renderQueue.hpp"
+#include "transformHierarchy.hpp"
+
 class Motorcycle {
 public:
-    Motorcycle( GLuint shaderProgramHandle, GLint mvpMtxUniformLocation, GLint normalMtxUniformLocation, GLint materialColorUniformLocation, GLint modelMtxUniformLocation);
+    Motorcycle( MeshLibrary* meshLibrary, TransformHierarchy* transforms );
 
-    void drawMotorcycle(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx);
+    /// \desc queues the body and wheels at their world matrices in a hierarchy
+    /// \param transforms hierarchy of the same shape as the one passed to the constructor, e.g. a copy rendering places
+    void drawMotorcycle(DrawList& drawList, const TransformHierarchy& transforms);
 
-    //movement Methods
-    void driveForward();
+    //movement Methods, each advances the motorcycle by deltaTime seconds
+    void driveForward(GLfloat deltaTime);
 
-    void driveBackward();
+    void driveBackward(GLfloat deltaTime);
 
-    void rotate(GLfloat dTheta);
+    /// \param direction 1 to turn right, -1 to turn left
+    void rotate(GLfloat direction, GLfloat deltaTime);
 
     glm::vec3 getPosition();
     glm::vec3 getCameraOffset();
@@ -32,24 +39,18 @@ public:
 
 private:
     GLfloat _wheelAngle;
+    /// \desc radians per second the wheels spin while driving
     GLfloat _wheelRotationSpeed;
-    GLuint _shaderProgramHandle;
 
+    /// \desc units per second
     GLfloat _movementSpeed;
+    /// \desc radians per second
+    GLfloat _turnSpeed;
 
     glm::vec3 _position;
 
     glm::vec3 _cameraOffset;
 
-
-    //uniforms
-    struct ShaderProgramUniformLocations {
-        GLint mvpMtx;
-        GLint normalMtx;
-        GLint materialColor;
-        GLint modelMtx;
-    } _shaderProgramUniformLocations;
-
     //drawing info
     GLfloat _rotateMotorcycleAngle;
 
@@ -57,16 +58,28 @@ private:
     glm::vec3 _scaleBody;
     glm::vec3 _transBody;
 
-    glm::vec3 _colorWheel;
     glm::vec3 _scaleWheel;
     glm::vec3 _transWheel;
 
-    //draw methods
-    void _drawMotorcycleBody(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const;
+    /// \desc body with its size and color baked in, the wheels spin so stay separate
+    const Mesh* _bodyMesh;
+    LodMesh _wheelLod;
+    /// \desc level each wheel was last drawn with, front wheel first
+    GLuint _wheelLodLevels[2];
+
+    /// \desc hierarchy holding the motorcycle's part transforms
+    TransformHierarchy* _transforms;
+    /// \desc places the motorcycle in the world, the body is drawn here
+    GLuint _rootNode;
+    /// \desc front wheel first
+    GLuint _wheelNodes[2];
 
-    void _drawMotorcycleWheel(bool isFrontWheel, glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx );
+    //transform methods
+    void _updateRootNode();
+    void _updateWheelNodes();
 
-    void _computeAndSendMatrixUniforms(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const;
+    //draw methods
+    void _drawMotorcycleWheel(bool isFrontWheel, DrawList& drawList, const TransformHierarchy& transforms );
 
 
 
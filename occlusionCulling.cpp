@@ -0,0 +1,277 @@
+#include "occlusionCulling.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MP_OCCLUSION_SSE
+    #include <emmintrin.h>
+#endif
+
+/// \desc the rows of the depth buffer are processed this many pixels at a time
+static constexpr GLint LANES = 4;
+/// \desc most bands worth splitting such a small buffer into
+static constexpr GLuint MAX_BANDS = 8;
+/// \desc fewest objects worth testing as a job of their own
+static constexpr GLuint TEST_GRAIN_SIZE = 64;
+/// \desc smallest w a projected corner may have, anything closer is treated as crossing the near plane
+static constexpr GLfloat MIN_W = 1e-4f;
+/// \desc boxes covering fewer pixels than this hide too little to be worth rasterizing
+static constexpr GLint MIN_OCCLUDER_PIXELS = 16;
+
+/// \desc corner indices of the twelve triangles of a box, bit 0 selects max x, bit 1 max y and bit 2 max z.
+/// back faces are rasterized too, the nearest-wins depth test makes them harmless and skipping
+/// them would need a consistent winding the projected corners do not have
+static const GLuint BOX_TRIANGLES[12][3] = {
+        {0, 2, 6}, {0, 6, 4},       // -x
+        {1, 3, 7}, {1, 7, 5},       // +x
+        {0, 1, 5}, {0, 5, 4},       // -y
+        {2, 3, 7}, {2, 7, 6},       // +y
+        {0, 1, 3}, {0, 3, 2},       // -z
+        {4, 5, 7}, {4, 7, 6}        // +z
+};
+
+OcclusionCuller::OcclusionCuller(JobSystem* jobSystem, GLsizei width, GLsizei height) :
+    _jobSystem( jobSystem ),
+    _width( (std::max(width, LANES) + LANES - 1) / LANES * LANES ),
+    _height( std::max(height, 1) ),
+    _viewProjectionMtx( 1.0f ) {
+
+    _numBands = std::min( _jobSystem->getNumThreads(), std::min(MAX_BANDS, (GLuint)_height) );
+    _inverseW.resize( _width * _height, 0.0f );
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewProjectionMtx) {
+    _viewProjectionMtx = viewProjectionMtx;
+    std::fill( _inverseW.begin(), _inverseW.end(), 0.0f );
+    _occluders.clear();
+    _isOccluder.clear();
+    _stats = Stats();
+    _stats.numThreads = _jobSystem->getNumThreads();
+}
+
+void OcclusionCuller::renderOccluders(const std::vector<BoundingBox>& boxes, const std::vector<GLuint>& candidates) {
+    auto start = std::chrono::steady_clock::now();
+
+    // rank the candidates by how much of the screen they cover, ties broken by index so the
+    // choice never depends on the order they arrive in
+    _candidateBoxes.resize( candidates.size() );
+    _rankedCandidates.clear();
+    for(GLuint i = 0; i < candidates.size(); i++) {
+        ScreenBox& screenBox = _candidateBoxes[i];
+        if( !_projectBox(boxes[ candidates[i] ], screenBox) ) continue;
+        GLint pixels = (screenBox.maxX - screenBox.minX) * (screenBox.maxY - screenBox.minY);
+        if(pixels >= MIN_OCCLUDER_PIXELS) {
+            _rankedCandidates.emplace_back( (GLfloat)pixels, i );
+        }
+    }
+    auto isLarger = [&candidates](const std::pair<GLfloat, GLuint>& a, const std::pair<GLfloat, GLuint>& b) {
+        if(a.first != b.first) return a.first > b.first;
+        return candidates[a.second] < candidates[b.second];
+    };
+    size_t numOccluders = std::min( _rankedCandidates.size(), (size_t)MAX_OCCLUDERS );
+    std::partial_sort( _rankedCandidates.begin(), _rankedCandidates.begin() + numOccluders, _rankedCandidates.end(), isLarger );
+
+    _isOccluder.assign( boxes.size(), 0 );
+    for(size_t i = 0; i < numOccluders; i++) {
+        GLuint candidate = _rankedCandidates[i].second;
+        _occluders.push_back( _candidateBoxes[candidate] );
+        _isOccluder[ candidates[candidate] ] = 1;
+    }
+
+    // every band owns its rows outright, so the threads never write the same pixel
+    const GLuint NUM_BANDS = _numBands;
+    _jobSystem->parallelFor( NUM_BANDS, 1, [this, NUM_BANDS](GLuint bandBegin, GLuint bandEnd) {
+        for(GLuint band = bandBegin; band < bandEnd; band++) {
+            _rasterizeBand( _height * band / NUM_BANDS, _height * (band + 1) / NUM_BANDS );
+        }
+    } );
+
+    _stats.occluders += numOccluders;
+    std::chrono::duration<GLdouble, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    _stats.rasterizeMilliseconds += elapsed.count();
+}
+
+GLuint OcclusionCuller::cullOccluded(const std::vector<BoundingBox>& bounds, std::vector<GLuint>& objects, bool areOccluderCandidates) {
+    auto start = std::chrono::steady_clock::now();
+
+    // test in parallel, then compact on this thread so the survivors keep their order
+    const GLuint NUM_OBJECTS = objects.size();
+    _isVisible.resize( NUM_OBJECTS );
+    _jobSystem->parallelFor( NUM_OBJECTS, TEST_GRAIN_SIZE, [&](GLuint begin, GLuint end) {
+        for(GLuint i = begin; i < end; i++) {
+            GLuint object = objects[i];
+            if(areOccluderCandidates && object < _isOccluder.size() && _isOccluder[object]) {
+                _isVisible[i] = 1;
+                continue;
+            }
+            ScreenBox screenBox;
+            _isVisible[i] = !_projectBox(bounds[object], screenBox) || !_isOccluded(screenBox);
+        }
+    } );
+
+    GLuint numVisible = 0;
+    for(GLuint i = 0; i < NUM_OBJECTS; i++) {
+        if(_isVisible[i]) {
+            objects[numVisible++] = objects[i];
+        }
+    }
+    objects.resize(numVisible);
+
+    GLuint numOccluded = NUM_OBJECTS - numVisible;
+    _stats.testedObjects += NUM_OBJECTS;
+    _stats.occludedObjects += numOccluded;
+    std::chrono::duration<GLdouble, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    _stats.testMilliseconds += elapsed.count();
+    return numOccluded;
+}
+
+const OcclusionCuller::Stats& OcclusionCuller::getStats() const {
+    return _stats;
+}
+
+bool OcclusionCuller::_projectBox(const BoundingBox& box, ScreenBox& screenBox) const {
+    glm::vec2 windowMin( (GLfloat)_width, (GLfloat)_height );
+    glm::vec2 windowMax( 0.0f );
+    screenBox.nearestInverseW = 0.0f;
+    for(GLint corner = 0; corner < 8; corner++) {
+        glm::vec4 point( (corner & 1) ? box.max.x : box.min.x,
+                         (corner & 2) ? box.max.y : box.min.y,
+                         (corner & 4) ? box.max.z : box.min.z,
+                         1.0f );
+        glm::vec4 clip = _viewProjectionMtx * point;
+        if(clip.w < MIN_W) return false;
+
+        GLfloat inverseW = 1.0f / clip.w;
+        glm::vec2 window( (clip.x * inverseW * 0.5f + 0.5f) * _width,
+                          (clip.y * inverseW * 0.5f + 0.5f) * _height );
+        screenBox.corners[corner] = glm::vec3(window.x, window.y, inverseW);
+        windowMin = glm::min(windowMin, window);
+        windowMax = glm::max(windowMax, window);
+        screenBox.nearestInverseW = std::max(screenBox.nearestInverseW, inverseW);
+    }
+
+    screenBox.minX = std::max( (GLint)floorf(windowMin.x), 0 );
+    screenBox.minY = std::max( (GLint)floorf(windowMin.y), 0 );
+    screenBox.maxX = std::min( (GLint)ceilf(windowMax.x), (GLint)_width );
+    screenBox.maxY = std::min( (GLint)ceilf(windowMax.y), (GLint)_height );
+    return true;
+}
+
+void OcclusionCuller::_rasterizeBand(GLint rowBegin, GLint rowEnd) {
+    for(const ScreenBox& occluder : _occluders) {
+        if(occluder.maxY <= rowBegin || occluder.minY >= rowEnd) continue;
+        for(const GLuint* triangle : BOX_TRIANGLES) {
+            _rasterizeTriangle( occluder.corners[triangle[0]], occluder.corners[triangle[1]], occluder.corners[triangle[2]],
+                                rowBegin, rowEnd );
+        }
+    }
+}
+
+void OcclusionCuller::_rasterizeTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, GLint rowBegin, GLint rowEnd) {
+    // the edge functions below are positive inside counter-clockwise triangles, flip the rest
+    GLfloat area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if(fabsf(area) < 1e-6f) return;
+    const glm::vec3& a = v0;
+    const glm::vec3& b = area > 0.0f ? v1 : v2;
+    const glm::vec3& c = area > 0.0f ? v2 : v1;
+    area = fabsf(area);
+
+    GLint minX = std::max( (GLint)floorf( std::min(std::min(a.x, b.x), c.x) ), 0 );
+    GLint maxX = std::min( (GLint)ceilf( std::max(std::max(a.x, b.x), c.x) ), (GLint)_width );
+    GLint minY = std::max( (GLint)floorf( std::min(std::min(a.y, b.y), c.y) ), rowBegin );
+    GLint maxY = std::min( (GLint)ceilf( std::max(std::max(a.y, b.y), c.y) ), rowEnd );
+    if(minX >= maxX || minY >= maxY) return;
+
+    // edge function of the edge from p to q, e(x, y) = dx * x + dy * y + offset
+    struct Edge { GLfloat dx, dy, offset; };
+    auto makeEdge = [](const glm::vec3& p, const glm::vec3& q) {
+        Edge edge = { p.y - q.y, q.x - p.x, 0.0f };
+        edge.offset = -(edge.dx * p.x + edge.dy * p.y);
+        return edge;
+    };
+    // a linear function evaluated at a pixel's center, shifted to its lowest value over the whole
+    // pixel, i.e. its value at the corner of the pixel farthest in the negative direction
+    auto makeLowestOverPixel = [](const Edge& edge) {
+        return Edge{ edge.dx, edge.dy, edge.offset - 0.5f * (fabsf(edge.dx) + fabsf(edge.dy)) };
+    };
+    const Edge CENTER_A = makeEdge(b, c);
+    const Edge CENTER_B = makeEdge(c, a);
+    const Edge CENTER_C = makeEdge(a, b);
+    // a pixel only counts as occluded if the triangle covers all of it, sampling at its center would
+    // let an occluder that covers part of the pixel hide objects seen through the rest
+    const Edge EDGE_A = makeLowestOverPixel(CENTER_A);
+    const Edge EDGE_B = makeLowestOverPixel(CENTER_B);
+    const Edge EDGE_C = makeLowestOverPixel(CENTER_C);
+
+    // 1/w is affine in window space, the edge functions over the area are the barycentric weights.
+    // the farthest the triangle gets within the pixel is stored, so the pixel is never nearer than all of it
+    const Edge INVERSE_W = makeLowestOverPixel( { (CENTER_A.dx * a.z + CENTER_B.dx * b.z + CENTER_C.dx * c.z) / area,
+                                                  (CENTER_A.dy * a.z + CENTER_B.dy * b.z + CENTER_C.dy * c.z) / area,
+                                                  (CENTER_A.offset * a.z + CENTER_B.offset * b.z + CENTER_C.offset * c.z) / area } );
+    // rounding must never make the occluder nearer than its nearest corner
+    const GLfloat NEAREST_INVERSE_W = std::max( std::max(a.z, b.z), c.z );
+
+    // start on a lane boundary, the buffer width is a multiple of the lane count
+    const GLint START_X = minX / LANES * LANES;
+    for(GLint y = minY; y < maxY; y++) {
+        GLfloat* row = &_inverseW[y * _width];
+        const GLfloat PY = (GLfloat)y + 0.5f;
+#ifdef MP_OCCLUSION_SSE
+        const __m128 ZERO = _mm_setzero_ps();
+        const __m128 LANE_OFFSETS = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 NEAREST = _mm_set1_ps(NEAREST_INVERSE_W);
+        for(GLint x = START_X; x < maxX; x += LANES) {
+            __m128 px = _mm_add_ps( _mm_set1_ps((GLfloat)x), LANE_OFFSETS );
+            __m128 edgeA = _mm_add_ps( _mm_mul_ps(_mm_set1_ps(EDGE_A.dx), px), _mm_set1_ps(EDGE_A.dy * PY + EDGE_A.offset) );
+            __m128 edgeB = _mm_add_ps( _mm_mul_ps(_mm_set1_ps(EDGE_B.dx), px), _mm_set1_ps(EDGE_B.dy * PY + EDGE_B.offset) );
+            __m128 edgeC = _mm_add_ps( _mm_mul_ps(_mm_set1_ps(EDGE_C.dx), px), _mm_set1_ps(EDGE_C.dy * PY + EDGE_C.offset) );
+            __m128 inside = _mm_and_ps( _mm_and_ps( _mm_cmpgt_ps(edgeA, ZERO), _mm_cmpgt_ps(edgeB, ZERO) ), _mm_cmpgt_ps(edgeC, ZERO) );
+
+            __m128 inverseW = _mm_add_ps( _mm_mul_ps(_mm_set1_ps(INVERSE_W.dx), px), _mm_set1_ps(INVERSE_W.dy * PY + INVERSE_W.offset) );
+            inverseW = _mm_min_ps( inverseW, NEAREST );
+            // lanes outside the triangle become 0, which the max leaves untouched
+            __m128 stored = _mm_loadu_ps(row + x);
+            _mm_storeu_ps( row + x, _mm_max_ps(stored, _mm_and_ps(inside, inverseW)) );
+        }
+#else
+        for(GLint x = START_X; x < maxX; x++) {
+            const GLfloat PX = (GLfloat)x + 0.5f;
+            if(EDGE_A.dx * PX + EDGE_A.dy * PY + EDGE_A.offset <= 0.0f) continue;
+            if(EDGE_B.dx * PX + EDGE_B.dy * PY + EDGE_B.offset <= 0.0f) continue;
+            if(EDGE_C.dx * PX + EDGE_C.dy * PY + EDGE_C.offset <= 0.0f) continue;
+            GLfloat inverseW = std::min( INVERSE_W.dx * PX + INVERSE_W.dy * PY + INVERSE_W.offset, NEAREST_INVERSE_W );
+            row[x] = std::max( row[x], inverseW );
+        }
+#endif
+    }
+}
+
+bool OcclusionCuller::_isOccluded(const ScreenBox& screenBox) const {
+    // entirely off screen is the frustum's call, not ours
+    if(screenBox.minX >= screenBox.maxX || screenBox.minY >= screenBox.maxY) return false;
+
+    const GLint START_X = screenBox.minX / LANES * LANES;
+    for(GLint y = screenBox.minY; y < screenBox.maxY; y++) {
+        const GLfloat* row = &_inverseW[y * _width];
+#ifdef MP_OCCLUSION_SSE
+        const __m128 LANE_OFFSETS = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        const __m128 MIN_X = _mm_set1_ps((GLfloat)screenBox.minX);
+        const __m128 MAX_X = _mm_set1_ps((GLfloat)screenBox.maxX);
+        const __m128 NEAREST = _mm_set1_ps(screenBox.nearestInverseW);
+        for(GLint x = START_X; x < screenBox.maxX; x += LANES) {
+            __m128 px = _mm_add_ps( _mm_set1_ps((GLfloat)x), LANE_OFFSETS );
+            __m128 isCovered = _mm_and_ps( _mm_cmpge_ps(px, MIN_X), _mm_cmplt_ps(px, MAX_X) );
+            // any covered pixel whose occluder is no nearer than the box lets it show through
+            __m128 showsThrough = _mm_and_ps( isCovered, _mm_cmple_ps(_mm_loadu_ps(row + x), NEAREST) );
+            if(_mm_movemask_ps(showsThrough) != 0) return false;
+        }
+#else
+        for(GLint x = screenBox.minX; x < screenBox.maxX; x++) {
+            if(row[x] <= screenBox.nearestInverseW) return false;
+        }
+#endif
+    }
+    return true;
+}
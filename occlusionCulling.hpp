@@ -0,0 +1,102 @@
+#ifndef MP_OCCLUSION_CULLING_HPP
+#define MP_OCCLUSION_CULLING_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+#include "jobSystem.hpp"
+
+#include <vector>
+
+/// \desc software occlusion culling on the CPU.  the nearest large boxes in view are rasterized
+/// into a small depth buffer, only where they cover whole pixels, then the bounds of everything else are tested against it and
+/// dropped if every pixel they cover already holds something nearer.  the buffer stores 1/w,
+/// which unlike window depth interpolates linearly across the screen and keeps its precision far
+/// from the camera.  rows are split into bands rasterized as separate jobs, and each band only
+/// ever takes the nearest of what is written to it, so the result does not depend on the number
+/// of threads or their timing
+class OcclusionCuller {
+public:
+    /// \desc work done by the culler since the last beginFrame()
+    struct Stats {
+        GLuint occluders = 0;
+        GLuint testedObjects = 0;
+        GLuint occludedObjects = 0;
+        GLuint numThreads = 0;
+        GLdouble rasterizeMilliseconds = 0.0;
+        GLdouble testMilliseconds = 0.0;
+    };
+
+    /// \param jobSystem pool to rasterize and test on
+    /// \param width pixels per row of the depth buffer, rounded up to a multiple of 4
+    /// \param height rows of the depth buffer
+    explicit OcclusionCuller(JobSystem* jobSystem, GLsizei width = 256, GLsizei height = 128);
+
+    /// \desc clears the depth buffer and the statistics
+    /// \param viewProjectionMtx camera occluders are rasterized and objects are tested with
+    void beginFrame(const glm::mat4& viewProjectionMtx);
+
+    /// \desc picks the candidates that cover the most of the screen and rasterizes their boxes
+    /// \param boxes world space bounds, indexed by the candidates
+    /// \param candidates indices of the boxes that may occlude, typically the ones in view
+    void renderOccluders(const std::vector<BoundingBox>& boxes, const std::vector<GLuint>& candidates);
+
+    /// \desc removes every object hidden behind the rasterized occluders, the survivors keep their order
+    /// \param bounds world space bounds, indexed by the objects
+    /// \param objects indices of the objects to test, replaced by the visible ones
+    /// \param areOccluderCandidates true if objects index the same boxes passed to renderOccluders(),
+    /// in which case the chosen occluders are kept without testing them against themselves
+    /// \return number of objects removed
+    GLuint cullOccluded(const std::vector<BoundingBox>& bounds, std::vector<GLuint>& objects, bool areOccluderCandidates);
+
+    const Stats& getStats() const;
+
+    /// \desc most boxes rasterized per frame
+    static constexpr GLuint MAX_OCCLUDERS = 48;
+
+private:
+    /// \desc box projected to the depth buffer
+    struct ScreenBox {
+        /// \desc window coordinates and 1/w of the eight corners
+        glm::vec3 corners[8];
+        /// \desc pixel rectangle covered, max exclusive
+        GLint minX, minY, maxX, maxY;
+        /// \desc largest 1/w of the corners, the nearest point of the box
+        GLfloat nearestInverseW;
+    };
+
+    /// \desc projects a box into the depth buffer
+    /// \return false if the box crosses the near plane, which leaves its footprint unbounded
+    bool _projectBox(const BoundingBox& box, ScreenBox& screenBox) const;
+    /// \desc rasterizes every occluder triangle that touches rows [rowBegin, rowEnd)
+    void _rasterizeBand(GLint rowBegin, GLint rowEnd);
+    /// \desc rasterizes one triangle into rows [rowBegin, rowEnd)
+    void _rasterizeTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, GLint rowBegin, GLint rowEnd);
+    /// \desc true if every pixel the box covers holds something nearer than the box
+    bool _isOccluded(const ScreenBox& screenBox) const;
+
+    JobSystem* _jobSystem;
+    GLsizei _width;
+    GLsizei _height;
+    /// \desc row bands the depth buffer is rasterized in, one per thread
+    GLuint _numBands;
+    /// \desc 1/w of the nearest occluder per pixel, 0 where nothing was drawn
+    std::vector<GLfloat> _inverseW;
+
+    glm::mat4 _viewProjectionMtx;
+    /// \desc projected boxes of the occluders chosen this frame
+    std::vector<ScreenBox> _occluders;
+    /// \desc 1 for the boxes rasterized this frame, indexed like the boxes of renderOccluders()
+    std::vector<unsigned char> _isOccluder;
+
+    /// \desc scratch lists reused every frame
+    mutable std::vector<std::pair<GLfloat, GLuint>> _rankedCandidates;
+    mutable std::vector<ScreenBox> _candidateBoxes;
+    mutable std::vector<unsigned char> _isVisible;
+
+    Stats _stats;
+};
+
+#endif //MP_OCCLUSION_CULLING_HPP
@@ -0,0 +1,102 @@
+#include "redrawScheduler.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/// \desc CPU time every thread of the process has used so far, in seconds
+static GLdouble getProcessCpuSeconds() {
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if(!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) return 0.0;
+    // counted in 100 nanosecond units
+    auto toSeconds = [](const FILETIME& time) { return ((GLuint64)time.dwHighDateTime << 32 | time.dwLowDateTime) * 1.0e-7; };
+    return toSeconds(kernelTime) + toSeconds(userTime);
+#else
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0e-6;
+#endif
+}
+
+RedrawScheduler::RedrawScheduler() :
+    _isOn( true ),
+    _drawnChangeTick( 0 ),
+    _numSettledFrames( 0 ),
+    _statsStartTime( 0.0 ),
+    _statsStartCpuSeconds( 0.0 ),
+    _gpuMilliseconds( 0.0 ) {
+
+    resetStats();
+}
+
+void RedrawScheduler::setOn(bool isOn) {
+    _isOn = isOn;
+    requestRedraw();
+}
+
+bool RedrawScheduler::isOn() const {
+    return _isOn;
+}
+
+void RedrawScheduler::requestRedraw() {
+    _numSettledFrames = 0;
+}
+
+bool RedrawScheduler::isRedrawDue(const WorldSnapshot& snapshot) const {
+    if(!_isOn) return true;
+    // something changed since the last frame, or the frames so far have not shown where it ended up
+    return snapshot.changeTick != _drawnChangeTick || _numSettledFrames < SETTLE_FRAMES;
+}
+
+bool RedrawScheduler::isLastRedraw(const WorldSnapshot& snapshot, GLfloat alpha) const {
+    return _isOn && _countSettledFrames(snapshot, alpha) == SETTLE_FRAMES;
+}
+
+void RedrawScheduler::frameDrawn(const WorldSnapshot& snapshot, GLfloat alpha) {
+    _numSettledFrames = _countSettledFrames(snapshot, alpha);
+    _drawnChangeTick = snapshot.changeTick;
+    _stats.framesDrawn++;
+}
+
+void RedrawScheduler::waitForEvents() {
+    glfwWaitEventsTimeout(MAX_WAIT_SECONDS);
+    _stats.waits++;
+}
+
+bool RedrawScheduler::_isSettled(const WorldSnapshot& snapshot, GLfloat alpha) {
+    // a tick after the change holds still from its start, the change itself only once fully blended in
+    return snapshot.changeTick != snapshot.tick || alpha >= 1.0f;
+}
+
+GLuint RedrawScheduler::_countSettledFrames(const WorldSnapshot& snapshot, GLfloat alpha) const {
+    GLuint numSettledFrames = snapshot.changeTick == _drawnChangeTick ? _numSettledFrames : 0;
+    return _isSettled(snapshot, alpha) ? std::min(numSettledFrames + 1, SETTLE_FRAMES) : numSettledFrames;
+}
+
+void RedrawScheduler::addGpuMilliseconds(GLdouble milliseconds) {
+    _gpuMilliseconds += milliseconds;
+}
+
+RedrawScheduler::Stats RedrawScheduler::getStats() const {
+    Stats stats = _stats;
+    stats.seconds = glfwGetTime() - _statsStartTime;
+    if(stats.seconds > 0.0) {
+        stats.cpuPercent = (getProcessCpuSeconds() - _statsStartCpuSeconds) / stats.seconds * 100.0;
+        stats.gpuPercent = _gpuMilliseconds / 1000.0 / stats.seconds * 100.0;
+    }
+    return stats;
+}
+
+void RedrawScheduler::resetStats() {
+    _stats = Stats();
+    _statsStartTime = glfwGetTime();
+    _statsStartCpuSeconds = getProcessCpuSeconds();
+    _gpuMilliseconds = 0.0;
+}
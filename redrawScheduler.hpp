@@ -0,0 +1,79 @@
+#ifndef MP_REDRAW_SCHEDULER_HPP
+#define MP_REDRAW_SCHEDULER_HPP
+
+#include <GL/glew.h>
+
+#include "simulation.hpp"
+
+/// \desc decides whether the render loop has anything new to draw.  every snapshot carries the
+/// last tick that changed anything drawn, and once a frame has shown that tick's end state the
+/// same image stays correct until the next change, so rather than draw it again the loop waits
+/// for an event: input, the window needing a repaint, or the simulation publishing a change.
+/// it also keeps the CPU and GPU time spent since the last report, to show what that saves
+class RedrawScheduler {
+public:
+    /// \desc frames drawn of the scene at rest after a change.  the second lets what is built from
+    /// the frame before, e.g. GPU culling's depth pyramid, catch up with it
+    static constexpr GLuint SETTLE_FRAMES = 2;
+    /// \desc longest the render loop waits without an event
+    static constexpr GLdouble MAX_WAIT_SECONDS = 0.5;
+
+    /// \desc frames and resources used since the last resetStats()
+    struct Stats {
+        GLuint framesDrawn = 0;
+        /// \desc times the loop waited for events instead of drawing
+        GLuint waits = 0;
+        GLdouble seconds = 0.0;
+        /// \desc CPU time of every thread of the process, as a percentage of one core
+        GLdouble cpuPercent = 0.0;
+        /// \desc time the GPU spent drawing the views, as a percentage of the wall clock
+        GLdouble gpuPercent = 0.0;
+    };
+
+    RedrawScheduler();
+
+    /// \param isOn if false every loop iteration draws a frame, as it did before
+    void setOn(bool isOn);
+    bool isOn() const;
+
+    /// \desc makes the next frames redraw even though the simulation has not changed anything,
+    /// call when a render toggle changes or the window needs repainting
+    void requestRedraw();
+    /// \desc true if a frame drawn from the snapshot could differ from the last one drawn
+    bool isRedrawDue(const WorldSnapshot& snapshot) const;
+    /// \desc true if nothing will be drawn after this frame until something changes, so the
+    /// frame should bring everything it otherwise refreshes over several frames up to date
+    /// \param alpha how far the frame is between the snapshot's ticks
+    bool isLastRedraw(const WorldSnapshot& snapshot, GLfloat alpha) const;
+    /// \desc records that a frame was drawn from the snapshot
+    /// \param alpha how far the frame was between the snapshot's ticks
+    void frameDrawn(const WorldSnapshot& snapshot, GLfloat alpha);
+    /// \desc blocks until a GLFW event arrives, at most MAX_WAIT_SECONDS
+    void waitForEvents();
+
+    /// \desc adds the GPU time of a frame once its timer comes back
+    void addGpuMilliseconds(GLdouble milliseconds);
+    /// \desc frames and utilization since the last resetStats()
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    /// \desc true if the frame shows the end state of the snapshot's last change
+    static bool _isSettled(const WorldSnapshot& snapshot, GLfloat alpha);
+    /// \desc settled frames the next frame would make
+    GLuint _countSettledFrames(const WorldSnapshot& snapshot, GLfloat alpha) const;
+
+    bool _isOn;
+    /// \desc changeTick of the snapshot last drawn
+    GLuint64 _drawnChangeTick;
+    /// \desc frames drawn since then that showed its end state
+    GLuint _numSettledFrames;
+
+    Stats _stats;
+    /// \desc wall clock and process CPU time at the last resetStats()
+    GLdouble _statsStartTime;
+    GLdouble _statsStartCpuSeconds;
+    GLdouble _gpuMilliseconds;
+};
+
+#endif //MP_REDRAW_SCHEDULER_HPP
@@ -0,0 +1,211 @@
+#include "renderQueue.hpp"
+
+#include <algorithm>
+
+// widths of the fields packed into a sort key
+static constexpr uint64_t PASS_BITS = 2;
+static constexpr uint64_t INSTANCED_BITS = 1;
+static constexpr uint64_t MESH_BITS = 16;
+static constexpr uint64_t DEPTH_BITS = 24;
+static constexpr uint64_t ORDER_BITS = 21;
+
+static constexpr uint64_t MESH_MASK = (1ull << MESH_BITS) - 1;
+static constexpr uint64_t DEPTH_MASK = (1ull << DEPTH_BITS) - 1;
+static constexpr uint64_t ORDER_MASK = (1ull << ORDER_BITS) - 1;
+
+/// \desc a packet with no transform assigned yet
+static DrawPacket makePacket(const Mesh* mesh, RenderPass pass, RenderLayer layer, bool isInstanced,
+                             const glm::vec3& position, const glm::vec3& color) {
+    DrawPacket packet;
+    packet.mesh = mesh;
+    packet.pass = pass;
+    packet.layer = layer;
+    packet.isInstanced = isInstanced;
+    packet.position = position;
+    packet.color = color;
+    packet.transformIndex = 0;
+    packet.transformOffset = 0;
+    return packet;
+}
+
+RenderQueue::RenderQueue(GLuint shaderProgramHandle, GLStateCache* stateCache, UniformRingBuffer* uniformRing,
+                         GLint materialColorUniformLocation) {
+    _shaderProgramHandle = shaderProgramHandle;
+    _instancedShaderProgramHandle = 0;
+    _stateCache = stateCache;
+    _uniformRing = uniformRing;
+    _materialColorUniformLocation = materialColorUniformLocation;
+    _areTransformsWritten = false;
+    _currentLayer = RENDER_LAYER_DYNAMIC;
+}
+
+void RenderQueue::setShaderPrograms(GLuint shaderProgramHandle, GLint materialColorUniformLocation, GLuint instancedShaderProgramHandle) {
+    _shaderProgramHandle = shaderProgramHandle;
+    _instancedShaderProgramHandle = instancedShaderProgramHandle;
+    _materialColorUniformLocation = materialColorUniformLocation;
+}
+
+void RenderQueue::begin() {
+    _packets.clear();
+    _transforms.clear();
+    _areTransformsWritten = false;
+    _currentLayer = RENDER_LAYER_DYNAMIC;
+    _stats = Stats();
+}
+
+void RenderQueue::setLayer(RenderLayer layer) {
+    _currentLayer = layer;
+}
+
+void RenderQueue::submit(const Mesh* mesh, const glm::mat4& modelMtx, const glm::vec3& color, RenderPass pass) {
+    DrawPacket packet = makePacket(mesh, pass, _currentLayer, false, glm::vec3(modelMtx[3]), color);
+    packet.transformIndex = _transforms.add(modelMtx);
+    _packets.push_back(packet);
+}
+
+void RenderQueue::setLodViews(const std::vector<LodView>& lodViews) {
+    _lodViews = lodViews;
+}
+
+void RenderQueue::submitLod(const LodMesh& lodMesh, GLuint& lodLevel, const glm::mat4& modelMtx, const glm::vec3& color, RenderPass pass) {
+    lodLevel = lodMesh.selectLevel( computePixelsPerUnit(_lodViews, modelMtx), lodLevel );
+    submit(lodMesh.getMesh(lodLevel), modelMtx, color, pass);
+}
+
+void RenderQueue::submitInstanced(const Mesh* mesh, RenderPass pass) {
+    // instances are spread over the whole world, so there is no single meaningful depth
+    _packets.push_back( makePacket(mesh, pass, _currentLayer, true, glm::vec3(0.0f), glm::vec3(1.0f)) );
+}
+
+void RenderQueue::merge(const DrawList& drawList) {
+    _packets.reserve( _packets.size() + drawList._packets.size() );
+    for(DrawPacket packet : drawList._packets) {
+        if(!packet.isInstanced) {
+            packet.transformIndex = _transforms.add( drawList._modelMatrices[packet.transformIndex] );
+        }
+        _packets.push_back(packet);
+    }
+    _stats.drawLists++;
+}
+
+void DrawList::begin(const RenderQueue& renderQueue) {
+    _lodViews = &renderQueue._lodViews;
+    _packets.clear();
+    _modelMatrices.clear();
+    _currentLayer = RENDER_LAYER_DYNAMIC;
+}
+
+void DrawList::setLayer(RenderLayer layer) {
+    _currentLayer = layer;
+}
+
+void DrawList::submit(const Mesh* mesh, const glm::mat4& modelMtx, const glm::vec3& color, RenderPass pass) {
+    DrawPacket packet = makePacket(mesh, pass, _currentLayer, false, glm::vec3(modelMtx[3]), color);
+    packet.transformIndex = _modelMatrices.size();
+    _modelMatrices.push_back(modelMtx);
+    _packets.push_back(packet);
+}
+
+void DrawList::submitLod(const LodMesh& lodMesh, GLuint& lodLevel, const glm::mat4& modelMtx, const glm::vec3& color, RenderPass pass) {
+    lodLevel = lodMesh.selectLevel( computePixelsPerUnit(*_lodViews, modelMtx), lodLevel );
+    submit(lodMesh.getMesh(lodLevel), modelMtx, color, pass);
+}
+
+void DrawList::submitInstanced(const Mesh* mesh, RenderPass pass) {
+    _packets.push_back( makePacket(mesh, pass, _currentLayer, true, glm::vec3(0.0f), glm::vec3(1.0f)) );
+}
+
+uint64_t RenderQueue::_makeKey(const DrawPacket& packet, GLfloat depth, size_t order) {
+    uint64_t depthBits = packet.isInstanced ? 0 : (uint64_t)( std::clamp(depth / MAX_SORT_DEPTH, 0.0f, 1.0f) * DEPTH_MASK );
+    uint64_t meshId = packet.mesh->getId() & MESH_MASK;
+
+    uint64_t key = (uint64_t)packet.pass << (INSTANCED_BITS + MESH_BITS + DEPTH_BITS + ORDER_BITS);
+    if(packet.pass == RENDER_PASS_OPAQUE) {
+        // group by program permutation, then by mesh to minimize VAO changes, then front-to-back
+        // for early depth rejection
+        key |= (uint64_t)packet.isInstanced << (MESH_BITS + DEPTH_BITS + ORDER_BITS);
+        key |= meshId << (DEPTH_BITS + ORDER_BITS);
+        key |= depthBits << ORDER_BITS;
+    } else {
+        // blended geometry must be back-to-front regardless of mesh
+        key |= (DEPTH_MASK - depthBits) << (MESH_BITS + INSTANCED_BITS + ORDER_BITS);
+        key |= meshId << (INSTANCED_BITS + ORDER_BITS);
+    }
+    key |= order & ORDER_MASK;
+    return key;
+}
+
+void RenderQueue::_writeTransforms() {
+    _transforms.computeNormalMatrices();
+    for(DrawPacket& packet : _packets) {
+        if(packet.isInstanced) continue;
+        // the block holds no camera state, so every view binds this same copy
+        TransformUniforms transform = _transforms.getTransformUniforms(packet.transformIndex);
+        packet.transformOffset = _uniformRing->write( &transform, sizeof(TransformUniforms) );
+    }
+    _areTransformsWritten = true;
+}
+
+void RenderQueue::execute(const glm::mat4& viewMtx, GLuint passMask, GLuint layerMask) {
+    if(!_areTransformsWritten) {
+        _writeTransforms();
+    }
+
+    // only the ordering depends on the view, the packets themselves are reused as is
+    _sortedPackets.clear();
+    for(GLuint i = 0; i < _packets.size(); i++) {
+        if((passMask & renderPassBit(_packets[i].pass)) == 0) continue;
+        if((layerMask & renderLayerBit(_packets[i].layer)) == 0) continue;
+        GLfloat depth = -(viewMtx * glm::vec4(_packets[i].position, 1.0f)).z;
+        _sortedPackets.emplace_back( _makeKey(_packets[i], depth, i), i );
+    }
+    std::sort(_sortedPackets.begin(), _sortedPackets.end());
+
+    _stats.packets += _sortedPackets.size();
+
+    _stateCache->useProgram(_shaderProgramHandle);
+
+    const Mesh* previousMesh = nullptr;
+    for(const auto& sortedPacket : _sortedPackets) {
+        const DrawPacket& packet = _packets[sortedPacket.second];
+        if(packet.isInstanced && packet.mesh->getNumInstances() == 0) continue;
+
+        if(packet.mesh != previousMesh) {
+            _stats.meshChanges++;
+            previousMesh = packet.mesh;
+        }
+
+        // packets are grouped by mesh, so the program only really changes between groups
+        _stateCache->useProgram(packet.isInstanced ? _instancedShaderProgramHandle : _shaderProgramHandle);
+        if(packet.isInstanced) {
+            packet.mesh->drawInstanced(*_stateCache);
+            _stats.triangles += packet.mesh->getNumIndices() / 3 * packet.mesh->getNumInstances();
+        } else {
+            _uniformRing->bind( TRANSFORM_BLOCK_BINDING, packet.transformOffset, sizeof(TransformUniforms) );
+            _stateCache->setUniform(_materialColorUniformLocation, packet.color);
+            packet.mesh->draw(*_stateCache);
+            _stats.triangles += packet.mesh->getNumIndices() / 3;
+        }
+    }
+}
+
+void RenderQueue::submitToGpuCuller(GpuCuller& gpuCuller) {
+    _transforms.computeNormalMatrices();
+    for(const DrawPacket& packet : _packets) {
+        if(packet.isInstanced) continue;
+
+        TransformUniforms transform = _transforms.getTransformUniforms(packet.transformIndex);
+        InstanceData instance;
+        instance.modelMtx = transform.modelMtx;
+        instance.normalMtx = glm::mat3( glm::vec3(transform.normalMtx[0]), glm::vec3(transform.normalMtx[1]), glm::vec3(transform.normalMtx[2]) );
+        instance.color = packet.color;
+        gpuCuller.addDynamicObject(packet.mesh, instance);
+
+        _stats.packets++;
+        _stats.triangles += packet.mesh->getNumIndices() / 3;
+    }
+}
+
+const RenderQueue::Stats& RenderQueue::getStats() const {
+    return _stats;
+}
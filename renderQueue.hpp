@@ -0,0 +1,210 @@
+#ifndef MP_RENDER_QUEUE_HPP
+#define MP_RENDER_QUEUE_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "glStateCache.hpp"
+#include "gpuCulling.hpp"
+#include "lod.hpp"
+#include "mesh.hpp"
+#include "transformBatch.hpp"
+#include "uniformBuffers.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// \desc passes are drawn in order, opaque geometry first
+enum RenderPass : GLuint {
+    RENDER_PASS_OPAQUE = 0,
+    RENDER_PASS_TRANSPARENT = 1
+};
+
+/// \desc bit of a pass in the mask execute() filters packets with
+/// \param pass pass to select
+constexpr GLuint renderPassBit(RenderPass pass) { return 1u << pass; }
+/// \desc mask selecting every pass
+static constexpr GLuint ALL_RENDER_PASSES = ~0u;
+
+/// \desc whether a draw belongs to the static environment, which may be cached across frames,
+/// or changes from frame to frame
+enum RenderLayer : GLuint {
+    RENDER_LAYER_STATIC = 0,
+    RENDER_LAYER_DYNAMIC = 1
+};
+
+/// \desc bit of a layer in the mask execute() filters packets with
+/// \param layer layer to select
+constexpr GLuint renderLayerBit(RenderLayer layer) { return 1u << layer; }
+/// \desc mask selecting every layer
+static constexpr GLuint ALL_RENDER_LAYERS = ~0u;
+
+/// \desc everything needed to issue a single draw, independent of the view it is drawn from
+struct DrawPacket {
+    const Mesh* mesh;
+    RenderPass pass;
+    RenderLayer layer;
+    /// \desc if true the mesh's instance attributes supply the transform and color
+    bool isInstanced;
+    /// \desc world space origin of the object, used for ordering within a pass
+    glm::vec3 position;
+    glm::vec3 color;
+    /// \desc index of the packet's model matrix in the frame's transform batch
+    GLuint transformIndex;
+    /// \desc offset of the packet's TransformBlock in the uniform ring, written by the first execute()
+    GLintptr transformOffset;
+};
+
+class RenderQueue;
+
+/// \desc draws of one slice of the scene recorded away from the GL thread.  recording only
+/// builds packets and collects model matrices, it makes no GL calls and touches nothing but
+/// the list, so each slice can be recorded on a thread of its own and the lists merged into
+/// the RenderQueue afterwards in a fixed order
+class DrawList {
+public:
+    /// \desc empties the list for a frame, submissions start in the dynamic layer
+    /// \param renderQueue queue the list will be merged into, submitLod() picks levels for its lod views
+    void begin(const RenderQueue& renderQueue);
+    /// \desc sets the layer of every packet submitted from now on
+    /// \param layer layer to record into
+    void setLayer(RenderLayer layer);
+
+    /// \desc records a single draw of a mesh, see RenderQueue::submit()
+    void submit(const Mesh* mesh, const glm::mat4& modelMtx, const glm::vec3& color, RenderPass pass = RENDER_PASS_OPAQUE);
+    /// \desc records a single draw of the level of a lod chain, see RenderQueue::submitLod()
+    void submitLod(const LodMesh& lodMesh, GLuint& lodLevel, const glm::mat4& modelMtx, const glm::vec3& color, RenderPass pass = RENDER_PASS_OPAQUE);
+    /// \desc records one draw of every instance of a mesh, see RenderQueue::submitInstanced()
+    void submitInstanced(const Mesh* mesh, RenderPass pass = RENDER_PASS_OPAQUE);
+
+private:
+    friend class RenderQueue;
+    /// \desc lod views of the queue, only read while recording
+    const std::vector<LodView>* _lodViews = nullptr;
+    /// \desc packets in submission order, transformIndex indexes _modelMatrices until merged
+    std::vector<DrawPacket> _packets;
+    std::vector<glm::mat4> _modelMatrices;
+    RenderLayer _currentLayer = RENDER_LAYER_DYNAMIC;
+};
+
+/// \desc records the draws of a frame from the environment and the characters once, then
+/// replays them for each view.  the recorded list holds world space transforms only, so a
+/// view just sorts it for its own camera so draws of the same mesh are adjacent and opaque
+/// geometry goes front-to-back, then submits it through the state cache.  sort keys are laid
+/// out (high to low bits) as
+///   opaque:      pass (2) | instanced (1) | mesh id (16) | depth (24) | submission order (21)
+///   transparent: pass (2) | inverted depth (24) | mesh id (16) | unused (1) | submission order (21)
+class RenderQueue {
+public:
+    /// \desc counters summed over every view executed since the last begin()
+    struct Stats {
+        /// \desc draw lists merged since the last begin()
+        GLuint drawLists = 0;
+        GLuint packets = 0;
+        GLuint meshChanges = 0;
+        GLuint triangles = 0;
+    };
+
+    /// \param shaderProgramHandle program every packet is drawn with
+    /// \param stateCache cache every program, VAO and uniform change is routed through
+    /// \param uniformRing ring buffer the per-draw transform blocks are written into
+    /// \param materialColorUniformLocation uniform location for the material diffuse color
+    RenderQueue(GLuint shaderProgramHandle, GLStateCache* stateCache, UniformRingBuffer* uniformRing,
+                GLint materialColorUniformLocation);
+
+    /// \desc changes the programs subsequent executes draw with to a pair of permutations, one
+    /// built for single draws and one built with SHADER_FEATURE_INSTANCING.  each packet is drawn
+    /// with the one that suits it, opaque instanced packets are sorted together so it changes once
+    /// \param shaderProgramHandle program single draws are drawn with
+    /// \param materialColorUniformLocation uniform location for the material diffuse color in shaderProgramHandle
+    /// \param instancedShaderProgramHandle program instanced draws are drawn with
+    void setShaderPrograms(GLuint shaderProgramHandle, GLint materialColorUniformLocation, GLuint instancedShaderProgramHandle);
+
+    /// \desc empties the queue so the next frame can be recorded, submissions start in the dynamic layer
+    void begin();
+    /// \desc sets the layer of every packet submitted from now on
+    /// \param layer layer to record into
+    void setLayer(RenderLayer layer);
+    /// \desc sets the cameras submitLod() picks levels for.  since the recorded list is shared by
+    /// every view, a part is drawn at the finest level any of them needs
+    /// \param lodViews every view the frame will be drawn from
+    void setLodViews(const std::vector<LodView>& lodViews);
+
+    /// \desc records a single draw of a mesh.  its transform block is written with the rest of the
+    /// frame's once the first view is executed
+    /// \param mesh mesh to draw
+    /// \param modelMtx model transformation matrix
+    /// \param color material diffuse color
+    /// \param pass pass to draw the mesh in
+    void submit(const Mesh* mesh, const glm::mat4& modelMtx, const glm::vec3& color, RenderPass pass = RENDER_PASS_OPAQUE);
+    /// \desc records a single draw of the level of a lod chain that suits the current lod views
+    /// \param lodMesh tessellations to choose from
+    /// \param lodLevel level the part used last frame, updated to the level chosen now
+    /// \param modelMtx model transformation matrix
+    /// \param color material diffuse color
+    /// \param pass pass to draw the mesh in
+    void submitLod(const LodMesh& lodMesh, GLuint& lodLevel, const glm::mat4& modelMtx, const glm::vec3& color, RenderPass pass = RENDER_PASS_OPAQUE);
+    /// \desc records one draw of every instance set on a mesh at the time the queue is executed
+    /// \param mesh mesh with instancing enabled
+    /// \param pass pass to draw the mesh in
+    void submitInstanced(const Mesh* mesh, RenderPass pass = RENDER_PASS_OPAQUE);
+    /// \desc appends every draw of a list recorded since its begin(), as if submitted here
+    /// directly.  lists merged in the same order every frame replay in the same order
+    /// \param drawList list to merge, GL thread only and after its recording has finished
+    void merge(const DrawList& drawList);
+
+    /// \desc sorts the recorded packets for a view and draws them.  may be called once per view
+    /// \param viewMtx camera view matrix, orders the packets by depth
+    /// \param passMask renderPassBit() of every pass to draw, packets of other passes are skipped
+    /// \param layerMask renderLayerBit() of every layer to draw, packets of other layers are skipped
+    /// \note the FrameBlock for the view must already be bound
+    void execute(const glm::mat4& viewMtx, GLuint passMask = ALL_RENDER_PASSES, GLuint layerMask = ALL_RENDER_LAYERS);
+
+    /// \desc hands every single draw recorded this frame to the GPU culler as a dynamic object,
+    /// used instead of execute() when culling and drawing happen on the GPU.  instanced packets
+    /// are skipped, their instances are registered with the culler as static objects
+    /// \param gpuCuller culler to add the objects to
+    void submitToGpuCuller(GpuCuller& gpuCuller);
+
+    const Stats& getStats() const;
+
+    /// \desc view space distance mapped to the largest depth key
+    static constexpr GLfloat MAX_SORT_DEPTH = 1000.0f;
+
+private:
+    friend class DrawList;
+
+    /// \desc builds the sort key of a packet for a view
+    /// \param packet packet to build the key of
+    /// \param depth view space distance to the packet
+    /// \param order index of the packet in submission order
+    static uint64_t _makeKey(const DrawPacket& packet, GLfloat depth, size_t order);
+    /// \desc computes the normal matrices of every recorded packet in one batch and writes their
+    /// transform blocks into the uniform ring
+    void _writeTransforms();
+
+    GLuint _shaderProgramHandle;
+    /// \desc program instanced packets are drawn with, built with SHADER_FEATURE_INSTANCING
+    GLuint _instancedShaderProgramHandle;
+    GLStateCache* _stateCache;
+    UniformRingBuffer* _uniformRing;
+    GLint _materialColorUniformLocation;
+
+    /// \desc cameras lod levels are chosen for
+    std::vector<LodView> _lodViews;
+    /// \desc packets recorded this frame, in submission order
+    std::vector<DrawPacket> _packets;
+    /// \desc sort key paired with the packet index, rebuilt for every view
+    std::vector<std::pair<uint64_t, GLuint>> _sortedPackets;
+    /// \desc model matrices of the single draws recorded this frame
+    TransformBatch _transforms;
+    /// \desc true once the transform blocks of this frame are in the uniform ring
+    bool _areTransformsWritten;
+    /// \desc layer new packets are recorded into
+    RenderLayer _currentLayer;
+    Stats _stats;
+};
+
+#endif //MP_RENDER_QUEUE_HPP
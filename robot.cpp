@@ -6,80 +6,72 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <CSCI441/objects.hpp>
 #include <CSCI441/OpenGLUtils.hpp>
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 
+#ifndef M_PI
+#define M_PI 3.14159265
+#endif
+
 //constructor
-Robot::Robot(GLuint shaderProgramHandle, GLint mvpMtxUniformLocation, GLint normalMtxUniformLocation,GLint materialColorUniformLocation, GLint modelMtxUniformLocation, GLint vPosAttributeLocation, GLint vNormalAttributeLocation) {
-    CSCI441::ModelLoader::enableAutoGenerateNormals();
-    _shaderProgramHandle = shaderProgramHandle;
-    _shaderProgramUniformLocations.mvpMtx = mvpMtxUniformLocation;
-    _shaderProgramUniformLocations.modelMtx = modelMtxUniformLocation;
-    _shaderProgramUniformLocations.normalMtx = normalMtxUniformLocation;
-    _shaderProgramUniformLocations.materialColor = materialColorUniformLocation;
-    _shaderProgramAttributeLocations.vPos = vPosAttributeLocation;
-    _shaderProgramAttributeLocations.vNormal = vNormalAttributeLocation;
+Robot::Robot(MeshLibrary* meshLibrary, TransformHierarchy* transforms) {
     /*
      * Switch Robot with Cube for fast loading model
      * Switch back for detailed model
      * Switch scaling down below
     */
-    _modelBody = new CSCI441::ModelLoader();
-    _modelBody->loadModelFile( "models/RobotReduced.obj" );
-    _modelBody->setAttributeLocations(_shaderProgramAttributeLocations.vPos, _shaderProgramAttributeLocations.vNormal);
+    /*
+     * Change from 0.03 to 0.001 for models/Robot.obj
+    */
+    glm::mat4 bodyMtx = glm::translate( glm::mat4(1.0f), glm::vec3(0.0,-0.01,0.0) );
+    bodyMtx = glm::scale( bodyMtx, glm::vec3(0.001,0.001,0.001) );
+    // bake the body's placement into its own mesh, the cube stack bobs so it stays separate
+    std::vector<BakePart> bodyParts = {
+            { LodMesh( meshLibrary->getModel( "models/RobotReduced.obj" ) ), bodyMtx, glm::vec3(1.0,1.0,1.0) }
+    };
+    _modelBody = bakeLodMesh(*meshLibrary, "robot", bodyParts).getMesh(0);
 
 
 
 
 
-    _modelCube = new CSCI441::ModelLoader();
-    _modelCube->loadModelFile( "models/Cube.obj" );
-    _modelCube->setAttributeLocations(_shaderProgramAttributeLocations.vPos, _shaderProgramAttributeLocations.vNormal);
+    _modelCube = meshLibrary->getModel( "models/Cube.obj" );
 
     _position = glm::vec3(0.0f,0.0f,0.0f);
     _boxX = 0.29;
     _boxZ = 0.8;
     _idleMotion = 0.0;
     _rotation = 0.0;
-    _speed = 0.1;
-}
-
-
-//Draws the whole robot
-void Robot::drawRobot(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) {
-    glUseProgram(_shaderProgramHandle);
-    modelMtx = glm::mat4(1.0f);
-    modelMtx = glm::translate(modelMtx, _position);
-    modelMtx = glm::translate( modelMtx, glm::vec3(0.4,0.0,0.456) );
-    modelMtx = glm::rotate( modelMtx, _rotation, glm::vec3(0.0,1.0,0.0) );
-    modelMtx = glm::translate( modelMtx, glm::vec3(-0.4,0.0,-0.456) );
-    _drawBody(modelMtx, viewMtx, projMtx);
-    _drawCubeStack(modelMtx, viewMtx, projMtx);
+    _speed = 6.0;
+    _turnSpeed = 3.14159;
+
+    // the robot turns about (0.4, 0, 0.456), so the root sits on that pivot and the body moves back off it
+    _transforms = transforms;
+    _rootNode = _transforms->addNode();
+    _bodyNode = _transforms->addNode(_rootNode);
+    _transforms->setTranslation( _bodyNode, glm::vec3(-0.4,0.0,-0.456) );
+    _cubeNode = _transforms->addNode(_bodyNode);
+    _transforms->setTranslation( _cubeNode, glm::vec3(_boxX,0.125,_boxZ+_idleMotion) );
+    _transforms->setScale( _cubeNode, glm::vec3(0.01,0.01,0.01) );
+    _updateRootNode();
 }
 
-void Robot::_drawBody(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const {
-    modelMtx = glm::translate( modelMtx, glm::vec3(0.0,-0.01,0.0) );
 
-    /*
-     * Change from 0.03 to 0.001 for models/Robot.obj
-    */
-     modelMtx = glm::scale( modelMtx, glm::vec3(0.001,0.001,0.001) );
-    _computeAndSendMatrixUniforms(modelMtx, viewMtx, projMtx);
-
-    glm::vec3 modelColor = glm::vec3(1.0,1.0,1.0);
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &modelColor[0]);
-
-    _modelBody->draw(_shaderProgramHandle);
+//Draws the whole robot at its cached matrices
+void Robot::drawRobot(DrawList& drawList, const TransformHierarchy& transforms) {
+    drawList.submit(_modelBody, transforms.getWorldMatrix(_bodyNode), glm::vec3(1.0f));
+    _drawCubeStack(drawList, transforms);
 }
 
-void Robot::_drawCubeStack(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const {
-    modelMtx = glm::translate( modelMtx, glm::vec3(_boxX,0.125,_boxZ+_idleMotion) );
-    modelMtx = glm::scale( modelMtx, glm::vec3(0.01,0.01,0.01) );
+void Robot::_drawCubeStack(DrawList& drawList, const TransformHierarchy& transforms) const {
     glm::vec3 modelColor = glm::vec3(0.92,0.85,0.2);
-    glUniform3fv(_shaderProgramUniformLocations.materialColor, 1, &modelColor[0]);
+    drawList.submit(_modelCube, transforms.getWorldMatrix(_cubeNode), modelColor);
+}
 
-    _computeAndSendMatrixUniforms(modelMtx, viewMtx, projMtx);
-    _modelCube->draw(_shaderProgramHandle);
+void Robot::_updateRootNode() {
+    _transforms->setTranslation( _rootNode, _position + glm::vec3(0.4,0.0,0.456) );
+    _transforms->setRotation( _rootNode, _rotation, glm::vec3(0.0,1.0,0.0) );
 }
 
 glm::vec3 Robot::getPosition(){
@@ -94,24 +86,26 @@ glm::vec3 Robot::cameraOffsetFirstPerson(){
 }
 void Robot::setPosition(glm::vec3 newPosition){
     _position = newPosition;
+    _updateRootNode();
 }
 
-void Robot::rotate(float radians){
-    _rotation+=radians;
+void Robot::rotate(float direction, GLfloat deltaTime){
+    _rotation+=direction*_turnSpeed*deltaTime;
+    _updateRootNode();
 }
 
 float Robot::getAngle(){
     return (_rotation - 3.398112);
 }
 
-void Robot::moveForward(GLfloat worldSize){
-    _position.x+=_speed*sin(_rotation);
-    _position.z+=_speed*cos(_rotation);
+void Robot::moveForward(GLfloat worldSize, GLfloat deltaTime){
+    _position.x+=_speed*deltaTime*sin(_rotation);
+    _position.z+=_speed*deltaTime*cos(_rotation);
     _checkBounds(worldSize);
 }
-void Robot::moveBackwards(GLfloat worldSize){
-    _position.x-=_speed*sin(_rotation);
-    _position.z-=_speed*cos(_rotation);
+void Robot::moveBackwards(GLfloat worldSize, GLfloat deltaTime){
+    _position.x-=_speed*deltaTime*sin(_rotation);
+    _position.z-=_speed*deltaTime*cos(_rotation);
     _checkBounds(worldSize);
 }
 
@@ -129,17 +123,29 @@ void Robot::_checkBounds(GLfloat WorldSize) {
     else if(_position.z < -WorldSize){
         _position.z = -WorldSize;
     }
+    _updateRootNode();
 }
 
-void Robot::idleMotion(){
-    _idleMotion = 0.02*sin(glfwGetTime());
+void Robot::idleMotion(GLdouble time){
+    _idleMotion = IDLE_MOTION_STEP*std::round(IDLE_MOTION_AMPLITUDE*sin(time)/IDLE_MOTION_STEP);
+    _transforms->setTranslation( _cubeNode, glm::vec3(_boxX,0.125,_boxZ+_idleMotion) );
 }
 
-void Robot::_computeAndSendMatrixUniforms(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const{
-    glm::mat4 mvpMtx = projMtx * viewMtx * modelMtx;
-    glProgramUniformMatrix4fv( _shaderProgramHandle, _shaderProgramUniformLocations.mvpMtx, 1, GL_FALSE, &mvpMtx[0][0] );
-    glProgramUniformMatrix4fv( _shaderProgramHandle, _shaderProgramUniformLocations.modelMtx, 1, GL_FALSE, &modelMtx[0][0] );
-    glm::mat3 normalMtx = glm::mat3( glm::transpose( glm::inverse( modelMtx )));
-    glProgramUniformMatrix3fv( _shaderProgramHandle, _shaderProgramUniformLocations.normalMtx, 1, GL_FALSE, &normalMtx[0][0] );
+GLdouble Robot::getSecondsToIdleMotionStep(GLdouble time) const {
+    // the cube moves when the sine crosses halfway between its step and the one above or below
+    const GLdouble STEP = std::round(IDLE_MOTION_AMPLITUDE*sin(time)/IDLE_MOTION_STEP);
+    GLdouble nextTime = HUGE_VAL;
+    for(GLdouble crossing : { STEP - 0.5, STEP + 0.5 }) {
+        const GLdouble SINE = crossing*IDLE_MOTION_STEP/IDLE_MOTION_AMPLITUDE;
+        if(std::fabs(SINE) > 1.0) continue;     // past the top or bottom of the swing
+        const GLdouble ANGLE = std::asin(SINE);
+        for(GLdouble angle : { ANGLE, M_PI - ANGLE }) {
+            // the first time from now on the sine takes this value, one a rounding error behind
+            // now is the crossing time just reached
+            GLdouble crossingTime = angle + 2.0*M_PI*std::ceil( (time - angle) / (2.0*M_PI) - 1.0e-9 );
+            nextTime = std::min(nextTime, crossingTime);
+        }
+    }
+    return std::max(nextTime - time, 0.0);
 }
 
@@ -7,25 +7,42 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
-#include <CSCI441/ModelLoader.hpp>
 #include <CSCI441/OpenGLEngine.hpp>
 
+#include "mesh.hpp"
+#include "renderQueue.hpp"
+#include "transformHierarchy.hpp"
+
 class Robot{
 public:
-    Robot( GLuint shaderProgramHandle, GLint mvpMtxUniformLocation, GLint normalMtxUniformLocation, GLint materialColorUniformLocation, GLint modelMtxUniformLocation, GLint vPosAttributeLocation, GLint vNormalAttributeLocation );
-    void drawRobot(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx);
+    Robot( MeshLibrary* meshLibrary, TransformHierarchy* transforms );
+    /// \param transforms hierarchy of the same shape as the one passed to the constructor, e.g. a copy rendering places
+    void drawRobot(DrawList& drawList, const TransformHierarchy& transforms);
     glm::vec3 getPosition();
     void setPosition(glm::vec3 newPosition);
     void _checkBounds(GLfloat worldSize);
-    void rotate(float radians);
+    /// \param direction 1 to turn left, -1 to turn right
+    /// \param deltaTime seconds to turn for
+    void rotate(float direction, GLfloat deltaTime);
     float getAngle();
-    void moveForward(GLfloat worldSize);
-    void moveBackwards(GLfloat worldSize);
-    void idleMotion();
+    void moveForward(GLfloat worldSize, GLfloat deltaTime);
+    void moveBackwards(GLfloat worldSize, GLfloat deltaTime);
+    /// \desc bobs the cube back and forth, in steps of IDLE_MOTION_STEP so it holds still between them
+    /// \param time seconds of simulation so far
+    void idleMotion(GLdouble time);
+    /// \desc seconds from time until idleMotion() next moves the cube a step
+    GLdouble getSecondsToIdleMotionStep(GLdouble time) const;
+    /// \desc farthest the cube bobs from its rest position
+    static constexpr GLdouble IDLE_MOTION_AMPLITUDE = 0.02;
+    /// \desc distance the cube bobs at once, an eighth of the amplitude so the bob still reads as smooth
+    static constexpr GLdouble IDLE_MOTION_STEP = 0.0025;
     glm::vec3 cameraOffset();
     glm::vec3 cameraOffsetFirstPerson();
 private:
+    /// \desc units per second
     float _speed;
+    /// \desc radians per second
+    float _turnSpeed;
     float _boxX;
     float _boxZ;
     float _rotation;
@@ -33,28 +50,24 @@ private:
 //    float bodyScale;
     glm::vec3 _position;
 
-    CSCI441::ModelLoader* _modelBody;
-    CSCI441::ModelLoader* _modelCube;
-    GLuint _shaderProgramHandle;
-    struct ShaderProgramUniformLocations {
-        GLint mvpMtx;
-        GLint modelMtx;
-        GLint normalMtx;
-        GLint materialColor;
-    } _shaderProgramUniformLocations;
-
-    struct ShaderProgramAttributeLocations {
-        GLint vPos;
-        GLint vNormal;
-    } _shaderProgramAttributeLocations;
+    /// \desc body model with its placement baked in
+    const Mesh* _modelBody;
+    /// \desc idle animated cube, drawn separately
+    const Mesh* _modelCube;
 
+    /// \desc hierarchy holding the robot's part transforms
+    TransformHierarchy* _transforms;
+    /// \desc turns the robot about its center
+    GLuint _rootNode;
+    /// \desc moves the pivot back to the body's origin, the body is drawn here
+    GLuint _bodyNode;
+    GLuint _cubeNode;
 
+    //transform methods
+    void _updateRootNode();
 
     //draw methods
-    void _drawBody(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx ) const;
-    void _drawCubeStack(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx )const;
-
-    void _computeAndSendMatrixUniforms(glm::mat4 modelMtx, glm::mat4 viewMtx, glm::mat4 projMtx) const;
+    void _drawCubeStack(DrawList& drawList, const TransformHierarchy& transforms )const;
 };
 
 
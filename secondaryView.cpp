@@ -0,0 +1,100 @@
+#include "secondaryView.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+SecondaryView::SecondaryView(const Settings& settings) :
+    _settings( settings ),
+    _width( 0 ),
+    _height( 0 ),
+    _framesSinceUpdate( 0 ),
+    _hasContents( false ) {
+
+    _settings.resolutionScale = std::max(_settings.resolutionScale, 0.01f);
+    _settings.updateInterval = std::max(_settings.updateInterval, 1u);
+
+    glGenFramebuffers(1, &_framebuffer);
+    glGenRenderbuffers(1, &_colorRenderbuffer);
+    glGenRenderbuffers(1, &_depthRenderbuffer);
+}
+
+SecondaryView::~SecondaryView() {
+    glDeleteFramebuffers(1, &_framebuffer);
+    glDeleteRenderbuffers(1, &_colorRenderbuffer);
+    glDeleteRenderbuffers(1, &_depthRenderbuffer);
+}
+
+bool SecondaryView::beginFrame(GLint framebufferWidth, GLint framebufferHeight) {
+    GLsizei width = std::max( (GLsizei)lroundf(framebufferWidth * _settings.windowSize.x * _settings.resolutionScale), 1 );
+    GLsizei height = std::max( (GLsizei)lroundf(framebufferHeight * _settings.windowSize.y * _settings.resolutionScale), 1 );
+    if(width != _width || height != _height) {
+        _width = width;
+        _height = height;
+        _allocateStorage();
+    }
+
+    _framesSinceUpdate++;
+    if(!_hasContents || _framesSinceUpdate >= _settings.updateInterval) {
+        _framesSinceUpdate = 0;
+        _hasContents = true;
+        return true;
+    }
+    return false;
+}
+
+void SecondaryView::bindForRendering() {
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glViewport(0, 0, _width, _height);
+    glScissor(0, 0, _width, _height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void SecondaryView::composite(GLint framebufferWidth, GLint framebufferHeight) const {
+    GLint x0 = (GLint)(framebufferWidth * _settings.windowOrigin.x);
+    GLint y0 = (GLint)(framebufferHeight * _settings.windowOrigin.y);
+    GLint x1 = (GLint)(framebufferWidth * (_settings.windowOrigin.x + _settings.windowSize.x));
+    GLint y1 = (GLint)(framebufferHeight * (_settings.windowOrigin.y + _settings.windowSize.y));
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    // the blit is scissored like any other write
+    glScissor(0, 0, framebufferWidth, framebufferHeight);
+    glBlitFramebuffer(0, 0, _width, _height, x0, y0, x1, y1, GL_COLOR_BUFFER_BIT, _width == x1 - x0 && _height == y1 - y0 ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void SecondaryView::invalidate() {
+    _hasContents = false;
+}
+
+GLsizei SecondaryView::getWidth() const {
+    return _width;
+}
+
+GLsizei SecondaryView::getHeight() const {
+    return _height;
+}
+
+GLfloat SecondaryView::getAspectRatio() const {
+    return (GLfloat)_width / (GLfloat)_height;
+}
+
+void SecondaryView::_allocateStorage() {
+    glBindRenderbuffer(GL_RENDERBUFFER, _colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, _width, _height);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _width, _height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorRenderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthRenderbuffer);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf( stderr, "[ERROR]: secondary view framebuffer of %dx%d is incomplete\n", _width, _height );
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // whatever was drawn before is gone
+    _hasContents = false;
+}
@@ -0,0 +1,66 @@
+#ifndef MP_SECONDARY_VIEW_HPP
+#define MP_SECONDARY_VIEW_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+/// \desc an extra camera drawn into its own framebuffer and blitted into a corner of the window.
+/// it gets its own budget: the framebuffer can be smaller than the area it covers on screen, and
+/// the view can be redrawn only every few frames while the last image keeps being composited
+class SecondaryView {
+public:
+    /// \desc where the view appears and how much it may cost
+    struct Settings {
+        /// \desc bottom left corner of the view as a fraction of the window size
+        glm::vec2 windowOrigin = glm::vec2(0.0f);
+        /// \desc size of the view as a fraction of the window size
+        glm::vec2 windowSize = glm::vec2(1.0f);
+        /// \desc framebuffer pixels per window pixel covered
+        GLfloat resolutionScale = 1.0f;
+        /// \desc the view is redrawn once every this many frames
+        GLuint updateInterval = 1;
+    };
+
+    explicit SecondaryView(const Settings& settings);
+    ~SecondaryView();
+
+    SecondaryView(const SecondaryView&) = delete;
+    SecondaryView& operator=(const SecondaryView&) = delete;
+
+    /// \desc advances a frame and resizes the framebuffer to the window if needed
+    /// \param framebufferWidth width of the window's framebuffer
+    /// \param framebufferHeight height of the window's framebuffer
+    /// \return true if the view is due to be redrawn this frame
+    bool beginFrame(GLint framebufferWidth, GLint framebufferHeight);
+    /// \desc binds the offscreen framebuffer, covers it with the viewport and scissor and clears it
+    void bindForRendering();
+    /// \desc blits the last image drawn into the view's corner of the window, then rebinds the window
+    /// \param framebufferWidth width of the window's framebuffer
+    /// \param framebufferHeight height of the window's framebuffer
+    void composite(GLint framebufferWidth, GLint framebufferHeight) const;
+    /// \desc forces a redraw on the next beginFrame(), call when the view becomes visible again
+    void invalidate();
+
+    GLsizei getWidth() const;
+    GLsizei getHeight() const;
+    /// \desc width over height of the offscreen framebuffer
+    GLfloat getAspectRatio() const;
+
+private:
+    /// \desc (re)creates the framebuffer attachments at the current size
+    void _allocateStorage();
+
+    Settings _settings;
+    GLuint _framebuffer;
+    GLuint _colorRenderbuffer;
+    GLuint _depthRenderbuffer;
+    GLsizei _width;
+    GLsizei _height;
+    /// \desc frames since the view was last drawn
+    GLuint _framesSinceUpdate;
+    /// \desc false until the framebuffer holds an image of the current size
+    bool _hasContents;
+};
+
+#endif //MP_SECONDARY_VIEW_HPP
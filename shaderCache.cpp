@@ -0,0 +1,247 @@
+#include "shaderCache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+/// \desc macro each ShaderFeature bit defines, in bit order
+static const char* const FEATURE_MACROS[] = { "POINT_LIGHT", "SPOT_LIGHT", "BAKED_LIGHTING", "INSTANCING" };
+static constexpr GLuint NUM_FEATURES = sizeof(FEATURE_MACROS) / sizeof(FEATURE_MACROS[0]);
+/// \desc stages a program may have, in the order getProgram() takes them
+static constexpr GLuint NUM_STAGES = 3;
+static constexpr GLenum STAGES[NUM_STAGES] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+/// \desc whole contents of a text file, empty if it could not be read
+static std::string readSourceFile(const char* path) {
+    std::ifstream file(path);
+    if(!file) {
+        fprintf( stderr, "[ERROR]: could not open shader source %s\n", path );
+        return std::string();
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+ShaderCache::ShaderCache(const char* cacheDirectory) :
+    _directory( cacheDirectory ) {
+
+    GLint numBinaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
+    _isBinaryCacheSupported = numBinaryFormats > 0;
+
+    // a binary is only good for the driver that produced it
+    const GLubyte* vendor = glGetString(GL_VENDOR);
+    const GLubyte* renderer = glGetString(GL_RENDERER);
+    const GLubyte* version = glGetString(GL_VERSION);
+    _driver = std::string(vendor ? (const char*)vendor : "") + "|" +
+              std::string(renderer ? (const char*)renderer : "") + "|" +
+              std::string(version ? (const char*)version : "");
+}
+
+ShaderCache::~ShaderCache() {
+    for(const auto& program : _programs) {
+        glDeleteProgram(program.second);
+    }
+}
+
+GLuint ShaderCache::getProgram(const char* vertexPath, const char* geometryPath, const char* fragmentPath, GLuint features) {
+    const char* const PATHS[NUM_STAGES] = { vertexPath, geometryPath, fragmentPath };
+
+    std::string programKey = std::to_string(features);
+    for(const char* path : PATHS) {
+        programKey += "|";
+        programKey += path ? path : "";
+    }
+    auto existing = _programs.find(programKey);
+    if(existing != _programs.end()) {
+        return existing->second;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // the key covers the preprocessed text, so an edit to any stage or a new feature rebuilds it
+    std::string sources[NUM_STAGES];
+    uint64_t hash = _hash(_driver, FNV_OFFSET_BASIS);
+    for(GLuint stage = 0; stage < NUM_STAGES; stage++) {
+        if(PATHS[stage] != nullptr) {
+            sources[stage] = _addDefines( readSourceFile(PATHS[stage]), features );
+        }
+        hash = _hash(sources[stage] + '\0', hash);
+    }
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016" PRIx64 ".bin", hash);
+    const std::string BINARY_PATH = _directory + "/" + fileName;
+
+    GLuint program = _isBinaryCacheSupported ? _loadBinary(BINARY_PATH) : 0;
+    if(program != 0) {
+        _stats.binariesLoaded++;
+    } else {
+        program = _buildProgram(sources, PATHS);
+        if(program != 0) {
+            _stats.compiled++;
+            if(_isBinaryCacheSupported) _saveBinary(program, BINARY_PATH);
+        }
+    }
+
+    std::chrono::duration<GLdouble, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    _stats.milliseconds += elapsed.count();
+    if(program != 0) {
+        _stats.programs++;
+        _programs[programKey] = program;
+    }
+    return program;
+}
+
+const ShaderCache::Stats& ShaderCache::getStats() const {
+    return _stats;
+}
+
+bool ShaderCache::isBinaryCacheSupported() const {
+    return _isBinaryCacheSupported;
+}
+
+std::string ShaderCache::_addDefines(const std::string& source, GLuint features) {
+    std::string defines;
+    for(GLuint i = 0; i < NUM_FEATURES; i++) {
+        if(features & (1u << i)) {
+            defines += "#define ";
+            defines += FEATURE_MACROS[i];
+            defines += "\n";
+        }
+    }
+    // #version must stay the first line, so the defines go right after it
+    size_t versionLine = source.find("#version");
+    size_t insertAt = versionLine == std::string::npos ? 0 : source.find('\n', versionLine);
+    if(insertAt == std::string::npos) {
+        return source + "\n" + defines;
+    }
+    if(versionLine != std::string::npos) insertAt++;
+    return source.substr(0, insertAt) + defines + source.substr(insertAt);
+}
+
+uint64_t ShaderCache::_hash(const std::string& text, uint64_t hash) {
+    for(unsigned char c : text) {
+        hash ^= c;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+GLuint ShaderCache::_compileStage(GLenum stage, const std::string& source, const char* path) {
+    GLuint shader = glCreateShader(stage);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+
+    GLint isCompiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+    if(!isCompiled) {
+        GLint logLength = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+        std::vector<GLchar> log( std::max(logLength, 1) );
+        glGetShaderInfoLog(shader, log.size(), nullptr, log.data());
+        fprintf( stderr, "[ERROR]: could not compile %s\n%s\n", path, log.data() );
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint ShaderCache::_buildProgram(const std::string* sources, const char* const* paths) {
+    GLuint program = glCreateProgram();
+    // must be set before linking for the driver to keep the binary around
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    GLuint shaders[NUM_STAGES] = {};
+    bool isCompiled = true;
+    for(GLuint stage = 0; stage < NUM_STAGES; stage++) {
+        if(paths[stage] == nullptr) continue;
+        shaders[stage] = _compileStage(STAGES[stage], sources[stage], paths[stage]);
+        if(shaders[stage] == 0) {
+            isCompiled = false;
+            continue;
+        }
+        glAttachShader(program, shaders[stage]);
+    }
+    GLint isLinked = GL_FALSE;
+    if(isCompiled) {
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+        if(!isLinked) {
+            GLint logLength = 0;
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+            std::vector<GLchar> log( std::max(logLength, 1) );
+            glGetProgramInfoLog(program, log.size(), nullptr, log.data());
+            fprintf( stderr, "[ERROR]: could not link %s\n%s\n", paths[0], log.data() );
+        }
+    }
+    // the program holds on to what it needs once linked
+    for(GLuint shader : shaders) {
+        if(shader == 0) continue;
+        glDetachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    if(!isLinked) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+GLuint ShaderCache::_loadBinary(const std::string& binaryPath) {
+    FILE* file = fopen(binaryPath.c_str(), "rb");
+    if(file == nullptr) return 0;
+
+    // the file holds the binary format followed by the binary itself
+    GLenum binaryFormat = 0;
+    std::vector<char> binary;
+    if(fread(&binaryFormat, sizeof(binaryFormat), 1, file) == 1) {
+        char buffer[4096];
+        size_t numRead;
+        while((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            binary.insert(binary.end(), buffer, buffer + numRead);
+        }
+    }
+    fclose(file);
+    if(binary.empty()) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, binaryFormat, binary.data(), binary.size());
+    GLint isLinked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+    if(!isLinked) {
+        fprintf( stdout, "[INFO]: cached program binary %s is stale, rebuilding it\n", binaryPath.c_str() );
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ShaderCache::_saveBinary(GLuint program, const std::string& binaryPath) {
+    GLint binaryLength = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if(binaryLength <= 0) return;
+
+    std::vector<char> binary(binaryLength);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(program, binaryLength, nullptr, &binaryFormat, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(_directory, error);
+    FILE* file = fopen(binaryPath.c_str(), "wb");
+    if(file == nullptr) {
+        fprintf( stderr, "[ERROR]: could not write program binary %s\n", binaryPath.c_str() );
+        return;
+    }
+    fwrite(&binaryFormat, sizeof(binaryFormat), 1, file);
+    fwrite(binary.data(), 1, binary.size(), file);
+    fclose(file);
+}
@@ -0,0 +1,85 @@
+#ifndef MP_SHADER_CACHE_HPP
+#define MP_SHADER_CACHE_HPP
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/// \desc compile-time features a program is built with, each defines the macro of the same name
+/// without the SHADER_FEATURE_ prefix right after the #version line of every stage
+enum ShaderFeature : GLuint {
+    /// \desc adds the point light of the FrameBlock
+    SHADER_FEATURE_POINT_LIGHT = 1u << 0,
+    /// \desc adds the spot light of the FrameBlock
+    SHADER_FEATURE_SPOT_LIGHT = 1u << 1,
+    /// \desc reads the point, spot and directional lights baked by StaticLighting instead, needs instancing
+    SHADER_FEATURE_BAKED_LIGHTING = 1u << 2,
+    /// \desc reads the model and normal matrices and the color per instance instead of from the TransformBlock
+    SHADER_FEATURE_INSTANCING = 1u << 3
+};
+
+/// \desc builds every permutation of a program at most once per run.  linked programs are
+/// written to disk with glGetProgramBinary under a hash of their preprocessed sources and
+/// the driver, so later runs on the same driver load them with glProgramBinary instead of
+/// compiling.  a binary the driver refuses, e.g. after an update, is simply rebuilt
+class ShaderCache {
+public:
+    /// \desc time spent building programs, tells a cold start from a warm one
+    struct Stats {
+        GLuint programs = 0;
+        /// \desc programs linked from a binary on disk
+        GLuint binariesLoaded = 0;
+        /// \desc programs compiled from source, a cold start compiles every one
+        GLuint compiled = 0;
+        GLdouble milliseconds = 0.0;
+    };
+
+    /// \param cacheDirectory directory the program binaries are kept in, created on the first write
+    explicit ShaderCache(const char* cacheDirectory);
+    /// \desc deletes every program handed out
+    ~ShaderCache();
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    /// \desc the program built from a set of stages with the macros of some features defined
+    /// \param vertexPath vertex shader source file
+    /// \param geometryPath geometry shader source file, nullptr for none
+    /// \param fragmentPath fragment shader source file
+    /// \param features ShaderFeature bits to define
+    /// \return handle of the linked program, owned by the cache, or 0 if it failed to build
+    GLuint getProgram(const char* vertexPath, const char* geometryPath, const char* fragmentPath, GLuint features);
+
+    const Stats& getStats() const;
+    /// \desc false if the driver offers no binary formats, every program is compiled then
+    bool isBinaryCacheSupported() const;
+
+private:
+    /// \desc inserts the #define of every feature after the #version line of a source
+    static std::string _addDefines(const std::string& source, GLuint features);
+    /// \desc 64-bit FNV-1a, continued from a previous hash
+    static uint64_t _hash(const std::string& text, uint64_t hash);
+    /// \desc compiles a stage, logging its errors
+    /// \return shader handle, 0 on failure
+    static GLuint _compileStage(GLenum stage, const std::string& source, const char* path);
+    /// \desc compiles and links every stage of a program
+    /// \return program handle, 0 on failure
+    static GLuint _buildProgram(const std::string* sources, const char* const* paths);
+    /// \desc links a program from the binary at a path
+    /// \return program handle, 0 if there is no binary or the driver rejected it
+    static GLuint _loadBinary(const std::string& binaryPath);
+    /// \desc writes a linked program's binary to a path
+    void _saveBinary(GLuint program, const std::string& binaryPath);
+
+    std::string _directory;
+    /// \desc vendor, renderer and version of the driver, part of every binary's key
+    std::string _driver;
+    bool _isBinaryCacheSupported;
+    /// \desc programs built this run by their stage paths and features
+    std::map<std::string, GLuint> _programs;
+    Stats _stats;
+};
+
+#endif //MP_SHADER_CACHE_HPP
@@ -0,0 +1,57 @@
+#version 410 core
+
+// uniform inputs
+// how the current view is split into clusters, written once per view by LightClusters::build()
+layout(std140) uniform ClusterBlock {
+    vec2 clusterScale;                  // clusters per pixel across and down the view
+    float sliceScale;                   // depth slices per unit of log(depth)
+    float sliceBias;                    // moves the near plane to slice zero
+    int numLights;                      // zero when clustered lights are off
+};
+
+uniform samplerBuffer lights;           // two texels per light, position & radius then color
+uniform usamplerBuffer clusterRanges;   // first light index & number of lights of each cluster
+uniform usamplerBuffer lightIndices;    // the lights of every cluster, cluster after cluster
+
+// must match LightClusters
+const int CLUSTERS_X = 16;
+const int CLUSTERS_Y = 9;
+const int CLUSTERS_Z = 24;
+
+// varying inputs
+layout(location = 0) in vec3 color;         // interpolated color for this fragment
+layout(location = 1) in vec3 worldPosition;
+layout(location = 2) in vec3 worldNormal;
+layout(location = 3) in vec3 surfaceColor;      // material color the lights are reflected off
+
+// outputs
+out vec4 fragColorOut;                  // color to apply to this fragment
+
+void main() {
+    vec3 finalColor = color;
+
+    if(numLights > 0) {
+        // gl_FragCoord.w is one over the distance in front of the camera
+        ivec2 tile = clamp( ivec2(gl_FragCoord.xy * clusterScale), ivec2(0), ivec2(CLUSTERS_X - 1, CLUSTERS_Y - 1) );
+        int slice = clamp( int(log(1.0 / gl_FragCoord.w) * sliceScale + sliceBias), 0, CLUSTERS_Z - 1 );
+        uvec2 range = texelFetch(clusterRanges, (slice * CLUSTERS_Y + tile.y) * CLUSTERS_X + tile.x).rg;
+
+        vec3 normal = normalize(worldNormal);
+        for(uint i = range.x; i < range.x + range.y; i++) {
+            int light = int(texelFetch(lightIndices, int(i)).r);
+            vec4 positionRadius = texelFetch(lights, light * 2);
+            vec3 lightColor = texelFetch(lights, light * 2 + 1).rgb;
+
+            // fades smoothly to nothing at the radius the light was culled with
+            vec3 toLight = positionRadius.xyz - worldPosition;
+            float distanceSquared = dot(toLight, toLight);
+            float falloff = clamp(1.0 - distanceSquared / (positionRadius.w * positionRadius.w), 0.0, 1.0);
+            falloff *= falloff;
+
+            float diffuse = max(dot(toLight * inversesqrt(max(distanceSquared, 1e-6)), normal), 0.0);
+            finalColor += lightColor * surfaceColor * (diffuse + 0.15) * falloff;
+        }
+    }
+
+    fragColorOut = vec4(finalColor, 1.0);
+}
@@ -0,0 +1,6 @@
+#version 410 core
+
+// the depth pre-pass only writes depth, color writes are masked off while it runs
+
+void main() {
+}
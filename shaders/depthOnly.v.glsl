@@ -0,0 +1,51 @@
+#version 410 core
+// built once per permutation like lab05.v.glsl, ShaderCache inserts a #define after the #version line
+//   INSTANCING      reads the model matrix per instance
+
+// position-only twin of lab05.v.glsl for the depth pre-pass.  gl_Position is declared invariant
+// and computed with exactly the same expression in both shaders, each draw using the permutation
+// with the same INSTANCING as the shading pass, so the shading pass lands on the very same depths
+// and passes GL_EQUAL
+
+// uniform inputs
+// must match the block in lab05.v.glsl, only the view-projection matrix is read
+layout(std140) uniform FrameBlock {
+    mat4 viewProjectionMtx;             // the precomputed View-Projection Matrix
+    vec3 lightColor;
+    float spotLightPhi;
+    vec3 lightDirection;
+    vec3 pointLightColor;
+    vec3 pointLightPosition;
+    vec3 spotLightColor;
+    vec3 spotLightPosition;
+    vec3 spotLightDirection;
+};
+
+#ifndef INSTANCING
+// must match the block in lab05.v.glsl, only the model matrix is read
+layout(std140) uniform TransformBlock {
+    mat4 modelMtx;
+    mat3 normalMatrix;
+};
+#endif
+
+// attribute inputs
+layout(location = 0) in vec3 vPos;      // the position of this specific vertex in object space
+
+#ifdef INSTANCING
+// per-instance attribute inputs
+layout(location = 3) in mat4 instanceModelMtx;
+#endif
+
+invariant gl_Position;
+
+void main() {
+#ifdef INSTANCING
+    mat4 objectModelMtx = instanceModelMtx;
+#else
+    mat4 objectModelMtx = modelMtx;
+#endif
+
+    // transform & output the vertex in clip space
+    gl_Position = viewProjectionMtx * (objectModelMtx * vec4(vPos, 1.0));
+}
@@ -0,0 +1,37 @@
+#version 430 core
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// uniform inputs
+uniform bool isFirstLevel;              // if true copy sourceDepth, otherwise reduce sourceLevel
+uniform sampler2D sourceDepth;          // copy of the depth buffer
+layout(r32f, binding = 0) readonly uniform image2D sourceLevel;        // previous pyramid level
+layout(r32f, binding = 1) writeonly uniform image2D destinationLevel;  // level being built
+
+void main() {
+    ivec2 destinationTexel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 destinationSize = imageSize(destinationLevel);
+    if(any(greaterThanEqual(destinationTexel, destinationSize))) return;
+
+    if(isFirstLevel) {
+        imageStore(destinationLevel, destinationTexel, vec4(texelFetch(sourceDepth, destinationTexel, 0).r));
+        return;
+    }
+
+    // farthest of the 2x2 block below, plus the extra row / column when the level above is odd
+    // sized so nothing falls between texels
+    ivec2 sourceSize = imageSize(sourceLevel);
+    ivec2 sourceTexel = destinationTexel * 2;
+    ivec2 extent = ivec2(2);
+    if(destinationTexel.x == destinationSize.x - 1 && (sourceSize.x & 1) != 0) extent.x = 3;
+    if(destinationTexel.y == destinationSize.y - 1 && (sourceSize.y & 1) != 0) extent.y = 3;
+
+    float farthestDepth = 0.0;
+    for(int y = 0; y < extent.y; y++) {
+        for(int x = 0; x < extent.x; x++) {
+            ivec2 texel = min(sourceTexel + ivec2(x, y), sourceSize - 1);
+            farthestDepth = max(farthestDepth, imageLoad(sourceLevel, texel).r);
+        }
+    }
+    imageStore(destinationLevel, destinationTexel, vec4(farthestDepth));
+}
@@ -0,0 +1,112 @@
+#version 430 core
+
+layout(local_size_x = 64) in;
+
+// one entry per object, must match GpuCuller::GpuObject
+struct Object {
+    float instance[29];                 // InstanceData: model matrix, normal matrix, color and baked lighting offset
+    uint meshSlot;                      // draw command the object is appended to
+    vec4 boundsMin;                     // world space bounds
+    vec4 boundsMax;
+};
+
+// must match GpuCuller::DrawCommand, the layout glMultiDrawElementsIndirect reads
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer ObjectBuffer {
+    Object objects[];
+};
+layout(std430, binding = 1) buffer CommandBuffer {
+    DrawCommand commands[];
+};
+// InstanceData of the visible objects, each command's instances start at its baseInstance
+layout(std430, binding = 2) writeonly buffer InstanceBuffer {
+    float instances[];
+};
+
+// uniform inputs
+uniform uint numObjects;
+uniform vec4 frustumPlanes[4 * 6];      // six inward facing planes per view, must match GpuCuller::MAX_VIEWS
+uniform uint numViews;
+uniform bool useOcclusion;
+uniform mat4 occlusionViewProjection;   // camera the depth pyramid was built from
+uniform sampler2D depthPyramid;         // farthest depth of each texel's footprint, per level
+uniform int depthPyramidLevels;
+
+// true if any part of the box may be inside the given view's frustum
+bool isInFrustum(uint view, vec3 boundsMin, vec3 boundsMax) {
+    for(uint i = 0; i < 6; i++) {
+        vec4 plane = frustumPlanes[view * 6 + i];
+        // the corner furthest along the plane normal, if even that is outside the box is too
+        vec3 positiveCorner = mix(boundsMin, boundsMax, greaterThanEqual(plane.xyz, vec3(0.0)));
+        if(dot(plane.xyz, positiveCorner) + plane.w < 0.0) return false;
+    }
+    return true;
+}
+
+// true if the box is entirely behind the depth the pyramid recorded over its screen footprint
+bool isOccluded(vec3 boundsMin, vec3 boundsMax) {
+    vec3 ndcMin = vec3(1.0);
+    vec3 ndcMax = vec3(-1.0);
+    for(int corner = 0; corner < 8; corner++) {
+        vec3 point = vec3( (corner & 1) != 0 ? boundsMax.x : boundsMin.x,
+                           (corner & 2) != 0 ? boundsMax.y : boundsMin.y,
+                           (corner & 4) != 0 ? boundsMax.z : boundsMin.z );
+        vec4 clip = occlusionViewProjection * vec4(point, 1.0);
+        // crossing the near plane, the footprint is unbounded
+        if(clip.w <= 0.0) return false;
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+
+    // footprint in texels of the finest level
+    vec2 size = vec2(textureSize(depthPyramid, 0));
+    vec2 texelMin = clamp((ndcMin.xy * 0.5 + 0.5) * size, vec2(0.0), size - 1.0);
+    vec2 texelMax = clamp((ndcMax.xy * 0.5 + 0.5) * size, vec2(0.0), size - 1.0);
+
+    // the level where the footprint spans at most 2x2 texels
+    vec2 extent = texelMax - texelMin;
+    int level = int(ceil(log2(max(max(extent.x, extent.y), 1.0))));
+    level = clamp(level, 0, depthPyramidLevels - 1);
+
+    ivec2 levelSize = textureSize(depthPyramid, level);
+    ivec2 levelMin = min(ivec2(texelMin) >> level, levelSize - 1);
+    ivec2 levelMax = min(ivec2(texelMax) >> level, levelSize - 1);
+    float farthestDepth = max( max( texelFetch(depthPyramid, levelMin, level).r,
+                                    texelFetch(depthPyramid, ivec2(levelMax.x, levelMin.y), level).r ),
+                               max( texelFetch(depthPyramid, ivec2(levelMin.x, levelMax.y), level).r,
+                                    texelFetch(depthPyramid, levelMax, level).r ) );
+
+    float nearestDepth = ndcMin.z * 0.5 + 0.5;
+    return nearestDepth > farthestDepth;
+}
+
+void main() {
+    uint objectIndex = gl_GlobalInvocationID.x;
+    if(objectIndex >= numObjects) return;
+
+    vec3 boundsMin = objects[objectIndex].boundsMin.xyz;
+    vec3 boundsMax = objects[objectIndex].boundsMax.xyz;
+
+    bool isVisible = false;
+    for(uint view = 0; view < numViews && !isVisible; view++) {
+        isVisible = isInFrustum(view, boundsMin, boundsMax);
+    }
+    if(!isVisible) return;
+    if(useOcclusion && isOccluded(boundsMin, boundsMax)) return;
+
+    // append to the instances of the object's mesh
+    uint meshSlot = objects[objectIndex].meshSlot;
+    uint slot = atomicAdd(commands[meshSlot].instanceCount, 1u);
+    uint first = (commands[meshSlot].baseInstance + slot) * 29;
+    for(uint i = 0; i < 29; i++) {
+        instances[first + i] = objects[objectIndex].instance[i];
+    }
+}
@@ -0,0 +1,19 @@
+#version 410 core
+
+// uniform inputs
+uniform sampler2D atlas;                // sprites of every variant, baked at startup
+
+// varying inputs
+layout(location = 0) in vec2 texCoord;  // where in the atlas to read this fragment
+
+// outputs
+out vec4 fragColorOut;                  // color to apply to this fragment
+
+void main() {
+    vec4 texel = texture(atlas, texCoord);
+    // the background of every sprite was cleared to transparent
+    if(texel.a < 0.5) {
+        discard;
+    }
+    fragColorOut = vec4(texel.rgb, 1.0);
+}
@@ -0,0 +1,62 @@
+#version 410 core
+
+// uniform inputs
+// camera & light constants, written once per view
+layout(std140) uniform FrameBlock {
+    mat4 viewProjectionMtx;             // the precomputed View-Projection Matrix
+    vec3 lightColor;
+    float spotLightPhi;
+    vec3 lightDirection;
+    vec3 pointLightColor;
+    vec3 pointLightPosition;
+    vec3 spotLightColor;
+    vec3 spotLightPosition;
+    vec3 spotLightDirection;
+};
+
+uniform vec3 cameraPosition;            // world space position of the camera
+uniform float variantRadii[16];         // bounding sphere radius each variant was baked around
+uniform float numVariants;              // rows in the atlas
+
+// attribute inputs
+layout(location = 0) in vec2 vCorner;   // corner of the unit quad
+
+// per-instance attribute inputs
+layout(location = 1) in vec4 instanceCenter;    // world space center of the object, w holds its height scale
+layout(location = 2) in float instanceVariant;  // row of the atlas to read the sprite from
+
+// varying outputs
+layout(location = 0) out vec2 texCoord; // where in the atlas to read this vertex
+
+// must match ImpostorAtlas
+const int NUM_AZIMUTHS = 8;
+const int NUM_ELEVATIONS = 3;
+const float ELEVATION_STEP = 0.5235988;
+const float PI = 3.14159265;
+
+void main() {
+    vec3 center = instanceCenter.xyz;
+    float heightScale = instanceCenter.w;
+    int variant = int(instanceVariant + 0.5);
+    float radius = variantRadii[variant];
+
+    // pick the baked direction closest to the one the object is seen from
+    vec3 toCamera = normalize(cameraPosition - center);
+    int azimuthIndex = int(round(atan(toCamera.x, toCamera.z) / (2.0 * PI / NUM_AZIMUTHS)));
+    azimuthIndex = (azimuthIndex % NUM_AZIMUTHS + NUM_AZIMUTHS) % NUM_AZIMUTHS;
+    int elevationIndex = clamp(int(round(asin(clamp(toCamera.y, -1.0, 1.0)) / ELEVATION_STEP)), 0, NUM_ELEVATIONS - 1);
+
+    // face the quad towards the camera, the bake cameras kept +Y up in the same way
+    vec3 right = cross(vec3(0.0, 1.0, 0.0), toCamera);
+    right = dot(right, right) > 1e-6 ? normalize(right) : vec3(1.0, 0.0, 0.0);
+    vec3 up = cross(toCamera, right);
+
+    vec3 position = center + (right * vCorner.x + up * vCorner.y) * radius;
+    // taller or shorter objects than the variant stretch its sprite
+    position.y = center.y + (position.y - center.y) * heightScale;
+    gl_Position = viewProjectionMtx * vec4(position, 1.0);
+
+    vec2 sprite = vec2(float(elevationIndex * NUM_AZIMUTHS + azimuthIndex), float(variant));
+    vec2 spriteScale = vec2(1.0 / float(NUM_AZIMUTHS * NUM_ELEVATIONS), 1.0 / numVariants);
+    texCoord = (sprite + vCorner * 0.5 + 0.5) * spriteScale;
+}
@@ -1,39 +1,93 @@
 #version 410 core
+// built once per permutation, ShaderCache inserts a #define after the #version line for each feature in use
+//   POINT_LIGHT     adds the point light
+//   SPOT_LIGHT      adds the spot light
+//   BAKED_LIGHTING  reads the lights StaticLighting baked instead of evaluating them, needs INSTANCING
+//   INSTANCING      reads the model/normal matrices and color per instance
 
 // uniform inputs
-uniform mat4 mvpMatrix;                 // the precomputed Model-View-Projection Matrix
-uniform mat3 normalMatrix;
-uniform vec3 lightColor;
-uniform vec3 lightDirection;
-uniform vec3 pointLightColor;
-uniform vec3 pointLightPosition;
-
-uniform vec3 spotLightPosition;
-uniform vec3 spotLightColor;
-uniform float spotLightPhi;
-uniform vec3 spotLightDirection;
+// camera & light constants, written once per view
+layout(std140) uniform FrameBlock {
+    mat4 viewProjectionMtx;             // the precomputed View-Projection Matrix
+    vec3 lightColor;
+    float spotLightPhi;
+    vec3 lightDirection;
+    vec3 pointLightColor;
+    vec3 pointLightPosition;
+    vec3 spotLightColor;
+    vec3 spotLightPosition;
+    vec3 spotLightDirection;
+};
+
+#ifndef INSTANCING
+// matrices for the current draw, bound at an offset in the per-frame ring buffer.
+// nothing here depends on the camera so every view of a frame shares the same block
+layout(std140) uniform TransformBlock {
+    mat4 modelMtx;
+    mat3 normalMatrix;
+};
 
 uniform vec3 materialColor;             // the material color for our vertex (& whole object)
-uniform mat4 modelMtx;
-
+#endif
 
+#ifdef BAKED_LIGHTING
+uniform samplerBuffer bakedLighting;    // lit color of every vertex of every static instance
+#endif
 
 // attribute inputs
 layout(location = 0) in vec3 vPos;      // the position of this specific vertex in object space
-in vec3 vNormal;
+layout(location = 1) in vec3 vNormal;
+layout(location = 2) in vec3 vColor;    // per-vertex tint, lets baked meshes carry the colors of their parts
+
+#ifdef INSTANCING
+// per-instance attribute inputs
+layout(location = 3) in mat4 instanceModelMtx;
+layout(location = 7) in mat3 instanceNormalMtx;
+layout(location = 10) in vec3 instanceColor;
+#endif
+#ifdef BAKED_LIGHTING
+layout(location = 11) in float instanceBakedLighting;  // first of this instance's colors in bakedLighting
+#endif
 
 // varying outputs
 layout(location = 0) out vec3 color;    // color to apply to this vertex
+// read by clusteredLights.f.glsl to add the lights of the fragment's cluster
+layout(location = 1) out vec3 worldPosition;
+layout(location = 2) out vec3 worldNormal;
+layout(location = 3) out vec3 surfaceColor;
+
+// the depth pre-pass in depthOnly.v.glsl must produce bit-identical positions
+invariant gl_Position;
 
 void main() {
+#ifdef INSTANCING
+    mat4 objectModelMtx = instanceModelMtx;
+    mat3 objectNormalMtx = instanceNormalMtx;
+    vec3 objectColor = instanceColor;
+#else
+    mat4 objectModelMtx = modelMtx;
+    mat3 objectNormalMtx = normalMatrix;
+    vec3 objectColor = materialColor;
+#endif
+    objectColor *= vColor;
+
     // transform & output the vertex in clip space
-    gl_Position = mvpMatrix * vec4(vPos, 1.0);
+    gl_Position = viewProjectionMtx * (objectModelMtx * vec4(vPos, 1.0));
 
+    worldPosition = vec3(objectModelMtx * vec4(vPos, 1.0));
+    // same multiplication order as the other lights below and the bake in staticLighting.cpp
+    worldNormal = vNormal * objectNormalMtx;
+    surfaceColor = objectColor;
+
+#ifdef BAKED_LIGHTING
+    // gl_VertexID is the index of the vertex in the mesh, the order the colors were baked in
+    color = texelFetch(bakedLighting, int(instanceBakedLighting) + gl_VertexID).rgb;
+#else
     vec3 newLightDirection = normalize(-1 *lightDirection);
 
-    vec3 newNormalVector = vNormal * normalMatrix;
+    vec3 newNormalVector = vNormal * objectNormalMtx;
 
-    //vec3 finalColor = lightColor * materialColor * max(dot(newLightDirection, newNormalVector),0);
+    //vec3 finalColor = lightColor * objectColor * max(dot(newLightDirection, newNormalVector),0);
     // Lighting used goes for a flat, "banded" approach.
     // the dotV value per point is categorized
     // by the below if/else checks and an exaggerated value
@@ -42,21 +96,25 @@ void main() {
     float _diffuseThreshB = 0.5;
     float _diffuseThreshC = 0.25;
 
-    //Point Light
-    vec3 pointLight;
-    vec4 reletivePosition = modelMtx * vec4(vPos, 1.0);
+    vec4 reletivePosition = objectModelMtx * vec4(vPos, 1.0);
     float x = reletivePosition[0];
     float y = reletivePosition[1];
     float z = reletivePosition[2];
     vec3 xyz = vec3(x,y,z);
+
+#ifdef POINT_LIGHT
+    //Point Light
+    vec3 pointLight;
     float pointLightDistance = sqrt(pow(x-pointLightPosition[0],2) + pow(y-pointLightPosition[1],2) + pow(z-pointLightPosition[2],2));
     vec3 pointLightDirection = vec3(normalize(-xyz+pointLightPosition));
-    vec3 pointDiffuse = pointLightColor*materialColor*max(dot(pointLightDirection, newNormalVector),0);
-    vec3 pointAmbiant = pointLightColor*materialColor*0.15;
+    vec3 pointDiffuse = pointLightColor*objectColor*max(dot(pointLightDirection, newNormalVector),0);
+    vec3 pointAmbiant = pointLightColor*objectColor*0.15;
     pointLight = pointDiffuse + pointAmbiant;
     float pointAttenuation = 1.0/(0.5+0.1*pointLightDistance+0.02*pow(pointLightDistance,2));
     pointLight = pointLight*pointAttenuation;
+#endif
 
+#ifdef SPOT_LIGHT
     //Spot Light
     //Find vector between point and light;
     float cutOff = spotLightPhi;
@@ -66,24 +124,30 @@ void main() {
     float angle = acos(float(dot(spotPointVector, newSpotDirection))/(length(spotPointVector)*length(newSpotDirection)));
     if(angle<1){
 
-        vec3 spotDiffuse = spotLightColor * materialColor*max(dot(spotPointVector, newNormalVector),0);
-        vec3 spotAmbiant = spotLightColor * materialColor*0.2;
+        vec3 spotDiffuse = spotLightColor * objectColor*max(dot(spotPointVector, newNormalVector),0);
+        vec3 spotAmbiant = spotLightColor * objectColor*0.2;
         spotLight = spotAmbiant + spotDiffuse;
 
         float spotLightDistance = sqrt(pow(x-spotLightPosition[0],2) + pow(y-spotLightPosition[1],2) + pow(z-spotLightPosition[2],2));
         float spotAttenuation = 1.0/(0.5+0.1*spotLightDistance+0.02*pow(spotLightDistance,2));
         spotLight = spotLight * spotAttenuation;
     }
+#endif
 
     //Directional Light
     if(max(dot(newLightDirection, newNormalVector),0) >= _diffuseThreshA){
-        color = lightColor * materialColor * 1.5;
+        color = lightColor * objectColor * 1.5;
     } else if(max(dot(newLightDirection, newNormalVector),0) >= _diffuseThreshB && max(dot(newLightDirection, newNormalVector),0) < _diffuseThreshA) {
-        color = lightColor * materialColor;
+        color = lightColor * objectColor;
     } else if(max(dot(newLightDirection, newNormalVector),0) >= _diffuseThreshC && max(dot(newLightDirection, newNormalVector),0) < _diffuseThreshB) {
-        color = lightColor * materialColor * 0.6;
+        color = lightColor * objectColor * 0.6;
     }
-    else color = lightColor * materialColor * 0.3;
+    else color = lightColor * objectColor * 0.3;
+#ifdef POINT_LIGHT
     color += pointLight;
+#endif
+#ifdef SPOT_LIGHT
     color += spotLight;
+#endif
+#endif
 }
\ No newline at end of file
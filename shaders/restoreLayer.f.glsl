@@ -0,0 +1,15 @@
+#version 410 core
+
+// uniform inputs
+uniform sampler2D colorLayer;           // cached color of the static environment
+uniform sampler2D depthLayer;           // cached depth of the static environment
+
+// outputs
+out vec4 fragColorOut;                  // color to apply to this fragment
+
+void main() {
+    // the layer was drawn at the size of the framebuffer, so texels map one to one
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    fragColorOut = texelFetch(colorLayer, texel, 0);
+    gl_FragDepth = texelFetch(depthLayer, texel, 0).r;
+}
@@ -0,0 +1,8 @@
+#version 410 core
+
+// one triangle big enough to cover the whole viewport, no vertex attributes needed
+
+void main() {
+    vec2 position = vec2( (gl_VertexID & 1) * 4.0 - 1.0, (gl_VertexID & 2) * 2.0 - 1.0 );
+    gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,46 @@
+#version 410 core
+
+// one invocation per split-screen view, must match MAX_SPLIT_SCREEN_VIEWS
+layout(triangles, invocations = 4) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+// uniform inputs
+// camera of every view, written once per frame
+layout(std140) uniform ViewBlock {
+    mat4 viewProjectionMatrices[4];     // the precomputed View-Projection Matrix of each view
+    int numViews;                       // number of entries in use
+};
+
+// varying inputs
+// gl_Position arrives in world space because the FrameBlock view-projection is the identity
+layout(location = 0) in vec3 color[];   // lit color of each vertex
+
+// varying outputs
+layout(location = 0) out vec3 viewColor;
+
+void main() {
+    if(gl_InvocationID >= numViews) return;
+
+    vec4 clipPositions[3];
+    for(int i = 0; i < 3; i++) {
+        clipPositions[i] = viewProjectionMatrices[gl_InvocationID] * gl_in[i].gl_Position;
+    }
+
+    // skip the triangle for this view if every vertex lies outside the same clip plane
+    for(int axis = 0; axis < 3; axis++) {
+        if(clipPositions[0][axis] >  clipPositions[0].w &&
+           clipPositions[1][axis] >  clipPositions[1].w &&
+           clipPositions[2][axis] >  clipPositions[2].w) return;
+        if(clipPositions[0][axis] < -clipPositions[0].w &&
+           clipPositions[1][axis] < -clipPositions[1].w &&
+           clipPositions[2][axis] < -clipPositions[2].w) return;
+    }
+
+    for(int i = 0; i < 3; i++) {
+        gl_Position = clipPositions[i];
+        gl_ViewportIndex = gl_InvocationID;
+        viewColor = color[i];
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,502 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+Simulation::Simulation(TransformHierarchy* transforms, Motorcycle* motorcycle, Bobomb* bobomb, Robot* robot,
+                       CSCI441::ArcballCam* arcballCam, CSCI441::FreeCam* freeCam, CSCI441::FreeCam* firstPersonCam,
+                       GLfloat worldSize) :
+    _transforms( transforms ),
+    _motorcycle( motorcycle ),
+    _bobomb( bobomb ),
+    _robot( robot ),
+    _arcballCam( arcballCam ),
+    _freeCam( freeCam ),
+    _firstPersonCam( firstPersonCam ),
+    _worldSize( worldSize ),
+    _mousePosition( MOUSE_UNINITIALIZED, MOUSE_UNINITIALIZED ),
+    _leftMouseButtonState( GLFW_RELEASE ),
+    _shiftButtonState( GLFW_RELEASE ),
+    _cameraIndex( 0 ),
+    _modelChoice( 0 ),
+    _firstPersonOn( false ),
+    _clock( TICK_RATE, MAX_CATCH_UP_TICKS ),
+    _numTicks( 0 ),
+    _animationTime( 0.0 ),
+    _changeTick( 0 ),
+    _previousCameraIndex( 0 ),
+    _previousModelChoice( 0 ),
+    _wasFlicker( false ),
+    _numDroppedInputs( 0 ),
+    _isRunning( false ),
+    _isSleeping( false ) {
+
+    for(auto& _key : _keys) _key = GL_FALSE;
+
+    // the first snapshot is the scene as placed, there is nothing before it to blend from
+    _beginTick();
+    _publish(0.0);
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+bool Simulation::pushInput(const InputEvent& event) {
+    if(!_inputs.push(event)) {
+        _numDroppedInputs++;
+        return false;
+    }
+    // the handoff stays lock-free while the simulation is ticking.  an idle thread announces
+    // itself before it checks the queue, so either it sees this event or this sees it sleeping,
+    // and it checks under the lock, so the notify cannot slip in between its check and its wait
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(_isSleeping.load(std::memory_order_relaxed)) {
+        { std::lock_guard<std::mutex> lock(_wakeMutex); }
+        _wake.notify_one();
+    }
+    return true;
+}
+
+GLuint64 Simulation::getNumDroppedInputs() const {
+    return _numDroppedInputs;
+}
+
+void Simulation::start() {
+    if(_isRunning) return;
+    _isRunning = true;
+    _thread = std::thread(&Simulation::_run, this);
+}
+
+void Simulation::stop() {
+    if(!_isRunning) return;
+    {
+        std::lock_guard<std::mutex> lock(_wakeMutex);
+        _isRunning = false;
+    }
+    _wake.notify_one();
+    _thread.join();
+}
+
+void Simulation::_run() {
+    const GLdouble STEP_SECONDS = _clock.getStepSeconds();
+    GLdouble lastTime = glfwGetTime();
+    while(_isRunning) {
+        const GLuint64 CHANGE_TICK = _changeTick;
+        if(_isIdle()) {
+            // sleep until just past the next change, but never for less than a tick
+            const GLdouble WAIT_SECONDS = std::max( _getSecondsToNextChange() + 1.0e-6, STEP_SECONDS );
+            _isSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            {
+                std::unique_lock<std::mutex> lock(_wakeMutex);
+                _wake.wait_for( lock, std::chrono::duration<GLdouble>(WAIT_SECONDS),
+                                [this]() { return !_inputs.isEmpty() || !_isRunning; } );
+            }
+            _isSleeping.store(false, std::memory_order_relaxed);
+            GLdouble now = glfwGetTime();
+            _idleTick(now - lastTime, now);
+            lastTime = now;
+            // the time asleep is accounted for, ticking starts afresh from here
+            _clock.reset();
+        } else {
+            GLdouble now = glfwGetTime();
+            GLuint numTicks = _clock.advance(now - lastTime);
+            lastTime = now;
+
+            // the ticks were due a step apart, the last of them the leftover fraction of a tick ago
+            GLdouble lastTickTime = now - _clock.getAlpha() * STEP_SECONDS;
+            for(GLuint i = 0; i < numTicks; i++) {
+                tick(lastTickTime - (numTicks - 1 - i) * STEP_SECONDS);
+            }
+        }
+
+        // a render thread with nothing new to draw is waiting for events
+        if(_changeTick != CHANGE_TICK) glfwPostEmptyEvent();
+
+        if(!_isIdle()) {
+            // nothing to do until the next tick is due
+            std::this_thread::sleep_for( std::chrono::duration<GLdouble>((1.0 - _clock.getAlpha()) * STEP_SECONDS) );
+        }
+    }
+}
+
+bool Simulation::_isIdle() const {
+    for(GLint key : MOVEMENT_KEYS) {
+        if(_keys[key]) return false;
+    }
+    return _inputs.isEmpty();
+}
+
+GLdouble Simulation::_getSecondsToNextChange() const {
+    return std::min<GLdouble>( _bobomb->getSecondsToFlicker(), _robot->getSecondsToIdleMotionStep(_animationTime) );
+}
+
+void Simulation::_idleTick(GLdouble seconds, GLdouble tickTime) {
+    // with nothing held, only the idle animations depend on time, and neither on the step size
+    _beginTick();
+    _bobomb->_updateFlicker( static_cast<GLfloat>(seconds) );
+    _animationTime += seconds;
+    _robot->idleMotion(_animationTime);
+    _numTicks++;
+    _publish(tickTime);
+}
+
+void Simulation::tick(GLdouble tickTime) {
+    // input that arrived since the last tick applies to this one
+    InputEvent event;
+    while(_inputs.pop(event)) {
+        _handleInput(event);
+    }
+
+    _beginTick();
+    _animationTime += _clock.getStepSeconds();
+    _updateScene( static_cast<GLfloat>(_clock.getStepSeconds()) );
+    _numTicks++;
+    _publish(tickTime);
+}
+
+const WorldSnapshot& Simulation::acquireSnapshot() {
+    _snapshots.acquire();
+    return _snapshots.getReadBuffer();
+}
+
+GLdouble Simulation::getStepSeconds() const {
+    return _clock.getStepSeconds();
+}
+
+void Simulation::_beginTick() {
+    _previousCameras[SIMULATION_CAMERA_ARCBALL] = _getCameraPose(_arcballCam);
+    _previousCameras[SIMULATION_CAMERA_FREE] = _getCameraPose(_freeCam);
+    _previousCameras[SIMULATION_CAMERA_FIRST_PERSON] = _getCameraPose(_firstPersonCam);
+    _getChaseTargets(_previousChaseTargets);
+    _previousCameraIndex = _cameraIndex;
+    _previousModelChoice = _modelChoice;
+    _wasFlicker = _bobomb->isFlicker();
+    _transforms->beginTick();
+}
+
+bool Simulation::_isChanged() const {
+    if(_transforms->isMoving()) return true;
+    if(_cameraIndex != _previousCameraIndex || _modelChoice != _previousModelChoice) return true;
+    if(_bobomb->isFlicker() != _wasFlicker) return true;
+    // the cameras move on their own as well as with the characters
+    return !_isSamePose(_getCameraPose(_arcballCam), _previousCameras[SIMULATION_CAMERA_ARCBALL]) ||
+           !_isSamePose(_getCameraPose(_freeCam), _previousCameras[SIMULATION_CAMERA_FREE]) ||
+           !_isSamePose(_getCameraPose(_firstPersonCam), _previousCameras[SIMULATION_CAMERA_FIRST_PERSON]);
+}
+
+void Simulation::_publish(GLdouble tickTime) {
+    // the buffer is the render thread's no longer, and the vectors keep their capacity from its last use
+    WorldSnapshot& snapshot = _snapshots.getWriteBuffer();
+    if(_isChanged()) _changeTick = _numTicks;
+    snapshot.tick = _numTicks;
+    snapshot.tickTime = tickTime;
+    _transforms->getTransforms(snapshot.previousTransforms, snapshot.transforms);
+    for(GLuint i = 0; i < NUM_SIMULATION_CAMERAS; i++) {
+        snapshot.previousCameras[i] = _previousCameras[i];
+    }
+    snapshot.cameras[SIMULATION_CAMERA_ARCBALL] = _getCameraPose(_arcballCam);
+    snapshot.cameras[SIMULATION_CAMERA_FREE] = _getCameraPose(_freeCam);
+    snapshot.cameras[SIMULATION_CAMERA_FIRST_PERSON] = _getCameraPose(_firstPersonCam);
+    for(GLuint i = 0; i < NUM_CHASE_TARGETS; i++) {
+        snapshot.previousChaseTargets[i] = _previousChaseTargets[i];
+    }
+    _getChaseTargets(snapshot.chaseTargets);
+    snapshot.cameraIndex = _cameraIndex;
+    snapshot.modelChoice = _modelChoice;
+    snapshot.isFlicker = _bobomb->isFlicker();
+    snapshot.changeTick = _changeTick;
+    snapshot.numDroppedTicks = _clock.getNumDroppedTicks();
+    _snapshots.publish();
+}
+
+CameraPose Simulation::_getCameraPose(const CSCI441::Camera* camera) {
+    return { camera->getPosition(), camera->getLookAtPoint(), camera->getUpVector() };
+}
+
+bool Simulation::_isSamePose(const CameraPose& a, const CameraPose& b) {
+    return a.eye == b.eye && a.lookAt == b.lookAt && a.up == b.up;
+}
+
+void Simulation::_getChaseTargets(glm::vec3* targets) const {
+    targets[0] = _motorcycle->getPosition();
+    targets[1] = _bobomb->getPosition();
+    targets[2] = _robot->getPosition() + _robot->cameraOffset();
+}
+
+void Simulation::_handleInput(const InputEvent& event) {
+    switch(event.type) {
+        case InputEvent::KEY:
+            if(event.code != GLFW_KEY_UNKNOWN)
+                _keys[event.code] = ((event.action == GLFW_PRESS) || (event.action == GLFW_REPEAT));
+
+            if(event.action == GLFW_PRESS) {
+                switch( event.code ) {
+                    case GLFW_KEY_LEFT_SHIFT:
+                    case GLFW_KEY_RIGHT_SHIFT:
+                        _shiftButtonState = GLFW_PRESS;
+                        break;
+                    case GLFW_KEY_UP:
+                        _changeCamera(true);
+                        break;
+                    case GLFW_KEY_DOWN:
+                        _changeCamera(false);
+                        break;
+                    case GLFW_KEY_1:
+                        _modelChoice = 0;
+                        _arcballCam->setPosition(_motorcycle->getPosition());
+                        _arcballCam->setLookAtPoint(_motorcycle->getPosition());
+                        _arcballCam->recomputeOrientation();
+                        break;
+                    case GLFW_KEY_2:
+                        _modelChoice = 1;
+                        _arcballCam->setPosition(_bobomb->getPosition());
+                        _arcballCam->setLookAtPoint(_bobomb->getPosition());
+                        _arcballCam->recomputeOrientation();
+                        break;
+                    case GLFW_KEY_3:
+                        _modelChoice = 2;
+                        _arcballCam->setPosition(_robot->getPosition()+_robot->cameraOffset());
+                        _arcballCam->setLookAtPoint(_robot->getPosition()+_robot->cameraOffset());
+                        _arcballCam->recomputeOrientation();
+                        break;
+                    case GLFW_KEY_4:
+                        _firstPersonOn = !_firstPersonOn;
+                        break;
+                    default: break;
+                }
+            }
+            if(event.action == GLFW_RELEASE){
+                switch(event.code) {
+                    case GLFW_KEY_LEFT_SHIFT:
+                    case GLFW_KEY_RIGHT_SHIFT:
+                        _shiftButtonState = GLFW_RELEASE;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            break;
+
+        case InputEvent::MOUSE_BUTTON:
+            // if the event is for the left mouse button
+            if( event.code == GLFW_MOUSE_BUTTON_LEFT ) {
+                // update the left mouse button's state
+                _leftMouseButtonState = event.action;
+            }
+            break;
+
+        case InputEvent::CURSOR_POSITION: {
+            const glm::vec2 currMousePosition = event.position;
+            // if mouse hasn't moved in the window, prevent camera from flipping out
+            if(_mousePosition.x == MOUSE_UNINITIALIZED) {
+                _mousePosition = currMousePosition;
+            }
+
+            // if the left mouse button is being held down while the mouse is moving
+            if(_leftMouseButtonState == GLFW_PRESS) {
+                if (_shiftButtonState != GLFW_PRESS) {
+                    // rotate the camera by the distance the mouse moved
+                    switch (_cameraIndex) {
+                        case (0):
+                            _arcballCam->rotate((currMousePosition.x - _mousePosition.x) * 0.005f,
+                                                (_mousePosition.y - currMousePosition.y) * 0.005f);
+                            break;
+                        case (1):
+                            _freeCam->rotate((currMousePosition.x - _mousePosition.x) * 0.005f,
+                                             (_mousePosition.y - currMousePosition.y) * 0.005f);
+                            break;
+                    }
+                } else {
+                    _arcballCam->zoom((_mousePosition.y - currMousePosition.y) * 0.005f);
+                }
+            }
+
+            // update the mouse position
+            _mousePosition = currMousePosition;
+            break;
+        }
+    }
+}
+
+void Simulation::_changeCamera(bool up) {
+    if(up){
+        if(_cameraIndex == 1){
+            _cameraIndex = 0;
+        }
+        else{
+            _cameraIndex++;
+        }
+    }
+    else{
+        if(_cameraIndex == 0){
+            _cameraIndex = 1;
+        }
+        else{
+            _cameraIndex--;
+        }
+    }
+}
+
+void Simulation::_updateScene(GLfloat deltaTime) {
+    _bobomb->_updateFlicker(deltaTime);
+    _robot->idleMotion(_animationTime);
+    // turn right
+    if(_keys[GLFW_KEY_SPACE]){
+        switch(_cameraIndex){
+            case(0):
+                break;
+            case(1):
+                if( _keys[GLFW_KEY_LEFT_SHIFT] || _keys[GLFW_KEY_RIGHT_SHIFT] ) {
+                    _freeCam->moveBackward(FREE_CAM_SPEED * deltaTime);
+                }
+                // go forward
+                else {
+                    _freeCam->moveForward(FREE_CAM_SPEED * deltaTime);
+                }
+                break;
+        }
+    }
+    if( _keys[GLFW_KEY_D] ) {
+        switch(_cameraIndex) {
+            case(0):
+                if(_modelChoice == 0){
+                    _motorcycle->rotate(1.0f, deltaTime);
+                    if(_firstPersonOn){
+                        _firstPersonCam->setTheta(-_motorcycle->getAngle() + (5 * M_PI_2 + M_PI_4 - .2));
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+                else if(_modelChoice == 1){
+                    _bobomb->rotateBobomb(GLFW_KEY_D, deltaTime);
+                    if(_firstPersonOn){
+                        _firstPersonCam->setTheta( -_bobomb->getDirection() + glm::radians(200.0f) );
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+                else if(_modelChoice == 2){
+                    _robot->rotate(-1.0f, deltaTime);
+                    if(_firstPersonOn){
+                        _firstPersonCam->setTheta(-_robot->getAngle());
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+                break;
+            case(1):
+                _freeCam->rotate(FREE_CAM_TURN_SPEED * deltaTime, 0.0f);
+                break;
+
+        }
+    }
+    // turn left
+    if( _keys[GLFW_KEY_A] ) {
+        switch(_cameraIndex) {
+            case(0):
+                if(_modelChoice == 0){
+                    _motorcycle->rotate(-1.0f, deltaTime);
+                    if(_firstPersonOn){
+                        _firstPersonCam->setTheta(-_motorcycle->getAngle() + (5 * M_PI_2 + M_PI_4 - .15) );
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+                else if(_modelChoice == 1){
+                    _bobomb->rotateBobomb(GLFW_KEY_A, deltaTime);
+                    if(_firstPersonOn){
+                        _firstPersonCam->setTheta(-_bobomb->getDirection() + glm::radians(200.0f));
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+                else if(_modelChoice == 2){
+                    _robot->rotate(1.0f, deltaTime);
+                    if(_firstPersonOn){
+                        _firstPersonCam->setTheta(-_robot->getAngle());
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+
+                break;
+            case(1):
+                _freeCam->rotate(-FREE_CAM_TURN_SPEED * deltaTime, 0.0f);
+                break;
+        }
+
+
+    }
+    // move forward
+    if( _keys[GLFW_KEY_W] ) {
+
+        switch(_cameraIndex) {
+            case(0):
+                if(_modelChoice == 0) {
+                    _motorcycle->driveForward(deltaTime);
+                    _motorcycle->_checkBounds(_worldSize);
+                    _arcballCam->setLookAtPoint(_motorcycle->getPosition());
+                    if(_firstPersonOn){
+                        _firstPersonCam->setPosition(_motorcycle->getPosition() + _motorcycle->getCameraOffset());
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+                else if(_modelChoice == 1) {
+                    _bobomb->driveForward(_worldSize, deltaTime);
+                    _arcballCam->setLookAtPoint(_bobomb->getPosition());
+                    if(_firstPersonOn){
+                        _firstPersonCam->setPosition(_bobomb->getPosition() + glm::vec3(0.0f,1.2f,0.0f));
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+                else if(_modelChoice == 2) {
+                    _robot->moveForward(_worldSize, deltaTime);
+                    _arcballCam->setLookAtPoint(_robot->getPosition()+_robot->cameraOffset());
+                    if(_firstPersonOn){
+                        _firstPersonCam->setPosition(_robot->getPosition()+_robot->cameraOffsetFirstPerson());
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+
+                _arcballCam->recomputeOrientation();
+                break;
+            case(1):
+                _freeCam->rotate(0.0f, FREE_CAM_TURN_SPEED * deltaTime);
+                break;
+        }
+
+    }
+    // move backward
+    if( _keys[GLFW_KEY_S] ) {
+        switch(_cameraIndex) {
+            case (0):
+                if (_modelChoice == 0) {
+                    _motorcycle->driveBackward(deltaTime);
+                    _motorcycle->_checkBounds(_worldSize);
+                    _arcballCam->setLookAtPoint(_motorcycle->getPosition());
+                    if(_firstPersonOn){
+                        _firstPersonCam->setPosition(_motorcycle->getPosition() + _motorcycle->getCameraOffset());
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+                else if(_modelChoice == 1) {
+                    _bobomb->driveBackward(_worldSize, deltaTime);
+                    _arcballCam->setLookAtPoint(_bobomb->getPosition());
+                    if(_firstPersonOn){
+                        _firstPersonCam->setPosition(_bobomb->getPosition() + glm::vec3(0.0f,1.2f,0.0f));
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+                else if(_modelChoice == 2) {
+                    _robot->moveBackwards(_worldSize, deltaTime);
+                    _arcballCam->setLookAtPoint(_robot->getPosition()+_robot->cameraOffset());
+                    if(_firstPersonOn){
+                        _firstPersonCam->setPosition(_robot->getPosition()+_robot->cameraOffsetFirstPerson());
+                        _firstPersonCam->recomputeOrientation();
+                    }
+                }
+
+                _arcballCam->recomputeOrientation();
+                break;
+            case(1):
+                _freeCam->rotate(0.0f, -FREE_CAM_TURN_SPEED * deltaTime);
+                break;
+        }
+    }
+}
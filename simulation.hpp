@@ -0,0 +1,232 @@
+#ifndef MP_SIMULATION_HPP
+#define MP_SIMULATION_HPP
+
+#include <CSCI441/FreeCam.hpp>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include "ArcBallCam.hpp"
+#include "bobomb.hpp"
+#include "fixedTimestep.hpp"
+#include "motorcycle.hpp"
+#include "robot.hpp"
+#include "spscQueue.hpp"
+#include "transformHierarchy.hpp"
+#include "tripleBuffer.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// \desc a GLFW input event handed from the main thread to the simulation
+struct InputEvent {
+    enum Type : GLuint {
+        KEY,
+        MOUSE_BUTTON,
+        CURSOR_POSITION
+    };
+    Type type;
+    /// \desc key or mouse button, as GLFW_KEY_ or GLFW_MOUSE_BUTTON_ macros
+    GLint code;
+    /// \desc GLFW_PRESS, GLFW_REPEAT or GLFW_RELEASE
+    GLint action;
+    /// \desc cursor position in window coordinates
+    glm::vec2 position;
+};
+
+/// \desc where a camera is and looks, enough to rebuild its view matrix
+struct CameraPose {
+    glm::vec3 eye;
+    glm::vec3 lookAt;
+    glm::vec3 up;
+};
+
+/// \desc cameras the simulation moves
+enum SimulationCamera {
+    SIMULATION_CAMERA_ARCBALL,
+    SIMULATION_CAMERA_FREE,
+    SIMULATION_CAMERA_FIRST_PERSON,
+    NUM_SIMULATION_CAMERAS
+};
+
+/// \desc characters the split-screen chase cameras follow, motorcycle then bobomb then robot
+static constexpr GLuint NUM_CHASE_TARGETS = 3;
+
+/// \desc everything rendering reads from one simulation tick, as it was before and after the
+/// tick so frames can be drawn part way between the two
+struct WorldSnapshot {
+    /// \desc ticks simulated so far, including this one
+    GLuint64 tick = 0;
+    /// \desc glfwGetTime() at which this tick was due, a frame drawn one tick later shows its end state
+    GLdouble tickTime = 0.0;
+    /// \desc local transform of every character part, indexed by transform hierarchy node
+    std::vector<TransformHierarchy::LocalTransform> previousTransforms;
+    std::vector<TransformHierarchy::LocalTransform> transforms;
+    CameraPose previousCameras[NUM_SIMULATION_CAMERAS];
+    CameraPose cameras[NUM_SIMULATION_CAMERAS];
+    glm::vec3 previousChaseTargets[NUM_CHASE_TARGETS];
+    glm::vec3 chaseTargets[NUM_CHASE_TARGETS];
+    /// \desc 0 for the arcball camera, 1 for the free cam
+    GLint cameraIndex = 0;
+    /// \desc character the keyboard drives and the arcball follows
+    GLint modelChoice = 0;
+    /// \desc flicker color of the bobomb's fuse
+    bool isFlicker = false;
+    /// \desc last tick that changed anything drawn.  a frame showing that tick's end state stays
+    /// correct until this moves on, however many ticks follow
+    GLuint64 changeTick = 0;
+    /// \desc ticks dropped after stalls so far
+    GLuint64 numDroppedTicks = 0;
+};
+
+/// \desc moves the characters and cameras in fixed ticks on a thread of its own.  the GLFW
+/// callbacks hand it input through a lock-free queue, and after every tick it publishes a
+/// WorldSnapshot through a triple buffer, so neither a slow frame nor a slow tick ever holds
+/// the other thread up.  the characters and cameras belong to the simulation once it starts;
+/// the render thread only reads snapshots and the characters' meshes.  while no key is held the
+/// only things that move are the bobomb's fuse and the robot's idle motion, so rather than tick
+/// the thread sleeps until input arrives or one of them next changes, and it wakes the render
+/// thread with an empty GLFW event whenever it publishes a change
+class Simulation {
+public:
+    /// \desc simulation ticks per second, whatever rate the display refreshes at
+    static constexpr GLuint TICK_RATE = 120;
+    /// \desc most ticks the simulation catches up on at once, a tenth of a second
+    static constexpr GLuint MAX_CATCH_UP_TICKS = 12;
+    /// \desc input events that may wait for the next tick, more are dropped
+    static constexpr GLuint INPUT_QUEUE_CAPACITY = 256;
+
+    /// \desc takes over the characters and cameras as they are placed now and publishes them as the first snapshot
+    /// \param transforms hierarchy the characters were built in
+    /// \param worldSize half the width of the world the characters are kept inside
+    Simulation(TransformHierarchy* transforms, Motorcycle* motorcycle, Bobomb* bobomb, Robot* robot,
+               CSCI441::ArcballCam* arcballCam, CSCI441::FreeCam* freeCam, CSCI441::FreeCam* firstPersonCam,
+               GLfloat worldSize);
+    /// \desc stops the thread if it is running
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    /// \desc queues an input event for the next tick and wakes the simulation thread if it is idle, main thread only.
+    /// takes no lock unless the simulation thread is asleep
+    /// \return false if the queue was full and the event was dropped
+    bool pushInput(const InputEvent& event);
+    /// \desc input events pushInput() has dropped
+    GLuint64 getNumDroppedInputs() const;
+
+    /// \desc starts ticking in real time on the simulation thread
+    void start();
+    /// \desc waits for the tick in progress and stops the simulation thread
+    void stop();
+    /// \desc runs one tick on the calling thread, for running without the simulation thread
+    /// \param tickTime recorded as the snapshot's tickTime
+    void tick(GLdouble tickTime);
+
+    /// \desc the latest published snapshot, render thread only.  it stays valid and unchanged
+    /// until the next call
+    const WorldSnapshot& acquireSnapshot();
+    /// \desc length of one tick in seconds
+    GLdouble getStepSeconds() const;
+
+private:
+    /// \desc body of the simulation thread, ticks whenever one is due and sleeps in between
+    void _run();
+    /// \desc true if nothing but the idle animations would change at the next tick: no movement
+    /// key is held and there is no input waiting
+    bool _isIdle() const;
+    /// \desc seconds until an idle animation next changes something drawn
+    GLdouble _getSecondsToNextChange() const;
+    /// \desc advances the idle animations over time spent asleep and publishes the result, in
+    /// place of the ticks that would have covered it
+    /// \param seconds time since the last tick
+    /// \param tickTime recorded as the snapshot's tickTime
+    void _idleTick(GLdouble seconds, GLdouble tickTime);
+    /// \desc applies an input event to the key, mouse and camera state
+    void _handleInput(const InputEvent& event);
+    void _changeCamera(bool up);
+    /// \desc handles moving our cameras and models as determined by keyboard input, one simulation tick
+    /// \param deltaTime length of the tick in seconds
+    void _updateScene(GLfloat deltaTime);
+    /// \desc what the chase cameras of the split-screen views look at
+    void _getChaseTargets(glm::vec3* targets) const;
+    static CameraPose _getCameraPose(const CSCI441::Camera* camera);
+    static bool _isSamePose(const CameraPose& a, const CameraPose& b);
+    /// \desc remembers the cameras and characters as they are before a tick
+    void _beginTick();
+    /// \desc writes the state before and after the tick to the snapshot buffer and publishes it
+    void _publish(GLdouble tickTime);
+    /// \desc true if the tick since _beginTick() changed anything drawn
+    bool _isChanged() const;
+
+    TransformHierarchy* _transforms;
+    Motorcycle* _motorcycle;
+    Bobomb* _bobomb;
+    Robot* _robot;
+    CSCI441::ArcballCam* _arcballCam;
+    CSCI441::FreeCam* _freeCam;
+    CSCI441::FreeCam* _firstPersonCam;
+    GLfloat _worldSize;
+
+    /// \desc units per second the free cam flies
+    static constexpr GLfloat FREE_CAM_SPEED = 15.0f;
+    /// \desc radians per second the free cam turns
+    static constexpr GLfloat FREE_CAM_TURN_SPEED = 1.2f;
+    /// \desc value off-screen to represent mouse has not begun interacting with window yet
+    static constexpr GLfloat MOUSE_UNINITIALIZED = -9999.0f;
+
+    /// \desc keys that move a character or camera for as long as they are held
+    static constexpr GLint MOVEMENT_KEYS[] = { GLFW_KEY_SPACE, GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D };
+
+    /// \desc tracks the number of different keys that can be present as determined by GLFW
+    static constexpr GLuint NUM_KEYS = GLFW_KEY_LAST;
+    /// \desc boolean array tracking each key state.  if true, then the key is in a pressed or held
+    /// down state.  if false, then the key is in a released state and not being interacted with
+    GLboolean _keys[NUM_KEYS];
+    /// \desc last location of the mouse in window coordinates
+    glm::vec2 _mousePosition;
+    /// \desc current state of the left mouse button
+    GLint _leftMouseButtonState;
+    GLint _shiftButtonState;
+    GLint _cameraIndex;
+    /// \desc int to choose model driven
+    GLint _modelChoice;
+    /// \desc the first person camera only follows the character while its inset is shown
+    bool _firstPersonOn;
+
+    /// \desc splits the time between wake-ups into ticks
+    FixedTimestep _clock;
+    /// \desc ticks simulated so far
+    GLuint64 _numTicks;
+    /// \desc seconds the idle animations have run for, ticked or slept through
+    GLdouble _animationTime;
+    /// \desc last tick that changed anything drawn
+    GLuint64 _changeTick;
+    /// \desc camera poses, chase targets and choices before the tick in progress
+    CameraPose _previousCameras[NUM_SIMULATION_CAMERAS];
+    glm::vec3 _previousChaseTargets[NUM_CHASE_TARGETS];
+    GLint _previousCameraIndex;
+    GLint _previousModelChoice;
+    bool _wasFlicker;
+
+    /// \desc written by the main thread, read by the simulation thread
+    SpscQueue<InputEvent, INPUT_QUEUE_CAPACITY> _inputs;
+    GLuint64 _numDroppedInputs;
+    /// \desc written by the simulation thread, read by the render thread
+    TripleBuffer<WorldSnapshot> _snapshots;
+
+    std::thread _thread;
+    std::atomic<bool> _isRunning;
+    /// \desc an idle simulation thread sleeps on this until input arrives or it is stopped
+    std::mutex _wakeMutex;
+    std::condition_variable _wake;
+    /// \desc set while the simulation thread is idle, pushInput() only takes the lock to wake it then
+    std::atomic<bool> _isSleeping;
+};
+
+#endif //MP_SIMULATION_HPP
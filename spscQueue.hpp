@@ -0,0 +1,52 @@
+#ifndef MP_SPSC_QUEUE_HPP
+#define MP_SPSC_QUEUE_HPP
+
+#include <GL/glew.h>
+
+#include <atomic>
+
+/// \desc fixed size ring of items handed from exactly one producer thread to exactly one
+/// consumer thread without locks.  each side only writes its own index, the producer
+/// publishing an item with a release store the consumer's acquire load pairs with
+/// \tparam T item type, copied in and out
+/// \tparam CAPACITY most items held at once, a power of two
+template<typename T, GLuint CAPACITY>
+class SpscQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    /// \desc adds an item, producer thread only
+    /// \return false if the queue is full, the item is not added then
+    bool push(const T& item) {
+        const GLuint tail = _tail.load(std::memory_order_relaxed);
+        // the indices only ever grow, so their difference is the number of items even once they wrap
+        if(tail - _head.load(std::memory_order_acquire) == CAPACITY) return false;
+        _items[tail & (CAPACITY - 1)] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// \desc removes the oldest item, consumer thread only
+    /// \return false if the queue is empty
+    bool pop(T& item) {
+        const GLuint head = _head.load(std::memory_order_relaxed);
+        if(head == _tail.load(std::memory_order_acquire)) return false;
+        item = _items[head & (CAPACITY - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// \desc true if there is nothing to pop, consumer thread only.  the producer may push right after
+    bool isEmpty() const {
+        return _head.load(std::memory_order_relaxed) == _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T _items[CAPACITY];
+    /// \desc next item to pop, written by the consumer; kept off the producer's cache line
+    alignas(64) std::atomic<GLuint> _head{0};
+    /// \desc next slot to push into, written by the producer
+    alignas(64) std::atomic<GLuint> _tail{0};
+};
+
+#endif //MP_SPSC_QUEUE_HPP
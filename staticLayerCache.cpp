@@ -0,0 +1,115 @@
+#include "staticLayerCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+/// \desc texture units the cached layer is read from while restoring
+static constexpr GLint COLOR_LAYER_TEXTURE_UNIT = 0;
+static constexpr GLint DEPTH_LAYER_TEXTURE_UNIT = 1;
+
+StaticLayerCache::StaticLayerCache() :
+    _width( 0 ),
+    _height( 0 ),
+    _frameUniforms(),
+    _isValid( false ),
+    _lastFrameUniforms(),
+    _lastWidth( 0 ),
+    _lastHeight( 0 ) {
+
+    glGenFramebuffers(1, &_framebuffer);
+    glGenTextures(1, &_colorTexture);
+    glGenTextures(1, &_depthTexture);
+    glGenVertexArrays(1, &_emptyVAO);
+
+    _restoreShaderProgram = new CSCI441::ShaderProgram("shaders/restoreLayer.v.glsl", "shaders/restoreLayer.f.glsl");
+    _colorLayerUniformLocation = _restoreShaderProgram->getUniformLocation("colorLayer");
+    _depthLayerUniformLocation = _restoreShaderProgram->getUniformLocation("depthLayer");
+}
+
+StaticLayerCache::~StaticLayerCache() {
+    delete _restoreShaderProgram;
+    glDeleteVertexArrays(1, &_emptyVAO);
+    glDeleteTextures(1, &_colorTexture);
+    glDeleteTextures(1, &_depthTexture);
+    glDeleteFramebuffers(1, &_framebuffer);
+}
+
+StaticLayerCache::Action StaticLayerCache::prepare(const FrameUniforms& frameUniforms, GLsizei width, GLsizei height) {
+    // FrameUniforms is all floats with its padding spelled out, so comparing the bytes is exact
+    if(_isValid && width == _width && height == _height
+       && memcmp(&frameUniforms, &_frameUniforms, sizeof(FrameUniforms)) == 0) {
+        return Action::RESTORE;
+    }
+
+    bool isStill = width == _lastWidth && height == _lastHeight
+                   && memcmp(&frameUniforms, &_lastFrameUniforms, sizeof(FrameUniforms)) == 0;
+    _lastFrameUniforms = frameUniforms;
+    _lastWidth = width;
+    _lastHeight = height;
+    return isStill ? Action::CAPTURE : Action::DRAW_DIRECTLY;
+}
+
+void StaticLayerCache::beginCapture() {
+    if(_lastWidth != _width || _lastHeight != _height) {
+        _width = _lastWidth;
+        _height = _lastHeight;
+        _allocateStorage();
+    }
+    _frameUniforms = _lastFrameUniforms;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glViewport(0, 0, _width, _height);
+    glScissor(0, 0, _width, _height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void StaticLayerCache::endCapture() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    _isValid = true;
+}
+
+void StaticLayerCache::restore(GLStateCache& stateCache) const {
+    stateCache.useProgram(_restoreShaderProgram->getShaderProgramHandle());
+    stateCache.setUniform(_colorLayerUniformLocation, COLOR_LAYER_TEXTURE_UNIT);
+    stateCache.setUniform(_depthLayerUniformLocation, DEPTH_LAYER_TEXTURE_UNIT);
+    glActiveTexture(GL_TEXTURE0 + COLOR_LAYER_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _colorTexture);
+    glActiveTexture(GL_TEXTURE0 + DEPTH_LAYER_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    // every pixel is replaced, whatever was there before and however deep
+    glDepthFunc(GL_ALWAYS);
+    glDisable(GL_BLEND);
+    stateCache.bindVertexArray(_emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_BLEND);
+    glDepthFunc(GL_LESS);
+}
+
+void StaticLayerCache::invalidate() {
+    _isValid = false;
+}
+
+void StaticLayerCache::_allocateStorage() {
+    // both layers are read back texel for texel, so no filtering
+    glBindTexture(GL_TEXTURE_2D, _colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _width, _height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, _depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, _width, _height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _colorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, _depthTexture, 0);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf( stderr, "[ERROR]: static layer framebuffer of %dx%d is incomplete\n", _width, _height );
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    _isValid = false;
+}
@@ -0,0 +1,79 @@
+#ifndef MP_STATIC_LAYER_CACHE_HPP
+#define MP_STATIC_LAYER_CACHE_HPP
+
+#include <GL/glew.h>
+
+#include <CSCI441/ShaderProgram.hpp>
+
+#include "glStateCache.hpp"
+#include "uniformBuffers.hpp"
+
+/// \desc keeps the color and depth of the static environment as last drawn, so frames where
+/// neither the camera nor the lights changed can restore them with one full screen triangle
+/// and only draw what moves on top.  the cached image is keyed by the FrameBlock it was drawn
+/// with and the framebuffer size, anything else that changes the environment must invalidate()
+class StaticLayerCache {
+public:
+    /// \desc how the static layer of a frame should be drawn
+    enum class Action {
+        /// \desc the view changed since last frame and will likely change again, skip the cache
+        DRAW_DIRECTLY,
+        /// \desc the view held still, draw the layer between beginCapture() and endCapture() then restore() it
+        CAPTURE,
+        /// \desc the cached layer is up to date, restore() it
+        RESTORE
+    };
+
+    StaticLayerCache();
+    ~StaticLayerCache();
+
+    StaticLayerCache(const StaticLayerCache&) = delete;
+    StaticLayerCache& operator=(const StaticLayerCache&) = delete;
+
+    /// \desc decides how this frame's static layer is drawn.  a view that differs from last
+    /// frame's is probably still moving, so capturing is put off until it holds still for a frame
+    /// \param frameUniforms camera and light constants of the view about to be drawn
+    /// \param width width of the target framebuffer
+    /// \param height height of the target framebuffer
+    Action prepare(const FrameUniforms& frameUniforms, GLsizei width, GLsizei height);
+
+    /// \desc binds and clears the offscreen textures so the static layer can be drawn into them,
+    /// at the size and with the constants passed to the last prepare()
+    void beginCapture();
+    /// \desc rebinds the window framebuffer, the layer is valid from now on
+    void endCapture();
+
+    /// \desc overwrites the color and depth of the bound framebuffer with the cached layer
+    /// \param stateCache cache the program and VAO binds are routed through
+    void restore(GLStateCache& stateCache) const;
+
+    /// \desc forces the layer to be redrawn, call whenever the static environment changes
+    void invalidate();
+
+private:
+    /// \desc (re)creates the textures at the current size
+    void _allocateStorage();
+
+    GLuint _framebuffer;
+    GLuint _colorTexture;
+    GLuint _depthTexture;
+    GLsizei _width;
+    GLsizei _height;
+    /// \desc constants the cached layer was drawn with
+    FrameUniforms _frameUniforms;
+    bool _isValid;
+
+    /// \desc view passed to the last prepare()
+    FrameUniforms _lastFrameUniforms;
+    GLsizei _lastWidth;
+    GLsizei _lastHeight;
+
+    /// \desc copies both textures to the bound framebuffer
+    CSCI441::ShaderProgram* _restoreShaderProgram;
+    GLint _colorLayerUniformLocation;
+    GLint _depthLayerUniformLocation;
+    /// \desc the full screen triangle is generated from gl_VertexID, but core profiles still need a VAO bound
+    GLuint _emptyVAO;
+};
+
+#endif //MP_STATIC_LAYER_CACHE_HPP
@@ -0,0 +1,110 @@
+#include "staticLighting.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+/// \desc fewest instances worth lighting as a job of their own
+static constexpr GLuint BAKE_GRAIN_SIZE = 16;
+
+StaticLighting::StaticLighting(JobSystem* jobSystem) :
+    _jobSystem( jobSystem ),
+    _bakeMilliseconds( 0.0 ) {
+
+    glGenBuffers(1, &_buffer);
+    glGenTextures(1, &_texture);
+}
+
+StaticLighting::~StaticLighting() {
+    glDeleteTextures(1, &_texture);
+    glDeleteBuffers(1, &_buffer);
+}
+
+void StaticLighting::clear() {
+    _jobs.clear();
+    _colors.clear();
+}
+
+void StaticLighting::addInstance(const Mesh* mesh, InstanceData& instance) {
+    instance.bakedLightingOffset = (GLfloat)_colors.size();
+    _jobs.push_back( { &mesh->getData(), instance } );
+    _colors.resize( _colors.size() + mesh->getData().vertices.size() );
+}
+
+void StaticLighting::bake(const FrameUniforms& lights) {
+    auto start = std::chrono::steady_clock::now();
+
+    // every instance writes its own range of _colors, so the threads share nothing
+    _jobSystem->parallelFor( _jobs.size(), BAKE_GRAIN_SIZE, [this, &lights](GLuint begin, GLuint end) {
+        for(GLuint jobIndex = begin; jobIndex < end; jobIndex++) {
+            const BakeJob& job = _jobs[jobIndex];
+            glm::vec3* colors = &_colors[(GLuint)job.instance.bakedLightingOffset];
+            for(const MeshVertex& vertex : job.meshData->vertices) {
+                *colors++ = computeVertexLighting(lights, vertex, job.instance);
+            }
+        }
+    } );
+
+    std::chrono::duration<GLdouble, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    _bakeMilliseconds = elapsed.count();
+
+    glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(_colors.size(), (size_t)1) * sizeof(glm::vec3), _colors.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, _texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, _buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void StaticLighting::bind(GLint textureUnit) const {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, _texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+glm::vec3 StaticLighting::computeVertexLighting(const FrameUniforms& lights, const MeshVertex& vertex, const InstanceData& instance) {
+    // mirrors lab05.v.glsl term for term, including its unnormalized normal
+    const glm::vec3 OBJECT_COLOR = instance.color * vertex.color;
+    const glm::vec3 NORMAL = vertex.normal * instance.normalMtx;
+    const glm::vec3 POSITION = glm::vec3( instance.modelMtx * glm::vec4(vertex.position, 1.0f) );
+
+    // point light
+    GLfloat pointLightDistance = glm::length(POSITION - lights.pointLightPosition);
+    glm::vec3 pointLightDirection = glm::normalize(lights.pointLightPosition - POSITION);
+    glm::vec3 pointLight = lights.pointLightColor * OBJECT_COLOR * std::max(glm::dot(pointLightDirection, NORMAL), 0.0f)
+                           + lights.pointLightColor * OBJECT_COLOR * 0.15f;
+    pointLight *= 1.0f / (0.5f + 0.1f * pointLightDistance + 0.02f * pointLightDistance * pointLightDistance);
+
+    // spot light, a fixed one radian cone like the shader
+    glm::vec3 spotLight(0.0f);
+    glm::vec3 spotDirection = glm::normalize(-lights.spotLightDirection);
+    glm::vec3 spotPointVector = glm::normalize(lights.spotLightPosition - POSITION);
+    GLfloat angle = acosf( glm::clamp(glm::dot(spotPointVector, spotDirection), -1.0f, 1.0f) );
+    if(angle < 1.0f) {
+        spotLight = lights.spotLightColor * OBJECT_COLOR * std::max(glm::dot(spotPointVector, NORMAL), 0.0f)
+                    + lights.spotLightColor * OBJECT_COLOR * 0.2f;
+        GLfloat spotLightDistance = glm::length(POSITION - lights.spotLightPosition);
+        spotLight *= 1.0f / (0.5f + 0.1f * spotLightDistance + 0.02f * spotLightDistance * spotLightDistance);
+    }
+
+    // directional light, banded
+    GLfloat diffuse = std::max(glm::dot(glm::normalize(-lights.lightDirection), NORMAL), 0.0f);
+    GLfloat band = 0.3f;
+    if(diffuse >= 0.95f)      band = 1.5f;
+    else if(diffuse >= 0.5f)  band = 1.0f;
+    else if(diffuse >= 0.25f) band = 0.6f;
+
+    return lights.lightColor * OBJECT_COLOR * band + pointLight + spotLight;
+}
+
+GLuint StaticLighting::getNumVertices() const {
+    return _colors.size();
+}
+
+GLuint StaticLighting::getNumThreads() const {
+    return _jobSystem->getNumThreads();
+}
+
+GLdouble StaticLighting::getBakeMilliseconds() const {
+    return _bakeMilliseconds;
+}
@@ -0,0 +1,66 @@
+#ifndef MP_STATIC_LIGHTING_HPP
+#define MP_STATIC_LIGHTING_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "jobSystem.hpp"
+#include "mesh.hpp"
+#include "uniformBuffers.hpp"
+
+#include <vector>
+
+/// \desc lights every vertex of every instance of the static environment once, on the CPU,
+/// with the same equations as lab05.v.glsl.  the colors are laid out instance after instance
+/// in a buffer texture, so the BAKED_LIGHTING permutation of lab05.v.glsl reads a vertex's
+/// color at the instance's bakedLightingOffset plus gl_VertexID instead of evaluating the
+/// lights every frame
+class StaticLighting {
+public:
+    /// \param jobSystem pool the bake is split across
+    explicit StaticLighting(JobSystem* jobSystem);
+    ~StaticLighting();
+
+    StaticLighting(const StaticLighting&) = delete;
+    StaticLighting& operator=(const StaticLighting&) = delete;
+
+    /// \desc forgets every instance added so far
+    void clear();
+    /// \desc reserves the lit colors of one instance and stores where they start in its bakedLightingOffset
+    /// \param mesh mesh the instance is drawn with, must outlive the next bake()
+    /// \param instance instance to light, its transform and color must be final
+    void addInstance(const Mesh* mesh, InstanceData& instance);
+
+    /// \desc lights every instance added since clear() and uploads the colors
+    /// \param lights light constants to bake, the view-projection matrix is ignored
+    void bake(const FrameUniforms& lights);
+    /// \desc binds the baked colors as a buffer texture
+    /// \param textureUnit unit the bakedLighting sampler reads from
+    void bind(GLint textureUnit) const;
+
+    /// \desc the color lab05.v.glsl computes for a vertex of an instance
+    static glm::vec3 computeVertexLighting(const FrameUniforms& lights, const MeshVertex& vertex, const InstanceData& instance);
+
+    GLuint getNumVertices() const;
+    GLuint getNumThreads() const;
+    /// \desc wall time the last bake() spent lighting, excluding the upload
+    GLdouble getBakeMilliseconds() const;
+
+private:
+    /// \desc an instance waiting to be lit
+    struct BakeJob {
+        const MeshData* meshData;
+        InstanceData instance;
+    };
+    std::vector<BakeJob> _jobs;
+    /// \desc lit color of every vertex of every job, laid out job after job
+    std::vector<glm::vec3> _colors;
+    JobSystem* _jobSystem;
+    GLdouble _bakeMilliseconds;
+
+    GLuint _buffer;
+    GLuint _texture;
+};
+
+#endif //MP_STATIC_LIGHTING_HPP
@@ -0,0 +1,334 @@
+#include "transformBatch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define MP_TRANSFORM_BATCH_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+// GCC and Clang only emit AVX instructions in functions that ask for them, so the rest of
+// the program can still run on CPUs without it.  MSVC always allows the intrinsics
+#if defined(__GNUC__) || defined(__clang__)
+    #define MP_TARGET_AVX __attribute__((target("avx")))
+#else
+    #define MP_TARGET_AVX
+#endif
+
+/// \desc the widest kernel processes this many matrices per iteration
+static constexpr size_t BATCH_PADDING = 8;
+
+// component indices into the SoA arrays, [column * 3 + row]
+enum Component { A0, A1, A2, B0, B1, B2, C0, C1, C2 };
+
+/// \desc inverse-transpose of the upper 3x3 of affine matrices.  with columns a, b and c the
+/// result's columns are b x c, c x a and a x b divided by the determinant a . (b x c)
+/// \param in source component arrays
+/// \param out destination component arrays
+/// \param begin first matrix to compute
+/// \param end one past the last matrix to compute
+static void computeNormalsScalar(const GLfloat* const in[9], GLfloat* const out[9], size_t begin, size_t end) {
+    for(size_t i = begin; i < end; i++) {
+        GLfloat a0 = in[A0][i], a1 = in[A1][i], a2 = in[A2][i];
+        GLfloat b0 = in[B0][i], b1 = in[B1][i], b2 = in[B2][i];
+        GLfloat c0 = in[C0][i], c1 = in[C1][i], c2 = in[C2][i];
+
+        GLfloat bc0 = b1 * c2 - b2 * c1, bc1 = b2 * c0 - b0 * c2, bc2 = b0 * c1 - b1 * c0;
+        GLfloat ca0 = c1 * a2 - c2 * a1, ca1 = c2 * a0 - c0 * a2, ca2 = c0 * a1 - c1 * a0;
+        GLfloat ab0 = a1 * b2 - a2 * b1, ab1 = a2 * b0 - a0 * b2, ab2 = a0 * b1 - a1 * b0;
+
+        GLfloat invDet = 1.0f / (a0 * bc0 + a1 * bc1 + a2 * bc2);
+
+        out[A0][i] = bc0 * invDet; out[A1][i] = bc1 * invDet; out[A2][i] = bc2 * invDet;
+        out[B0][i] = ca0 * invDet; out[B1][i] = ca1 * invDet; out[B2][i] = ca2 * invDet;
+        out[C0][i] = ab0 * invDet; out[C1][i] = ab1 * invDet; out[C2][i] = ab2 * invDet;
+    }
+}
+
+#ifdef MP_TRANSFORM_BATCH_X86
+
+/// \desc computeNormalsScalar() four matrices at a time
+/// \note end - begin must be a multiple of 4
+static void computeNormalsSse(const GLfloat* const in[9], GLfloat* const out[9], size_t begin, size_t end) {
+    for(size_t i = begin; i < end; i += 4) {
+        __m128 a0 = _mm_loadu_ps(in[A0] + i), a1 = _mm_loadu_ps(in[A1] + i), a2 = _mm_loadu_ps(in[A2] + i);
+        __m128 b0 = _mm_loadu_ps(in[B0] + i), b1 = _mm_loadu_ps(in[B1] + i), b2 = _mm_loadu_ps(in[B2] + i);
+        __m128 c0 = _mm_loadu_ps(in[C0] + i), c1 = _mm_loadu_ps(in[C1] + i), c2 = _mm_loadu_ps(in[C2] + i);
+
+        __m128 bc0 = _mm_sub_ps( _mm_mul_ps(b1, c2), _mm_mul_ps(b2, c1) );
+        __m128 bc1 = _mm_sub_ps( _mm_mul_ps(b2, c0), _mm_mul_ps(b0, c2) );
+        __m128 bc2 = _mm_sub_ps( _mm_mul_ps(b0, c1), _mm_mul_ps(b1, c0) );
+        __m128 ca0 = _mm_sub_ps( _mm_mul_ps(c1, a2), _mm_mul_ps(c2, a1) );
+        __m128 ca1 = _mm_sub_ps( _mm_mul_ps(c2, a0), _mm_mul_ps(c0, a2) );
+        __m128 ca2 = _mm_sub_ps( _mm_mul_ps(c0, a1), _mm_mul_ps(c1, a0) );
+        __m128 ab0 = _mm_sub_ps( _mm_mul_ps(a1, b2), _mm_mul_ps(a2, b1) );
+        __m128 ab1 = _mm_sub_ps( _mm_mul_ps(a2, b0), _mm_mul_ps(a0, b2) );
+        __m128 ab2 = _mm_sub_ps( _mm_mul_ps(a0, b1), _mm_mul_ps(a1, b0) );
+
+        __m128 det = _mm_add_ps( _mm_add_ps( _mm_mul_ps(a0, bc0), _mm_mul_ps(a1, bc1) ), _mm_mul_ps(a2, bc2) );
+        // a true divide rather than _mm_rcp_ps, whose 12 bits would show up as shading error
+        __m128 invDet = _mm_div_ps( _mm_set1_ps(1.0f), det );
+
+        _mm_storeu_ps( out[A0] + i, _mm_mul_ps(bc0, invDet) );
+        _mm_storeu_ps( out[A1] + i, _mm_mul_ps(bc1, invDet) );
+        _mm_storeu_ps( out[A2] + i, _mm_mul_ps(bc2, invDet) );
+        _mm_storeu_ps( out[B0] + i, _mm_mul_ps(ca0, invDet) );
+        _mm_storeu_ps( out[B1] + i, _mm_mul_ps(ca1, invDet) );
+        _mm_storeu_ps( out[B2] + i, _mm_mul_ps(ca2, invDet) );
+        _mm_storeu_ps( out[C0] + i, _mm_mul_ps(ab0, invDet) );
+        _mm_storeu_ps( out[C1] + i, _mm_mul_ps(ab1, invDet) );
+        _mm_storeu_ps( out[C2] + i, _mm_mul_ps(ab2, invDet) );
+    }
+}
+
+/// \desc computeNormalsScalar() eight matrices at a time
+/// \note end - begin must be a multiple of 8
+MP_TARGET_AVX
+static void computeNormalsAvx(const GLfloat* const in[9], GLfloat* const out[9], size_t begin, size_t end) {
+    for(size_t i = begin; i < end; i += 8) {
+        __m256 a0 = _mm256_loadu_ps(in[A0] + i), a1 = _mm256_loadu_ps(in[A1] + i), a2 = _mm256_loadu_ps(in[A2] + i);
+        __m256 b0 = _mm256_loadu_ps(in[B0] + i), b1 = _mm256_loadu_ps(in[B1] + i), b2 = _mm256_loadu_ps(in[B2] + i);
+        __m256 c0 = _mm256_loadu_ps(in[C0] + i), c1 = _mm256_loadu_ps(in[C1] + i), c2 = _mm256_loadu_ps(in[C2] + i);
+
+        __m256 bc0 = _mm256_sub_ps( _mm256_mul_ps(b1, c2), _mm256_mul_ps(b2, c1) );
+        __m256 bc1 = _mm256_sub_ps( _mm256_mul_ps(b2, c0), _mm256_mul_ps(b0, c2) );
+        __m256 bc2 = _mm256_sub_ps( _mm256_mul_ps(b0, c1), _mm256_mul_ps(b1, c0) );
+        __m256 ca0 = _mm256_sub_ps( _mm256_mul_ps(c1, a2), _mm256_mul_ps(c2, a1) );
+        __m256 ca1 = _mm256_sub_ps( _mm256_mul_ps(c2, a0), _mm256_mul_ps(c0, a2) );
+        __m256 ca2 = _mm256_sub_ps( _mm256_mul_ps(c0, a1), _mm256_mul_ps(c1, a0) );
+        __m256 ab0 = _mm256_sub_ps( _mm256_mul_ps(a1, b2), _mm256_mul_ps(a2, b1) );
+        __m256 ab1 = _mm256_sub_ps( _mm256_mul_ps(a2, b0), _mm256_mul_ps(a0, b2) );
+        __m256 ab2 = _mm256_sub_ps( _mm256_mul_ps(a0, b1), _mm256_mul_ps(a1, b0) );
+
+        __m256 det = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps(a0, bc0), _mm256_mul_ps(a1, bc1) ), _mm256_mul_ps(a2, bc2) );
+        __m256 invDet = _mm256_div_ps( _mm256_set1_ps(1.0f), det );
+
+        _mm256_storeu_ps( out[A0] + i, _mm256_mul_ps(bc0, invDet) );
+        _mm256_storeu_ps( out[A1] + i, _mm256_mul_ps(bc1, invDet) );
+        _mm256_storeu_ps( out[A2] + i, _mm256_mul_ps(bc2, invDet) );
+        _mm256_storeu_ps( out[B0] + i, _mm256_mul_ps(ca0, invDet) );
+        _mm256_storeu_ps( out[B1] + i, _mm256_mul_ps(ca1, invDet) );
+        _mm256_storeu_ps( out[B2] + i, _mm256_mul_ps(ca2, invDet) );
+        _mm256_storeu_ps( out[C0] + i, _mm256_mul_ps(ab0, invDet) );
+        _mm256_storeu_ps( out[C1] + i, _mm256_mul_ps(ab1, invDet) );
+        _mm256_storeu_ps( out[C2] + i, _mm256_mul_ps(ab2, invDet) );
+    }
+    // leave the upper halves clean so following SSE code does not pay a transition penalty
+    _mm256_zeroupper();
+}
+
+/// \desc asks the CPU and the OS whether AVX registers can be used
+static bool isAvxSupported() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    bool cpuHasAvx = (info[2] & (1 << 28)) != 0;
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    return cpuHasAvx && osSavesYmm;
+#else
+    // also checks that the OS saves the upper register halves
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+#endif
+
+TransformBatch::Isa TransformBatch::getSupportedIsa() {
+#ifdef MP_TRANSFORM_BATCH_X86
+    static const Isa isa = isAvxSupported() ? Isa::AVX : Isa::SSE;
+    return isa;
+#else
+    return Isa::SCALAR;
+#endif
+}
+
+const char* TransformBatch::getIsaName(Isa isa) {
+    switch(isa) {
+        case Isa::SSE: return "SSE";
+        case Isa::AVX: return "AVX";
+        default:       return "scalar";
+    }
+}
+
+void TransformBatch::clear() {
+    _modelMatrices.clear();
+    for(GLuint component = 0; component < NUM_COMPONENTS; component++) {
+        _linear[component].clear();
+    }
+    _projectiveIndices.clear();
+}
+
+GLuint TransformBatch::add(const glm::mat4& modelMtx) {
+    GLuint index = _modelMatrices.size();
+    _modelMatrices.push_back(modelMtx);
+    for(GLuint column = 0; column < 3; column++) {
+        for(GLuint row = 0; row < 3; row++) {
+            std::vector<GLfloat>& component = _linear[column * 3 + row];
+            // drop padding left by an earlier computeNormalMatrices()
+            component.resize(index);
+            component.push_back( modelMtx[column][row] );
+        }
+    }
+    if(modelMtx[0][3] != 0.0f || modelMtx[1][3] != 0.0f || modelMtx[2][3] != 0.0f || modelMtx[3][3] != 1.0f) {
+        _projectiveIndices.push_back(index);
+    }
+    return index;
+}
+
+size_t TransformBatch::size() const {
+    return _modelMatrices.size();
+}
+
+void TransformBatch::computeNormalMatrices(Isa isa) {
+    size_t count = _modelMatrices.size();
+    size_t paddedCount = (count + BATCH_PADDING - 1) / BATCH_PADDING * BATCH_PADDING;
+
+    const GLfloat* in[NUM_COMPONENTS];
+    GLfloat* out[NUM_COMPONENTS];
+    for(GLuint component = 0; component < NUM_COMPONENTS; component++) {
+        // pad with identity matrices so the unused lanes never divide by zero
+        bool isDiagonal = component == A0 || component == B1 || component == C2;
+        _linear[component].resize( paddedCount, isDiagonal ? 1.0f : 0.0f );
+        _normal[component].resize( paddedCount );
+        in[component] = _linear[component].data();
+        out[component] = _normal[component].data();
+    }
+
+    switch(isa) {
+#ifdef MP_TRANSFORM_BATCH_X86
+        case Isa::AVX: computeNormalsAvx(in, out, 0, paddedCount); break;
+        case Isa::SSE: computeNormalsSse(in, out, 0, paddedCount); break;
+#endif
+        default:       computeNormalsScalar(in, out, 0, count); break;
+    }
+
+    // the cofactor form only holds for affine matrices
+    for(GLuint index : _projectiveIndices) {
+        glm::mat3 normalMtx = glm::mat3( glm::transpose( glm::inverse( _modelMatrices[index] ) ) );
+        for(GLuint column = 0; column < 3; column++) {
+            for(GLuint row = 0; row < 3; row++) {
+                _normal[column * 3 + row][index] = normalMtx[column][row];
+            }
+        }
+    }
+}
+
+TransformUniforms TransformBatch::getTransformUniforms(GLuint index) const {
+    TransformUniforms transform;
+    transform.modelMtx = _modelMatrices[index];
+    for(GLuint column = 0; column < 3; column++) {
+        transform.normalMtx[column] = glm::vec4( _normal[column * 3 + 0][index],
+                                                 _normal[column * 3 + 1][index],
+                                                 _normal[column * 3 + 2][index],
+                                                 0.0f );
+    }
+    return transform;
+}
+
+/// \desc runs a function repeatedly and keeps the fastest run, so scheduling noise does not skew the result
+/// \return nanoseconds per matrix of the fastest run
+template<typename Function>
+static GLdouble timePerMatrix(size_t numMatrices, Function function) {
+    static constexpr GLuint NUM_RUNS = 20;
+    GLdouble best = HUGE_VAL;
+    for(GLuint run = 0; run < NUM_RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<GLdouble, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min( best, elapsed.count() / (GLdouble)numMatrices );
+    }
+    return best;
+}
+
+bool benchmarkTransformBatch(size_t numMatrices) {
+    // fixed seed so every run checks the same matrices
+    std::mt19937 generator(441);
+    std::uniform_real_distribution<GLfloat> entry(-1.0f, 1.0f);
+
+    std::vector<glm::mat4> matrices(numMatrices);
+    for(size_t i = 0; i < numMatrices; i++) {
+        glm::mat4& matrix = matrices[i];
+        for(GLuint column = 0; column < 4; column++) {
+            for(GLuint row = 0; row < 3; row++) {
+                matrix[column][row] = entry(generator);
+            }
+            matrix[column][3] = 0.0f;
+        }
+        // keep the linear part well conditioned so the comparison measures the kernels, not float cancellation
+        for(GLuint axis = 0; axis < 3; axis++) {
+            matrix[axis][axis] += 3.0f;
+        }
+        matrix[3][3] = 1.0f;
+        // exercise the projective fallback as well
+        if(i % 64 == 0) {
+            matrix[0][3] = 0.1f * entry(generator);
+        }
+    }
+
+    // the per-draw path the batch replaced, makeTransformUniforms() written out so the test
+    // target can link this file without the GL sources
+    std::vector<glm::mat3> reference(numMatrices);
+    GLdouble glmTime = timePerMatrix(numMatrices, [&]() {
+        for(size_t i = 0; i < numMatrices; i++) {
+            reference[i] = glm::mat3( glm::transpose( glm::inverse( matrices[i] ) ) );
+        }
+    });
+    fprintf(stdout, "[INFO]: normal matrices of %zu transforms\n", numMatrices);
+    fprintf(stdout, "[INFO]: %-8s %7.2f ns/matrix\n", "glm", glmTime);
+
+    // relative to the largest entry of each reference matrix, about 80 ulps.  glm::inverse expands
+    // the full 4x4 and rounds its own way, so it only agrees with the kernels to within both their
+    // errors; transformBatchTest holds the kernels to the exact result and to each other bit for bit
+    static constexpr GLfloat TOLERANCE = 1e-5f;
+
+    using Isa = TransformBatch::Isa;
+
+    bool isCorrect = true;
+    Isa supported = TransformBatch::getSupportedIsa();
+    // normal matrices of the scalar kernel, the SIMD ones must reproduce them exactly
+    std::vector<TransformUniforms> scalar(numMatrices);
+    for(Isa isa : { Isa::SCALAR, Isa::SSE, Isa::AVX }) {
+        if(isa > supported) continue;
+
+        TransformBatch batch;
+        for(const glm::mat4& matrix : matrices) {
+            batch.add(matrix);
+        }
+        GLdouble batchTime = timePerMatrix(numMatrices, [&]() { batch.computeNormalMatrices(isa); });
+
+        GLfloat maxError = 0.0f;
+        bool isExact = true;
+        for(size_t i = 0; i < numMatrices; i++) {
+            TransformUniforms transform = batch.getTransformUniforms(i);
+            GLfloat scale = 0.0f, error = 0.0f;
+            for(GLuint column = 0; column < 3; column++) {
+                for(GLuint row = 0; row < 3; row++) {
+                    scale = std::max( scale, fabsf(reference[i][column][row]) );
+                    error = std::max( error, fabsf(transform.normalMtx[column][row] - reference[i][column][row]) );
+                }
+            }
+            maxError = std::max( maxError, error / scale );
+
+            if(isa == Isa::SCALAR) {
+                scalar[i] = transform;
+            } else {
+                isExact = isExact && memcmp(transform.normalMtx, scalar[i].normalMtx, sizeof(transform.normalMtx)) == 0;
+            }
+        }
+
+        bool isMatch = maxError <= TOLERANCE && isExact;
+        isCorrect = isCorrect && isMatch;
+        fprintf(stdout, "[INFO]: %-8s %7.2f ns/matrix (%.2fx glm), max relative error %g%s %s\n",
+                TransformBatch::getIsaName(isa), batchTime, glmTime / batchTime, maxError,
+                isa == Isa::SCALAR ? "" : (isExact ? ", bit-exact to scalar" : ", differs from scalar"), isMatch ? "ok" : "MISMATCH");
+    }
+    return isCorrect;
+}
@@ -0,0 +1,61 @@
+#ifndef MP_TRANSFORM_BATCH_HPP
+#define MP_TRANSFORM_BATCH_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "uniformBuffers.hpp"
+
+#include <cstddef>
+#include <vector>
+
+/// \desc collects every model matrix recorded in a frame and computes their normal matrices
+/// together.  the upper 3x3 of each matrix is kept in structure-of-arrays form so SSE and AVX
+/// kernels can invert 4 or 8 matrices at once.  affine matrices take a fast path using the
+/// cofactor form of the inverse-transpose, anything projective falls back to glm::inverse
+class TransformBatch {
+public:
+    /// \desc instruction sets the kernels are written for
+    enum class Isa { SCALAR, SSE, AVX };
+
+    /// \desc best instruction set the running CPU supports, detected once
+    static Isa getSupportedIsa();
+    static const char* getIsaName(Isa isa);
+
+    /// \desc removes every matrix so the next frame can be recorded
+    void clear();
+    /// \desc appends a model matrix
+    /// \return index of the matrix within the batch
+    GLuint add(const glm::mat4& modelMtx);
+    size_t size() const;
+
+    /// \desc computes the normal matrix of every matrix added since the last clear()
+    /// \param isa kernel to use, must be supported by the running CPU
+    void computeNormalMatrices(Isa isa = getSupportedIsa());
+
+    /// \desc packs a matrix and its normal matrix as a TransformBlock
+    /// \param index value returned by add()
+    /// \note computeNormalMatrices() must have been called since the matrix was added
+    TransformUniforms getTransformUniforms(GLuint index) const;
+
+private:
+    /// \desc SoA component arrays, indexed [column * 3 + row] of the upper 3x3
+    static constexpr GLuint NUM_COMPONENTS = 9;
+
+    /// \desc full matrices, used for the model matrix itself and the projective fallback
+    std::vector<glm::mat4> _modelMatrices;
+    /// \desc upper 3x3 of each model matrix, padded to a multiple of 8 entries
+    std::vector<GLfloat> _linear[NUM_COMPONENTS];
+    /// \desc inverse-transpose of the upper 3x3, same layout as _linear
+    std::vector<GLfloat> _normal[NUM_COMPONENTS];
+    /// \desc indices of matrices whose bottom row is not (0,0,0,1)
+    std::vector<GLuint> _projectiveIndices;
+};
+
+/// \desc checks every supported kernel against glm and reports how long each takes per matrix
+/// \param numMatrices number of random matrices to test with
+/// \return true if every kernel matches glm
+bool benchmarkTransformBatch(size_t numMatrices);
+
+#endif //MP_TRANSFORM_BATCH_HPP
@@ -0,0 +1,176 @@
+#include "transformBatch.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// checks the normal matrices TransformBatch computes, run by ctest.
+//
+// the SSE and AVX kernels evaluate the same cofactor formula as the scalar one with the same
+// operations in the same order, and IEEE float arithmetic rounds each of those the same way in
+// a vector lane as in a scalar register, so they must match it bit for bit.  the same holds for
+// the projective fallback, which is glm::inverse whichever kernel ran.
+//
+// the scalar kernel itself cannot match an exact inverse: every cofactor and the determinant
+// are rounded to float.  it is checked against the formula evaluated in double instead, within
+// MAX_ULPS units in the last place of the largest entry of the matrix.  the products of a
+// cofactor are rounded once each and their difference once more, the determinant adds three
+// more roundings and the reciprocal and the final product one each; with the linear part kept
+// well conditioned, as below, that comes to a little over 5 ulps at worst
+
+/// \desc most units in the last place the scalar kernel may be from the exact inverse-transpose
+static constexpr GLdouble MAX_ULPS = 8.0;
+
+/// \desc builds the matrices the test runs on, some projective so the fallback is covered
+/// \param numMatrices number of matrices, deliberately not a multiple of the SIMD widths
+static std::vector<glm::mat4> makeTestMatrices(size_t numMatrices) {
+    // fixed seed so every run checks the same matrices
+    std::mt19937 generator(441);
+    std::uniform_real_distribution<GLfloat> entry(-1.0f, 1.0f);
+    // uniform scales of the whole linear part, scene objects range from tiny to huge
+    static const GLfloat SCALES[] = { 1.0f, 0.001f, 0.25f, 3.0f, 1000.0f };
+
+    std::vector<glm::mat4> matrices(numMatrices);
+    for(size_t i = 0; i < numMatrices; i++) {
+        glm::mat4& matrix = matrices[i];
+        for(GLuint column = 0; column < 4; column++) {
+            for(GLuint row = 0; row < 3; row++) {
+                matrix[column][row] = entry(generator);
+            }
+            matrix[column][3] = 0.0f;
+        }
+        // keep the linear part well conditioned, the bound is on the kernel rather than on float cancellation
+        for(GLuint axis = 0; axis < 3; axis++) {
+            matrix[axis][axis] += 3.0f;
+        }
+        // every eighth matrix mirrored, so negative determinants are covered
+        const GLfloat SCALE = SCALES[i % 5] * (i % 8 == 7 ? -1.0f : 1.0f);
+        for(GLuint column = 0; column < 3; column++) {
+            for(GLuint row = 0; row < 3; row++) {
+                matrix[column][row] *= SCALE;
+            }
+        }
+        matrix[3][3] = 1.0f;
+        if(i % 64 == 0) {
+            matrix[0][3] = 0.1f * entry(generator);
+        }
+    }
+    return matrices;
+}
+
+/// \desc inverse-transpose of the upper 3x3 by the scalar kernel's formula, in double
+static void computeExactNormalMatrix(const glm::mat4& modelMtx, GLdouble normalMtx[3][3]) {
+    GLdouble a[3], b[3], c[3];
+    for(GLuint row = 0; row < 3; row++) {
+        a[row] = modelMtx[0][row];
+        b[row] = modelMtx[1][row];
+        c[row] = modelMtx[2][row];
+    }
+    const GLdouble* columns[3][2] = { {b, c}, {c, a}, {a, b} };
+    for(GLuint column = 0; column < 3; column++) {
+        const GLdouble* u = columns[column][0];
+        const GLdouble* v = columns[column][1];
+        normalMtx[column][0] = u[1] * v[2] - u[2] * v[1];
+        normalMtx[column][1] = u[2] * v[0] - u[0] * v[2];
+        normalMtx[column][2] = u[0] * v[1] - u[1] * v[0];
+    }
+    const GLdouble DETERMINANT = a[0] * normalMtx[0][0] + a[1] * normalMtx[0][1] + a[2] * normalMtx[0][2];
+    for(GLuint column = 0; column < 3; column++) {
+        for(GLuint row = 0; row < 3; row++) {
+            normalMtx[column][row] /= DETERMINANT;
+        }
+    }
+}
+
+/// \desc true if the normal matrices of two transforms have identical bits
+static bool isSameNormalMatrix(const TransformUniforms& a, const TransformUniforms& b) {
+    return memcmp(a.normalMtx, b.normalMtx, sizeof(a.normalMtx)) == 0;
+}
+
+int main() {
+    static constexpr size_t NUM_MATRICES = 10003;
+    const std::vector<glm::mat4> MATRICES = makeTestMatrices(NUM_MATRICES);
+
+    TransformBatch batch;
+    for(const glm::mat4& matrix : MATRICES) {
+        batch.add(matrix);
+    }
+
+    using Isa = TransformBatch::Isa;
+
+    batch.computeNormalMatrices(Isa::SCALAR);
+    std::vector<TransformUniforms> scalar(NUM_MATRICES);
+    for(size_t i = 0; i < NUM_MATRICES; i++) {
+        scalar[i] = batch.getTransformUniforms(i);
+    }
+
+    bool isCorrect = true;
+
+    // the scalar kernel against the exact result, and the fallback against what it calls
+    GLdouble maxUlps = 0.0;
+    GLuint numFallbackMismatches = 0;
+    for(size_t i = 0; i < NUM_MATRICES; i++) {
+        const glm::mat4& matrix = MATRICES[i];
+        if(matrix[0][3] != 0.0f || matrix[1][3] != 0.0f || matrix[2][3] != 0.0f || matrix[3][3] != 1.0f) {
+            glm::mat3 normalMtx = glm::mat3( glm::transpose( glm::inverse( matrix ) ) );
+            for(GLuint column = 0; column < 3; column++) {
+                glm::vec4 expected = glm::vec4(normalMtx[column], 0.0f);
+                if(memcmp(&expected, &scalar[i].normalMtx[column], sizeof(expected)) != 0) {
+                    numFallbackMismatches++;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        GLdouble exact[3][3];
+        computeExactNormalMatrix(matrix, exact);
+        GLdouble scale = 0.0, error = 0.0;
+        for(GLuint column = 0; column < 3; column++) {
+            for(GLuint row = 0; row < 3; row++) {
+                scale = std::max( scale, fabs(exact[column][row]) );
+                error = std::max( error, fabs(scalar[i].normalMtx[column][row] - exact[column][row]) );
+            }
+        }
+        // spacing of the floats around the largest entry
+        GLdouble ulp = ldexp( 1.0, ilogb(scale) - 23 );
+        maxUlps = std::max( maxUlps, error / ulp );
+    }
+    bool isAccurate = maxUlps <= MAX_ULPS;
+    isCorrect = isCorrect && isAccurate && numFallbackMismatches == 0;
+    fprintf(stdout, "[INFO]: %-8s max error %.2f ulps of the largest entry (at most %.0f) %s\n",
+            TransformBatch::getIsaName(Isa::SCALAR), maxUlps, MAX_ULPS, isAccurate ? "ok" : "FAILED");
+    fprintf(stdout, "[INFO]: %-8s %u projective matrices differ from glm::inverse %s\n",
+            "fallback", numFallbackMismatches, numFallbackMismatches == 0 ? "ok" : "FAILED");
+
+    // the SIMD kernels against the scalar one
+    Isa supported = TransformBatch::getSupportedIsa();
+    for(Isa isa : { Isa::SSE, Isa::AVX }) {
+        if(isa > supported) {
+            fprintf(stdout, "[INFO]: %-8s not supported by this CPU, skipped\n", TransformBatch::getIsaName(isa));
+            continue;
+        }
+
+        batch.computeNormalMatrices(isa);
+        GLuint numMismatches = 0;
+        for(size_t i = 0; i < NUM_MATRICES; i++) {
+            if(!isSameNormalMatrix(batch.getTransformUniforms(i), scalar[i])) {
+                if(numMismatches == 0) {
+                    fprintf(stderr, "[ERROR]: %s normal matrix %zu differs from the scalar kernel\n", TransformBatch::getIsaName(isa), i);
+                }
+                numMismatches++;
+            }
+        }
+        isCorrect = isCorrect && numMismatches == 0;
+        fprintf(stdout, "[INFO]: %-8s %u of %zu normal matrices differ from the scalar kernel %s\n",
+                TransformBatch::getIsaName(isa), numMismatches, NUM_MATRICES, numMismatches == 0 ? "ok" : "FAILED");
+    }
+
+    return isCorrect ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,156 @@
+#include "transformHierarchy.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265
+#endif
+
+GLuint TransformHierarchy::addNode(GLuint parent) {
+    Node node;
+    node.parent = parent;
+    node.current.translation = glm::vec3(0.0f);
+    node.current.angle = 0.0f;
+    node.current.axis = glm::vec3(0.0f, 1.0f, 0.0f);
+    node.current.scale = glm::vec3(1.0f);
+    node.previous = node.current;
+    node.worldMtx = glm::mat4(1.0f);
+    node.isDirty = false;
+    node.isMoving = false;
+    node.wasUpdated = false;
+    _nodes.push_back(node);
+
+    // an identity node still inherits its parent's placement
+    GLuint index = _nodes.size() - 1;
+    _nodes[index].isDirty = true;
+    _isDirty = true;
+    return index;
+}
+
+void TransformHierarchy::setTranslation(GLuint node, const glm::vec3& translation) {
+    if(_nodes[node].current.translation == translation) return;
+    _nodes[node].current.translation = translation;
+    _setMoved(node);
+}
+
+void TransformHierarchy::setRotation(GLuint node, GLfloat angle, const glm::vec3& axis) {
+    if(_nodes[node].current.angle == angle && _nodes[node].current.axis == axis) return;
+    _nodes[node].current.angle = angle;
+    _nodes[node].current.axis = axis;
+    _setMoved(node);
+}
+
+void TransformHierarchy::setScale(GLuint node, const glm::vec3& scale) {
+    if(_nodes[node].current.scale == scale) return;
+    _nodes[node].current.scale = scale;
+    _setMoved(node);
+}
+
+void TransformHierarchy::_setMoved(GLuint node) {
+    _nodes[node].isDirty = true;
+    _nodes[node].isMoving = true;
+    _isDirty = true;
+    _isMoving = true;
+}
+
+void TransformHierarchy::beginTick() {
+    if(!_isMoving) return;
+
+    // a node that moved last tick starts this one where it ended up
+    for(Node& node : _nodes) {
+        if(!node.isMoving) continue;
+        node.previous = node.current;
+        node.isMoving = false;
+        node.isDirty = true;
+        _isDirty = true;
+    }
+    _isMoving = false;
+}
+
+glm::mat4 TransformHierarchy::_interpolate(const Node& node, GLfloat alpha) {
+    const LocalTransform& previous = node.previous;
+    const LocalTransform& current = node.current;
+
+    // written so that a node that did not move lands exactly on its current transform
+    glm::vec3 translation = previous.translation + (current.translation - previous.translation) * alpha;
+    glm::vec3 scale = previous.scale + (current.scale - previous.scale) * alpha;
+    GLfloat angle = current.angle;
+    if(previous.axis == current.axis) {
+        // angles wrap, so turn the short way round
+        GLfloat delta = std::remainder(current.angle - previous.angle, 2.0f * static_cast<GLfloat>(M_PI));
+        angle = previous.angle + delta * alpha;
+    }
+
+    glm::mat4 localMtx = glm::translate( glm::mat4(1.0f), translation );
+    if(angle != 0.0f) {
+        localMtx = glm::rotate( localMtx, angle, current.axis );
+    }
+    return glm::scale( localMtx, scale );
+}
+
+void TransformHierarchy::update(GLfloat alpha) {
+    _numUpdated = 0;
+    // moving nodes are placed by alpha, so they change every frame between ticks
+    const bool IS_ALPHA_CHANGED = _isMoving && alpha != _alpha;
+    _alpha = alpha;
+    if(!_isDirty && !IS_ALPHA_CHANGED) return;
+
+    // parents precede their children, so a parent's flags are final by the time a child reads them
+    for(Node& node : _nodes) {
+        bool isParentUpdated = node.parent != NO_PARENT && _nodes[node.parent].wasUpdated;
+        node.wasUpdated = node.isDirty || (node.isMoving && IS_ALPHA_CHANGED) || isParentUpdated;
+        if(!node.wasUpdated) continue;
+
+        glm::mat4 localMtx = _interpolate(node, alpha);
+        node.worldMtx = node.parent == NO_PARENT ? localMtx : _nodes[node.parent].worldMtx * localMtx;
+        node.isDirty = false;
+        _numUpdated++;
+    }
+    _isDirty = false;
+}
+
+void TransformHierarchy::getTransforms(std::vector<LocalTransform>& previous, std::vector<LocalTransform>& current) const {
+    previous.resize(_nodes.size());
+    current.resize(_nodes.size());
+    for(GLuint i = 0; i < _nodes.size(); i++) {
+        previous[i] = _nodes[i].previous;
+        current[i] = _nodes[i].current;
+    }
+}
+
+void TransformHierarchy::setTransforms(const std::vector<LocalTransform>& previous, const std::vector<LocalTransform>& current) {
+    _isMoving = false;
+    for(GLuint i = 0; i < _nodes.size(); i++) {
+        Node& node = _nodes[i];
+        if(!_isEqual(node.previous, previous[i]) || !_isEqual(node.current, current[i])) {
+            node.previous = previous[i];
+            node.current = current[i];
+            node.isDirty = true;
+            _isDirty = true;
+        }
+        node.isMoving = !_isEqual(node.previous, node.current);
+        if(node.isMoving) _isMoving = true;
+    }
+}
+
+bool TransformHierarchy::_isEqual(const LocalTransform& a, const LocalTransform& b) {
+    return a.translation == b.translation && a.angle == b.angle && a.axis == b.axis && a.scale == b.scale;
+}
+
+const glm::mat4& TransformHierarchy::getWorldMatrix(GLuint node) const {
+    return _nodes[node].worldMtx;
+}
+
+GLuint TransformHierarchy::getNumNodes() const {
+    return _nodes.size();
+}
+
+bool TransformHierarchy::isMoving() const {
+    return _isMoving;
+}
+
+GLuint TransformHierarchy::getNumUpdated() const {
+    return _numUpdated;
+}
@@ -0,0 +1,101 @@
+#ifndef MP_TRANSFORM_HIERARCHY_HPP
+#define MP_TRANSFORM_HIERARCHY_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/// \desc parts of the characters arranged as a tree of translate-rotate-scale nodes.  every node
+/// caches its world matrix and is only recomputed when it or one of its ancestors changed since
+/// the last update(), so a character standing still costs no matrix math at all.  parents are
+/// always added before their children, which lets a single pass in index order update the tree.
+/// each node keeps its transform as of the previous simulation tick too, so frames drawn between
+/// two ticks place it part way from one to the other
+class TransformHierarchy {
+public:
+    /// \desc parent index of a root node
+    static constexpr GLuint NO_PARENT = 0xFFFFFFFF;
+
+    /// \desc transform of a node relative to its parent
+    struct LocalTransform {
+        glm::vec3 translation;
+        GLfloat angle;
+        glm::vec3 axis;
+        glm::vec3 scale;
+    };
+
+    /// \desc adds an identity node
+    /// \param parent node the new node is placed relative to, must already exist
+    /// \return index of the node
+    GLuint addNode(GLuint parent = NO_PARENT);
+
+    /// \desc sets the translation of a node relative to its parent
+    void setTranslation(GLuint node, const glm::vec3& translation);
+    /// \desc sets the rotation of a node, applied after its scale and before its translation
+    /// \param angle rotation in radians
+    /// \param axis axis to rotate about
+    void setRotation(GLuint node, GLfloat angle, const glm::vec3& axis);
+    /// \desc sets the scale of a node, applied before its rotation
+    void setScale(GLuint node, const glm::vec3& scale);
+
+    /// \desc makes the current transforms the previous ones, call before a simulation tick moves anything
+    void beginTick();
+
+    /// \desc recomputes the world matrix of every node that changed and everything below it
+    /// \param alpha how far between the previous and the current tick to place the nodes, 0 to 1
+    void update(GLfloat alpha = 1.0f);
+
+    /// \desc copies out the transform of every node before and after the current tick
+    /// \param previous receives the transforms as of beginTick(), indexed by node
+    /// \param current receives the transforms as of now, indexed by node
+    void getTransforms(std::vector<LocalTransform>& previous, std::vector<LocalTransform>& current) const;
+    /// \desc replaces the transforms of every node, e.g. with those a copy of this hierarchy
+    /// handed out with getTransforms() on another thread.  only nodes that differ are dirtied
+    /// \param previous transforms before the tick, indexed by node
+    /// \param current transforms after the tick, indexed by node
+    void setTransforms(const std::vector<LocalTransform>& previous, const std::vector<LocalTransform>& current);
+
+    /// \desc world matrix as of the last update()
+    const glm::mat4& getWorldMatrix(GLuint node) const;
+
+    GLuint getNumNodes() const;
+    /// \desc true if any node moved during the current tick
+    bool isMoving() const;
+    /// \desc number of world matrices the last update() recomputed
+    GLuint getNumUpdated() const;
+
+private:
+    struct Node {
+        GLuint parent;
+        /// \desc transform set during the current tick
+        LocalTransform current;
+        /// \desc transform as of the end of the previous tick
+        LocalTransform previous;
+        glm::mat4 worldMtx;
+        /// \desc local transform changed since the last update
+        bool isDirty;
+        /// \desc current and previous transforms differ, so the world matrix depends on alpha
+        bool isMoving;
+        /// \desc world matrix was recomputed by the last update, so its children must be too
+        bool wasUpdated;
+    };
+
+    /// \desc marks a node dirty and moving
+    void _setMoved(GLuint node);
+    /// \desc local matrix of a node part way from its previous to its current transform
+    static glm::mat4 _interpolate(const Node& node, GLfloat alpha);
+    static bool _isEqual(const LocalTransform& a, const LocalTransform& b);
+
+    std::vector<Node> _nodes;
+    /// \desc true if any node is dirty, lets update() return without touching the nodes
+    bool _isDirty = false;
+    /// \desc true if any node is moving, lets beginTick() return without touching the nodes
+    bool _isMoving = false;
+    /// \desc alpha of the last update
+    GLfloat _alpha = 1.0f;
+    GLuint _numUpdated = 0;
+};
+
+#endif //MP_TRANSFORM_HIERARCHY_HPP
@@ -0,0 +1,57 @@
+#ifndef MP_TRIPLE_BUFFER_HPP
+#define MP_TRIPLE_BUFFER_HPP
+
+#include <GL/glew.h>
+
+#include <atomic>
+
+/// \desc hands the latest of a stream of values from one writer thread to one reader thread
+/// without either ever waiting on the other.  the writer fills its own buffer and swaps it
+/// with the spare one, the reader swaps its buffer with the spare one whenever the spare
+/// holds something newer, so each side always owns a buffer the other cannot touch.  values
+/// the reader was too slow to see are simply replaced
+/// \tparam T value type, buffers are reused so their allocations are too
+template<typename T>
+class TripleBuffer {
+public:
+    /// \desc buffer to fill before publish(), writer thread only
+    T& getWriteBuffer() {
+        return _buffers[_writeIndex];
+    }
+
+    /// \desc makes the write buffer the latest value, writer thread only.  the next write
+    /// buffer is whatever the reader is not holding, its contents are stale
+    void publish() {
+        const GLuint spare = _spare.exchange(_writeIndex | IS_FRESH, std::memory_order_acq_rel);
+        _writeIndex = spare & INDEX_MASK;
+    }
+
+    /// \desc takes the latest published value if there is a newer one, reader thread only
+    /// \return true if the read buffer changed
+    bool acquire() {
+        if((_spare.load(std::memory_order_relaxed) & IS_FRESH) == 0) return false;
+        const GLuint spare = _spare.exchange(_readIndex, std::memory_order_acq_rel);
+        _readIndex = spare & INDEX_MASK;
+        return true;
+    }
+
+    /// \desc value as of the last acquire(), reader thread only
+    const T& getReadBuffer() const {
+        return _buffers[_readIndex];
+    }
+
+private:
+    static constexpr GLuint INDEX_MASK = 3;
+    /// \desc set on the spare index when it holds a value the reader has not taken yet
+    static constexpr GLuint IS_FRESH = 4;
+
+    T _buffers[3];
+    /// \desc owned by the writer
+    alignas(64) GLuint _writeIndex = 0;
+    /// \desc buffer neither side holds, swapped by both
+    alignas(64) std::atomic<GLuint> _spare{1};
+    /// \desc owned by the reader
+    alignas(64) GLuint _readIndex = 2;
+};
+
+#endif //MP_TRIPLE_BUFFER_HPP
@@ -0,0 +1,154 @@
+#include "uniformBuffers.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+TransformUniforms makeTransformUniforms(const glm::mat4& modelMtx) {
+    TransformUniforms transform;
+    transform.modelMtx = modelMtx;
+    glm::mat3 normalMtx = glm::mat3( glm::transpose( glm::inverse( modelMtx ) ) );
+    for(GLint column = 0; column < 3; column++) {
+        transform.normalMtx[column] = glm::vec4(normalMtx[column], 0.0f);
+    }
+    return transform;
+}
+
+UniformRingBuffer::UniformRingBuffer(GLsizeiptr bytesPerFrame, GLuint framesInFlight) {
+    _bytesPerFrame = bytesPerFrame;
+    _framesInFlight = framesInFlight;
+    _currentFrame = 0;
+    _frameOffset = 0;
+    _baseOffset = 0;
+
+    _fences = new GLsync[framesInFlight];
+    for(GLuint i = 0; i < framesInFlight; i++) _fences[i] = nullptr;
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &_offsetAlignment);
+
+    if( !GLEW_ARB_buffer_storage ) {
+        fprintf( stdout, "[INFO]: ARB_buffer_storage unavailable, uniform blocks will use glBufferSubData\n" );
+    }
+    _allocate();
+}
+
+UniformRingBuffer::~UniformRingBuffer() {
+    for(GLuint i = 0; i < _framesInFlight; i++) {
+        if(_fences[i] != nullptr) glDeleteSync(_fences[i]);
+    }
+    delete[] _fences;
+
+    for(const RetiredBuffer& retired : _retiredBuffers) {
+        _release(retired.handle, retired.mappedMemory);
+    }
+    _release(_handle, _mappedMemory);
+}
+
+void UniformRingBuffer::_allocate() {
+    const GLsizeiptr totalSize = _bytesPerFrame * _framesInFlight;
+    _mappedMemory = nullptr;
+    glGenBuffers(1, &_handle);
+    glBindBuffer(GL_UNIFORM_BUFFER, _handle);
+    if( GLEW_ARB_buffer_storage ) {
+        // map once for the lifetime of the buffer; coherent so writes need no explicit flush
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, totalSize, nullptr, flags);
+        _mappedMemory = (GLubyte*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, totalSize, flags);
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformRingBuffer::_release(GLuint handle, GLubyte* mappedMemory) {
+    if(mappedMemory != nullptr) {
+        glBindBuffer(GL_UNIFORM_BUFFER, handle);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &handle);
+}
+
+void UniformRingBuffer::_grow(GLsizeiptr minBytesPerFrame) {
+    // blocks written this frame may still be bound later this frame and are read by the GPU
+    // after it, so the old buffer lives on until the fence of this region has passed
+    const GLsizeiptr oldSize = _bytesPerFrame * _framesInFlight;
+    _retiredBuffers.push_back( { _handle, _mappedMemory, _baseOffset, oldSize, _currentFrame } );
+    _baseOffset += oldSize;
+
+    do {
+        _bytesPerFrame *= 2;
+    } while(_bytesPerFrame < minBytesPerFrame);
+    _allocate();
+    _frameOffset = 0;
+    fprintf( stdout, "[INFO]: uniform ring buffer grew to %ld bytes per frame\n", (long)_bytesPerFrame );
+}
+
+void UniformRingBuffer::beginFrame() {
+    _currentFrame = (_currentFrame + 1) % _framesInFlight;
+    _frameOffset = 0;
+
+    // block until the GPU is done with the last frame that used this region
+    GLsync& fence = _fences[_currentFrame];
+    if(fence != nullptr) {
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while(result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // buffers outgrown by that frame are no longer read either
+    for(size_t i = 0; i < _retiredBuffers.size(); ) {
+        if(_retiredBuffers[i].frame == _currentFrame) {
+            _release(_retiredBuffers[i].handle, _retiredBuffers[i].mappedMemory);
+            _retiredBuffers.erase(_retiredBuffers.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
+
+void UniformRingBuffer::endFrame() {
+    _fences[_currentFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr UniformRingBuffer::write(const void* data, GLsizeiptr size) {
+    // starting over at the front of the region would overwrite blocks draws of this frame still read
+    if(_frameOffset + size > _bytesPerFrame) {
+        _grow(size);
+    }
+
+    GLintptr offset = _currentFrame * _bytesPerFrame + _frameOffset;
+    if(_mappedMemory != nullptr) {
+        memcpy(_mappedMemory + offset, data, size);
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, _handle);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    }
+
+    // round up so the next block starts on a legal binding offset
+    _frameOffset += ((size + _offsetAlignment - 1) / _offsetAlignment) * _offsetAlignment;
+    return _baseOffset + offset;
+}
+
+void UniformRingBuffer::bind(GLuint bindingPoint, GLintptr offset, GLsizeiptr size) const {
+    if(offset >= _baseOffset) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, _handle, offset - _baseOffset, size);
+        return;
+    }
+    for(const RetiredBuffer& retired : _retiredBuffers) {
+        if(offset >= retired.baseOffset && offset < retired.baseOffset + retired.size) {
+            glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, retired.handle, offset - retired.baseOffset, size);
+            return;
+        }
+    }
+}
+
+GLuint UniformRingBuffer::getHandle() const {
+    return _handle;
+}
+
+bool UniformRingBuffer::isPersistentlyMapped() const {
+    return _mappedMemory != nullptr;
+}
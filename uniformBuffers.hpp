@@ -0,0 +1,159 @@
+#ifndef MP_UNIFORM_BUFFERS_HPP
+#define MP_UNIFORM_BUFFERS_HPP
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/// \desc binding point of the per-view FrameBlock in lab05.v.glsl
+static constexpr GLuint FRAME_BLOCK_BINDING = 0;
+/// \desc binding point of the per-draw TransformBlock in lab05.v.glsl
+static constexpr GLuint TRANSFORM_BLOCK_BINDING = 1;
+/// \desc binding point of the split-screen ViewBlock in splitScreen.g.glsl
+static constexpr GLuint VIEW_BLOCK_BINDING = 2;
+/// \desc binding point of the per-view ClusterBlock in clusteredLights.f.glsl
+static constexpr GLuint CLUSTER_BLOCK_BINDING = 3;
+
+/// \desc most views drawn in a single split-screen pass, must match splitScreen.g.glsl
+static constexpr GLuint MAX_SPLIT_SCREEN_VIEWS = 4;
+
+/// \desc camera and light constants shared by every draw in a view, laid out to match
+/// the std140 FrameBlock in lab05.v.glsl
+struct FrameUniforms {
+    glm::mat4 viewProjectionMtx;
+    glm::vec3 lightColor;
+    GLfloat spotLightPhi;
+    glm::vec3 lightDirection;
+    GLfloat padding0;
+    glm::vec3 pointLightColor;
+    GLfloat padding1;
+    glm::vec3 pointLightPosition;
+    GLfloat padding2;
+    glm::vec3 spotLightColor;
+    GLfloat padding3;
+    glm::vec3 spotLightPosition;
+    GLfloat padding4;
+    glm::vec3 spotLightDirection;
+    GLfloat padding5;
+};
+
+/// \desc cameras of every split-screen view, laid out to match the std140 ViewBlock in splitScreen.g.glsl
+struct ViewUniforms {
+    glm::mat4 viewProjectionMtx[MAX_SPLIT_SCREEN_VIEWS];
+    GLint numViews;
+    GLint padding[3];
+};
+
+/// \desc how a view's fragments find their light cluster, laid out to match the std140 ClusterBlock
+/// in clusteredLights.f.glsl
+struct ClusterUniforms {
+    /// \desc clusters per framebuffer pixel along x and y
+    glm::vec2 clusterScale;
+    /// \desc depth slice of a fragment is log(view depth) * sliceScale + sliceBias
+    GLfloat sliceScale;
+    GLfloat sliceBias;
+    /// \desc lights in the light buffer, 0 skips the clustered lights entirely
+    GLint numLights;
+    GLint padding[3];
+};
+
+/// \desc matrices for a single draw, laid out to match the std140 TransformBlock in lab05.v.glsl.
+/// holds nothing camera dependent so one block can be shared by every view in a frame
+struct TransformUniforms {
+    glm::mat4 modelMtx;
+    /// \desc std140 stores each column of a mat3 in its own vec4
+    glm::vec4 normalMtx[3];
+};
+
+/// \desc precomputes the normal matrix for a draw
+/// \param modelMtx model transformation matrix
+TransformUniforms makeTransformUniforms(const glm::mat4& modelMtx);
+
+/// \desc uniform buffer split into one region per frame in flight.  each frame's uniform
+/// blocks are written linearly into mapped memory and draws bind an offset into it.  a
+/// fence guards every region so the CPU never overwrites blocks the GPU is still reading.
+/// a frame that runs out of room moves to a larger buffer rather than reusing its region
+class UniformRingBuffer {
+public:
+    /// \desc allocates and maps the buffer
+    /// \param bytesPerFrame space available to a single frame
+    /// \param framesInFlight number of frames the CPU may run ahead of the GPU
+    UniformRingBuffer(GLsizeiptr bytesPerFrame, GLuint framesInFlight);
+    ~UniformRingBuffer();
+
+    UniformRingBuffer(const UniformRingBuffer&) = delete;
+    UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+
+    /// \desc moves to the next region, waiting until the GPU has finished reading it
+    void beginFrame();
+    /// \desc fences the region written this frame
+    void endFrame();
+
+    /// \desc copies a block into the current frame's region, growing the buffer if the region is full
+    /// \param data block to copy
+    /// \param size size of the block in bytes
+    /// \return offset of the block, only meaningful to bind()
+    GLintptr write(const void* data, GLsizeiptr size);
+
+    /// \desc binds a block previously written this frame to a uniform block binding point
+    /// \param bindingPoint uniform block binding point
+    /// \param offset offset returned by write(), may lie in a buffer replaced since
+    /// \param size size of the block in bytes
+    void bind(GLuint bindingPoint, GLintptr offset, GLsizeiptr size) const;
+
+    /// \desc writes a block and binds it to a uniform block binding point
+    template<typename T>
+    void push(GLuint bindingPoint, const T& block) {
+        bind(bindingPoint, write(&block, sizeof(T)), sizeof(T));
+    }
+
+    /// \desc buffer blocks are currently written to
+    GLuint getHandle() const;
+    /// \desc true if the buffer is written through a persistent mapping, false if each
+    /// block is uploaded with glBufferSubData because ARB_buffer_storage is missing
+    bool isPersistentlyMapped() const;
+
+private:
+    /// \desc a buffer outgrown part way through a frame, kept until that frame's fence has passed
+    struct RetiredBuffer {
+        GLuint handle;
+        GLubyte* mappedMemory;
+        /// \desc offsets write() handed out for this buffer start here
+        GLintptr baseOffset;
+        GLsizeiptr size;
+        /// \desc region whose fence covers the last frame that used the buffer
+        GLuint frame;
+    };
+
+    /// \desc creates and maps a buffer with room for every frame in flight
+    void _allocate();
+    /// \desc unmaps and deletes a buffer
+    static void _release(GLuint handle, GLubyte* mappedMemory);
+    /// \desc retires the current buffer and allocates one with at least twice the room per frame
+    /// \param minBytesPerFrame size of the block that did not fit, the new region holds at least that
+    void _grow(GLsizeiptr minBytesPerFrame);
+
+    GLuint _handle;
+    /// \desc start of the persistent mapping, nullptr when falling back to glBufferSubData
+    GLubyte* _mappedMemory;
+    /// \desc offsets of the current buffer handed out by write() start here, past those of every
+    /// buffer it replaced so bind() can tell which buffer an offset belongs to
+    GLintptr _baseOffset;
+    GLsizeiptr _bytesPerFrame;
+    GLuint _framesInFlight;
+    /// \desc GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, every block must start on a multiple of this
+    GLint _offsetAlignment;
+
+    /// \desc region currently being written
+    GLuint _currentFrame;
+    /// \desc next free byte within the current region
+    GLsizeiptr _frameOffset;
+    /// \desc fence placed after the last use of each region
+    GLsync* _fences;
+    /// \desc buffers replaced while frames still in flight may read them
+    std::vector<RetiredBuffer> _retiredBuffers;
+};
+
+#endif //MP_UNIFORM_BUFFERS_HPP